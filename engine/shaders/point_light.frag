@@ -1,6 +1,7 @@
 #version 450
 
 layout (location = 0) in vec2 fragOffset;
+layout (location = 1) flat in vec3 fragColor;
 layout (location = 0) out vec4 outColor;
 
 struct PointLight {
@@ -13,16 +14,12 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 view;
 	mat4 inverseView;
 	vec4 ambientLightColor;
-	PointLight pointLights[10];
+	vec4 viewport;
+	uvec4 clusterCount;
+	vec4 clusterDepth;
 	int numLights;
 } ubo;
 
-layout (push_constant) uniform Push {
-	vec4 position;
-	vec4 color;
-	float radius;
-} push;
-
 const float M_PI = 3.1415926538;
 
 void main() {
@@ -33,8 +30,8 @@ void main() {
 
 	// smooth step
 	float alpha = smoothstep(1.0, 0.0, dist);
-	outColor = vec4(push.color.xyz, alpha);
+	outColor = vec4(fragColor, alpha);
 
 	// cosine
-	// outColor = vec4(push.color.xyz, 0.5 * cos((dist * M_PI) + 1.0));
+	// outColor = vec4(fragColor, 0.5 * cos((dist * M_PI) + 1.0));
 }
\ No newline at end of file
@@ -11,6 +11,7 @@ const vec2 OFFSETS[6] = vec2[](
 );
 
 layout (location = 0) out vec2 fragOffset;
+layout (location = 1) flat out vec3 fragColor;
 
 struct PointLight {
 	vec4 position;
@@ -22,24 +23,32 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 view;
 	mat4 inverseView;
 	vec4 ambientLightColor;
-	PointLight pointLights[10];
+	vec4 viewport;
+	uvec4 clusterCount;
+	vec4 clusterDepth;
 	int numLights;
 } ubo;
 
-layout (push_constant) uniform Push {
-	vec4 position;
-	vec4 color;
-	float radius;
-} push;
+layout(std430, set = 0, binding = 1) readonly buffer Lights {
+	PointLight lights[];
+};
+
+layout(std430, set = 0, binding = 4) readonly buffer LightBillboards {
+	float billboardRadii[];
+};
 
 void main() {
+	PointLight light = lights[gl_InstanceIndex];
+	float radius = billboardRadii[gl_InstanceIndex];
+	fragColor = light.color.xyz;
+
 	fragOffset = OFFSETS[gl_VertexIndex];
 	vec3 cameraRightWorld = {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};
 	vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
 
-	vec3 positionWorld = push.position.xyz
-		+ push.radius * fragOffset.x * cameraRightWorld
-		+ push.radius * fragOffset.y * cameraUpWorld;
+	vec3 positionWorld = light.position.xyz
+		+ radius * fragOffset.x * cameraRightWorld
+		+ radius * fragOffset.y * cameraUpWorld;
 
 	gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
 }
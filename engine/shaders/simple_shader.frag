@@ -3,6 +3,7 @@
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec3 fragPosWorld;
 layout(location = 2) in vec3 fragNormalWorld;
+layout(location = 3) in vec4 fragTangentWorld; // w is the bitangent's handedness, for normal maps
 
 layout(location = 0) out vec4 outColor;
 
@@ -16,10 +17,29 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 view;
 	mat4 inverseView;
 	vec4 ambientLightColor;
-	PointLight pointLights[10];
+	vec4 viewport;
+	uvec4 clusterCount;
+	vec4 clusterDepth;
 	int numLights;
 } ubo;
 
+struct LightCluster {
+	uint offset;
+	uint count;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Lights {
+	PointLight lights[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Clusters {
+	LightCluster clusters[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer LightIndices {
+	uint lightIndices[];
+};
+
 layout(push_constant) uniform Push {
 	mat4 modelMatrix;
 	mat4 normalMatrix;
@@ -33,10 +53,23 @@ void main() {
 	vec3 cameraPosWorld = ubo.inverseView[3].xyz;
 	vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
 
-	for (int i = 0; i < ubo.numLights; i++) {
-		PointLight light = ubo.pointLights[i];
+	// find the froxel this fragment lies in, the grid is binned on the cpu with the same slicing
+	float viewDepth = (ubo.view * vec4(fragPosWorld, 1.0)).z;
+	uvec2 tile = uvec2(gl_FragCoord.xy * ubo.viewport.zw * vec2(ubo.clusterCount.xy));
+	uint slice = uint(max(log(viewDepth) * ubo.clusterDepth.x + ubo.clusterDepth.y, 0.0));
+	tile = min(tile, ubo.clusterCount.xy - 1u);
+	slice = min(slice, ubo.clusterCount.z - 1u);
+	LightCluster cluster = clusters[(slice * ubo.clusterCount.y + tile.y) * ubo.clusterCount.x + tile.x];
+
+	for (uint i = 0; i < cluster.count; i++) {
+		PointLight light = lights[lightIndices[cluster.offset + i]];
 		vec3 directionToLight = light.position.xyz - fragPosWorld.xyz;
-		float attenuation = 1.0 / dot(directionToLight, directionToLight);
+		float distanceSquared = dot(directionToLight, directionToLight);
+
+		// inverse square falloff windowed to reach zero at the light's influence radius
+		float falloff = distanceSquared / (light.position.w * light.position.w);
+		float window = clamp(1.0 - falloff * falloff, 0.0, 1.0);
+		float attenuation = window * window / distanceSquared;
 		directionToLight = normalize(directionToLight);
 
 		// diffuse
@@ -1,13 +1,21 @@
 #version 450
 
+// BveModel::VertexFormat, FULL = 0 or PACKED = 1
+layout(constant_id = 0) const uint VERTEX_FORMAT = 0;
+const uint VERTEX_FORMAT_PACKED = 1;
+
+// packed positions arrive as unorm values within the mesh bounds and are dequantized by the model matrix,
+// packed normals are two octahedral coordinates and packed tangents a unorm16 angle around the normal
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec2 uv;
+layout(location = 4) in vec4 tangent;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
+layout(location = 3) out vec4 fragTangentWorld;
 
 struct PointLight {
 	vec4 position;
@@ -19,7 +27,9 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 view;
 	mat4 inverseView;
 	vec4 ambientLightColor;
-	PointLight pointLights[10];
+	vec4 viewport;
+	uvec4 clusterCount;
+	vec4 clusterDepth;
 	int numLights;
 } ubo;
 
@@ -28,11 +38,43 @@ layout(push_constant) uniform Push {
 	mat4 normalMatrix;
 } push;
 
+vec3 decodeOctahedral(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0) {
+		vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+		n.xy = (1.0 - abs(n.yx)) * signs;
+	}
+	return normalize(n);
+}
+
+// the angle is measured from the tangent of mesh_attributes::buildBasis, the top bit flips the bitangent
+vec4 decodeTangent(vec3 n, float packed) {
+	const float PI = 3.14159265;
+	uint bits = uint(round(packed * 65535.0));
+	float angle = (float(bits & 0x7fffu) / 32767.0 * 2.0 - 1.0) * PI;
+
+	float s = n.z >= 0.0 ? 1.0 : -1.0;
+	float a = -1.0 / (s + n.z);
+	float b = n.x * n.y * a;
+	vec3 basisTangent = vec3(1.0 + s * n.x * n.x * a, s * b, -s * n.x);
+	vec3 basisBitangent = vec3(b, s + n.y * n.y * a, -n.y);
+	return vec4(basisTangent * cos(angle) + basisBitangent * sin(angle), (bits & 0x8000u) != 0u ? -1.0 : 1.0);
+}
+
 void main() {
 	vec4 positionWorld = push.modelMatrix * vec4(position,1.0);
 	gl_Position = ubo.projection * ubo.view * positionWorld;
 
-	fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+	vec3 normalModel = VERTEX_FORMAT == VERTEX_FORMAT_PACKED ? decodeOctahedral(normal.xy) : normal;
+	vec4 tangentModel = VERTEX_FORMAT == VERTEX_FORMAT_PACKED ? decodeTangent(normalModel, tangent.x) : tangent;
+	vec3 normalWorld = normalize(mat3(push.normalMatrix) * normalModel);
+	fragNormalWorld = normalWorld;
+	// the model matrix of packed meshes carries the dequantization scale, so the tangent goes through the normal
+	// matrix too. Under non uniform scale that tilts it off the surface and turns it a little within it, the tilt
+	// is removed here so the basis the fragment shader builds stays orthonormal
+	vec3 tangentWorld = normalize(mat3(push.normalMatrix) * tangentModel.xyz);
+	tangentWorld = normalize(tangentWorld - normalWorld * dot(normalWorld, tangentWorld));
+	fragTangentWorld = vec4(tangentWorld, tangentModel.w);
 	fragPosWorld = positionWorld.xyz;
 	fragColor = color;
 }
\ No newline at end of file
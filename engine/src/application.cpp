@@ -7,7 +7,11 @@
 #include "systems/camera_system.h"
 #include "systems/point_light_render_system.h"
 #include "systems/movement_system.h"
+#include "systems/transform_system.h"
 #include "master_renderer.h"
+#include "asset_manager.h"
+#include "image_writer.h"
+#include "core/profiler.h"
 #include "log.h"
 
 #include <imgui.h>
@@ -18,40 +22,56 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 
 namespace bve
 {
+	// written next to the loose models by the AssetArchive build target
+	constexpr const char* MODEL_ARCHIVE = "models.igpak";
+	// shared with the AssetImporter tool run from the same directory, created on the first run
+	constexpr const char* IMPORT_DATABASE = "models.igdb";
+
 	Application::Application()
 	{
 	}
 
 	Application::~Application() = default;
 
-	void loadEntities(EntityManager& entityManager, BveDevice& device)
+	void loadEntities(EntityManager& entityManager, AssetManager& assetManager)
 	{
+		IG_PROFILE_FUNCTION();
+		// meshes missing from the archive, or all of them without one, are read from the loose files
+		if (std::filesystem::exists(MODEL_ARCHIVE)) {
+			assetManager.mountArchive(MODEL_ARCHIVE);
+		}
+		assetManager.openImportDatabase(IMPORT_DATABASE);
+
 		LOG_INFO("loading entities");
 		const Entity modelEntity = entityManager.createEntity("Guy");
-		std::unique_ptr<BveModel> model = BveModel::createModelFromFile(device, "models/LowPolyCharacter.obj");
-		entityManager.addComponent<RenderComponent>(modelEntity, { std::move(model), glm::vec3{} });
+		const MeshHandle model = assetManager.loadMesh("models/LowPolyCharacter.obj");
+		entityManager.addComponent<RenderComponent>(modelEntity, { model, glm::vec3{} });
 		entityManager.addComponent<TransformComponent>(modelEntity, TransformComponent{ {1.f, -1.f, 0.0f} });
 		entityManager.addComponent<MoveComponent, RotateComponent>(modelEntity);
 
 		//const Entity cubeEntity = entityManager.createEntity("Cube");
-		//std::unique_ptr<BveModel> cubeModel = BveModel::createModelFromFile(bveDevice_, "models/colored_cube.obj");
-		//entityManager.addComponent<RenderComponent>(cubeEntity, {std::move(cubeModel), glm::vec3{}});
+		//const MeshHandle cubeModel = assetManager.loadMesh("models/colored_cube.obj");
+		//entityManager.addComponent<RenderComponent>(cubeEntity, {cubeModel, glm::vec3{}});
 		//entityManager.addComponent<TransformComponent>(cubeEntity, {{-2.5f, -2.5f, -0.5f}});
 		//entityManager.addComponent<MoveComponent, RotateComponent, PlayerTag>(cubeEntity);
 
 		const Entity floorEntity = entityManager.createEntity("Floor");
-		std::unique_ptr<BveModel> floorModel = BveModel::createModelFromFile(device, "models/quad.obj");
-		entityManager.addComponent<RenderComponent>(floorEntity, { std::move(floorModel), glm::vec3{} });
+		const MeshHandle floorModel = assetManager.loadMesh("models/quad.obj", BveModel::VertexFormat::PACKED, true);
+		entityManager.addComponent<RenderComponent>(floorEntity, { floorModel, glm::vec3{} });
 		entityManager.addComponent<TransformComponent>(floorEntity, { {0.5f, 0.5f, 0.f}, {10.f, 1.f, 10.f} });
-		entityManager.addComponent<MoveComponent, RotateComponent>(floorEntity);
+		entityManager.addComponent<MoveComponent, RotateComponent, OccluderTag>(floorEntity);
 
 		const Entity smoothVase = entityManager.createEntity("Smooth Vase");
-		std::unique_ptr<BveModel> smoothVaseModel = BveModel::createModelFromFile(device, "models/smooth_vase.obj");
-		entityManager.addComponent<RenderComponent>(smoothVase, { std::move(smoothVaseModel), glm::vec3{} });
+		const MeshHandle smoothVaseModel = assetManager.loadMesh("models/smooth_vase.obj");
+		entityManager.addComponent<RenderComponent>(smoothVase, { smoothVaseModel, glm::vec3{} });
 		entityManager.addComponent<TransformComponent>(smoothVase, { {0.5f, -0.f, 0.f} });
 		entityManager.addComponent<MoveComponent, RotateComponent>(smoothVase);
 
@@ -73,30 +93,44 @@ namespace bve
 
 	void Application::run()
 	{
+		IG_PROFILE_THREAD("main");
+		const auto startTime = std::chrono::high_resolution_clock::now();
 		BveWindow bveWindow{ WIDTH, HEIGHT, "Hello Vulkan!" };
 		BveDevice bveDevice{ bveWindow };
-		loadEntities(entityManager_, bveDevice);
+		AssetManager assetManager{ bveDevice };
+		loadEntities(entityManager_, assetManager);
 
 		InputController inputController{entityManager_};
-		MasterRenderer renderer{bveWindow, bveDevice, entityManager_};
+		MasterRenderer renderer{bveWindow, bveDevice, entityManager_, assetManager};
 		CameraSystem cameraSystem{entityManager_};
 		MovementSystem movementSystem{entityManager_};
+		TransformSystem transformSystem{entityManager_};
 
 		float aspectRatio = renderer.getAspectRatio();
 		auto currentTime = std::chrono::high_resolution_clock::now();
+		bool firstFrame = true;
 
 		while (!bveWindow.shouldClose()) {
-			glfwPollEvents();
+			IG_PROFILE_FRAME();
+			IG_PROFILE_SCOPE("frame");
+			{
+				IG_PROFILE_SCOPE("poll events");
+				glfwPollEvents();
+			}
 
 			auto newTime = std::chrono::high_resolution_clock::now();
 			const float frameDt = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
 			currentTime = newTime;
 
+			// meshes that finished loading are uploaded and drawn from this frame on
+			assetManager.update();
+
 			// process inputs
 			inputController.update(bveWindow.getGLFWWindow());
 
 			// physics
 			movementSystem.update(frameDt);
+			transformSystem.update();
 
 			// cameras
 			cameraSystem.update(aspectRatio);
@@ -106,11 +140,114 @@ namespace bve
 			if (!renderer.renderFrame(frameDt)) {
 				aspectRatio = renderer.getAspectRatio();
 			}
+
+			if (firstFrame) {
+				const float elapsed = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+				LOG_INFO("first frame after {:.1f} ms, {} assets still loading", elapsed, assetManager.getPendingCount());
+				firstFrame = false;
+			}
 		}
 
 		vkDeviceWaitIdle(bveDevice.device());
 	}
 
+	void Application::runHeadless(const HeadlessOptions& options)
+	{
+		IG_PROFILE_THREAD("main");
+		BveDevice bveDevice{};
+		AssetManager assetManager{ bveDevice };
+		loadEntities(entityManager_, assetManager);
+		// captures have to be reproducible, so they never show placeholders
+		assetManager.waitAll();
+
+		MasterRenderer renderer{bveDevice, {options.width, options.height}, entityManager_, assetManager};
+		CameraSystem cameraSystem{entityManager_};
+		MovementSystem movementSystem{entityManager_};
+		TransformSystem transformSystem{entityManager_};
+
+		const float aspectRatio = renderer.getAspectRatio();
+		LOG_INFO("rendering {} headless frames at {}x{}", options.frameCount, options.width, options.height);
+
+		const auto startTime = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < options.frameCount; frame++) {
+			IG_PROFILE_FRAME();
+			IG_PROFILE_SCOPE("frame");
+			movementSystem.update(options.frameTime);
+			transformSystem.update();
+			cameraSystem.update(aspectRatio);
+
+			const bool capture = std::ranges::find(options.captureFrames, frame) != options.captureFrames.end();
+			if (capture) {
+				renderer.requestCapture();
+			}
+
+			renderer.renderFrame(options.frameTime);
+
+			if (capture) {
+				IG_PROFILE_SCOPE("write capture");
+				const std::string path = options.outputPrefix + "_" + std::to_string(frame) + ".png";
+				const VkExtent2D extent = renderer.getExtent();
+				writePng(path, extent.width, extent.height, renderer.getCapturedPixels());
+				LOG_INFO("captured frame {} to {}", frame, path);
+			}
+		}
+
+		vkDeviceWaitIdle(bveDevice.device());
+
+		if (!options.gpuTimingsPath.empty()) {
+			renderer.getGpuProfiler().exportCsv(options.gpuTimingsPath);
+		}
+		if (!options.tracePath.empty()) {
+			Profiler::writeChromeTrace(options.tracePath);
+		}
+
+		const float elapsed = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+		LOG_INFO("rendered {} frames in {:.1f} ms, {:.3f} ms per frame", options.frameCount, elapsed, elapsed / std::max(options.frameCount, 1u));
+	}
+
+	std::optional<HeadlessOptions> Application::parseHeadlessOptions(int argc, char** argv)
+	{
+		const bool headless = std::any_of(argv + 1, argv + argc, [](const char* arg) { return std::strcmp(arg, "--headless") == 0; });
+		if (!headless) {
+			return std::nullopt;
+		}
+
+		HeadlessOptions options{};
+		for (int i = 1; i < argc; i++) {
+			const char* arg = argv[i];
+			const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+			if (std::strcmp(arg, "--headless") == 0) {
+				continue;
+			}
+
+			if (!value) {
+				throw std::runtime_error(std::string{"missing value for argument: "} + arg);
+			}
+
+			if (std::strcmp(arg, "--frames") == 0) {
+				options.frameCount = static_cast<uint32_t>(std::stoul(value));
+			} else if (std::strcmp(arg, "--capture") == 0) {
+				options.captureFrames.push_back(static_cast<uint32_t>(std::stoul(value)));
+			} else if (std::strcmp(arg, "--size") == 0) {
+				if (std::sscanf(value, "%ux%u", &options.width, &options.height) != 2 || options.width == 0 || options.height == 0) {
+					throw std::runtime_error(std::string{"invalid size, expected WxH: "} + value);
+				}
+			} else if (std::strcmp(arg, "--output") == 0) {
+				options.outputPrefix = value;
+			} else if (std::strcmp(arg, "--gpu-timings") == 0) {
+				options.gpuTimingsPath = value;
+			} else if (std::strcmp(arg, "--trace") == 0) {
+				options.tracePath = value;
+			} else {
+				throw std::runtime_error(std::string{"unknown argument: "} + arg);
+			}
+			i++;
+		}
+
+		return options;
+	}
+
 	void subdivideTriangle(int subdivisionIterations, std::vector<BveModel::Vertex>& inVertices, std::vector<BveModel::Vertex>& outVertices)
 	{
 		if (subdivisionIterations == 0) {
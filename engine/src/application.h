@@ -3,8 +3,26 @@
 #include "defines.h"
 #include "entity_manager.h"
 
+#include <optional>
+#include <string>
+#include <vector>
+
 namespace bve
 {
+	// Renders without a window into offscreen images, stepping the simulation by a fixed frameTime so runs are
+	// reproducible. Captured frames are written to outputPrefix_<frame>.png
+	struct HeadlessOptions
+	{
+		uint32_t width = 1280;
+		uint32_t height = 720;
+		uint32_t frameCount = 60;
+		float frameTime = 1.f / 60.f;
+		std::vector<uint32_t> captureFrames{};
+		std::string outputPrefix = "frame";
+		std::string gpuTimingsPath{}; // csv export of the gpu profiler, skipped if empty
+		std::string tracePath{}; // chrome trace of the cpu profiling zones, skipped if empty or built without IG_PROFILE
+	};
+
 	IG_API class Application
 	{
 	public:
@@ -20,6 +38,11 @@ namespace bve
 		Application& operator=(const Application&&) = delete;
 
 		void run();
+		void runHeadless(const HeadlessOptions& options);
+
+		// empty unless --headless is passed. Also takes --frames N, --capture N (repeatable), --size WxH, --output prefix,
+		// --gpu-timings file.csv, --trace file.json
+		static std::optional<HeadlessOptions> parseHeadlessOptions(int argc, char** argv);
 
 	private:
 		EntityManager entityManager_{};
@@ -0,0 +1,355 @@
+#include "pch.h"
+#include "asset_archive.h"
+#include "bve_utils.h"
+#include "core/compression.h"
+#include "core/profiler.h"
+#include "core/thread_pool.h"
+#include "log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+namespace bve
+{
+	namespace
+	{
+		constexpr uint32_t MAGIC = 0x4b504749; // "IGPK"
+		// blocks decompress in parallel, a few per task keeps the scheduling cost small next to the work
+		constexpr uint32_t BLOCKS_PER_TASK = 4;
+
+		// little endian, the table of contents follows at tocOffset and the names right after it
+		struct FileHeader
+		{
+			uint32_t magic;
+			uint32_t formatVersion;
+			uint32_t entryCount;
+			uint32_t namesSize;
+			uint64_t tocOffset;
+			uint64_t namesOffset;
+			uint64_t fileSize;
+			uint64_t reserved;
+		};
+
+		// a compressed entry starts with the stored size of each block, a block stored as large as it decompresses
+		// to didn't compress and is kept as is
+		struct TocEntry
+		{
+			uint64_t offset;
+			uint64_t storedSize;
+			uint64_t size;
+			uint64_t contentHash;
+			uint32_t nameOffset;
+			uint32_t nameLength;
+			uint32_t compression;
+			uint32_t blockCount;
+		};
+
+		static_assert(std::is_trivially_copyable_v<FileHeader> && sizeof(FileHeader) == 48);
+		static_assert(std::is_trivially_copyable_v<TocEntry> && sizeof(TocEntry) == 48);
+
+		uint64_t alignOffset(uint64_t offset)
+		{
+			return (offset + AssetArchive::ENTRY_ALIGNMENT - 1) & ~(AssetArchive::ENTRY_ALIGNMENT - 1);
+		}
+
+		uint32_t getBlockCount(uint64_t size)
+		{
+			return static_cast<uint32_t>((size + AssetArchive::BLOCK_SIZE - 1) / AssetArchive::BLOCK_SIZE);
+		}
+
+		uint32_t getBlockSize(uint64_t size, uint32_t block)
+		{
+			return static_cast<uint32_t>(std::min<uint64_t>(AssetArchive::BLOCK_SIZE, size - static_cast<uint64_t>(block) * AssetArchive::BLOCK_SIZE));
+		}
+
+		// the block size table followed by every block
+		std::vector<std::byte> compressEntry(std::span<const std::byte> data)
+		{
+			const uint32_t blockCount = getBlockCount(data.size());
+			std::vector<std::vector<std::byte>> blocks(blockCount);
+			ThreadPool::instance().parallelFor(blockCount, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++) {
+					const std::span<const std::byte> block = data.subspan(static_cast<size_t>(i) * AssetArchive::BLOCK_SIZE, getBlockSize(data.size(), i));
+					blocks[i].resize(compression::getCompressBound(block.size()));
+					const size_t compressedSize = compression::compressBlock(block, blocks[i]);
+					if (compressedSize < block.size()) {
+						blocks[i].resize(compressedSize);
+					} else {
+						blocks[i].assign(block.begin(), block.end());
+					}
+				}
+			});
+
+			std::vector<std::byte> stored(blockCount * sizeof(uint32_t));
+			for (uint32_t i = 0; i < blockCount; i++) {
+				const auto storedSize = static_cast<uint32_t>(blocks[i].size());
+				std::memcpy(stored.data() + i * sizeof(uint32_t), &storedSize, sizeof(storedSize));
+				stored.insert(stored.end(), blocks[i].begin(), blocks[i].end());
+			}
+			return stored;
+		}
+	}
+
+	AssetArchive::AssetArchive(const std::string& path) : path_{path}, file_{path}
+	{
+		IG_PROFILE_FUNCTION();
+		auto malformed = [&path](const char* reason) {
+			return std::runtime_error("malformed asset archive " + path + ": " + reason);
+		};
+
+		FileHeader header{};
+		if (file_.size() < sizeof(header)) {
+			throw malformed("truncated header");
+		}
+		std::memcpy(&header, file_.data(), sizeof(header));
+		if (header.magic != MAGIC) {
+			throw malformed("not an asset archive");
+		}
+		if (header.formatVersion != FORMAT_VERSION) {
+			throw malformed("unsupported format version");
+		}
+
+		const uint64_t fileSize = file_.size();
+		auto fits = [fileSize](uint64_t offset, uint64_t size) {
+			return offset <= fileSize && size <= fileSize - offset;
+		};
+		if (header.fileSize != fileSize
+			|| !fits(header.tocOffset, static_cast<uint64_t>(header.entryCount) * sizeof(TocEntry))
+			|| !fits(header.namesOffset, header.namesSize)) {
+			throw malformed("table of contents out of bounds");
+		}
+
+		const auto* names = reinterpret_cast<const char*>(file_.data() + header.namesOffset);
+		entries_.reserve(header.entryCount);
+		for (uint32_t i = 0; i < header.entryCount; i++) {
+			TocEntry toc{};
+			std::memcpy(&toc, file_.data() + header.tocOffset + i * sizeof(TocEntry), sizeof(toc));
+
+			if (toc.nameOffset > header.namesSize || toc.nameLength > header.namesSize - toc.nameOffset) {
+				throw malformed("entry name out of bounds");
+			}
+			if (toc.offset % ENTRY_ALIGNMENT != 0 || !fits(toc.offset, toc.storedSize)) {
+				throw malformed("entry out of bounds");
+			}
+
+			const auto compression = static_cast<Compression>(toc.compression);
+			if (compression == Compression::NONE) {
+				if (toc.storedSize != toc.size || toc.blockCount != 0) {
+					throw malformed("uncompressed entry with a different stored size");
+				}
+			} else if (compression == Compression::LZ4) {
+				if (toc.blockCount != getBlockCount(toc.size) || toc.storedSize < toc.blockCount * sizeof(uint32_t)) {
+					throw malformed("compressed entry with the wrong number of blocks");
+				}
+			} else {
+				throw malformed("unknown compression");
+			}
+
+			Entry& entry = entries_.emplace_back();
+			entry.name = std::string_view{names + toc.nameOffset, toc.nameLength};
+			entry.offset = toc.offset;
+			entry.storedSize = toc.storedSize;
+			entry.size = toc.size;
+			entry.contentHash = toc.contentHash;
+			entry.compression = compression;
+			entry.blockCount = toc.blockCount;
+
+			// find relies on the order, which also rules out duplicate names
+			if (i > 0 && entries_[i - 1].name >= entry.name) {
+				throw malformed("entries out of order");
+			}
+		}
+
+		LOG_INFO("mounted {} with {} entries, {:.1f} KiB", path, entries_.size(), fileSize / 1024.0);
+	}
+
+	const AssetArchive::Entry* AssetArchive::find(std::string_view name) const
+	{
+		const auto entry = std::lower_bound(entries_.begin(), entries_.end(), name, [](const Entry& entry, std::string_view name) {
+			return entry.name < name;
+		});
+		return entry != entries_.end() && entry->name == name ? &*entry : nullptr;
+	}
+
+	std::span<const std::byte> AssetArchive::view(const Entry& entry) const
+	{
+		assert(entry.compression == Compression::NONE && "Only uncompressed entries can be viewed in place");
+		return file_.bytes().subspan(entry.offset, entry.size);
+	}
+
+	std::vector<std::byte> AssetArchive::read(const Entry& entry) const
+	{
+		IG_PROFILE_FUNCTION();
+		const std::span<const std::byte> stored = file_.bytes().subspan(entry.offset, entry.storedSize);
+		std::vector<std::byte> data(entry.size);
+
+		if (entry.compression == Compression::NONE) {
+			std::copy(stored.begin(), stored.end(), data.begin());
+		} else {
+			// block offsets come from the size table, so every block is checked to fit before any is decompressed
+			std::vector<uint64_t> blockOffsets(entry.blockCount + 1);
+			blockOffsets[0] = entry.blockCount * sizeof(uint32_t);
+			for (uint32_t i = 0; i < entry.blockCount; i++) {
+				uint32_t storedSize;
+				std::memcpy(&storedSize, stored.data() + i * sizeof(uint32_t), sizeof(storedSize));
+				blockOffsets[i + 1] = blockOffsets[i] + storedSize;
+			}
+			if (blockOffsets.back() != stored.size()) {
+				throw std::runtime_error("corrupt entry " + std::string{entry.name} + " in " + path_);
+			}
+
+			std::atomic<bool> corrupt = false;
+			ThreadPool::instance().parallelFor(entry.blockCount, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++) {
+					const std::span<const std::byte> block = stored.subspan(blockOffsets[i], blockOffsets[i + 1] - blockOffsets[i]);
+					const std::span<std::byte> destination = std::span{data}.subspan(static_cast<size_t>(i) * BLOCK_SIZE, getBlockSize(entry.size, i));
+					if (block.size() == destination.size()) {
+						std::memcpy(destination.data(), block.data(), block.size());
+					} else if (!compression::decompressBlock(block, destination)) {
+						corrupt = true;
+					}
+				}
+			}, BLOCKS_PER_TASK);
+
+			if (corrupt) {
+				throw std::runtime_error("corrupt entry " + std::string{entry.name} + " in " + path_);
+			}
+		}
+
+		if (hashBytes(data.data(), data.size()) != entry.contentHash) {
+			throw std::runtime_error("hash mismatch for " + std::string{entry.name} + " in " + path_);
+		}
+		return data;
+	}
+
+	bool AssetArchive::verify(const Entry& entry) const
+	{
+		if (entry.compression == Compression::NONE) {
+			const std::span<const std::byte> data = view(entry);
+			return hashBytes(data.data(), data.size()) == entry.contentHash;
+		}
+
+		try {
+			read(entry);
+			return true;
+		} catch (const std::exception&) {
+			return false;
+		}
+	}
+
+	void AssetArchive::write(const std::string& path, std::vector<Source> sources)
+	{
+		IG_PROFILE_FUNCTION();
+		std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) { return a.name < b.name; });
+		for (size_t i = 1; i < sources.size(); i++) {
+			if (sources[i - 1].name == sources[i].name) {
+				throw std::runtime_error("duplicate asset archive entry " + sources[i].name);
+			}
+		}
+
+		FileHeader header{};
+		header.magic = MAGIC;
+		header.formatVersion = FORMAT_VERSION;
+		header.entryCount = static_cast<uint32_t>(sources.size());
+		header.tocOffset = alignOffset(sizeof(header));
+		header.namesOffset = header.tocOffset + sources.size() * sizeof(TocEntry);
+
+		std::string names;
+		std::vector<TocEntry> toc(sources.size());
+		for (size_t i = 0; i < sources.size(); i++) {
+			toc[i].nameOffset = static_cast<uint32_t>(names.size());
+			toc[i].nameLength = static_cast<uint32_t>(sources[i].name.size());
+			names += sources[i].name;
+		}
+		header.namesSize = static_cast<uint32_t>(names.size());
+
+		// entries with the same contents point at the first copy
+		std::vector<std::vector<std::byte>> payloads;
+		std::vector<size_t> payloadIndices(sources.size());
+		std::unordered_map<uint64_t, size_t> firstWithHash;
+		uint64_t savedBytes = 0;
+		for (size_t i = 0; i < sources.size(); i++) {
+			const std::vector<std::byte>& data = sources[i].data;
+			toc[i].size = data.size();
+			toc[i].contentHash = hashBytes(data.data(), data.size());
+
+			const auto [first, inserted] = firstWithHash.try_emplace(toc[i].contentHash, i);
+			if (!inserted && sources[first->second].data == data) {
+				const TocEntry& original = toc[first->second];
+				toc[i].compression = original.compression;
+				toc[i].blockCount = original.blockCount;
+				toc[i].storedSize = original.storedSize;
+				payloadIndices[i] = payloadIndices[first->second];
+				savedBytes += original.storedSize;
+				continue;
+			}
+
+			std::vector<std::byte> payload;
+			if (sources[i].compress && !data.empty()) {
+				payload = compressEntry(data);
+				if (payload.size() <= data.size() - data.size() / 8) {
+					toc[i].compression = static_cast<uint32_t>(Compression::LZ4);
+					toc[i].blockCount = getBlockCount(data.size());
+				} else {
+					payload.clear();
+				}
+			}
+			if (toc[i].compression == static_cast<uint32_t>(Compression::NONE)) {
+				payload = data;
+			}
+			toc[i].storedSize = payload.size();
+			payloadIndices[i] = payloads.size();
+			payloads.push_back(std::move(payload));
+		}
+
+		std::vector<uint64_t> payloadOffsets(payloads.size());
+		uint64_t offset = header.namesOffset + names.size();
+		for (size_t i = 0; i < payloads.size(); i++) {
+			offset = alignOffset(offset);
+			payloadOffsets[i] = offset;
+			offset += payloads[i].size();
+		}
+		header.fileSize = offset;
+		for (size_t i = 0; i < sources.size(); i++) {
+			toc[i].offset = payloadOffsets[payloadIndices[i]];
+		}
+
+		const std::string temporaryPath = path + ".tmp";
+		{
+			std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+			const char padding[ENTRY_ALIGNMENT]{};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(padding, static_cast<std::streamsize>(header.tocOffset - sizeof(header)));
+			file.write(reinterpret_cast<const char*>(toc.data()), static_cast<std::streamsize>(toc.size() * sizeof(TocEntry)));
+			file.write(names.data(), static_cast<std::streamsize>(names.size()));
+			uint64_t written = header.namesOffset + names.size();
+			for (size_t i = 0; i < payloads.size(); i++) {
+				file.write(padding, static_cast<std::streamsize>(payloadOffsets[i] - written));
+				file.write(reinterpret_cast<const char*>(payloads[i].data()), static_cast<std::streamsize>(payloads[i].size()));
+				written = payloadOffsets[i] + payloads[i].size();
+			}
+
+			if (!file) {
+				file.close();
+				std::error_code error;
+				std::filesystem::remove(temporaryPath, error);
+				throw std::runtime_error("failed to write asset archive " + temporaryPath);
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, path, error);
+		if (error) {
+			const std::string message = error.message();
+			std::filesystem::remove(temporaryPath, error);
+			throw std::runtime_error("failed to replace asset archive " + path + ": " + message);
+		}
+
+		LOG_INFO("packed {} entries into {}, {:.1f} KiB with {:.1f} KiB of duplicates stored once", sources.size(), path, header.fileSize / 1024.0, savedBytes / 1024.0);
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "core/mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bve
+{
+	// Many assets packed into one file that is mapped once, so a scene loads with a few sequential reads instead of
+	// an open and seek per file. A table of contents sorted by name is followed by the names and then the entries,
+	// each starting on ENTRY_ALIGNMENT. Uncompressed entries are viewed in place; compressed ones are split into
+	// BLOCK_SIZE blocks that decompress in parallel. Every entry records a hash of its uncompressed contents, which
+	// read checks and callers can use to recognise the same contents under different names.
+	class AssetArchive
+	{
+	public:
+		static constexpr uint32_t FORMAT_VERSION = 1;
+		static constexpr uint64_t ENTRY_ALIGNMENT = 64;
+		static constexpr uint32_t BLOCK_SIZE = 64 * 1024;
+
+		enum class Compression : uint32_t
+		{
+			NONE,
+			LZ4, // block format, see compression.h
+		};
+
+		struct Entry
+		{
+			std::string_view name; // points into the archive
+			uint64_t offset;
+			uint64_t storedSize;
+			uint64_t size;
+			uint64_t contentHash; // hashBytes of the uncompressed contents
+			Compression compression;
+			uint32_t blockCount;
+		};
+
+		struct Source
+		{
+			std::string name;
+			std::vector<std::byte> data;
+			bool compress = false; // only kept if it saves at least an eighth of the size
+		};
+
+		// throws if the file can't be mapped or its table of contents is malformed
+		explicit AssetArchive(const std::string& path);
+
+		AssetArchive(const AssetArchive&) = delete;
+		AssetArchive& operator=(const AssetArchive&) = delete;
+		AssetArchive(const AssetArchive&&) = delete;
+		AssetArchive& operator=(const AssetArchive&&) = delete;
+
+		// null if there is no entry with the name
+		const Entry* find(std::string_view name) const;
+		// the entry in place, only for uncompressed entries. Not checked against the hash, see verify
+		std::span<const std::byte> view(const Entry& entry) const;
+		// copies or decompresses the entry and checks its hash, throws if it is corrupt
+		std::vector<std::byte> read(const Entry& entry) const;
+		bool verify(const Entry& entry) const;
+
+		const std::string& getPath() const { return path_; }
+		std::span<const Entry> getEntries() const { return entries_; }
+
+		// writes through a temporary file so a failed pack never replaces a good archive, throws on failure or
+		// duplicate names. Entries with the same contents are stored once
+		static void write(const std::string& path, std::vector<Source> sources);
+
+	private:
+		std::string path_;
+		MappedFile file_;
+		std::vector<Entry> entries_;
+	};
+}
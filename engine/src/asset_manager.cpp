@@ -0,0 +1,493 @@
+#include "pch.h"
+#include "asset_manager.h"
+#include "bve_swap_chain.h"
+#include "bve_utils.h"
+#include "mesh_cache.h"
+#include "core/profiler.h"
+#include "log.h"
+
+#include <exception>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <stdexcept>
+
+namespace bve
+{
+	namespace
+	{
+		// a release can come after the frame's draws were recorded, and update() runs before the next beginFrame
+		// waits on the oldest frame in flight, so one more frame has to pass before nothing can be drawing it
+		constexpr uint64_t RELEASE_DELAY_FRAMES = BveSwapChain::MAX_FRAMES_IN_FLIGHT + 1;
+	}
+
+	size_t AssetManager::KeyHash::operator()(const MeshKey& key) const
+	{
+		size_t seed = 0;
+		hashCombine(seed, key.filepath, static_cast<uint32_t>(key.vertexFormat), key.keepOccluderGeometry);
+		return seed;
+	}
+
+	size_t AssetManager::KeyHash::operator()(const ContentKey& key) const
+	{
+		size_t seed = 0;
+		hashCombine(seed, key.sourceHash, static_cast<uint32_t>(key.vertexFormat), key.keepOccluderGeometry);
+		return seed;
+	}
+
+	AssetManager::AssetManager(BveDevice& device) : bveDevice_{device}, uploadQueue_{device}
+	{
+		createPlaceholderMesh();
+	}
+
+	AssetManager::~AssetManager()
+	{
+		for (std::future<void>& load : loads_) {
+			loaders_.wait(load);
+		}
+		// nothing adds streams once the loads have finished
+		for (std::future<void>& stream : streams_) {
+			stream.wait();
+		}
+		// models are destroyed before the upload queue, so their copies have to finish first
+		uploadQueue_.waitIdle();
+		if (importDatabase_) {
+			importDatabase_->save();
+		}
+	}
+
+	bool AssetManager::mountArchive(const std::string& path)
+	{
+		assert(meshes_.empty() && "Archives have to be mounted before loading");
+		try {
+			archives_.push_back(std::make_unique<AssetArchive>(path));
+			return true;
+		} catch (const std::exception& e) {
+			LOG_WARN("failed to mount {}: {}", path, e.what());
+			return false;
+		}
+	}
+
+	void AssetManager::openImportDatabase(const std::string& path)
+	{
+		assert(meshes_.empty() && "The import database has to be opened before loading");
+		importDatabase_ = std::make_unique<ImportDatabase>(path);
+	}
+
+	MeshHandle AssetManager::loadMesh(const std::string& filepath, BveModel::VertexFormat vertexFormat, bool keepOccluderGeometry)
+	{
+		MeshKey key{std::filesystem::path{filepath}.lexically_normal().generic_string(), vertexFormat, keepOccluderGeometry};
+		if (const auto existing = meshLookup_.find(key); existing != meshLookup_.end()) {
+			MeshSlot& slot = meshes_[existing->second];
+			slot.referenceCount++;
+			return MeshHandle{existing->second, slot.generation};
+		}
+
+		uint32_t index;
+		if (!freeSlots_.empty()) {
+			index = freeSlots_.back();
+			freeSlots_.pop_back();
+		} else {
+			index = static_cast<uint32_t>(meshes_.size());
+			meshes_.emplace_back();
+		}
+
+		MeshSlot& slot = meshes_[index];
+		const uint32_t generation = slot.generation;
+		slot = MeshSlot{key};
+		slot.generation = generation;
+		slot.referenceCount = 1;
+		slot.requestTime = std::chrono::steady_clock::now();
+		meshLookup_.emplace(std::move(key), index);
+		pendingCount_++;
+
+		const MeshHandle handle{index, generation};
+		submitLoad(handle);
+		return handle;
+	}
+
+	MeshHandle AssetManager::acquire(MeshHandle handle)
+	{
+		getSlot(handle).referenceCount++;
+		return handle;
+	}
+
+	void AssetManager::release(MeshHandle handle)
+	{
+		MeshSlot& slot = getSlot(handle);
+		assert(slot.referenceCount > 0 && "Mesh released more often than it was acquired");
+		if (--slot.referenceCount > 0) {
+			return;
+		}
+
+		meshLookup_.erase(slot.key);
+		if (slot.contentKey) {
+			unregisterContent(*slot.contentKey, handle);
+		}
+		if (slot.state == AssetState::LOADING || slot.state == AssetState::UPLOADING) {
+			// a load still running for the slot is dropped by finishLoad, its generation no longer matches
+			pendingCount_--;
+			std::erase(uploading_, handle.index);
+			std::erase(waitingForSource_, handle.index);
+		}
+		if (slot.model) {
+			retired_.push_back(RetiredModel{std::move(slot.model), frame_, slot.uploadTicket});
+		}
+
+		const MeshHandle source = slot.source;
+		slot.generation++;
+		slot.source = MeshHandle{};
+		slot.contentKey.reset();
+		freeSlots_.push_back(handle.index);
+
+		if (source.isValid()) {
+			release(source);
+		}
+	}
+
+	void AssetManager::submitLoad(MeshHandle handle, bool streamCache)
+	{
+		loads_.push_back(loaders_.submit([this, handle, streamCache, key = getSlot(handle).key]() {
+			IG_PROFILE_SCOPE("load mesh");
+			LoadedMesh loaded{handle};
+			try {
+				// hashing is much cheaper than importing, so the contents are checked against other loads first. Packed
+				// meshes already have a hash in the archive, and sources the import database knows are unchanged in it
+				const AssetArchive* archive = nullptr;
+				const AssetArchive::Entry* packed = findPacked(key, archive);
+				BveModel::Builder builder{};
+				builder.vertexFormat = key.vertexFormat;
+				std::optional<uint64_t> knownHash = packed ? std::optional{packed->contentHash} : std::nullopt;
+				std::vector<ImportDatabase::Dependency> dependencies;
+				if (!knownHash && importDatabase_) {
+					knownHash = importDatabase_->findSourceHash(key.filepath, builder);
+					if (!knownHash) {
+						dependencies = importDatabase_->findDependencies(key.filepath);
+					}
+				}
+				const uint64_t sourceHash = knownHash ? *knownHash : mesh_cache::hashSource(key.filepath);
+				const ContentKey contentKey{sourceHash, key.vertexFormat, key.keepOccluderGeometry};
+				{
+					std::lock_guard lock{contentMutex_};
+					const auto [owner, inserted] = contentOwners_.try_emplace(contentKey, handle);
+					if (inserted) {
+						loaded.contentKey = contentKey;
+					} else {
+						loaded.source = owner->second;
+					}
+				}
+
+				if (!loaded.source.isValid() && packed) {
+					loaded.model = loadPacked(*archive, *packed, key, loaded.uploads);
+				} else if (!loaded.source.isValid() && streamCache && streamCached(handle, key, loaded.contentKey, mesh_cache::makeKey(sourceHash, builder), dependencies)) {
+					return;
+				} else if (!loaded.source.isValid()) {
+					loaded.model = BveModel::createModelFromFile(bveDevice_, key.filepath, key.vertexFormat, key.keepOccluderGeometry, &loaded.uploads, sourceHash);
+					if (!dependencies.empty()) {
+						importDatabase_->record(key.filepath, key.vertexFormat, mesh_cache::makeKey(sourceHash, builder), std::move(dependencies));
+					}
+				}
+			} catch (const std::exception& e) {
+				LOG_ERROR("failed to load {}: {}", key.filepath, e.what());
+				// staging buffers may be left for a model that was destroyed while unwinding
+				loaded.uploads.clear();
+			}
+
+			std::lock_guard lock{loadedMutex_};
+			loaded_.push_back(std::move(loaded));
+		}));
+	}
+
+	bool AssetManager::streamCached(MeshHandle handle, const MeshKey& key, const std::optional<ContentKey>& contentKey, const mesh_cache::Key& cacheKey, const std::vector<ImportDatabase::Dependency>& dependencies)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const std::string cachePath = mesh_cache::getCachePath(key.filepath, key.vertexFormat);
+		auto onComplete = [this, handle, key, contentKey, cacheKey, dependencies, cachePath, start](std::unique_ptr<BveModel> model, std::vector<BufferUpload> uploads, std::exception_ptr error) {
+			LoadedMesh loaded{handle};
+			loaded.contentKey = contentKey;
+			if (error) {
+				try {
+					std::rethrow_exception(error);
+				} catch (const std::exception& e) {
+					LOG_WARN("failed to stream {}, importing it again: {}", cachePath, e.what());
+				}
+				loaded.reimport = true;
+			} else {
+				loaded.model = std::move(model);
+				loaded.uploads = std::move(uploads);
+				if (!dependencies.empty()) {
+					importDatabase_->record(key.filepath, key.vertexFormat, cacheKey, dependencies);
+				}
+				LOG_INFO("streamed {} from {} in {:.2f} ms including staging", key.filepath, cachePath,
+					std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			}
+
+			std::lock_guard lock{loadedMutex_};
+			loaded_.push_back(std::move(loaded));
+		};
+
+		std::optional<std::future<void>> stream = mesh_cache::stream(bveDevice_, cachePath, cacheKey, key.keepOccluderGeometry, std::move(onComplete));
+		if (!stream) {
+			return false;
+		}
+		std::lock_guard lock{streamsMutex_};
+		streams_.push_back(std::move(*stream));
+		return true;
+	}
+
+	const AssetArchive::Entry* AssetManager::findPacked(const MeshKey& key, const AssetArchive*& archive) const
+	{
+		const std::string name = mesh_cache::getCachePath(key.filepath, key.vertexFormat);
+		for (auto mounted = archives_.rbegin(); mounted != archives_.rend(); ++mounted) {
+			if (const AssetArchive::Entry* entry = (*mounted)->find(name)) {
+				archive = mounted->get();
+				return entry;
+			}
+		}
+		return nullptr;
+	}
+
+	std::unique_ptr<BveModel> AssetManager::loadPacked(const AssetArchive& archive, const AssetArchive::Entry& entry, const MeshKey& key, std::vector<BufferUpload>& uploads)
+	{
+		IG_PROFILE_FUNCTION();
+		const auto start = std::chrono::steady_clock::now();
+
+		// uncompressed meshes are copied straight from the mapping into staging buffers
+		std::vector<std::byte> decompressed;
+		std::span<const std::byte> image;
+		if (entry.compression == AssetArchive::Compression::NONE) {
+			image = archive.view(entry);
+		} else {
+			decompressed = archive.read(entry);
+			image = decompressed;
+		}
+
+		BveModel::Builder builder{};
+		builder.vertexFormat = key.vertexFormat;
+		const std::string name{entry.name};
+		const std::optional<BveModel::MeshData> mesh = mesh_cache::parse(image, mesh_cache::makeKey(entry.contentHash, builder), false, name);
+		if (!mesh) {
+			throw std::runtime_error(name + " in " + archive.getPath() + " was packed by another importer version or is malformed");
+		}
+
+		auto model = std::make_unique<BveModel>(bveDevice_, *mesh, key.keepOccluderGeometry, uploads);
+		LOG_INFO("read {} from {} in {:.2f} ms including staging", key.filepath, archive.getPath(),
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		return model;
+	}
+
+	void AssetManager::finishLoad(LoadedMesh& loaded)
+	{
+		// released while loading, the gpu never saw the buffers so they can go right away
+		if (!isLive(loaded.handle)) {
+			if (loaded.contentKey) {
+				unregisterContent(*loaded.contentKey, loaded.handle);
+			}
+			return;
+		}
+
+		MeshSlot& slot = getSlot(loaded.handle);
+		if (loaded.reimport) {
+			// importing overwrites the cache, the contents are claimed again by the new load
+			if (loaded.contentKey) {
+				unregisterContent(*loaded.contentKey, loaded.handle);
+			}
+			submitLoad(loaded.handle, false);
+			return;
+		}
+
+		if (loaded.source.isValid()) {
+			// the source was released before this could share it, so the contents have to be loaded after all
+			if (!isLive(loaded.source)) {
+				submitLoad(loaded.handle);
+				return;
+			}
+			acquire(loaded.source);
+			slot.source = loaded.source;
+			waitingForSource_.push_back(loaded.handle.index);
+			return;
+		}
+
+		if (!loaded.model) {
+			if (loaded.contentKey) {
+				unregisterContent(*loaded.contentKey, loaded.handle);
+			}
+			slot.state = AssetState::FAILED;
+			pendingCount_--;
+			return;
+		}
+
+		slot.contentKey = loaded.contentKey;
+		slot.model = std::move(loaded.model);
+		slot.state = AssetState::UPLOADING;
+		slot.uploadTicket = uploadQueue_.enqueue(std::move(loaded.uploads));
+		uploading_.push_back(loaded.handle.index);
+	}
+
+	void AssetManager::resolveSources()
+	{
+		std::vector<MeshHandle> resolved;
+		std::erase_if(waitingForSource_, [this, &resolved](uint32_t index) {
+			MeshSlot& slot = meshes_[index];
+			const MeshSlot& source = getSlot(slot.source);
+			if (source.state == AssetState::LOADING || source.state == AssetState::UPLOADING) {
+				return false;
+			}
+
+			if (source.state == AssetState::READY) {
+				slot.model = source.model;
+				slot.state = AssetState::READY;
+				LOG_INFO("{} has the same contents as {}, sharing its mesh", slot.key.filepath, source.key.filepath);
+			} else {
+				slot.state = AssetState::FAILED;
+			}
+			pendingCount_--;
+			resolved.push_back(slot.source);
+			slot.source = MeshHandle{};
+			return true;
+		});
+
+		// releasing can't happen while waitingForSource_ is being erased from
+		for (const MeshHandle source : resolved) {
+			release(source);
+		}
+	}
+
+	void AssetManager::update()
+	{
+		IG_PROFILE_FUNCTION();
+		frame_++;
+		processLoads();
+
+		std::erase_if(retired_, [this](const RetiredModel& retired) {
+			return frame_ >= retired.releaseFrame + RELEASE_DELAY_FRAMES && uploadQueue_.isComplete(retired.uploadTicket);
+		});
+	}
+
+	void AssetManager::processLoads()
+	{
+		std::vector<LoadedMesh> loaded;
+		{
+			std::lock_guard lock{loadedMutex_};
+			loaded.swap(loaded_);
+		}
+
+		for (LoadedMesh& mesh : loaded) {
+			finishLoad(mesh);
+		}
+
+		uploadQueue_.submit();
+		uploadQueue_.update();
+
+		std::erase_if(uploading_, [this](uint32_t index) {
+			MeshSlot& slot = meshes_[index];
+			if (!uploadQueue_.isComplete(slot.uploadTicket)) {
+				return false;
+			}
+			slot.state = AssetState::READY;
+			pendingCount_--;
+			LOG_INFO("{} ready {:.1f} ms after it was requested", slot.key.filepath,
+				std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - slot.requestTime).count());
+			return true;
+		});
+
+		resolveSources();
+
+		std::erase_if(loads_, [](const std::future<void>& load) {
+			return load.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		});
+		std::lock_guard lock{streamsMutex_};
+		std::erase_if(streams_, [](const std::future<void>& stream) {
+			return stream.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		});
+	}
+
+	void AssetManager::waitAll()
+	{
+		IG_PROFILE_FUNCTION();
+		// loads can be resubmitted while finishing, so this runs until nothing is left rather than once
+		while (pendingCount_ > 0) {
+			for (std::future<void>& load : loads_) {
+				loaders_.wait(load);
+			}
+			std::vector<std::future<void>> streams;
+			{
+				std::lock_guard lock{streamsMutex_};
+				streams.swap(streams_);
+			}
+			for (std::future<void>& stream : streams) {
+				stream.wait();
+			}
+			processLoads();
+			uploadQueue_.waitIdle();
+			processLoads();
+		}
+	}
+
+	void AssetManager::unregisterContent(const ContentKey& key, MeshHandle handle)
+	{
+		std::lock_guard lock{contentMutex_};
+		if (const auto owner = contentOwners_.find(key); owner != contentOwners_.end() && owner->second == handle) {
+			contentOwners_.erase(owner);
+		}
+	}
+
+	bool AssetManager::isLive(MeshHandle handle) const
+	{
+		return handle.index < meshes_.size() && meshes_[handle.index].generation == handle.generation && meshes_[handle.index].referenceCount > 0;
+	}
+
+	AssetManager::MeshSlot& AssetManager::getSlot(MeshHandle handle)
+	{
+		assert(isLive(handle) && "Invalid or released mesh handle");
+		return meshes_[handle.index];
+	}
+
+	const AssetManager::MeshSlot& AssetManager::getSlot(MeshHandle handle) const
+	{
+		assert(isLive(handle) && "Invalid or released mesh handle");
+		return meshes_[handle.index];
+	}
+
+	AssetState AssetManager::getState(MeshHandle handle) const
+	{
+		return getSlot(handle).state;
+	}
+
+	const BveModel* AssetManager::getMesh(MeshHandle handle) const
+	{
+		const MeshSlot& slot = getSlot(handle);
+		return slot.state == AssetState::READY ? slot.model.get() : nullptr;
+	}
+
+	void AssetManager::createPlaceholderMesh()
+	{
+		BveModel::Builder builder{};
+		builder.vertexFormat = BveModel::VertexFormat::FULL;
+
+		// unit cube with a face per axis and side, so it is lit like any other mesh
+		const glm::vec3 color{0.5f};
+		for (int axis = 0; axis < 3; axis++) {
+			for (const float side : {-1.f, 1.f}) {
+				glm::vec3 normal{0.f};
+				normal[axis] = side;
+				glm::vec3 u{0.f};
+				u[(axis + 1) % 3] = 0.5f;
+				glm::vec3 v{0.f};
+				v[(axis + 2) % 3] = 0.5f * side;
+
+				const auto first = static_cast<uint32_t>(builder.vertices.size());
+				const glm::vec3 center = normal * 0.5f;
+				builder.vertices.push_back({center - u - v, color, normal});
+				builder.vertices.push_back({center + u - v, color, normal});
+				builder.vertices.push_back({center + u + v, color, normal});
+				builder.vertices.push_back({center - u + v, color, normal});
+				for (const uint32_t corner : {0u, 1u, 2u, 0u, 2u, 3u}) {
+					builder.indices.push_back(first + corner);
+				}
+			}
+		}
+
+		placeholderMesh_ = std::make_unique<BveModel>(bveDevice_, builder);
+	}
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "asset_archive.h"
+#include "bve_device.h"
+#include "bve_model.h"
+#include "import_database.h"
+#include "vulkan_upload_queue.h"
+#include "core/thread_pool.h"
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bve
+{
+	// refers to an asset owned by the AssetManager, typed so a mesh handle can't be used to look up anything else
+	template <typename T>
+	struct AssetHandle
+	{
+		static constexpr uint32_t INVALID_INDEX = ~0u;
+
+		uint32_t index = INVALID_INDEX;
+		uint32_t generation = 0; // slots are reused once released, a stale handle has an older generation
+
+		bool isValid() const { return index != INVALID_INDEX; }
+		bool operator==(const AssetHandle&) const = default;
+	};
+
+	using MeshHandle = AssetHandle<BveModel>;
+
+	enum class AssetState
+	{
+		LOADING, // reading or importing on a loader thread
+		UPLOADING, // waiting for the gpu copy
+		READY,
+		FAILED,
+	};
+
+	// Loads assets in the background. Requests return a handle right away; the file is read, imported and written
+	// into staging buffers on loader threads, then the copies are batched into one submit per frame and the
+	// handle turns ready when its fence signals. A mesh with a current cache is instead read by the AsyncFileReader
+	// straight into its staging buffers, leaving the loader thread free to import the next one while the disk works.
+	// Everything but the loader threads and the reader's callbacks runs on the main thread.
+	//
+	// Meshes are shared. Requesting a path that is already loaded returns the same handle, and a file with the same
+	// contents as a loaded one under another path shares its buffers instead of being imported again. Handles are
+	// reference counted: every loadMesh or acquire is matched by a release, and a mesh nobody holds is destroyed a
+	// few frames later, once no frame in flight can still draw it.
+	//
+	// Meshes packed into a mounted archive by the asset packer are read from it in place of their source files,
+	// anything not in an archive is still loaded from its own file. With an import database open, a source it knows
+	// to be unchanged goes straight to its cache without being read or hashed.
+	class AssetManager
+	{
+	public:
+		// loads mostly wait on the shared pool for their parallel parts, so a couple of threads keep it busy
+		static constexpr uint32_t LOADER_THREAD_COUNT = 2;
+
+		explicit AssetManager(BveDevice& device);
+		~AssetManager();
+
+		AssetManager(const AssetManager&) = delete;
+		AssetManager& operator=(const AssetManager&) = delete;
+		AssetManager(const AssetManager&&) = delete;
+		AssetManager& operator=(const AssetManager&&) = delete;
+
+		// mounted archives are searched newest first, so a later one can override meshes in an earlier one. Loader
+		// threads read the list without locking, so archives are mounted before anything is loaded. False and
+		// logged if the archive can't be read
+		bool mountArchive(const std::string& path);
+		// like archives, opened before anything is loaded. Meshes imported or found current are recorded in it, and it
+		// is saved when the manager is destroyed
+		void openImportDatabase(const std::string& path);
+
+		MeshHandle loadMesh(
+			const std::string& filepath,
+			BveModel::VertexFormat vertexFormat = BveModel::VertexFormat::PACKED,
+			bool keepOccluderGeometry = false);
+
+		// another reference to a mesh that is already held, without looking up its path
+		MeshHandle acquire(MeshHandle handle);
+		void release(MeshHandle handle);
+
+		// once per frame, hands finished loads to the upload queue, marks completed uploads ready and destroys
+		// meshes released long enough ago
+		void update();
+
+		// blocks until every requested asset is ready or has failed, for runs that need the whole scene on the first frame
+		void waitAll();
+
+		AssetState getState(MeshHandle handle) const;
+		// null until the mesh is ready
+		const BveModel* getMesh(MeshHandle handle) const;
+		// a small cube drawn in place of meshes that are still loading
+		const BveModel& getPlaceholderMesh() const { return *placeholderMesh_; }
+
+		uint32_t getPendingCount() const { return pendingCount_; }
+		uint32_t getReferenceCount(MeshHandle handle) const { return getSlot(handle).referenceCount; }
+
+	private:
+		struct MeshKey
+		{
+			std::string filepath; // lexically normalized
+			BveModel::VertexFormat vertexFormat;
+			bool keepOccluderGeometry;
+
+			bool operator==(const MeshKey&) const = default;
+		};
+
+		struct ContentKey
+		{
+			uint64_t sourceHash;
+			BveModel::VertexFormat vertexFormat;
+			bool keepOccluderGeometry;
+
+			bool operator==(const ContentKey&) const = default;
+		};
+
+		struct KeyHash
+		{
+			size_t operator()(const MeshKey& key) const;
+			size_t operator()(const ContentKey& key) const;
+		};
+
+		struct MeshSlot
+		{
+			MeshKey key;
+			std::shared_ptr<BveModel> model; // shared by every slot whose source has the same contents
+			AssetState state = AssetState::LOADING;
+			uint32_t generation = 0;
+			uint32_t referenceCount = 0;
+			uint64_t uploadTicket = 0;
+			MeshHandle source; // the slot loading the same contents under another path, held while waiting for it
+			std::optional<ContentKey> contentKey; // set while other slots can find this one by its contents
+			std::chrono::steady_clock::time_point requestTime;
+		};
+
+		// filled in by a loader thread, model is null if the load failed or the contents are loaded by source
+		struct LoadedMesh
+		{
+			MeshHandle handle;
+			std::unique_ptr<BveModel> model;
+			std::vector<BufferUpload> uploads;
+			MeshHandle source;
+			std::optional<ContentKey> contentKey;
+			bool reimport = false; // the cache failed to stream after its header was accepted
+		};
+
+		// released models are kept until every frame that could have drawn them and their upload have finished
+		struct RetiredModel
+		{
+			std::shared_ptr<BveModel> model;
+			uint64_t releaseFrame;
+			uint64_t uploadTicket;
+		};
+
+		// streamCache is cleared when a cache that failed to stream is imported again instead
+		void submitLoad(MeshHandle handle, bool streamCache = true);
+		// starts reading a current cache of the mesh, false if there is none. The callback hands the result to loaded_
+		bool streamCached(MeshHandle handle, const MeshKey& key, const std::optional<ContentKey>& contentKey, const mesh_cache::Key& cacheKey, const std::vector<ImportDatabase::Dependency>& dependencies);
+		// the packed cache of the mesh and the archive holding it, null if no archive has it
+		const AssetArchive::Entry* findPacked(const MeshKey& key, const AssetArchive*& archive) const;
+		std::unique_ptr<BveModel> loadPacked(const AssetArchive& archive, const AssetArchive::Entry& entry, const MeshKey& key, std::vector<BufferUpload>& uploads);
+		void finishLoad(LoadedMesh& loaded);
+		void resolveSources();
+		// the part of update that doesn't depend on frames being rendered
+		void processLoads();
+		void unregisterContent(const ContentKey& key, MeshHandle handle);
+		bool isLive(MeshHandle handle) const;
+		MeshSlot& getSlot(MeshHandle handle);
+		const MeshSlot& getSlot(MeshHandle handle) const;
+		void createPlaceholderMesh();
+
+		BveDevice& bveDevice_;
+		VulkanUploadQueue uploadQueue_;
+		std::unique_ptr<BveModel> placeholderMesh_;
+		std::vector<std::unique_ptr<AssetArchive>> archives_;
+		std::unique_ptr<ImportDatabase> importDatabase_;
+
+		std::vector<MeshSlot> meshes_;
+		std::vector<uint32_t> freeSlots_;
+		std::unordered_map<MeshKey, uint32_t, KeyHash> meshLookup_;
+		std::vector<uint32_t> uploading_;
+		std::vector<uint32_t> waitingForSource_;
+		std::vector<RetiredModel> retired_;
+		uint32_t pendingCount_ = 0;
+		uint64_t frame_ = 0;
+
+		// loader threads look for a slot already loading the same contents here before importing anything
+		std::mutex contentMutex_;
+		std::unordered_map<ContentKey, MeshHandle, KeyHash> contentOwners_;
+
+		std::mutex loadedMutex_;
+		std::vector<LoadedMesh> loaded_;
+		std::vector<std::future<void>> loads_;
+
+		// caches being streamed, their callbacks add to loaded_ themselves
+		std::mutex streamsMutex_;
+		std::vector<std::future<void>> streams_;
+
+		// last so the loader threads are joined before anything they write to is destroyed
+		ThreadPool loaders_{LOADER_THREAD_COUNT};
+	};
+}
@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "bve_device.h"
 
+#include "core/profiler.h"
+
 #include <cstring>
 #include <stdexcept>
 
@@ -47,11 +49,24 @@ namespace bve
 	}
 
 	// class member functions
-	BveDevice::BveDevice(BveWindow& window) : window_{window}
+	BveDevice::BveDevice(BveWindow& window) : window_{&window}
+	{
+		init();
+	}
+
+	BveDevice::BveDevice() : window_{nullptr}
+	{
+		deviceExtensions_.clear();
+		init();
+	}
+
+	void BveDevice::init()
 	{
 		createInstance();
 		setupDebugMessenger();
-		createSurface();
+		if (window_) {
+			createSurface();
+		}
 		pickPhysicalDevice();
 		createLogicalDevice();
 		createCommandPool();
@@ -66,7 +81,9 @@ namespace bve
 			DestroyDebugUtilsMessengerEXT(instance_, debugMessenger_, nullptr);
 		}
 
-		vkDestroySurfaceKHR(instance_, surface_, nullptr);
+		if (surface_ != VK_NULL_HANDLE) {
+			vkDestroySurfaceKHR(instance_, surface_, nullptr);
+		}
 		vkDestroyInstance(instance_, nullptr);
 	}
 
@@ -155,8 +172,14 @@ namespace bve
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
+		// software drivers may lack anisotropic filtering, nothing depends on it so it is only enabled when present.
+		// The same goes for pipeline statistics, which only the gpu profiler uses
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(physicalDevice_, &supportedFeatures);
 		VkPhysicalDeviceFeatures deviceFeatures = {};
-		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+		deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+		enabledFeatures = deviceFeatures;
 
 		VkDeviceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -200,7 +223,7 @@ namespace bve
 		}
 	}
 
-	void BveDevice::createSurface() { window_.createWindowSurface(instance_, &surface_); }
+	void BveDevice::createSurface() { window_->createWindowSurface(instance_, &surface_); }
 
 	bool BveDevice::isDeviceSuitable(VkPhysicalDevice device)
 	{
@@ -208,8 +231,8 @@ namespace bve
 
 		bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-		bool swapChainAdequate = false;
-		if (extensionsSupported) {
+		bool swapChainAdequate = isHeadless();
+		if (extensionsSupported && !isHeadless()) {
 			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 			swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 		}
@@ -218,7 +241,7 @@ namespace bve
 		vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
 		return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-			supportedFeatures.samplerAnisotropy;
+			(isHeadless() || supportedFeatures.samplerAnisotropy);
 	}
 
 	void BveDevice::populateDebugMessengerCreateInfo(
@@ -273,11 +296,14 @@ namespace bve
 
 	std::vector<const char*> BveDevice::getRequiredExtensions()
 	{
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		// glfw is never initialized without a window, headless instances need no surface extensions
+		std::vector<const char*> extensions;
+		if (window_) {
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions;
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
 		if (enableValidationLayers) {
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -350,8 +376,11 @@ namespace bve
 				indices.graphicsFamily = i;
 				indices.graphicsFamilyHasValue = true;
 			}
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+			// without a surface nothing is presented, the graphics queue stands in for the present queue
+			VkBool32 presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+			if (!isHeadless()) {
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+			}
 			if (queueFamily.queueCount > 0 && presentSupport) {
 				indices.presentFamily = i;
 				indices.presentFamilyHasValue = true;
@@ -478,6 +507,7 @@ namespace bve
 
 	void BveDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer)
 	{
+		IG_PROFILE_FUNCTION();
 		vkEndCommandBuffer(commandBuffer);
 
 		VkSubmitInfo submitInfo{};
@@ -493,6 +523,7 @@ namespace bve
 
 	void BveDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
 	{
+		IG_PROFILE_COUNT(UPLOAD_BYTES, size);
 		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
 		VkBufferCopy copyRegion{};
@@ -32,6 +32,8 @@ namespace bve
 #endif
 
 		BveDevice(BveWindow& window);
+		// headless, no surface or swap chain support is required so any driver down to lavapipe will do
+		BveDevice();
 		~BveDevice();
 
 		// Not copyable or movable
@@ -43,6 +45,7 @@ namespace bve
 		VkCommandPool getCommandPool() { return commandPool_; }
 		VkDevice device() { return device_; }
 		VkSurfaceKHR surface() { return surface_; }
+		bool isHeadless() const { return window_ == nullptr; }
 		VkQueue graphicsQueue() { return graphicsQueue_; }
 		VkQueue presentQueue() { return presentQueue_; }
 		VkInstance getInstance() { return instance_; }
@@ -75,8 +78,10 @@ namespace bve
 			VkDeviceMemory& imageMemory);
 
 		VkPhysicalDeviceProperties properties;
+		VkPhysicalDeviceFeatures enabledFeatures{};
 
 	private:
+		void init();
 		void createInstance();
 		void setupDebugMessenger();
 		void createSurface();
@@ -97,15 +102,15 @@ namespace bve
 		VkInstance instance_;
 		VkDebugUtilsMessengerEXT debugMessenger_;
 		VkPhysicalDevice physicalDevice_ = VK_NULL_HANDLE;
-		BveWindow& window_;
+		BveWindow* window_;
 		VkCommandPool commandPool_;
 
 		VkDevice device_;
-		VkSurfaceKHR surface_;
+		VkSurfaceKHR surface_ = VK_NULL_HANDLE;
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
 
 		const std::vector<const char*> validationLayers_ = {"VK_LAYER_KHRONOS_validation"};
-		const std::vector<const char*> deviceExtensions_ = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+		std::vector<const char*> deviceExtensions_ = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 	};
 } // namespace lve
@@ -3,12 +3,14 @@
 #include "bve_device.h"
 #include "bve_window.h"
 #include "components/components.h"
+#include "core/profiler.h"
 
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_vulkan.h>
 
 #include <stdexcept>
+#include <string>
 
 namespace bve
 {
@@ -187,4 +189,248 @@ namespace bve
 		}
 		ImGui::End();
 	}
+
+	void BveImgui::drawGpuProfiler(VulkanGpuProfiler& profiler)
+	{
+		constexpr size_t AVERAGE_FRAMES = 60;
+		ImGui::Begin("GPU Profiler");
+		if (!profiler.isEnabled()) {
+			ImGui::Text("Timestamp queries are not supported on this device");
+			ImGui::End();
+			return;
+		}
+
+		const auto& history = profiler.getHistory();
+		if (history.empty()) {
+			ImGui::End();
+			return;
+		}
+
+		// scopes are matched by position, they only change when a pass is switched on or off
+		const size_t frameCount = std::min(history.size(), AVERAGE_FRAMES);
+		const auto& latest = history.back();
+		std::vector<VulkanGpuProfiler::ScopeResult> averages(latest.scopes.size());
+		double frameMilliseconds = 0.0;
+		for (size_t i = history.size() - frameCount; i < history.size(); i++) {
+			frameMilliseconds += history[i].milliseconds;
+			for (size_t scope = 0; scope < std::min(averages.size(), history[i].scopes.size()); scope++) {
+				averages[scope].milliseconds += history[i].scopes[scope].milliseconds;
+			}
+		}
+
+		float frameTimes[AVERAGE_FRAMES];
+		for (size_t i = 0; i < frameCount; i++) {
+			frameTimes[i] = static_cast<float>(history[history.size() - frameCount + i].milliseconds);
+		}
+
+		ImGui::Text("GPU frame %.3f ms (average of %zu frames)", frameMilliseconds / frameCount, frameCount);
+		ImGui::PlotLines("##gpu frame times", frameTimes, static_cast<int>(frameCount), 0, nullptr, 0.f, FLT_MAX, ImVec2(0, 40));
+
+		const int columns = profiler.hasStatistics() ? 5 : 2;
+		if (ImGui::BeginTable("gpu scopes", columns, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+			ImGui::TableSetupColumn("Pass");
+			ImGui::TableSetupColumn("GPU ms");
+			if (profiler.hasStatistics()) {
+				ImGui::TableSetupColumn("Primitives");
+				ImGui::TableSetupColumn("VS invocations");
+				ImGui::TableSetupColumn("FS invocations");
+			}
+			ImGui::TableHeadersRow();
+
+			for (size_t scope = 0; scope < latest.scopes.size(); scope++) {
+				const auto& result = latest.scopes[scope];
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(result.name.c_str());
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", averages[scope].milliseconds / frameCount);
+				if (profiler.hasStatistics()) {
+					ImGui::TableNextColumn();
+					ImGui::Text("%llu", static_cast<unsigned long long>(result.inputPrimitives));
+					ImGui::TableNextColumn();
+					ImGui::Text("%llu", static_cast<unsigned long long>(result.vertexInvocations));
+					ImGui::TableNextColumn();
+					ImGui::Text("%llu", static_cast<unsigned long long>(result.fragmentInvocations));
+				}
+			}
+			ImGui::EndTable();
+		}
+
+		if (ImGui::Button("Export CSV")) {
+			try {
+				profiler.exportCsv("gpu_timings.csv");
+				gpuExportStatus_ = "wrote gpu_timings.csv";
+			} catch (const std::exception& e) {
+				gpuExportStatus_ = e.what();
+			}
+		}
+		if (!gpuExportStatus_.empty()) {
+			ImGui::SameLine();
+			ImGui::TextUnformatted(gpuExportStatus_.c_str());
+		}
+		ImGui::End();
+	}
+
+	namespace
+	{
+		// "void bve::RenderSystem::render(FrameInfo&) const" reads as "RenderSystem::render"
+		std::string_view shortZoneName(std::string_view name)
+		{
+			const size_t parameters = name.find('(');
+			if (parameters != std::string_view::npos) {
+				name = name.substr(0, parameters);
+				const size_t returnType = name.rfind(' ');
+				if (returnType != std::string_view::npos) {
+					name = name.substr(returnType + 1);
+				}
+			}
+			if (name.starts_with("bve::")) {
+				name = name.substr(5);
+			}
+			return name;
+		}
+
+		ImU32 zoneColor(const char* name)
+		{
+			const size_t hash = std::hash<const void*>{}(name);
+			return ImColor::HSV(static_cast<float>(hash % 360) / 360.f, 0.5f, 0.75f);
+		}
+	}
+
+	void BveImgui::drawFrameProfiler()
+	{
+		IG_PROFILE_FUNCTION();
+		const uint64_t panelStart = Profiler::now();
+
+		frameProfiler_.update();
+
+		ImGui::Begin("Frame Profiler");
+
+		bool paused = frameProfiler_.isPaused();
+		if (ImGui::Checkbox("Pause", &paused)) {
+			frameProfiler_.setPaused(paused);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Capture")) {
+			frameProfiler_.capture(static_cast<uint32_t>(std::max(captureCount_, 1)));
+			selectedFrame_ = UINT64_MAX;
+		}
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(80.f);
+		ImGui::InputInt("frames", &captureCount_);
+		if (frameProfiler_.getCaptureRemaining() > 0) {
+			ImGui::SameLine();
+			ImGui::Text("capturing, %u left", frameProfiler_.getCaptureRemaining());
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Save trace")) {
+			Profiler::writeChromeTrace("trace.json");
+		}
+
+		const auto& history = frameProfiler_.getHistory();
+		if (history.empty()) {
+			ImGui::End();
+			return;
+		}
+
+		const FrameProfiler::Summary summary = frameProfiler_.summarize();
+		ImGui::Text("p50 %.2f ms  p99 %.2f ms  max %.2f ms  (panel %.3f ms)", summary.p50, summary.p99, summary.max, frameProfilerMilliseconds_);
+
+		// frame time bars, scaled so the slowest frame fills the graph. Clicking one selects it
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		const ImVec2 graphOrigin = ImGui::GetCursorScreenPos();
+		const ImVec2 graphSize{ImGui::GetContentRegionAvail().x, 60.f};
+		ImGui::InvisibleButton("frame times", graphSize);
+		const bool graphClicked = ImGui::IsItemClicked();
+		drawList->AddRectFilled(graphOrigin, {graphOrigin.x + graphSize.x, graphOrigin.y + graphSize.y}, IM_COL32(20, 20, 20, 255));
+
+		const float barWidth = graphSize.x / static_cast<float>(FrameProfiler::HISTORY_SIZE);
+		const size_t selectedIndex = [&] {
+			for (size_t i = 0; i < history.size(); i++) {
+				if (history[i].frame.number == selectedFrame_) {
+					return i;
+				}
+			}
+			return history.size() - 1;
+		}();
+
+		for (size_t i = 0; i < history.size(); i++) {
+			const double milliseconds = frameProfiler_.toMilliseconds(history[i].frame.end - history[i].frame.start);
+			const float height = static_cast<float>(milliseconds / std::max(summary.max, 0.001)) * graphSize.y;
+			const float x = graphOrigin.x + static_cast<float>(i) * barWidth;
+			const ImU32 color = i == selectedIndex ? IM_COL32(255, 200, 60, 255) : milliseconds > summary.p99 ? IM_COL32(220, 80, 60, 255) : IM_COL32(90, 160, 220, 255);
+			drawList->AddRectFilled({x, graphOrigin.y + graphSize.y - height}, {x + std::max(barWidth - 1.f, 1.f), graphOrigin.y + graphSize.y}, color);
+		}
+
+		if (graphClicked) {
+			const size_t clicked = static_cast<size_t>((ImGui::GetIO().MousePos.x - graphOrigin.x) / barWidth);
+			if (clicked < history.size()) {
+				selectedFrame_ = history[clicked].frame.number;
+			}
+		}
+		if (ImGui::Button("Follow latest")) {
+			selectedFrame_ = UINT64_MAX;
+		}
+
+		const FrameProfiler::FrameRecord& selected = history[selectedIndex];
+		const uint64_t frameTicks = std::max<uint64_t>(selected.frame.end - selected.frame.start, 1);
+		ImGui::SameLine();
+		ImGui::Text("frame %llu, %.3f ms", static_cast<unsigned long long>(selected.frame.number), frameProfiler_.toMilliseconds(frameTicks));
+
+		const auto& counters = selected.frame.counters;
+		ImGui::Text("draw calls %llu  triangles %llu  culled objects %llu  uploaded %.1f KiB",
+			static_cast<unsigned long long>(counters[static_cast<size_t>(Profiler::Counter::DRAW_CALLS)]),
+			static_cast<unsigned long long>(counters[static_cast<size_t>(Profiler::Counter::TRIANGLES)]),
+			static_cast<unsigned long long>(counters[static_cast<size_t>(Profiler::Counter::CULLED_OBJECTS)]),
+			static_cast<double>(counters[static_cast<size_t>(Profiler::Counter::UPLOAD_BYTES)]) / 1024.0);
+
+		// one lane per thread, zones stacked by their nesting depth
+		if (ImGui::CollapsingHeader("Flame graph", ImGuiTreeNodeFlags_DefaultOpen)) {
+			constexpr float ROW_HEIGHT = 18.f;
+			const float width = ImGui::GetContentRegionAvail().x;
+			const auto& threadNames = frameProfiler_.getThreadNames();
+
+			size_t begin = 0;
+			while (begin < selected.zones.size()) {
+				const uint32_t thread = selected.zones[begin].thread;
+				size_t end = begin;
+				uint32_t maxDepth = 0;
+				while (end < selected.zones.size() && selected.zones[end].thread == thread) {
+					maxDepth = std::max(maxDepth, selected.zones[end].zone.depth);
+					end++;
+				}
+
+				ImGui::TextUnformatted(thread < threadNames.size() ? threadNames[thread].c_str() : "thread");
+				const ImVec2 origin = ImGui::GetCursorScreenPos();
+				const ImVec2 laneSize{width, (maxDepth + 1) * ROW_HEIGHT};
+				ImGui::InvisibleButton(("lane" + std::to_string(thread)).c_str(), laneSize);
+				const bool laneHovered = ImGui::IsItemHovered();
+				const ImVec2 mouse = ImGui::GetIO().MousePos;
+
+				for (size_t i = begin; i < end; i++) {
+					const Profiler::Zone& zone = selected.zones[i].zone;
+					const float x0 = origin.x + width * static_cast<float>(zone.start - selected.frame.start) / static_cast<float>(frameTicks);
+					const float x1 = std::max(origin.x + width * static_cast<float>(std::min(zone.end, selected.frame.end) - selected.frame.start) / static_cast<float>(frameTicks), x0 + 1.f);
+					const float y0 = origin.y + zone.depth * ROW_HEIGHT;
+					const ImVec2 min{x0, y0};
+					const ImVec2 max{x1, y0 + ROW_HEIGHT - 1.f};
+					drawList->AddRectFilled(min, max, zoneColor(zone.name));
+
+					const std::string_view name = shortZoneName(zone.name);
+					if (x1 - x0 > 30.f) {
+						drawList->PushClipRect(min, max, true);
+						drawList->AddText({x0 + 2.f, y0 + 2.f}, IM_COL32(0, 0, 0, 255), name.data(), name.data() + name.size());
+						drawList->PopClipRect();
+					}
+					if (laneHovered && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y) {
+						ImGui::SetTooltip("%.*s\n%.3f ms", static_cast<int>(name.size()), name.data(), frameProfiler_.toMilliseconds(zone.end - zone.start));
+					}
+				}
+				begin = end;
+			}
+		}
+
+		ImGui::End();
+		frameProfilerMilliseconds_ = static_cast<double>(Profiler::now() - panelStart) * 1e-6;
+	}
 } // namespace bve
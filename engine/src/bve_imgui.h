@@ -3,6 +3,8 @@
 #include "bve_device.h"
 #include "bve_window.h"
 #include "entity_manager.h"
+#include "vulkan_gpu_profiler.h"
+#include "core/frame_profiler.h"
 
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
@@ -41,6 +43,12 @@ namespace bve
 		ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 		void run();
 
+		// per scope gpu time and statistics, averaged over the last frames
+		void drawGpuProfiler(VulkanGpuProfiler& profiler);
+
+		// frame time graph and percentiles, a flame graph of the selected frame and its counters
+		void drawFrameProfiler();
+
 	private:
 		BveDevice& bveDevice_;
 
@@ -51,5 +59,12 @@ namespace bve
 		// maybe its preferred to have a separate descriptor pool for imgui anyway,
 		// I haven't looked into imgui best practices at all.
 		VkDescriptorPool descriptorPool_;
+
+		std::string gpuExportStatus_;
+
+		FrameProfiler frameProfiler_;
+		uint64_t selectedFrame_ = UINT64_MAX; // frame number, UINT64_MAX follows the latest
+		int captureCount_ = 60;
+		double frameProfilerMilliseconds_ = 0.0; // what the panel itself cost last frame
 	};
 } // namespace bve
@@ -1,61 +1,332 @@
 #include "pch.h"
 #include "bve_model.h"
 #include "bve_utils.h"
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
-
+#include "gltf_importer.h"
+#include "core/profiler.h"
+#include "core/thread_pool.h"
+#include "log.h"
+#include "mesh_attributes.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "obj_parser.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <numbers>
+#include <numeric>
+#include <optional>
 #include <stdexcept>
 
-namespace std
+namespace bve
 {
-	template <>
-	struct hash<bve::BveModel::Vertex>
+	namespace
 	{
-		size_t operator()(const bve::BveModel::Vertex& vertex) const
+		mesh_attributes::Streams getPositionStreams(const std::vector<BveModel::Vertex>& vertices)
 		{
-			size_t seed = 0;
-			bve::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-			return seed;
+			mesh_attributes::Streams positions{};
+			positions.x.resize(vertices.size());
+			positions.y.resize(vertices.size());
+			positions.z.resize(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++) {
+				positions.x[i] = vertices[i].position.x;
+				positions.y[i] = vertices[i].position.y;
+				positions.z[i] = vertices[i].position.z;
+			}
+			return positions;
 		}
-	};
-}
 
-namespace bve
-{
-	BveModel::BveModel(BveDevice& device, const Builder& builder) : bveDevice_{device} {
-		createVertexBuffer(builder.vertices);
-		createIndexBuffer(builder.indices);
+		// as decodeOctahedral in simple_shader.vert
+		glm::vec3 decodeOctahedral(uint32_t packed)
+		{
+			const glm::vec2 e = glm::unpackSnorm2x16(packed);
+			glm::vec3 n{e, 1.f - std::abs(e.x) - std::abs(e.y)};
+			if (n.z < 0.f) {
+				const glm::vec2 sign{n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f};
+				n = glm::vec3{(1.f - glm::abs(glm::vec2{n.y, n.x})) * sign, n.z};
+			}
+			return glm::normalize(n);
+		}
+	}
+
+	BveModel::BveModel(BveDevice& device, const Builder& builder) : bveDevice_{device}, vertexFormat_{builder.vertexFormat} {
+		const PackedMesh packed = builder.pack();
+		create(packed.data, builder.keepOccluderGeometry, nullptr);
+	}
+
+	BveModel::BveModel(BveDevice& device, const MeshData& mesh, bool keepOccluderGeometry) : bveDevice_{device}, vertexFormat_{mesh.vertexFormat} {
+		create(mesh, keepOccluderGeometry, nullptr);
+	}
+
+	BveModel::BveModel(BveDevice& device, const MeshData& mesh, bool keepOccluderGeometry, std::vector<BufferUpload>& uploads) : bveDevice_{device}, vertexFormat_{mesh.vertexFormat} {
+		create(mesh, keepOccluderGeometry, &uploads);
+	}
+
+	BveModel::BveModel(BveDevice& device, const MeshData& mesh, StagingBuffers staging, bool keepOccluderGeometry, std::vector<BufferUpload>& uploads) : bveDevice_{device}, vertexFormat_{mesh.vertexFormat} {
+		create(mesh, std::move(staging), keepOccluderGeometry, &uploads);
 	}
 
 	BveModel::~BveModel() = default;
 
-	std::unique_ptr<BveModel> BveModel::createModelFromFile(BveDevice& device, const std::string& filepath) {
+	void BveModel::create(const MeshData& mesh, bool keepOccluderGeometry, std::vector<BufferUpload>* uploads)
+	{
+		StagingBuffers staging = createStagingBuffers(bveDevice_, mesh);
+		staging.vertices->writeToBuffer(const_cast<std::byte*>(mesh.vertices.data()));
+		if (staging.indices) {
+			staging.indices->writeToBuffer(const_cast<std::byte*>(mesh.indices.data()));
+		}
+		create(mesh, std::move(staging), keepOccluderGeometry, uploads);
+	}
+
+	void BveModel::create(const MeshData& mesh, StagingBuffers staging, bool keepOccluderGeometry, std::vector<BufferUpload>* uploads)
+	{
+		assert(!mesh.lods.empty() && "Mesh data needs at least one level of detail");
+		positionTransform_ = mesh.positionTransform;
+		createVertexBuffer(std::move(staging.vertices), mesh.vertexCount, mesh.vertexStride, uploads);
+		createIndexBuffer(std::move(staging.indices), mesh.indexCount, mesh.indexSize, uploads);
+
+		lods_.assign(mesh.lods.begin(), mesh.lods.end());
+		meshlets_.assign(mesh.meshlets.begin(), mesh.meshlets.end());
+		if (keepOccluderGeometry) {
+			copyOccluderGeometry(mesh);
+		}
+
+		boundingCenter_ = mesh.boundingCenter;
+		boundingRadius_ = mesh.boundingRadius;
+		boundsMin_ = mesh.boundsMin;
+		boundsMax_ = mesh.boundsMax;
+		doubleSided_ = mesh.doubleSided;
+		memoryStats_.fullBytes = mesh.fullBytes;
+	}
+
+	void BveModel::copyOccluderGeometry(const MeshData& mesh)
+	{
+		occluderPositions_.resize(mesh.vertexCount);
+		for (uint32_t i = 0; i < mesh.vertexCount; i++) {
+			const std::byte* vertex = mesh.vertices.data() + static_cast<size_t>(i) * mesh.vertexStride;
+			if (mesh.vertexFormat == VertexFormat::PACKED) {
+				uint16_t position[3];
+				std::memcpy(position, vertex + offsetof(PackedVertex, position), sizeof(position));
+				const glm::vec4 unorm{position[0] / 65535.f, position[1] / 65535.f, position[2] / 65535.f, 1.f};
+				occluderPositions_[i] = glm::vec3{mesh.positionTransform * unorm};
+			} else {
+				std::memcpy(&occluderPositions_[i], vertex + offsetof(Vertex, position), sizeof(glm::vec3));
+			}
+		}
+
+		if (!hasIndexBuffer_) {
+			occluderIndices_.resize(vertexCount_);
+			std::iota(occluderIndices_.begin(), occluderIndices_.end(), 0);
+			return;
+		}
+
+		const Lod& full = lods_[0];
+		occluderIndices_.resize(full.indexCount);
+		for (uint32_t i = 0; i < full.indexCount; i++) {
+			const std::byte* index = mesh.indices.data() + static_cast<size_t>(full.firstIndex + i) * mesh.indexSize;
+			if (mesh.indexSize == sizeof(uint16_t)) {
+				uint16_t value;
+				std::memcpy(&value, index, sizeof(value));
+				occluderIndices_[i] = value;
+			} else {
+				std::memcpy(&occluderIndices_[i], index, sizeof(uint32_t));
+			}
+		}
+	}
+
+	std::unique_ptr<BveModel> BveModel::createModelFromFile(BveDevice& device, const std::string& filepath, VertexFormat vertexFormat, bool keepOccluderGeometry, std::vector<BufferUpload>* uploads, std::optional<uint64_t> sourceHash) {
+		IG_PROFILE_FUNCTION();
+		const auto start = std::chrono::steady_clock::now();
+		auto elapsedMilliseconds = [&start]() {
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		};
+		// deferred copies haven't happened yet, only the staging buffers have been filled
+		const char* uploadName = uploads ? "staging" : "upload";
+		auto logMemory = [&filepath](const BveModel& model, const MeshData& mesh) {
+			const MemoryStats& stats = model.getMemoryStats();
+			const VkDeviceSize bytes = stats.vertexBytes + stats.indexBytes;
+			LOG_INFO("loaded {}: {} vertices, {} indices, {:.1f} KiB on gpu, {:.1f} KiB less than full vertices with 32-bit indices",
+				filepath, mesh.vertexCount, mesh.indexCount, bytes / 1024.0, (stats.fullBytes - bytes) / 1024.0);
+		};
+
 		Builder builder{};
+		builder.vertexFormat = vertexFormat;
+		builder.keepOccluderGeometry = keepOccluderGeometry;
+
+		const std::string cachePath = mesh_cache::getCachePath(filepath, vertexFormat);
+		const mesh_cache::Key key = sourceHash ? mesh_cache::makeKey(*sourceHash, builder) : mesh_cache::makeKey(filepath, builder);
+		if (std::optional<mesh_cache::CachedMesh> cached = mesh_cache::read(cachePath, key)) {
+			const double readMilliseconds = elapsedMilliseconds();
+			auto model = uploads
+				? std::make_unique<BveModel>(device, cached->data, keepOccluderGeometry, *uploads)
+				: std::make_unique<BveModel>(device, cached->data, keepOccluderGeometry);
+			LOG_INFO("read {} from {} in {:.2f} ms, {:.2f} ms including {}", filepath, cachePath, readMilliseconds, elapsedMilliseconds(), uploadName);
+			logMemory(*model, cached->data);
+			return model;
+		}
+
 		builder.loadModel(filepath);
-		return std::make_unique<BveModel>(device, builder);
+		const PackedMesh packed = builder.pack();
+		const double importMilliseconds = elapsedMilliseconds();
+		mesh_cache::write(cachePath, key, packed.data);
+
+		auto model = uploads
+			? std::make_unique<BveModel>(device, packed.data, keepOccluderGeometry, *uploads)
+			: std::make_unique<BveModel>(device, packed.data, keepOccluderGeometry);
+		LOG_INFO("imported {} in {:.2f} ms, {:.2f} ms including cache write and {}", filepath, importMilliseconds, elapsedMilliseconds(), uploadName);
+		logMemory(*model, packed.data);
+		return model;
 	}
 
-	void BveModel::createVertexBuffer(const std::vector<Vertex>& vertices)
+	BveModel::PackedMesh BveModel::Builder::pack() const
 	{
-		vertexCount_ = static_cast<uint32_t>(vertices.size());
-		assert(vertexCount_ >= 3 && "Vertex count must be >= 3");
+		IG_PROFILE_FUNCTION();
+		PackedMesh packed{};
+		MeshData& mesh = packed.data;
+		mesh.vertexFormat = vertexFormat;
+		mesh.vertexCount = static_cast<uint32_t>(vertices.size());
+
+		if (vertexFormat == VertexFormat::PACKED) {
+			glm::vec3 boundsMin, boundsExtent;
+			const std::vector<PackedVertex> packedVertices = packVertices(vertices, boundsMin, boundsExtent);
+			mesh.vertexStride = sizeof(PackedVertex);
+			packed.vertices.resize(packedVertices.size() * sizeof(PackedVertex));
+			std::memcpy(packed.vertices.data(), packedVertices.data(), packed.vertices.size());
+
+			mesh.positionTransform[0][0] = boundsExtent.x;
+			mesh.positionTransform[1][1] = boundsExtent.y;
+			mesh.positionTransform[2][2] = boundsExtent.z;
+			mesh.positionTransform[3] = glm::vec4{boundsMin, 1.f};
+		} else {
+			mesh.vertexStride = sizeof(Vertex);
+			packed.vertices.resize(vertices.size() * sizeof(Vertex));
+			std::memcpy(packed.vertices.data(), vertices.data(), packed.vertices.size());
+		}
 
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount_;
-		uint32_t vertexSize = sizeof(vertices[0]);
+		// every index of a mesh with at most 65536 vertices fits in 16 bits, which halves the index buffer
+		mesh.indexCount = static_cast<uint32_t>(indices.size());
+		if (mesh.vertexCount <= std::numeric_limits<uint16_t>::max() + 1u) {
+			mesh.indexSize = sizeof(uint16_t);
+			packed.indices.resize(indices.size() * sizeof(uint16_t));
+			for (size_t i = 0; i < indices.size(); i++) {
+				const auto index = static_cast<uint16_t>(indices[i]);
+				std::memcpy(packed.indices.data() + i * sizeof(uint16_t), &index, sizeof(index));
+			}
+		} else {
+			mesh.indexSize = sizeof(uint32_t);
+			packed.indices.resize(indices.size() * sizeof(uint32_t));
+			std::memcpy(packed.indices.data(), indices.data(), packed.indices.size());
+		}
 
-		VulkanBuffer stagingBuffer{
-			bveDevice_,
-			vertexSize,
-			vertexCount_,
+		packed.lods = lods;
+		if (packed.lods.empty()) {
+			packed.lods.push_back(Lod{0, mesh.indexCount, 0.f});
+		}
+
+		const mesh_attributes::Bounds bounds = mesh_attributes::computeBounds(getPositionStreams(vertices));
+		mesh.boundingCenter = bounds.center;
+		mesh.boundingRadius = bounds.radius;
+		mesh.boundsMin = bounds.min;
+		mesh.boundsMax = bounds.max;
+
+		mesh.fullBytes = sizeof(Vertex) * vertices.size() + sizeof(uint32_t) * indices.size();
+		mesh.doubleSided = doubleSided;
+		mesh.vertices = packed.vertices;
+		mesh.indices = packed.indices;
+		mesh.lods = packed.lods;
+		mesh.meshlets = meshlets;
+		return packed;
+	}
+
+	std::vector<BveModel::PackedVertex> BveModel::packVertices(const std::vector<Vertex>& vertices, glm::vec3& boundsMin, glm::vec3& boundsExtent)
+	{
+		boundsMin = glm::vec3{std::numeric_limits<float>::max()};
+		glm::vec3 boundsMax{std::numeric_limits<float>::lowest()};
+		for (const Vertex& vertex : vertices) {
+			boundsMin = glm::min(boundsMin, vertex.position);
+			boundsMax = glm::max(boundsMax, vertex.position);
+		}
+
+		// flat meshes like quad.obj have no extent along one axis, which would divide by zero
+		boundsExtent = glm::max(boundsMax - boundsMin, glm::vec3{std::numeric_limits<float>::min()});
+		const glm::vec3 inverseExtent = 1.f / boundsExtent;
+
+		std::vector<PackedVertex> packed(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++) {
+			const Vertex& vertex = vertices[i];
+			PackedVertex& out = packed[i];
+
+			const glm::u16vec3 position = glm::round(glm::clamp((vertex.position - boundsMin) * inverseExtent, 0.f, 1.f) * 65535.f);
+			out.position[0] = position.x;
+			out.position[1] = position.y;
+			out.position[2] = position.z;
+
+			// project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the diagonals
+			glm::vec2 octahedral{0.f};
+			const float length = std::abs(vertex.normal.x) + std::abs(vertex.normal.y) + std::abs(vertex.normal.z);
+			if (length > 0.f) {
+				const glm::vec3 n = vertex.normal / length;
+				octahedral = glm::vec2{n.x, n.y};
+				if (n.z < 0.f) {
+					const glm::vec2 sign{n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f};
+					octahedral = (1.f - glm::abs(glm::vec2{n.y, n.x})) * sign;
+				}
+			}
+			const uint32_t normal = glm::packSnorm2x16(octahedral);
+			out.normal[0] = static_cast<int16_t>(normal & 0xffff);
+			out.normal[1] = static_cast<int16_t>(normal >> 16);
+
+			// measured against the basis of the normal the shader decodes, so quantizing the normal doesn't turn it
+			glm::vec3 basisTangent, basisBitangent;
+			mesh_attributes::buildBasis(decodeOctahedral(normal), basisTangent, basisBitangent);
+			const glm::vec3 tangent{vertex.tangent};
+			const float angle = std::atan2(glm::dot(tangent, basisBitangent), glm::dot(tangent, basisTangent));
+			out.tangent = static_cast<uint16_t>(std::lround((angle / std::numbers::pi_v<float> * 0.5f + 0.5f) * 32767.f))
+				| (vertex.tangent.w < 0.f ? 0x8000 : 0);
+
+			out.color = glm::packUnorm4x8(glm::vec4{glm::clamp(vertex.color, 0.f, 1.f), 1.f});
+			out.uv = glm::packHalf2x16(vertex.uv);
+		}
+
+		return packed;
+	}
+
+	BveModel::StagingBuffers BveModel::createStagingBuffers(BveDevice& device, const MeshData& mesh)
+	{
+		assert(mesh.vertexCount >= 3 && "Vertex count must be >= 3");
+		StagingBuffers staging{};
+		staging.vertices = std::make_unique<VulkanBuffer>(
+			device,
+			mesh.vertexStride,
+			mesh.vertexCount,
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		staging.vertices->map();
+
+		if (mesh.indexCount > 0) {
+			assert((mesh.indexSize == sizeof(uint16_t) || mesh.indexSize == sizeof(uint32_t)) && "Indices must be 16 or 32 bits");
+			staging.indices = std::make_unique<VulkanBuffer>(
+				device,
+				mesh.indexSize,
+				mesh.indexCount,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			staging.indices->map();
+		}
+		return staging;
+	}
+
+	void BveModel::createVertexBuffer(std::unique_ptr<VulkanBuffer> stagingBuffer, uint32_t vertexCount, uint32_t vertexSize, std::vector<BufferUpload>* uploads)
+	{
+		vertexCount_ = vertexCount;
+		assert(vertexCount_ >= 3 && "Vertex count must be >= 3");
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)vertices.data());
+		VkDeviceSize bufferSize = static_cast<VkDeviceSize>(vertexSize) * vertexCount_;
+		memoryStats_.vertexBytes = bufferSize;
 
 		vertexBuffer_ = std::make_unique<VulkanBuffer>(
 			bveDevice_,
@@ -64,31 +335,23 @@ namespace bve
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-		bveDevice_.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer_->getBuffer(), bufferSize);
+		uploadBuffer(std::move(stagingBuffer), *vertexBuffer_, bufferSize, uploads);
 	}
 
-	void BveModel::createIndexBuffer(const std::vector<uint32_t>& indices)
+	void BveModel::createIndexBuffer(std::unique_ptr<VulkanBuffer> stagingBuffer, uint32_t indexCount, uint32_t indexSize, std::vector<BufferUpload>* uploads)
 	{
-		indexCount_ = static_cast<uint32_t>(indices.size());
+		indexCount_ = indexCount;
 		hasIndexBuffer_ = indexCount_ > 0;
 
 		if (!hasIndexBuffer_) {
 			return;
 		}
 
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount_;
-		uint32_t indexSize = sizeof(indices[0]);
-
-		VulkanBuffer stagingBuffer{
-			bveDevice_,
-			indexSize,
-			indexCount_,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
+		assert((indexSize == sizeof(uint16_t) || indexSize == sizeof(uint32_t)) && "Indices must be 16 or 32 bits");
+		indexType_ = indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)indices.data());
+		VkDeviceSize bufferSize = static_cast<VkDeviceSize>(indexSize) * indexCount_;
+		memoryStats_.indexBytes = bufferSize;
 
 		indexBuffer_ = std::make_unique<VulkanBuffer>(
 			bveDevice_,
@@ -97,7 +360,16 @@ namespace bve
 			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-		bveDevice_.copyBuffer(stagingBuffer.getBuffer(), indexBuffer_->getBuffer(), bufferSize);
+		uploadBuffer(std::move(stagingBuffer), *indexBuffer_, bufferSize, uploads);
+	}
+
+	void BveModel::uploadBuffer(std::unique_ptr<VulkanBuffer> stagingBuffer, const VulkanBuffer& buffer, VkDeviceSize size, std::vector<BufferUpload>* uploads)
+	{
+		if (uploads) {
+			uploads->push_back(BufferUpload{std::move(stagingBuffer), buffer.getBuffer(), size});
+			return;
+		}
+		bveDevice_.copyBuffer(stagingBuffer->getBuffer(), buffer.getBuffer(), size);
 	}
 
 	void BveModel::bind(VkCommandBuffer commandBuffer) const
@@ -107,95 +379,302 @@ namespace bve
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
 
 		if (hasIndexBuffer_) {
-			vkCmdBindIndexBuffer(commandBuffer, indexBuffer_->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer_->getBuffer(), 0, indexType_);
 		}
 	}
 
-	void BveModel::draw(VkCommandBuffer commandBuffer) const
+	void BveModel::draw(VkCommandBuffer commandBuffer, uint32_t lod) const
 	{
 		if (hasIndexBuffer_) {
-			vkCmdDrawIndexed(commandBuffer, indexCount_, 1, 0, 0, 0);
+			const Lod& range = lods_[std::min(lod, getLodCount() - 1)];
+			vkCmdDrawIndexed(commandBuffer, range.indexCount, 1, range.firstIndex, 0, 0);
 		} else {
 			vkCmdDraw(commandBuffer, vertexCount_, 1, 0, 0);
 		}
 	}
 
-	std::vector<VkVertexInputBindingDescription> BveModel::Vertex::getBindingDescriptions()
+	uint32_t BveModel::getTriangleCount(uint32_t lod) const
+	{
+		return (hasIndexBuffer_ ? lods_[std::min(lod, getLodCount() - 1)].indexCount : vertexCount_) / 3;
+	}
+
+	void BveModel::drawIndices(VkCommandBuffer commandBuffer, uint32_t firstIndex, uint32_t indexCount) const
+	{
+		assert(hasIndexBuffer_ && "Cannot draw index ranges of a model without an index buffer");
+		vkCmdDrawIndexed(commandBuffer, indexCount, 1, firstIndex, 0, 0);
+	}
+
+	std::vector<VkVertexInputBindingDescription> BveModel::Vertex::getBindingDescriptions(VertexFormat format)
 	{
 		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
 		bindingDescriptions[0].binding = 0;
-		bindingDescriptions[0].stride = sizeof(Vertex);
+		bindingDescriptions[0].stride = format == VertexFormat::PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
 		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 		return bindingDescriptions;
 	}
 
-	std::vector<VkVertexInputAttributeDescription> BveModel::Vertex::getAttributeDescriptions()
+	std::vector<VkVertexInputAttributeDescription> BveModel::Vertex::getAttributeDescriptions(VertexFormat format)
 	{
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
 
+		if (format == VertexFormat::PACKED) {
+			// the fourth component is the tangent, which the shader reads on its own below
+			attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(PackedVertex, position)});
+			attributeDescriptions.push_back({1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedVertex, color)});
+			attributeDescriptions.push_back({2, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal)});
+			attributeDescriptions.push_back({3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv)});
+			attributeDescriptions.push_back({4, 0, VK_FORMAT_R16_UNORM, offsetof(PackedVertex, tangent)});
+			return attributeDescriptions;
+		}
+
 		attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)});
 		attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)});
 		attributeDescriptions.push_back({2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
 		attributeDescriptions.push_back({3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)});
+		attributeDescriptions.push_back({4, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, tangent)});
 
 		return attributeDescriptions;
 	}
 
 	void BveModel::Builder::loadModel(const std::string& filepath)
 	{
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		std::string warn, err;
-
-		if (!LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str())) {
-			// todo: handle gracefully
-			throw std::runtime_error(warn + err);
+		IG_PROFILE_FUNCTION();
+		// glb files are already indexed, so they skip the weld obj corners need
+		const auto [file, fragment] = splitAssetPath(filepath);
+		if (std::filesystem::path{file}.extension() == ".glb") {
+			const auto start = std::chrono::steady_clock::now();
+			gltf::Document::open(std::string{file})->loadMesh(gltf::parseMeshIndex(fragment), *this);
+			LOG_INFO("read {} vertices and {} indices from {} in {:.2f} ms", vertices.size(), indices.size(), filepath,
+				std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			process(filepath);
+			return;
 		}
 
-		vertices.clear();
-		indices.clear();
+		const obj_parser::Mesh mesh = obj_parser::load(filepath);
 
-		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				Vertex vertex{};
+		const auto cornerCount = static_cast<uint32_t>(mesh.indices.size());
+		std::vector<Vertex> corners(cornerCount);
+		ThreadPool::instance().parallelFor(cornerCount, [&mesh, &corners](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				const obj_parser::Index& index = mesh.indices[i];
+				Vertex& vertex = corners[i];
 
-				if (index.vertex_index >= 0) {
-					vertex.position = {
-						attrib.vertices[3 * index.vertex_index + 0],
-						attrib.vertices[3 * index.vertex_index + 1],
-						attrib.vertices[3 * index.vertex_index + 2],
-					};
+				vertex.position = {
+					mesh.positions[3 * index.position + 0],
+					mesh.positions[3 * index.position + 1],
+					mesh.positions[3 * index.position + 2],
+				};
 
-					vertex.color = {
-						attrib.colors[3 * index.vertex_index + 0],
-						attrib.colors[3 * index.vertex_index + 1],
-						attrib.colors[3 * index.vertex_index + 2],
-					};
-				}
+				vertex.color = {
+					mesh.colors[3 * index.position + 0],
+					mesh.colors[3 * index.position + 1],
+					mesh.colors[3 * index.position + 2],
+				};
 
-				if (index.normal_index >= 0) {
+				if (index.normal >= 0) {
 					vertex.normal = {
-						attrib.normals[3 * index.normal_index + 0],
-						attrib.normals[3 * index.normal_index + 1],
-						attrib.normals[3 * index.normal_index + 2],
+						mesh.normals[3 * index.normal + 0],
+						mesh.normals[3 * index.normal + 1],
+						mesh.normals[3 * index.normal + 2],
 					};
 				}
 
-				if (index.texcoord_index >= 0) {
+				if (index.texcoord >= 0) {
 					vertex.uv = {
-						attrib.texcoords[2 * index.texcoord_index + 0],
-						attrib.texcoords[2 * index.texcoord_index + 1],
+						mesh.texcoords[2 * index.texcoord + 0],
+						mesh.texcoords[2 * index.texcoord + 1],
 					};
 				}
+			}
+		}, 4096);
+
+		// vertices are plain floats, so they can be welded by their bytes
+		constexpr uint32_t FLOATS_PER_VERTEX = sizeof(Vertex) / sizeof(float);
+		static_assert(sizeof(Vertex) == FLOATS_PER_VERTEX * sizeof(float));
+		const std::span<const float> cornerFloats{reinterpret_cast<const float*>(corners.data()), corners.size() * FLOATS_PER_VERTEX};
+		std::vector<uint32_t> unique;
+		const uint32_t threadCount = ThreadPool::instance().getThreadCount() + 1;
+		const auto weldStart = std::chrono::steady_clock::now();
+		if (cornerCount >= mesh_optimizer::PARALLEL_WELD_MIN_CORNERS && threadCount >= mesh_optimizer::PARALLEL_WELD_MIN_THREADS) {
+			mesh_optimizer::weldVerticesSorted(cornerFloats, FLOATS_PER_VERTEX, unique, indices);
+		} else {
+			mesh_optimizer::weldVertices(cornerFloats, FLOATS_PER_VERTEX, unique, indices);
+		}
+
+		vertices.resize(unique.size());
+		for (size_t i = 0; i < unique.size(); i++) {
+			vertices[i] = corners[unique[i]];
+		}
+		LOG_INFO("welded {} corners of {} into {} vertices in {:.2f} ms", cornerCount, filepath, vertices.size(),
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - weldStart).count());
+
+		process(filepath);
+	}
+
+	void BveModel::Builder::process(const std::string& name)
+	{
+		if (generateNormals || generateTangents) {
+			generateAttributes();
+		}
+
+		if (!doubleSided) {
+			std::vector<glm::vec3> positions(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++) {
+				positions[i] = vertices[i].position;
+			}
+			doubleSided = mesh_optimizer::hasOpenEdges(indices, positions);
+			if (doubleSided) {
+				LOG_INFO("{} has open borders, it is drawn double sided", name);
+			}
+		}
+
+		if (optimizeMesh) {
+			const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+			const auto before = mesh_optimizer::analyzeVertexCache(indices, vertexCount);
+			optimize();
+			const auto after = mesh_optimizer::analyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+			LOG_INFO("optimized {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", name, before.acmr, after.acmr, before.atvr, after.atvr);
+		} else if (generateMeshlets) {
+			buildMeshlets();
+		}
+
+		if (!meshlets.empty()) {
+			LOG_INFO("split {} into {} meshlets, {:.1f} triangles each", name, meshlets.size(), indices.size() / 3.0 / meshlets.size());
+		}
+
+		if (generateLods) {
+			generateLodChain();
 
-				if (!uniqueVertices.contains(vertex)) {
-					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-					vertices.push_back(vertex);
+			std::string triangleCounts;
+			for (const Lod& lod : lods) {
+				triangleCounts += (triangleCounts.empty() ? "" : ", ") + std::to_string(lod.indexCount / 3);
+			}
+			LOG_INFO("generated {} levels of detail for {}: {} triangles, max error {:.4f}", lods.size(), name, triangleCounts, lods.back().error);
+		}
+	}
+
+	void BveModel::Builder::generateAttributes()
+	{
+		IG_PROFILE_FUNCTION();
+		const auto start = std::chrono::steady_clock::now();
+		const mesh_attributes::Streams positions = getPositionStreams(vertices);
+
+		uint32_t normalCount = 0;
+		if (generateNormals) {
+			const bool missing = std::any_of(vertices.begin(), vertices.end(), [](const Vertex& vertex) { return vertex.normal == glm::vec3{0.f}; });
+			if (missing) {
+				const mesh_attributes::Streams normals = mesh_attributes::generateNormals(positions, indices, normalWeighting);
+				for (size_t i = 0; i < vertices.size(); i++) {
+					if (vertices[i].normal == glm::vec3{0.f}) {
+						vertices[i].normal = normals.get(i);
+						normalCount++;
+					}
+				}
+			}
+		}
+
+		uint32_t tangentCount = 0;
+		const bool missingTangents = std::any_of(vertices.begin(), vertices.end(), [](const Vertex& vertex) { return glm::vec3{vertex.tangent} == glm::vec3{0.f}; });
+		if (generateTangents && missingTangents) {
+			mesh_attributes::Streams normals{};
+			mesh_attributes::Streams uvs{};
+			for (const Vertex& vertex : vertices) {
+				normals.x.push_back(vertex.normal.x);
+				normals.y.push_back(vertex.normal.y);
+				normals.z.push_back(vertex.normal.z);
+				uvs.x.push_back(vertex.uv.x);
+				uvs.y.push_back(vertex.uv.y);
+			}
+			const std::vector<glm::vec4> tangents = mesh_attributes::generateTangents(positions, normals, uvs, indices);
+			for (size_t i = 0; i < vertices.size(); i++) {
+				if (glm::vec3{vertices[i].tangent} == glm::vec3{0.f}) {
+					vertices[i].tangent = tangents[i];
+					tangentCount++;
 				}
-				indices.push_back(uniqueVertices[vertex]);
 			}
 		}
+
+		if (normalCount > 0 || tangentCount > 0) {
+			LOG_INFO("generated {} normals and {} tangents in {:.2f} ms", normalCount, tangentCount,
+				std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+	}
+
+	void BveModel::Builder::optimize()
+	{
+		IG_PROFILE_FUNCTION();
+		const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+		mesh_optimizer::optimizeVertexCache(indices, vertexCount);
+
+		std::vector<glm::vec3> positions(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			positions[i] = vertices[i].position;
+		}
+		mesh_optimizer::optimizeOverdraw(indices, positions);
+
+		// before fetch ordering, so vertices end up in meshlet order too. Building them reorders the triangles for
+		// culling, so each meshlet gets its cache order back
+		if (generateMeshlets) {
+			buildMeshlets();
+			mesh_optimizer::optimizeMeshletVertexCache(indices, meshlets, vertexCount);
+		}
+
+		std::vector<uint32_t> remap;
+		const uint32_t fetchVertexCount = mesh_optimizer::optimizeVertexFetch(indices, vertexCount, remap);
+		vertices = mesh_optimizer::remapVertices(vertices, remap, fetchVertexCount);
+	}
+
+	void BveModel::Builder::buildMeshlets()
+	{
+		IG_PROFILE_FUNCTION();
+		std::vector<glm::vec3> positions(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++) {
+			positions[i] = vertices[i].position;
+		}
+		meshlets = mesh_optimizer::buildMeshlets(indices, positions);
+	}
+
+	void BveModel::Builder::generateLodChain()
+	{
+		IG_PROFILE_FUNCTION();
+		assert(lods.empty() && "Levels of detail were already generated");
+
+		const uint32_t fullIndexCount = static_cast<uint32_t>(indices.size());
+		lods.push_back(Lod{0, fullIndexCount, 0.f});
+		if (fullIndexCount == 0) {
+			return;
+		}
+
+		std::vector<glm::vec3> positions(vertices.size());
+		std::vector<glm::vec3> normals(vertices.size());
+		glm::vec3 boundsMin = vertices[0].position;
+		glm::vec3 boundsMax = boundsMin;
+		for (size_t i = 0; i < vertices.size(); i++) {
+			positions[i] = vertices[i].position;
+			normals[i] = vertices[i].normal;
+			boundsMin = glm::min(boundsMin, positions[i]);
+			boundsMax = glm::max(boundsMax, positions[i]);
+		}
+		const float maxError = glm::length(boundsMax - boundsMin) * 0.5f * LOD_MAX_ERROR;
+
+		// every level is simplified from the full mesh so its error is measured against it rather than accumulated
+		const std::vector<uint32_t> fullIndices(indices.begin(), indices.end());
+		float targetRatio = 1.f;
+		for (uint32_t level = 1; level < MAX_LODS; level++) {
+			targetRatio *= LOD_REDUCTION;
+			const uint32_t targetIndexCount = static_cast<uint32_t>(fullIndexCount * targetRatio) / 3 * 3;
+
+			float error = 0.f;
+			std::vector<uint32_t> lodIndices = mesh_optimizer::simplify(fullIndices, positions, normals, targetIndexCount, maxError, error);
+
+			// stop once simplification stalls, a level barely smaller than the previous one is not worth switching to
+			if (lodIndices.empty() || lodIndices.size() > lods.back().indexCount * 9 / 10) {
+				break;
+			}
+
+			mesh_optimizer::optimizeVertexCache(lodIndices, static_cast<uint32_t>(vertices.size()));
+			lods.push_back(Lod{static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lodIndices.size()), std::max(error, lods.back().error)});
+			indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+		}
 	}
 }
@@ -2,12 +2,17 @@
 
 #include "bve_device.h"
 #include "vulkan_buffer.h"
+#include "vulkan_upload_queue.h"
+#include "mesh_attributes.h"
+#include "mesh_optimizer.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
 #include <memory>
+#include <optional>
+#include <span>
 #include <vector>
 
 namespace bve
@@ -15,31 +20,145 @@ namespace bve
 	class BveModel
 	{
 	public:
+		enum class VertexFormat
+		{
+			FULL, // 60 bytes, all attributes as 32-bit floats
+			PACKED, // 20 bytes, positions quantized to the mesh bounds, octahedral normals, unorm8 colors, half float uvs, tangent angles
+		};
+
 		struct Vertex
 		{
 			glm::vec3 position;
 			glm::vec3 color;
 			glm::vec3 normal{};
 			glm::vec2 uv{};
+			glm::vec4 tangent{0.f}; // w is the handedness of the bitangent, 1 or -1
 
-			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(VertexFormat format = VertexFormat::FULL);
+			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(VertexFormat format = VertexFormat::FULL);
 
 			bool operator==(const Vertex& other) const
 			{
-				return position == other.position && color == other.color && normal == other.normal && uv == other.uv;
+				return position == other.position && color == other.color && normal == other.normal && uv == other.uv && tangent == other.tangent;
 			}
 		};
 
+		// decoded by simple_shader.vert, the position is dequantized by the matrix from getPositionTransform
+		struct PackedVertex
+		{
+			uint16_t position[3]; // unorm16 within the mesh bounds
+			uint16_t tangent; // angle around the normal from mesh_attributes::buildBasis in 15 bits, the top bit set for a flipped bitangent
+			int16_t normal[2]; // snorm16 octahedral encoding
+			uint32_t color; // unorm8 rgba
+			uint32_t uv; // two half floats
+		};
+
+		// a range of the shared index buffer, error is the largest deviation from the full mesh in model units
+		struct Lod
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error;
+		};
+
+		static constexpr uint32_t MAX_LODS = 6;
+		// each level aims for this fraction of the triangles of the previous one
+		static constexpr float LOD_REDUCTION = 0.5f;
+		// simplification stops before any point moves further than this fraction of the bounding radius
+		static constexpr float LOD_MAX_ERROR = 0.05f;
+
+		// a mesh in the layout it is uploaded in, the spans point into a PackedMesh or a mapped cache file
+		struct MeshData
+		{
+			VertexFormat vertexFormat = VertexFormat::FULL;
+			uint32_t vertexCount = 0;
+			uint32_t vertexStride = 0;
+			std::span<const std::byte> vertices;
+			uint32_t indexCount = 0;
+			uint32_t indexSize = 0; // 2 or 4 bytes
+			std::span<const std::byte> indices;
+			std::span<const Lod> lods; // never empty
+			std::span<const mesh_optimizer::Meshlet> meshlets;
+			glm::mat4 positionTransform{1.f};
+			glm::vec3 boundingCenter{0.f};
+			float boundingRadius = 0.f;
+			glm::vec3 boundsMin{0.f};
+			glm::vec3 boundsMax{0.f};
+			uint64_t fullBytes = 0; // the same mesh with full vertices and 32-bit indices
+			bool doubleSided = false;
+		};
+
+		// a builder's mesh converted to the upload layout, data points into the other members so it can't be copied
+		struct PackedMesh
+		{
+			MeshData data{};
+			std::vector<std::byte> vertices;
+			std::vector<std::byte> indices;
+			std::vector<Lod> lods;
+
+			PackedMesh() = default;
+			PackedMesh(const PackedMesh&) = delete;
+			PackedMesh& operator=(const PackedMesh&) = delete;
+			PackedMesh(PackedMesh&&) = default;
+			PackedMesh& operator=(PackedMesh&&) = default;
+		};
+
 		struct Builder
 		{
 			std::vector<Vertex> vertices{};
-			std::vector<uint32_t> indices{};
-
+			std::vector<uint32_t> indices{}; // every level of detail, one after another
+			std::vector<Lod> lods{}; // empty means a single level made of all indices
+			std::vector<mesh_optimizer::Meshlet> meshlets{}; // partition of the full level of detail
+			VertexFormat vertexFormat = VertexFormat::PACKED;
+			bool optimizeMesh = true;
+			bool generateMeshlets = true;
+			bool generateLods = true;
+			bool keepOccluderGeometry = false; // keep the full level of detail in memory for the occlusion buffer
+			bool generateNormals = true; // for vertices that came without one
+			mesh_attributes::NormalWeighting normalWeighting = mesh_attributes::NormalWeighting::ANGLE;
+			bool generateTangents = true; // for vertices that came without one
+			// drawn without culling back faces or meshlets facing away, process sets it for meshes with open borders
+			bool doubleSided = false;
+
+			// an obj file, or a mesh of a glb file named as in gltf::getMeshPath
 			void loadModel(const std::string& filepath);
+			// runs the attribute, optimization, meshlet and level of detail steps the flags ask for on the loaded mesh,
+			// and finds out whether it is double sided
+			void process(const std::string& name);
+			// fills in the normals and tangents the source left zero
+			void generateAttributes();
+			// reorders triangles for the vertex cache and overdraw, then vertices into fetch order
+			void optimize();
+			// reorders the full level of detail into meshlets, run before generateLodChain
+			void buildMeshlets();
+			// appends simplified versions of the full mesh to indices, all indexing the same vertices
+			void generateLodChain();
+			// quantizes vertices for PACKED, narrows indices to 16 bits where they fit and computes the bounds
+			PackedMesh pack() const;
+		};
+
+		// mapped host visible buffers sized for a mesh's vertices and indices, so they can be read from disk straight into
+		struct StagingBuffers
+		{
+			std::unique_ptr<VulkanBuffer> vertices;
+			std::unique_ptr<VulkanBuffer> indices; // null for a mesh without indices
+		};
+
+		struct MemoryStats
+		{
+			VkDeviceSize vertexBytes;
+			VkDeviceSize indexBytes;
+			VkDeviceSize fullBytes; // the same mesh with full vertices and 32-bit indices
 		};
 
 		BveModel(BveDevice& device, const Builder& builder);
+		// copies the blobs straight into staging buffers, the data only has to outlive the constructor
+		BveModel(BveDevice& device, const MeshData& mesh, bool keepOccluderGeometry = false);
+		// leaves the copies to the caller, the model can only be drawn once every upload appended to uploads has executed
+		BveModel(BveDevice& device, const MeshData& mesh, bool keepOccluderGeometry, std::vector<BufferUpload>& uploads);
+		// takes over staging buffers from createStagingBuffers that already hold the mesh, with its vertex and index
+		// spans pointing into them. The copies are left to the caller like above
+		BveModel(BveDevice& device, const MeshData& mesh, StagingBuffers staging, bool keepOccluderGeometry, std::vector<BufferUpload>& uploads);
 		~BveModel();
 
 		BveModel(const BveModel&) = delete;
@@ -47,22 +166,85 @@ namespace bve
 		BveModel(BveModel&& other) = default;
 		BveModel& operator=(BveModel&& other) = delete;
 
-		static std::unique_ptr<BveModel> createModelFromFile(BveDevice& device, const std::string& filepath);
+		// reads the binary cache next to the file, or imports it and writes the cache. With uploads the copies are left
+		// to the caller as in the constructor above, which makes it safe to call from worker threads. sourceHash is
+		// mesh_cache::hashSource of the file if the caller already has it
+		static std::unique_ptr<BveModel> createModelFromFile(
+			BveDevice& device,
+			const std::string& filepath,
+			VertexFormat vertexFormat = VertexFormat::PACKED,
+			bool keepOccluderGeometry = false,
+			std::vector<BufferUpload>* uploads = nullptr,
+			std::optional<uint64_t> sourceHash = std::nullopt);
+
+		// bump whenever Builder's output changes, so caches written by older importers are rebuilt
+		static constexpr uint32_t IMPORTER_VERSION = 4;
+
+		// sized by the counts and strides of mesh, its spans aren't read
+		static StagingBuffers createStagingBuffers(BveDevice& device, const MeshData& mesh);
+
+		// quantizes positions to the bounds of the vertices, which are returned for dequantization
+		static std::vector<PackedVertex> packVertices(const std::vector<Vertex>& vertices, glm::vec3& boundsMin, glm::vec3& boundsExtent);
 
 		void bind(VkCommandBuffer commandBuffer) const;
-		void draw(VkCommandBuffer commandBuffer) const;
+		void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0) const;
+		// draws part of the index buffer, such as the meshlets that survived culling
+		void drawIndices(VkCommandBuffer commandBuffer, uint32_t firstIndex, uint32_t indexCount) const;
+
+		VertexFormat getVertexFormat() const { return vertexFormat_; }
+		// maps the stored positions to model space, must be applied before the model matrix
+		const glm::mat4& getPositionTransform() const { return positionTransform_; }
+		const MemoryStats& getMemoryStats() const { return memoryStats_; }
+
+		uint32_t getLodCount() const { return static_cast<uint32_t>(lods_.size()); }
+		const Lod& getLod(uint32_t lod) const { return lods_[lod]; }
+		// triangles draw(commandBuffer, lod) submits
+		uint32_t getTriangleCount(uint32_t lod = 0) const;
+		// empty if the model wasn't split, the ranges cover all of the first level of detail
+		const std::vector<mesh_optimizer::Meshlet>& getMeshlets() const { return meshlets_; }
+		// an open mesh, whose back faces are visible, so neither its triangles nor its meshlets may be culled by facing
+		bool isDoubleSided() const { return doubleSided_; }
+
+		// model space triangles for cpu occlusion culling, empty unless the builder kept them
+		bool hasOccluderGeometry() const { return !occluderIndices_.empty(); }
+		const std::vector<glm::vec3>& getOccluderPositions() const { return occluderPositions_; }
+		const std::vector<uint32_t>& getOccluderIndices() const { return occluderIndices_; }
+		// bounds of the model space positions
+		const glm::vec3& getBoundingCenter() const { return boundingCenter_; }
+		float getBoundingRadius() const { return boundingRadius_; }
+		const glm::vec3& getBoundsMin() const { return boundsMin_; }
+		const glm::vec3& getBoundsMax() const { return boundsMax_; }
 
 	private:
-		void createVertexBuffer(const std::vector<Vertex>& vertices);
-		void createIndexBuffer(const std::vector<uint32_t>& indices);
+		// copies through a staging buffer right away when uploads is null
+		void create(const MeshData& mesh, bool keepOccluderGeometry, std::vector<BufferUpload>* uploads);
+		void create(const MeshData& mesh, StagingBuffers staging, bool keepOccluderGeometry, std::vector<BufferUpload>* uploads);
+		void createVertexBuffer(std::unique_ptr<VulkanBuffer> stagingBuffer, uint32_t vertexCount, uint32_t vertexSize, std::vector<BufferUpload>* uploads);
+		void createIndexBuffer(std::unique_ptr<VulkanBuffer> stagingBuffer, uint32_t indexCount, uint32_t indexSize, std::vector<BufferUpload>* uploads);
+		void uploadBuffer(std::unique_ptr<VulkanBuffer> stagingBuffer, const VulkanBuffer& buffer, VkDeviceSize size, std::vector<BufferUpload>* uploads);
+		void copyOccluderGeometry(const MeshData& mesh);
 
 		BveDevice& bveDevice_;
 
+		VertexFormat vertexFormat_;
+		glm::mat4 positionTransform_{1.f};
+		MemoryStats memoryStats_{};
+		std::vector<Lod> lods_;
+		std::vector<mesh_optimizer::Meshlet> meshlets_;
+		std::vector<glm::vec3> occluderPositions_;
+		std::vector<uint32_t> occluderIndices_;
+		glm::vec3 boundingCenter_{0.f};
+		float boundingRadius_ = 0.f;
+		glm::vec3 boundsMin_{0.f};
+		glm::vec3 boundsMax_{0.f};
+		bool doubleSided_ = false;
+
 		std::unique_ptr<VulkanBuffer> vertexBuffer_;
 		uint32_t vertexCount_;
 
 		bool hasIndexBuffer_ = false;
 		std::unique_ptr<VulkanBuffer> indexBuffer_;
 		uint32_t indexCount_;
+		VkIndexType indexType_ = VK_INDEX_TYPE_UINT32;
 	};
 }
@@ -2,21 +2,16 @@
 #include "bve_pipeline.h"
 #include "bve_model.h"
 
-#include <fstream>
-#include <stdexcept>
-
 namespace bve
 {
-	BvePipeline::BvePipeline(BveDevice& device, const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo)
-		: bveDevice_{device}
+	BvePipeline::BvePipeline(BveDevice& device, VkPipeline graphicsPipeline)
+		: bveDevice_{device}, graphicsPipeline_{graphicsPipeline}
 	{
-		createGraphicsPipeline(vertFilePath, fragFilePath, configInfo);
+		assert(graphicsPipeline_ != VK_NULL_HANDLE && "Cannot wrap a null graphics pipeline");
 	}
 
 	BvePipeline::~BvePipeline()
 	{
-		vkDestroyShaderModule(bveDevice_.device(), vertShaderModule_, nullptr);
-		vkDestroyShaderModule(bveDevice_.device(), fragShaderModule_, nullptr);
 		vkDestroyPipeline(bveDevice_.device(), graphicsPipeline_, nullptr);
 	}
 
@@ -84,110 +79,6 @@ namespace bve
 		configInfo.attributeDescriptions = BveModel::Vertex::getAttributeDescriptions();
 	}
 
-	std::vector<char> BvePipeline::readFile(const std::string& filepath)
-	{
-		std::ifstream file{filepath, std::ios::ate | std::ios::binary};
-
-		if (!file.is_open()) {
-			throw std::runtime_error("failed to open file: " + filepath);
-		}
-
-		size_t fileSize = file.tellg();
-		std::vector<char> buffer(fileSize);
-
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-
-		file.close();
-
-		return buffer;
-	}
-
-	void BvePipeline::createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo)
-	{
-		assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
-		assert(configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline: no renderPass provided in configInfo");
-
-		std::vector<char> vertCode = readFile(vertFilePath);
-		std::vector<char> fragCode = readFile(fragFilePath);
-
-		createShaderModule(vertCode, &vertShaderModule_);
-		createShaderModule(fragCode, &fragShaderModule_);
-
-		VkPipelineShaderStageCreateInfo shaderStages[2];
-		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shaderStages[0].module = vertShaderModule_;
-		shaderStages[0].pName = "main";
-		shaderStages[0].flags = 0;
-		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
-		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		shaderStages[1].module = fragShaderModule_;
-		shaderStages[1].pName = "main";
-		shaderStages[1].flags = 0;
-		shaderStages[1].pNext = nullptr;
-		shaderStages[1].pSpecializationInfo = nullptr;
-
-		auto& bindingDescriptions = configInfo.bindingDescriptions;
-		auto& attributeDescriptions = configInfo.attributeDescriptions;
-
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
-
-		VkPipelineColorBlendStateCreateInfo colorBlendInfo{};
-		colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlendInfo.logicOpEnable = VK_FALSE;
-		colorBlendInfo.logicOp = VK_LOGIC_OP_COPY; // Optional
-		colorBlendInfo.attachmentCount = 1;
-		colorBlendInfo.pAttachments = &configInfo.colorBlendAttachment;
-		colorBlendInfo.blendConstants[0] = 0.0f; // Optional
-		colorBlendInfo.blendConstants[1] = 0.0f; // Optional
-		colorBlendInfo.blendConstants[2] = 0.0f; // Optional
-		colorBlendInfo.blendConstants[3] = 0.0f; // Optional
-
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
-		pipelineInfo.pViewportState = &configInfo.viewportInfo;
-		pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
-		pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
-		pipelineInfo.pColorBlendState = &colorBlendInfo;
-		pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
-		pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
-
-		pipelineInfo.layout = configInfo.pipelineLayout;
-		pipelineInfo.renderPass = configInfo.renderPass;
-		pipelineInfo.subpass = configInfo.subpass;
-
-		pipelineInfo.basePipelineIndex = -1;
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-		if (vkCreateGraphicsPipelines(bveDevice_.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline_) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create graphics pipeline");
-		}
-	}
-
-	void BvePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
-	{
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-		if (vkCreateShaderModule(bveDevice_.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create shader module");
-		}
-	}
-
 	void BvePipeline::bind(VkCommandBuffer commandBuffer)
 	{
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline_);
@@ -3,7 +3,6 @@
 #include "bve_device.h"
 
 #include <vector>
-#include <string>
 
 namespace bve
 {
@@ -24,15 +23,18 @@ namespace bve
 		VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
 		std::vector<VkDynamicState> dynamicStateEnables;
 		VkPipelineDynamicStateCreateInfo dynamicStateInfo;
+		// values of the vertex shader's specialization constants, constant_id i is element i
+		std::vector<uint32_t> vertexSpecializationConstants{};
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
 	};
 
+	// owns a graphics pipeline created by BvePipelineBuilder
 	class BvePipeline
 	{
 	public:
-		BvePipeline(BveDevice& device, const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo);
+		BvePipeline(BveDevice& device, VkPipeline graphicsPipeline);
 		~BvePipeline();
 
 		BvePipeline(const BvePipeline&) = delete;
@@ -46,15 +48,7 @@ namespace bve
 		static void enableAlphaBlending(PipelineConfigInfo& configInfo);
 
 	private:
-		static std::vector<char> readFile(const std::string& filepath);
-
-		void createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo);
-
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
-
 		BveDevice& bveDevice_;
 		VkPipeline graphicsPipeline_;
-		VkShaderModule vertShaderModule_;
-		VkShaderModule fragShaderModule_;
 	};
 }
@@ -0,0 +1,239 @@
+#include "pch.h"
+#include "bve_pipeline_builder.h"
+#include "bve_utils.h"
+#include "core/async_file_reader.h"
+#include "core/thread_pool.h"
+#include "log.h"
+
+#include <chrono>
+#include <future>
+#include <stdexcept>
+
+namespace bve
+{
+	BvePipelineBuilder::BvePipelineBuilder(BveDevice& device) : bveDevice_{device}
+	{
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+		if (vkCreatePipelineCache(bveDevice_.device(), &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create pipeline cache");
+		}
+	}
+
+	BvePipelineBuilder::~BvePipelineBuilder()
+	{
+		destroyShaderModules();
+		vkDestroyPipelineCache(bveDevice_.device(), pipelineCache_, nullptr);
+	}
+
+	void BvePipelineBuilder::addPipeline(
+		std::unique_ptr<BvePipeline>& target,
+		const std::string& vertFilePath,
+		const std::string& fragFilePath,
+		std::unique_ptr<PipelineConfigInfo> configInfo)
+	{
+		assert(configInfo != nullptr && "Cannot add pipeline without a configInfo");
+		assert(configInfo->pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
+		assert(configInfo->renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline: no renderPass provided in configInfo");
+
+		requests_.push_back({&target, vertFilePath, fragFilePath, std::move(configInfo)});
+	}
+
+	void BvePipelineBuilder::build()
+	{
+		if (requests_.empty()) {
+			return;
+		}
+
+		const auto startTime = std::chrono::high_resolution_clock::now();
+
+		createShaderModules();
+
+		// vkCreateGraphicsPipelines is thread safe and the cache is internally synchronized,
+		// so each worker submits one batched call for its share of the requests
+		std::vector<VkPipeline> pipelines(requests_.size(), VK_NULL_HANDLE);
+		try {
+			ThreadPool::instance().parallelFor(static_cast<uint32_t>(requests_.size()), [&](uint32_t begin, uint32_t end) {
+				createPipelines(begin, end, pipelines);
+			});
+		} catch (...) {
+			// parallelFor rethrows once every worker has finished, so the pipelines the others created are all in
+			// place. A failed batch leaves VK_NULL_HANDLE for the pipelines it couldn't create
+			for (VkPipeline pipeline : pipelines) {
+				if (pipeline != VK_NULL_HANDLE) {
+					vkDestroyPipeline(bveDevice_.device(), pipeline, nullptr);
+				}
+			}
+			throw;
+		}
+
+		for (size_t i = 0; i < requests_.size(); i++) {
+			*requests_[i].target = std::make_unique<BvePipeline>(bveDevice_, pipelines[i]);
+		}
+
+		const size_t pipelineCount = requests_.size();
+		const size_t moduleCount = modulesByHash_.size();
+
+		// modules are no longer needed once the pipelines that reference them exist
+		destroyShaderModules();
+		requests_.clear();
+
+		const float elapsedMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+			std::chrono::high_resolution_clock::now() - startTime).count();
+		LOG_INFO("built {} pipelines from {} unique shader modules in {:.2f} ms", pipelineCount, moduleCount, elapsedMs);
+	}
+
+	void BvePipelineBuilder::createShaderModules()
+	{
+		std::vector<std::string> paths{};
+		for (const auto& request : requests_) {
+			for (const std::string* path : {&request.vertFilePath, &request.fragFilePath}) {
+				if (!modulesByPath_.contains(*path) && std::find(paths.begin(), paths.end(), *path) == paths.end()) {
+					paths.push_back(*path);
+				}
+			}
+		}
+
+		// every file is queued at once so the reads overlap, each is hashed while the later ones are still arriving
+		std::vector<std::future<std::vector<std::byte>>> reads;
+		for (const std::string& path : paths) {
+			reads.push_back(AsyncFileReader::instance().readFile(path));
+		}
+		std::vector<std::vector<std::byte>> codes(paths.size());
+		std::vector<uint64_t> hashes(paths.size());
+		for (size_t i = 0; i < paths.size(); i++) {
+			codes[i] = reads[i].get();
+			hashes[i] = hashBytes(codes[i].data(), codes[i].size());
+		}
+
+		for (size_t i = 0; i < paths.size(); i++) {
+			auto it = modulesByHash_.find(hashes[i]);
+			if (it == modulesByHash_.end()) {
+				it = modulesByHash_.emplace(hashes[i], createShaderModule(codes[i])).first;
+			}
+			modulesByPath_[paths[i]] = it->second;
+		}
+	}
+
+	void BvePipelineBuilder::createPipelines(uint32_t begin, uint32_t end, std::vector<VkPipeline>& pipelines)
+	{
+		const uint32_t count = end - begin;
+
+		// create infos point into these, so they are sized up front and never reallocated
+		std::vector<std::array<VkPipelineShaderStageCreateInfo, 2>> shaderStages(count);
+		std::vector<std::vector<VkSpecializationMapEntry>> specializationEntries(count);
+		std::vector<VkSpecializationInfo> specializationInfos(count);
+		std::vector<VkPipelineVertexInputStateCreateInfo> vertexInputInfos(count);
+		std::vector<VkPipelineColorBlendStateCreateInfo> colorBlendInfos(count);
+		std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos(count);
+
+		for (uint32_t i = 0; i < count; i++) {
+			const PipelineRequest& request = requests_[begin + i];
+			const PipelineConfigInfo& configInfo = *request.configInfo;
+
+			auto& stages = shaderStages[i];
+			stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+			stages[0].module = modulesByPath_.at(request.vertFilePath);
+			stages[0].pName = "main";
+			stages[0].flags = 0;
+			stages[0].pNext = nullptr;
+			stages[0].pSpecializationInfo = nullptr;
+
+			const auto& constants = configInfo.vertexSpecializationConstants;
+			if (!constants.empty()) {
+				auto& entries = specializationEntries[i];
+				for (uint32_t id = 0; id < constants.size(); id++) {
+					entries.push_back({id, static_cast<uint32_t>(id * sizeof(uint32_t)), sizeof(uint32_t)});
+				}
+
+				VkSpecializationInfo& specializationInfo = specializationInfos[i];
+				specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+				specializationInfo.pMapEntries = entries.data();
+				specializationInfo.dataSize = constants.size() * sizeof(uint32_t);
+				specializationInfo.pData = constants.data();
+				stages[0].pSpecializationInfo = &specializationInfo;
+			}
+			stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+			stages[1].module = modulesByPath_.at(request.fragFilePath);
+			stages[1].pName = "main";
+			stages[1].flags = 0;
+			stages[1].pNext = nullptr;
+			stages[1].pSpecializationInfo = nullptr;
+
+			auto& bindingDescriptions = configInfo.bindingDescriptions;
+			auto& attributeDescriptions = configInfo.attributeDescriptions;
+
+			VkPipelineVertexInputStateCreateInfo& vertexInputInfo = vertexInputInfos[i];
+			vertexInputInfo = {};
+			vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+			vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+			vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+			vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+			vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+
+			VkPipelineColorBlendStateCreateInfo& colorBlendInfo = colorBlendInfos[i];
+			colorBlendInfo = {};
+			colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+			colorBlendInfo.logicOpEnable = VK_FALSE;
+			colorBlendInfo.logicOp = VK_LOGIC_OP_COPY; // Optional
+			colorBlendInfo.attachmentCount = 1;
+			colorBlendInfo.pAttachments = &configInfo.colorBlendAttachment;
+			colorBlendInfo.blendConstants[0] = 0.0f; // Optional
+			colorBlendInfo.blendConstants[1] = 0.0f; // Optional
+			colorBlendInfo.blendConstants[2] = 0.0f; // Optional
+			colorBlendInfo.blendConstants[3] = 0.0f; // Optional
+
+			VkGraphicsPipelineCreateInfo& pipelineInfo = pipelineInfos[i];
+			pipelineInfo = {};
+			pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+			pipelineInfo.pStages = stages.data();
+			pipelineInfo.pVertexInputState = &vertexInputInfo;
+			pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
+			pipelineInfo.pViewportState = &configInfo.viewportInfo;
+			pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
+			pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
+			pipelineInfo.pColorBlendState = &colorBlendInfo;
+			pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
+			pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
+
+			pipelineInfo.layout = configInfo.pipelineLayout;
+			pipelineInfo.renderPass = configInfo.renderPass;
+			pipelineInfo.subpass = configInfo.subpass;
+
+			pipelineInfo.basePipelineIndex = -1;
+			pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		}
+
+		if (vkCreateGraphicsPipelines(bveDevice_.device(), pipelineCache_, count, pipelineInfos.data(), nullptr, pipelines.data() + begin) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create graphics pipelines");
+		}
+	}
+
+	VkShaderModule BvePipelineBuilder::createShaderModule(const std::vector<std::byte>& code)
+	{
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(bveDevice_.device(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create shader module");
+		}
+
+		return shaderModule;
+	}
+
+	void BvePipelineBuilder::destroyShaderModules()
+	{
+		for (const auto& [hash, shaderModule] : modulesByHash_) {
+			vkDestroyShaderModule(bveDevice_.device(), shaderModule, nullptr);
+		}
+		modulesByHash_.clear();
+		modulesByPath_.clear();
+	}
+}
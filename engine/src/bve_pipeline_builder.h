@@ -0,0 +1,56 @@
+#pragma once
+
+#include "bve_device.h"
+#include "bve_pipeline.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bve
+{
+	// Collects pipeline requests from the render systems and creates them all at once. SPIR-V files
+	// are read once per path and shader modules are shared between pipelines with identical code.
+	class BvePipelineBuilder
+	{
+	public:
+		BvePipelineBuilder(BveDevice& device);
+		~BvePipelineBuilder();
+
+		BvePipelineBuilder(const BvePipelineBuilder&) = delete;
+		BvePipelineBuilder& operator=(const BvePipelineBuilder&) = delete;
+		BvePipelineBuilder(const BvePipelineBuilder&&) = delete;
+		BvePipelineBuilder& operator=(const BvePipelineBuilder&&) = delete;
+
+		// target is filled in by build(), so it must outlive the builder call
+		void addPipeline(
+			std::unique_ptr<BvePipeline>& target,
+			const std::string& vertFilePath,
+			const std::string& fragFilePath,
+			std::unique_ptr<PipelineConfigInfo> configInfo);
+
+		void build();
+
+	private:
+		struct PipelineRequest
+		{
+			std::unique_ptr<BvePipeline>* target;
+			std::string vertFilePath;
+			std::string fragFilePath;
+			std::unique_ptr<PipelineConfigInfo> configInfo;
+		};
+
+		void createShaderModules();
+		void createPipelines(uint32_t begin, uint32_t end, std::vector<VkPipeline>& pipelines);
+		VkShaderModule createShaderModule(const std::vector<std::byte>& code);
+		void destroyShaderModules();
+
+		BveDevice& bveDevice_;
+		VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+
+		std::vector<PipelineRequest> requests_;
+		std::unordered_map<std::string, VkShaderModule> modulesByPath_;
+		std::unordered_map<uint64_t, VkShaderModule> modulesByHash_;
+	};
+}
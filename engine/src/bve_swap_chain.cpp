@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "bve_swap_chain.h"
 
+#include "core/profiler.h"
+
 #include <limits>
 #include <stdexcept>
 
@@ -25,8 +27,6 @@ namespace bve
 		createSwapChain();
 		createImageViews();
 		createRenderPass();
-		createDepthResources();
-		createFramebuffers();
 		createSyncObjects();
 	}
 
@@ -42,16 +42,6 @@ namespace bve
 			swapChain_ = nullptr;
 		}
 
-		for (int i = 0; i < depthImages_.size(); i++) {
-			vkDestroyImageView(device_.device(), depthImageViews_[i], nullptr);
-			vkDestroyImage(device_.device(), depthImages_[i], nullptr);
-			vkFreeMemory(device_.device(), depthImageMemorys_[i], nullptr);
-		}
-
-		for (auto framebuffer : swapChainFramebuffers_) {
-			vkDestroyFramebuffer(device_.device(), framebuffer, nullptr);
-		}
-
 		vkDestroyRenderPass(device_.device(), renderPass_, nullptr);
 
 		// cleanup synchronization objects
@@ -64,12 +54,16 @@ namespace bve
 
 	VkResult BveSwapChain::acquireNextImage(uint32_t* imageIndex)
 	{
-		vkWaitForFences(
-			device_.device(),
-			1,
-			&inFlightFences_[currentFrame_],
-			VK_TRUE,
-			std::numeric_limits<uint64_t>::max());
+		IG_PROFILE_FUNCTION();
+		{
+			IG_PROFILE_SCOPE("wait for frame fence");
+			vkWaitForFences(
+				device_.device(),
+				1,
+				&inFlightFences_[currentFrame_],
+				VK_TRUE,
+				std::numeric_limits<uint64_t>::max());
+		}
 
 		VkResult result = vkAcquireNextImageKHR(
 			device_.device(),
@@ -85,7 +79,9 @@ namespace bve
 	VkResult BveSwapChain::submitCommandBuffers(
 		const VkCommandBuffer* buffers, uint32_t* imageIndex)
 	{
+		IG_PROFILE_FUNCTION();
 		if (imagesInFlight_[*imageIndex] != VK_NULL_HANDLE) {
+			IG_PROFILE_SCOPE("wait for image fence");
 			vkWaitForFences(device_.device(), 1, &imagesInFlight_[*imageIndex], VK_TRUE, UINT64_MAX);
 		}
 		imagesInFlight_[*imageIndex] = inFlightFences_[currentFrame_];
@@ -217,8 +213,12 @@ namespace bve
 
 	void BveSwapChain::createRenderPass()
 	{
+		// frames are rendered through the render graph, this pass only describes the attachment formats
+		// pipelines are built against, which every graph pass writing the swap chain image is compatible with
+		swapChainDepthFormat_ = findDepthFormat();
+
 		VkAttachmentDescription depthAttachment{};
-		depthAttachment.format = findDepthFormat();
+		depthAttachment.format = swapChainDepthFormat_;
 		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -274,82 +274,6 @@ namespace bve
 		}
 	}
 
-	void BveSwapChain::createFramebuffers()
-	{
-		swapChainFramebuffers_.resize(imageCount());
-		for (size_t i = 0; i < imageCount(); i++) {
-			std::array<VkImageView, 2> attachments = {swapChainImageViews_[i], depthImageViews_[i]};
-
-			VkExtent2D swapChainExtent = getSwapChainExtent();
-			VkFramebufferCreateInfo framebufferInfo = {};
-			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferInfo.renderPass = renderPass_;
-			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-			framebufferInfo.pAttachments = attachments.data();
-			framebufferInfo.width = swapChainExtent.width;
-			framebufferInfo.height = swapChainExtent.height;
-			framebufferInfo.layers = 1;
-
-			if (vkCreateFramebuffer(
-				device_.device(),
-				&framebufferInfo,
-				nullptr,
-				&swapChainFramebuffers_[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create framebuffer!");
-			}
-		}
-	}
-
-	void BveSwapChain::createDepthResources()
-	{
-		VkFormat depthFormat = findDepthFormat();
-		swapChainDepthFormat_ = depthFormat;
-		VkExtent2D swapChainExtent = getSwapChainExtent();
-
-		depthImages_.resize(imageCount());
-		depthImageMemorys_.resize(imageCount());
-		depthImageViews_.resize(imageCount());
-
-		for (int i = 0; i < depthImages_.size(); i++) {
-			VkImageCreateInfo imageInfo{};
-			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-			imageInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageInfo.extent.width = swapChainExtent.width;
-			imageInfo.extent.height = swapChainExtent.height;
-			imageInfo.extent.depth = 1;
-			imageInfo.mipLevels = 1;
-			imageInfo.arrayLayers = 1;
-			imageInfo.format = depthFormat;
-			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			imageInfo.flags = 0;
-
-			device_.createImageWithInfo(
-				imageInfo,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				depthImages_[i],
-				depthImageMemorys_[i]);
-
-			VkImageViewCreateInfo viewInfo{};
-			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			viewInfo.image = depthImages_[i];
-			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			viewInfo.format = depthFormat;
-			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-			viewInfo.subresourceRange.baseMipLevel = 0;
-			viewInfo.subresourceRange.levelCount = 1;
-			viewInfo.subresourceRange.baseArrayLayer = 0;
-			viewInfo.subresourceRange.layerCount = 1;
-
-			if (vkCreateImageView(device_.device(), &viewInfo, nullptr, &depthImageViews_[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create texture image view!");
-			}
-		}
-	}
-
 	void BveSwapChain::createSyncObjects()
 	{
 		imageAvailableSemaphores_.resize(MAX_FRAMES_IN_FLIGHT);
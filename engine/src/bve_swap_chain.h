@@ -22,11 +22,12 @@ namespace bve
 		BveSwapChain(const BveSwapChain&) = delete;
 		BveSwapChain& operator=(const BveSwapChain&) = delete;
 
-		VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers_[index]; }
 		VkRenderPass getRenderPass() { return renderPass_; }
+		VkImage getImage(int index) { return swapChainImages_[index]; }
 		VkImageView getImageView(int index) { return swapChainImageViews_[index]; }
 		size_t imageCount() { return swapChainImages_.size(); }
 		VkFormat getSwapChainImageFormat() { return swapChainImageFormat_; }
+		VkFormat getSwapChainDepthFormat() { return swapChainDepthFormat_; }
 		VkExtent2D getSwapChainExtent() { return swapChainExtent_; }
 		uint32_t width() { return swapChainExtent_.width; }
 		uint32_t height() { return swapChainExtent_.height; }
@@ -51,9 +52,7 @@ namespace bve
 		void init();
 		void createSwapChain();
 		void createImageViews();
-		void createDepthResources();
 		void createRenderPass();
-		void createFramebuffers();
 		void createSyncObjects();
 
 		// Helper functions
@@ -67,12 +66,8 @@ namespace bve
 		VkFormat swapChainDepthFormat_;
 		VkExtent2D swapChainExtent_;
 
-		std::vector<VkFramebuffer> swapChainFramebuffers_;
 		VkRenderPass renderPass_;
 
-		std::vector<VkImage> depthImages_;
-		std::vector<VkDeviceMemory> depthImageMemorys_;
-		std::vector<VkImageView> depthImageViews_;
 		std::vector<VkImage> swapChainImages_;
 		std::vector<VkImageView> swapChainImageViews_;
 
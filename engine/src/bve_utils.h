@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
 namespace bve
 {
 	template <typename T, typename... Rest>
@@ -8,4 +13,83 @@ namespace bve
 		seed ^= std::hash<T>{}(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
 		(hashCombine(seed, rest), ...);
 	};
+
+	// 64-bit content hash over raw bytes (xxHash64 algorithm), used to key shader modules and cached assets
+	inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0)
+	{
+		constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+		constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+		constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+		constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+		constexpr uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+		auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+		auto read64 = [](const uint8_t* p) { uint64_t v; std::memcpy(&v, p, sizeof(v)); return v; };
+		auto read32 = [](const uint8_t* p) { uint32_t v; std::memcpy(&v, p, sizeof(v)); return v; };
+		auto round = [&](uint64_t acc, uint64_t input) { return rotl(acc + input * prime2, 31) * prime1; };
+		auto mergeRound = [&](uint64_t acc, uint64_t value) { return (acc ^ round(0, value)) * prime1 + prime4; };
+
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		const uint8_t* const end = p + size;
+		uint64_t h;
+
+		if (size >= 32) {
+			uint64_t v1 = seed + prime1 + prime2;
+			uint64_t v2 = seed + prime2;
+			uint64_t v3 = seed;
+			uint64_t v4 = seed - prime1;
+
+			const uint8_t* const limit = end - 32;
+			do {
+				v1 = round(v1, read64(p));
+				v2 = round(v2, read64(p + 8));
+				v3 = round(v3, read64(p + 16));
+				v4 = round(v4, read64(p + 24));
+				p += 32;
+			} while (p <= limit);
+
+			h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+			h = mergeRound(h, v1);
+			h = mergeRound(h, v2);
+			h = mergeRound(h, v3);
+			h = mergeRound(h, v4);
+		} else {
+			h = seed + prime5;
+		}
+
+		h += static_cast<uint64_t>(size);
+
+		for (; p + 8 <= end; p += 8) {
+			h ^= round(0, read64(p));
+			h = rotl(h, 27) * prime1 + prime4;
+		}
+
+		if (p + 4 <= end) {
+			h ^= static_cast<uint64_t>(read32(p)) * prime1;
+			h = rotl(h, 23) * prime2 + prime3;
+			p += 4;
+		}
+
+		for (; p < end; p++) {
+			h ^= static_cast<uint64_t>(*p) * prime5;
+			h = rotl(h, 11) * prime1;
+		}
+
+		h ^= h >> 33;
+		h *= prime2;
+		h ^= h >> 29;
+		h *= prime3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	// an asset path may end in #fragment to name part of a file, such as one mesh of a glTF scene
+	inline std::pair<std::string_view, std::string_view> splitAssetPath(std::string_view path)
+	{
+		const size_t separator = path.rfind('#');
+		if (separator == std::string_view::npos) {
+			return {path, {}};
+		}
+		return {path.substr(0, separator), path.substr(separator + 1)};
+	}
 }
@@ -6,7 +6,7 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include "../defines.h"
 
-#include "../bve_model.h"
+#include "../asset_manager.h"
 #include <memory>
 
 namespace bve
@@ -81,6 +81,21 @@ namespace bve
 		}
 	};
 
+	// places the entity relative to another one, its TransformComponent is then in the parent's space
+	struct IG_API ParentComponent
+	{
+		uint32_t parent; // entity
+	};
+
+	// the transform of an entity with a parent composed with its ancestors', written each frame by the TransformSystem
+	// and used in place of the TransformComponent's own matrices
+	struct IG_API WorldTransformComponent
+	{
+		glm::mat4 matrix{1.f};
+		glm::mat3 normalMatrix{1.f};
+		float maxScale = 1.f; // largest stretch along any axis, for scaling bounding spheres
+	};
+
 	struct IG_API MoveComponent
 	{
 		glm::vec3 velocity{.0f, .0f, .0f};
@@ -114,8 +129,9 @@ namespace bve
 
 	struct IG_API RenderComponent
 	{
-		std::unique_ptr<BveModel> model;
+		MeshHandle mesh; // one reference to a mesh shared through the asset manager, drawn once it is ready
 		glm::vec3 color{.0f, .0f, .0f};
+		uint32_t lod = 0; // level of detail drawn last frame, updated by the render system
 	};
 
 	struct IG_API PointLightComponent
@@ -125,6 +141,10 @@ namespace bve
 
 	struct IG_API PlayerTag {};
 
+	// the entity's model is rasterized into the occlusion buffer and can hide other entities, it needs a
+	// model loaded with occluder geometry and a transform
+	struct IG_API OccluderTag {};
+
 	struct IG_API ActiveCameraTag {};
 
 	struct IG_API SelectedTag {};
@@ -0,0 +1,524 @@
+#include "../pch.h"
+#include "async_file_reader.h"
+#include "profiler.h"
+#include "../log.h"
+
+#ifdef _WIN32
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+	#include <linux/io_uring.h>
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#define BVE_IO_URING
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+namespace bve
+{
+	namespace
+	{
+#ifdef _WIN32
+		using NativeFile = HANDLE;
+		const NativeFile INVALID_FILE = INVALID_HANDLE_VALUE;
+#else
+		using NativeFile = int;
+		constexpr NativeFile INVALID_FILE = -1;
+#endif
+
+		// longer ranges are read in parts, the kernel stops a single read a little short of 2 GiB anyway
+		constexpr uint64_t MAX_READ_SIZE = 1ull << 30;
+
+		NativeFile openFile(const std::string& path)
+		{
+#ifdef _WIN32
+			const NativeFile file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+			const NativeFile file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+			if (file == INVALID_FILE) {
+				throw std::runtime_error("failed to open " + path);
+			}
+			return file;
+		}
+
+		void closeFile(NativeFile file)
+		{
+#ifdef _WIN32
+			CloseHandle(file);
+#else
+			::close(file);
+#endif
+		}
+
+		// as much of destination as one call returns, 0 at the end of the file
+		size_t readAt(NativeFile file, uint64_t offset, std::span<std::byte> destination, const std::string& path)
+		{
+			const auto size = static_cast<size_t>(std::min<uint64_t>(destination.size(), MAX_READ_SIZE));
+#ifdef _WIN32
+			// a positioned read on a handle opened without FILE_FLAG_OVERLAPPED still blocks, which is what's wanted here
+			OVERLAPPED position{};
+			position.Offset = static_cast<DWORD>(offset);
+			position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+			DWORD read = 0;
+			if (!ReadFile(file, destination.data(), static_cast<DWORD>(size), &read, &position)) {
+				if (GetLastError() == ERROR_HANDLE_EOF) {
+					return 0;
+				}
+				throw std::runtime_error("failed to read " + path);
+			}
+			return read;
+#else
+			while (true) {
+				const ssize_t read = ::pread(file, destination.data(), size, static_cast<off_t>(offset));
+				if (read >= 0) {
+					return static_cast<size_t>(read);
+				}
+				if (errno != EINTR) {
+					throw std::system_error{errno, std::generic_category(), "failed to read " + path};
+				}
+			}
+#endif
+		}
+	}
+
+	struct AsyncFileReader::Request
+	{
+		Batch* batch;
+		Range range;
+		uint64_t done = 0; // bytes of range already read
+	};
+
+	struct AsyncFileReader::Batch
+	{
+		std::string path;
+		NativeFile file = INVALID_FILE;
+		std::vector<Request> requests; // ranges with nothing to read are left out
+		std::atomic<uint32_t> remaining{0};
+		std::mutex errorMutex;
+		std::exception_ptr error; // the first request to fail
+		Callback onComplete;
+		std::promise<void> promise;
+	};
+
+#ifdef BVE_IO_URING
+	// the shared submission and completion queues, written without the liburing helpers to avoid the dependency
+	struct AsyncFileReader::Ring
+	{
+		int fd = -1;
+		void* queueMapping = MAP_FAILED;
+		size_t queueMappingSize = 0;
+		void* completionMapping = MAP_FAILED;
+		size_t completionMappingSize = 0;
+		void* entryMapping = MAP_FAILED;
+		size_t entryMappingSize = 0;
+
+		io_uring_sqe* entries = nullptr;
+		uint32_t* submissionTail = nullptr;
+		uint32_t* submissionMask = nullptr;
+		uint32_t* submissionArray = nullptr;
+		uint32_t* completionHead = nullptr;
+		uint32_t* completionTail = nullptr;
+		uint32_t* completionMask = nullptr;
+		io_uring_cqe* completions = nullptr;
+
+		~Ring()
+		{
+			if (entryMapping != MAP_FAILED) {
+				munmap(entryMapping, entryMappingSize);
+			}
+			if (completionMapping != MAP_FAILED && completionMapping != queueMapping) {
+				munmap(completionMapping, completionMappingSize);
+			}
+			if (queueMapping != MAP_FAILED) {
+				munmap(queueMapping, queueMappingSize);
+			}
+			if (fd >= 0) {
+				::close(fd);
+			}
+		}
+
+		// the entry queued after the ones not yet published, callers hold the submit mutex
+		io_uring_sqe& prepare(uint32_t queued)
+		{
+			const uint32_t index = (*submissionTail + queued) & *submissionMask;
+			submissionArray[index] = index;
+			io_uring_sqe& entry = entries[index];
+			entry = {};
+			return entry;
+		}
+
+		// makes the prepared entries visible to the kernel and submits them, returning how many it took. When it
+		// refuses them the rest are withdrawn again, so they can never complete later, and error says why
+		uint32_t submit(uint32_t count, std::error_code& error)
+		{
+			std::atomic_ref{*submissionTail}.store(*submissionTail + count, std::memory_order_release);
+			uint32_t submitted = 0;
+			while (submitted < count) {
+				const long result = syscall(__NR_io_uring_enter, fd, count - submitted, 0, 0, nullptr, 0);
+				if (result >= 0) {
+					submitted += static_cast<uint32_t>(result);
+				} else if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+					std::this_thread::yield();
+				} else {
+					// without a polling thread the kernel only reads the tail inside io_uring_enter
+					error = std::error_code{errno, std::generic_category()};
+					std::atomic_ref{*submissionTail}.store(*submissionTail - (count - submitted), std::memory_order_release);
+					break;
+				}
+			}
+			return submitted;
+		}
+	};
+#else
+	struct AsyncFileReader::Ring
+	{
+	};
+#endif
+
+	AsyncFileReader::AsyncFileReader(bool allowIoUring) : callbackPool_{ThreadPool::instance()}
+	{
+		if (allowIoUring && createRing()) {
+			completionThread_ = std::thread{[this]() {
+				IG_PROFILE_THREAD("file reader");
+				reapCompletions();
+			}};
+			return;
+		}
+		fallbackThreads_ = std::make_unique<ThreadPool>(FALLBACK_THREAD_COUNT);
+	}
+
+	AsyncFileReader::~AsyncFileReader()
+	{
+		{
+			std::unique_lock lock{batchMutex_};
+			batchFinished_.wait(lock, [this]() { return pendingBatches_ == 0; });
+		}
+
+#ifdef BVE_IO_URING
+		if (ring_) {
+			// a nop without a request tells the completion thread to stop
+			std::error_code error;
+			{
+				std::lock_guard lock{submitMutex_};
+				io_uring_sqe& entry = ring_->prepare(0);
+				entry.opcode = IORING_OP_NOP;
+				entry.user_data = 0;
+				ring_->submit(1, error);
+			}
+			if (error) {
+				// the thread is left waiting on a ring that is never closed, rather than joined forever
+				LOG_ERROR("failed to stop the file reader thread: {}", error.message());
+				completionThread_.detach();
+				static_cast<void>(ring_.release());
+				return;
+			}
+			completionThread_.join();
+		}
+#endif
+	}
+
+	AsyncFileReader& AsyncFileReader::instance()
+	{
+		static AsyncFileReader instance;
+		return instance;
+	}
+
+	bool AsyncFileReader::createRing()
+	{
+#ifdef BVE_IO_URING
+		io_uring_params params{};
+		auto ring = std::make_unique<Ring>();
+		ring->fd = static_cast<int>(syscall(__NR_io_uring_setup, QUEUE_DEPTH, &params));
+		if (ring->fd < 0) {
+			LOG_INFO("io_uring is unavailable ({}), reading files on threads instead", std::system_category().message(errno));
+			return false;
+		}
+
+		ring->queueMappingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+		ring->completionMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (singleMapping) {
+			ring->queueMappingSize = std::max(ring->queueMappingSize, ring->completionMappingSize);
+			ring->completionMappingSize = ring->queueMappingSize;
+		}
+		ring->entryMappingSize = params.sq_entries * sizeof(io_uring_sqe);
+
+		ring->queueMapping = mmap(nullptr, ring->queueMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+		ring->completionMapping = singleMapping ? ring->queueMapping
+			: mmap(nullptr, ring->completionMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		ring->entryMapping = mmap(nullptr, ring->entryMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+		if (ring->queueMapping == MAP_FAILED || ring->completionMapping == MAP_FAILED || ring->entryMapping == MAP_FAILED) {
+			LOG_INFO("failed to map the io_uring queues, reading files on threads instead");
+			return false;
+		}
+
+		// plain reads need a 5.6 kernel, older ones only know vectored reads
+		std::vector<std::byte> probeStorage(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+		auto* probe = reinterpret_cast<io_uring_probe*>(probeStorage.data());
+		if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) < 0
+			|| probe->last_op < IORING_OP_READ || (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) == 0) {
+			LOG_INFO("the kernel's io_uring can't read into buffers, reading files on threads instead");
+			return false;
+		}
+
+		auto at = [](void* mapping, uint32_t offset) {
+			return reinterpret_cast<uint32_t*>(static_cast<std::byte*>(mapping) + offset);
+		};
+		ring->entries = static_cast<io_uring_sqe*>(ring->entryMapping);
+		ring->submissionTail = at(ring->queueMapping, params.sq_off.tail);
+		ring->submissionMask = at(ring->queueMapping, params.sq_off.ring_mask);
+		ring->submissionArray = at(ring->queueMapping, params.sq_off.array);
+		ring->completionHead = at(ring->completionMapping, params.cq_off.head);
+		ring->completionTail = at(ring->completionMapping, params.cq_off.tail);
+		ring->completionMask = at(ring->completionMapping, params.cq_off.ring_mask);
+		ring->completions = reinterpret_cast<io_uring_cqe*>(static_cast<std::byte*>(ring->completionMapping) + params.cq_off.cqes);
+
+		ring_ = std::move(ring);
+		LOG_INFO("reading files through io_uring with {} entries", params.sq_entries);
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	std::future<void> AsyncFileReader::read(const std::string& path, std::vector<Range> ranges, Callback onComplete)
+	{
+		IG_PROFILE_FUNCTION();
+		// freed by completeBatch, which may run on another thread before this returns
+		auto* batch = new Batch{};
+		batch->path = path;
+		batch->onComplete = std::move(onComplete);
+		std::future<void> future = batch->promise.get_future();
+		for (const Range& range : ranges) {
+			if (!range.destination.empty()) {
+				batch->requests.push_back(Request{batch, range});
+			}
+		}
+		batch->remaining = static_cast<uint32_t>(batch->requests.size());
+		{
+			std::lock_guard lock{batchMutex_};
+			pendingBatches_++;
+		}
+
+		try {
+			batch->file = openFile(path);
+		} catch (...) {
+			batch->error = std::current_exception();
+			completeBatch(*batch);
+			return future;
+		}
+		if (batch->requests.empty()) {
+			completeBatch(*batch);
+			return future;
+		}
+
+		// the batch can't be touched once its last request is queued
+		std::vector<Request*> requests;
+		for (Request& request : batch->requests) {
+			requests.push_back(&request);
+		}
+		if (ring_) {
+			submitToRing(requests, false);
+		} else {
+			for (Request* request : requests) {
+				fallbackThreads_->submit([this, request]() { readBlocking(*request); });
+			}
+		}
+		return future;
+	}
+
+	std::future<std::vector<std::byte>> AsyncFileReader::readFile(const std::string& path)
+	{
+		auto promise = std::make_shared<std::promise<std::vector<std::byte>>>();
+		std::future<std::vector<std::byte>> future = promise->get_future();
+		std::shared_ptr<std::vector<std::byte>> contents;
+		try {
+			contents = std::make_shared<std::vector<std::byte>>(std::filesystem::file_size(path));
+		} catch (...) {
+			promise->set_exception(std::current_exception());
+			return future;
+		}
+
+		read(path, {Range{0, *contents}}, [promise, contents](std::exception_ptr error) {
+			if (error) {
+				promise->set_exception(error);
+			} else {
+				promise->set_value(std::move(*contents));
+			}
+		});
+		return future;
+	}
+
+	void AsyncFileReader::submitToRing(std::span<Request*> requests, bool reserved)
+	{
+#ifdef BVE_IO_URING
+		std::unique_lock lock{submitMutex_};
+		size_t next = 0;
+		std::error_code error;
+		uint32_t withdrawn = 0;
+		while (next < requests.size() && !error) {
+			// a request read in parts keeps the entry it was counted against
+			if (!reserved) {
+				entryFreed_.wait(lock, [this]() { return inFlight_ < QUEUE_DEPTH; });
+			}
+
+			uint32_t queued = 0;
+			while (next < requests.size() && (reserved || inFlight_ < QUEUE_DEPTH)) {
+				const Request& request = *requests[next++];
+				const std::span<std::byte> rest = request.range.destination.subspan(request.done);
+				io_uring_sqe& entry = ring_->prepare(queued++);
+				entry.opcode = IORING_OP_READ;
+				entry.fd = request.batch->file;
+				entry.off = request.range.offset + request.done;
+				entry.addr = reinterpret_cast<uint64_t>(rest.data());
+				entry.len = static_cast<uint32_t>(std::min<uint64_t>(rest.size(), MAX_READ_SIZE));
+				entry.user_data = reinterpret_cast<uint64_t>(&request);
+				if (!reserved) {
+					inFlight_++;
+				}
+			}
+
+			withdrawn = queued - ring_->submit(queued, error);
+		}
+		if (!error) {
+			return;
+		}
+
+		// the requests the kernel didn't take give their entries back, as do those not queued yet if they were
+		// counted against one already
+		const std::span<Request*> failed = requests.subspan(next - withdrawn);
+		inFlight_ -= reserved ? static_cast<uint32_t>(failed.size()) : withdrawn;
+		lock.unlock();
+		entryFreed_.notify_all();
+
+		const std::exception_ptr exception = std::make_exception_ptr(std::system_error{error, "failed to submit reads"});
+		for (Request* request : failed) {
+			finishRequest(*request, exception);
+		}
+#endif
+	}
+
+	void AsyncFileReader::reapCompletions()
+	{
+#ifdef BVE_IO_URING
+		auto releaseEntry = [this]() {
+			{
+				std::lock_guard lock{submitMutex_};
+				inFlight_--;
+			}
+			entryFreed_.notify_one();
+		};
+
+		while (true) {
+			// this thread is the only consumer, so the head only changes here
+			const uint32_t head = *ring_->completionHead;
+			if (head == std::atomic_ref{*ring_->completionTail}.load(std::memory_order_acquire)) {
+				if (syscall(__NR_io_uring_enter, ring_->fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+					LOG_ERROR("failed to wait for reads: {}", std::system_category().message(errno));
+				}
+				continue;
+			}
+			const io_uring_cqe completion = ring_->completions[head & *ring_->completionMask];
+			std::atomic_ref{*ring_->completionHead}.store(head + 1, std::memory_order_release);
+
+			if (completion.user_data == 0) {
+				return;
+			}
+			Request& request = *reinterpret_cast<Request*>(completion.user_data);
+			if (completion.res < 0) {
+				releaseEntry();
+				finishRequest(request, std::make_exception_ptr(std::system_error{-completion.res, std::generic_category(), "failed to read " + request.batch->path}));
+				continue;
+			}
+			if (completion.res == 0) {
+				releaseEntry();
+				finishRequest(request, std::make_exception_ptr(std::runtime_error{"unexpected end of " + request.batch->path}));
+				continue;
+			}
+
+			request.done += static_cast<uint64_t>(completion.res);
+			if (request.done < request.range.destination.size()) {
+				Request* rest = &request;
+				submitToRing({&rest, 1}, true);
+				continue;
+			}
+			releaseEntry();
+			finishRequest(request, nullptr);
+		}
+#endif
+	}
+
+	void AsyncFileReader::readBlocking(Request& request)
+	{
+		std::exception_ptr error;
+		try {
+			const Batch& batch = *request.batch;
+			while (request.done < request.range.destination.size()) {
+				const size_t read = readAt(batch.file, request.range.offset + request.done, request.range.destination.subspan(request.done), batch.path);
+				if (read == 0) {
+					throw std::runtime_error("unexpected end of " + batch.path);
+				}
+				request.done += read;
+			}
+		} catch (...) {
+			error = std::current_exception();
+		}
+		finishRequest(request, error);
+	}
+
+	void AsyncFileReader::finishRequest(Request& request, std::exception_ptr error)
+	{
+		Batch& batch = *request.batch;
+		if (error) {
+			std::lock_guard lock{batch.errorMutex};
+			if (!batch.error) {
+				batch.error = error;
+			}
+		}
+		// off the reading threads, the ring's would otherwise stop freeing entries while a callback runs
+		if (batch.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			callbackPool_.submit([this, &batch]() { completeBatch(batch); });
+		}
+	}
+
+	void AsyncFileReader::completeBatch(Batch& batch)
+	{
+		if (batch.file != INVALID_FILE) {
+			closeFile(batch.file);
+		}
+
+		std::exception_ptr error = batch.error;
+		if (batch.onComplete) {
+			try {
+				batch.onComplete(error);
+			} catch (...) {
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+		if (error) {
+			batch.promise.set_exception(error);
+		} else {
+			batch.promise.set_value();
+		}
+		delete &batch;
+
+		{
+			std::lock_guard lock{batchMutex_};
+			pendingBatches_--;
+		}
+		batchFinished_.notify_all();
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "thread_pool.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bve
+{
+	// Reads files into memory the caller owns without holding up the thread that asked. A batch is one file and any
+	// number of ranges of it, which are handed to the kernel together. On Linux they go through an io_uring ring
+	// whose completions are reaped by a thread of the reader's own; elsewhere, or where the kernel refuses to set up
+	// a ring, blocking reads run on a few threads of its own, so waiting on them from the shared pool can't starve
+	// it. Completion callbacks run on the shared ThreadPool and may queue further reads, but must not wait for them:
+	// the completion they would wait for is queued behind them on the same pool.
+	class AsyncFileReader
+	{
+	public:
+		// reads in flight at once, further ranges wait for a free entry
+		static constexpr uint32_t QUEUE_DEPTH = 64;
+		static constexpr uint32_t FALLBACK_THREAD_COUNT = 2;
+
+		struct Range
+		{
+			uint64_t offset = 0;
+			std::span<std::byte> destination; // filled completely, a file ending early fails the batch
+		};
+
+		// error is null once every range has been read, or what made the batch fail
+		using Callback = std::function<void(std::exception_ptr error)>;
+
+		explicit AsyncFileReader(bool allowIoUring = true);
+		// waits for every batch still in flight
+		~AsyncFileReader();
+
+		AsyncFileReader(const AsyncFileReader&) = delete;
+		AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+		AsyncFileReader(const AsyncFileReader&&) = delete;
+		AsyncFileReader& operator=(const AsyncFileReader&&) = delete;
+
+		// shared engine-wide reader
+		static AsyncFileReader& instance();
+
+		// the file is opened on the calling thread, a file that can't be opened completes the batch right away.
+		// Destinations have to stay valid until the future is ready, which is after onComplete has returned. The
+		// future throws what made the batch fail
+		std::future<void> read(const std::string& path, std::vector<Range> ranges, Callback onComplete = {});
+		// the whole file, sized when it is opened
+		std::future<std::vector<std::byte>> readFile(const std::string& path);
+
+		bool usesIoUring() const { return ring_ != nullptr; }
+
+	private:
+		struct Batch;
+		struct Request;
+		struct Ring;
+
+		bool createRing();
+		// queues the unread part of each request and submits them together, waiting for free entries if needed.
+		// Requests the kernel doesn't take fail with the reason instead
+		void submitToRing(std::span<Request*> requests, bool reserved);
+		void reapCompletions();
+		void readBlocking(Request& request);
+		void finishRequest(Request& request, std::exception_ptr error);
+		// closes the file, runs the callback and frees the batch
+		void completeBatch(Batch& batch);
+
+		// runs the callbacks, taken at construction so it outlives the shared reader
+		ThreadPool& callbackPool_;
+
+		std::unique_ptr<Ring> ring_;
+		std::thread completionThread_;
+		std::mutex submitMutex_;
+		std::condition_variable entryFreed_;
+		uint32_t inFlight_ = 0;
+
+		std::mutex batchMutex_;
+		std::condition_variable batchFinished_;
+		uint32_t pendingBatches_ = 0;
+
+		// only used without a ring, last so its threads are joined before the rest goes away
+		std::unique_ptr<ThreadPool> fallbackThreads_;
+	};
+}
@@ -0,0 +1,175 @@
+#include "../pch.h"
+#include "compression.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace bve::compression
+{
+	namespace
+	{
+		constexpr size_t MIN_MATCH = 4;
+		// the format requires the last five bytes to be literals and the last match to start twelve bytes before the end
+		constexpr size_t LAST_LITERALS = 5;
+		constexpr size_t MATCH_START_LIMIT = 12;
+		constexpr size_t MAX_DISTANCE = 65535;
+		constexpr uint32_t HASH_BITS = 14;
+
+		uint32_t read32(const uint8_t* p)
+		{
+			uint32_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		uint32_t hash(uint32_t sequence)
+		{
+			return (sequence * 2654435761u) >> (32 - HASH_BITS);
+		}
+
+		uint8_t* writeLength(uint8_t* out, size_t length)
+		{
+			for (; length >= 255; length -= 255) {
+				*out++ = 255;
+			}
+			*out++ = static_cast<uint8_t>(length);
+			return out;
+		}
+
+		uint8_t* writeLiterals(uint8_t* out, const uint8_t* literals, size_t literalCount, size_t matchLength)
+		{
+			uint8_t* token = out++;
+			*token = static_cast<uint8_t>(std::min<size_t>(literalCount, 15) << 4);
+			if (literalCount >= 15) {
+				out = writeLength(out, literalCount - 15);
+			}
+			out = std::copy_n(literals, literalCount, out);
+
+			if (matchLength > 0) {
+				const size_t extra = matchLength - MIN_MATCH;
+				*token |= static_cast<uint8_t>(std::min<size_t>(extra, 15));
+			}
+			return out;
+		}
+
+		// reads a length continued in 255 steps, false if the input ends first
+		bool readLength(const uint8_t*& in, const uint8_t* end, size_t& length)
+		{
+			uint8_t value;
+			do {
+				if (in == end) {
+					return false;
+				}
+				value = *in++;
+				length += value;
+			} while (value == 255);
+			return true;
+		}
+	}
+
+	size_t compressBlock(std::span<const std::byte> source, std::span<std::byte> destination)
+	{
+		assert(destination.size() >= getCompressBound(source.size()) && "Compression destination is too small");
+		const auto* const in = reinterpret_cast<const uint8_t*>(source.data());
+		auto* out = reinterpret_cast<uint8_t*>(destination.data());
+		const size_t size = source.size();
+
+		size_t anchor = 0;
+		if (size > MATCH_START_LIMIT) {
+			std::array<uint32_t, 1u << HASH_BITS> table{};
+			size_t position = 0;
+			while (position + MATCH_START_LIMIT <= size) {
+				const uint32_t sequence = read32(in + position);
+				const uint32_t hashed = hash(sequence);
+				const size_t candidate = table[hashed];
+				table[hashed] = static_cast<uint32_t>(position);
+
+				if (candidate >= position || position - candidate > MAX_DISTANCE || read32(in + candidate) != sequence) {
+					// skip faster through data that doesn't compress
+					position += 1 + ((position - anchor) >> 6);
+					continue;
+				}
+
+				size_t matchLength = MIN_MATCH;
+				while (position + matchLength < size - LAST_LITERALS && in[candidate + matchLength] == in[position + matchLength]) {
+					matchLength++;
+				}
+
+				out = writeLiterals(out, in + anchor, position - anchor, matchLength);
+				const auto distance = static_cast<uint16_t>(position - candidate);
+				*out++ = static_cast<uint8_t>(distance);
+				*out++ = static_cast<uint8_t>(distance >> 8);
+				if (matchLength - MIN_MATCH >= 15) {
+					out = writeLength(out, matchLength - MIN_MATCH - 15);
+				}
+
+				position += matchLength;
+				anchor = position;
+			}
+		}
+
+		out = writeLiterals(out, in + anchor, size - anchor, 0);
+		return static_cast<size_t>(out - reinterpret_cast<uint8_t*>(destination.data()));
+	}
+
+	bool decompressBlock(std::span<const std::byte> source, std::span<std::byte> destination)
+	{
+		const auto* in = reinterpret_cast<const uint8_t*>(source.data());
+		const uint8_t* const inEnd = in + source.size();
+		auto* const outBegin = reinterpret_cast<uint8_t*>(destination.data());
+		uint8_t* out = outBegin;
+		const uint8_t* const outEnd = outBegin + destination.size();
+
+		while (in < inEnd) {
+			const uint8_t token = *in++;
+
+			size_t literalCount = token >> 4;
+			if (literalCount == 15 && !readLength(in, inEnd, literalCount)) {
+				return false;
+			}
+			if (literalCount > static_cast<size_t>(inEnd - in) || literalCount > static_cast<size_t>(outEnd - out)) {
+				return false;
+			}
+			out = std::copy_n(in, literalCount, out);
+			in += literalCount;
+
+			// the last sequence has no match
+			if (in == inEnd) {
+				return out == outEnd;
+			}
+
+			if (inEnd - in < 2) {
+				return false;
+			}
+			const size_t distance = in[0] | static_cast<size_t>(in[1]) << 8;
+			in += 2;
+			if (distance == 0 || distance > static_cast<size_t>(out - outBegin)) {
+				return false;
+			}
+
+			size_t matchLength = token & 15;
+			if (matchLength == 15 && !readLength(in, inEnd, matchLength)) {
+				return false;
+			}
+			matchLength += MIN_MATCH;
+			if (matchLength > static_cast<size_t>(outEnd - out)) {
+				return false;
+			}
+
+			// a match may overlap the bytes it produces, which repeats them
+			const uint8_t* match = out - distance;
+			if (distance >= matchLength) {
+				std::memcpy(out, match, matchLength);
+				out += matchLength;
+			} else {
+				for (size_t i = 0; i < matchLength; i++) {
+					*out++ = match[i];
+				}
+			}
+		}
+
+		return false;
+	}
+}
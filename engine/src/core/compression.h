@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+namespace bve
+{
+	// Byte oriented LZ77 in the LZ4 block format, so blocks can be inspected with any LZ4 tool. Compression is a
+	// single greedy pass over a hash of the next four bytes, which favours speed over ratio; decompression is
+	// bounds checked throughout since it runs on data read from disk.
+	namespace compression
+	{
+		// the largest compressBlock can produce from size bytes
+		constexpr size_t getCompressBound(size_t size) { return size + size / 255 + 16; }
+
+		// returns the compressed size, destination must hold getCompressBound(source.size()) bytes
+		size_t compressBlock(std::span<const std::byte> source, std::span<std::byte> destination);
+
+		// false if source is malformed or doesn't decompress to exactly destination.size() bytes
+		bool decompressBlock(std::span<const std::byte> source, std::span<std::byte> destination);
+	}
+}
@@ -0,0 +1,99 @@
+#include "../pch.h"
+#include "frame_profiler.h"
+
+namespace bve
+{
+	void FrameProfiler::update()
+	{
+		if (paused_) {
+			skipBacklog_ = true;
+			return;
+		}
+
+		std::vector<Profiler::ThreadZones> threads = Profiler::collect(cursor_, newFrames_);
+		nanosecondsPerTick_ = Profiler::nanosecondsPerTick();
+
+		// whatever piled up while paused would be bucketed into stale frames
+		if (skipBacklog_) {
+			skipBacklog_ = false;
+			pending_.clear();
+			return;
+		}
+
+		threadNames_.resize(threads.size());
+		for (auto& thread : threads) {
+			threadNames_[thread.threadIndex] = std::move(thread.threadName);
+			for (const Profiler::Zone& zone : thread.zones) {
+				pending_.push_back({zone, thread.threadIndex});
+			}
+		}
+
+		for (const Profiler::Frame& frame : newFrames_) {
+			FrameRecord record{frame, {}};
+
+			// zones that started before the frame belong to one that already left the history
+			size_t kept = 0;
+			for (const FrameZone& zone : pending_) {
+				if (zone.zone.start >= frame.end) {
+					pending_[kept++] = zone;
+				} else if (zone.zone.start >= frame.start) {
+					record.zones.push_back(zone);
+				}
+			}
+			pending_.resize(kept);
+
+			std::sort(record.zones.begin(), record.zones.end(), [](const FrameZone& a, const FrameZone& b) {
+				return a.thread != b.thread ? a.thread < b.thread : a.zone.start < b.zone.start;
+			});
+
+			history_.push_back(std::move(record));
+			if (history_.size() > HISTORY_SIZE) {
+				history_.pop_front();
+			}
+
+			if (captureRemaining_ > 0 && --captureRemaining_ == 0) {
+				setPaused(true);
+				break;
+			}
+		}
+	}
+
+	void FrameProfiler::setPaused(bool paused)
+	{
+		paused_ = paused;
+		if (!paused) {
+			captureRemaining_ = 0;
+		}
+	}
+
+	void FrameProfiler::capture(uint32_t count)
+	{
+		history_.clear();
+		setPaused(false);
+		captureRemaining_ = std::min(count, HISTORY_SIZE);
+	}
+
+	FrameProfiler::Summary FrameProfiler::summarize() const
+	{
+		if (history_.empty()) {
+			return {};
+		}
+
+		std::vector<double> durations;
+		durations.reserve(history_.size());
+		for (const FrameRecord& record : history_) {
+			durations.push_back(toMilliseconds(record.frame.end - record.frame.start));
+		}
+		std::sort(durations.begin(), durations.end());
+
+		const auto percentile = [&](double p) {
+			return durations[std::min(durations.size() - 1, static_cast<size_t>(p * static_cast<double>(durations.size())))];
+		};
+
+		Summary summary{};
+		summary.p50 = percentile(0.5);
+		summary.p99 = percentile(0.99);
+		summary.max = durations.back();
+		return summary;
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "profiler.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace bve
+{
+	// Rolling history of the profiler's frames, each with the zones that started in it on any thread. Updates only
+	// copy what was recorded since the last one, so keeping it running costs a few hundred zone copies per frame.
+	class FrameProfiler
+	{
+	public:
+		static constexpr uint32_t HISTORY_SIZE = 240;
+
+		struct FrameZone
+		{
+			Profiler::Zone zone;
+			uint32_t thread;
+		};
+
+		struct FrameRecord
+		{
+			Profiler::Frame frame;
+			std::vector<FrameZone> zones; // sorted by thread, then start
+		};
+
+		struct Summary
+		{
+			double p50 = 0.0; // milliseconds
+			double p99 = 0.0;
+			double max = 0.0;
+		};
+
+		FrameProfiler() = default;
+
+		FrameProfiler(const FrameProfiler&) = delete;
+		FrameProfiler& operator=(const FrameProfiler&) = delete;
+		FrameProfiler(const FrameProfiler&&) = delete;
+		FrameProfiler& operator=(const FrameProfiler&&) = delete;
+
+		// adds the frames closed since the last update, does nothing while paused
+		void update();
+
+		void setPaused(bool paused);
+		bool isPaused() const { return paused_; }
+
+		// replaces the history with the next count frames, then pauses
+		void capture(uint32_t count);
+		uint32_t getCaptureRemaining() const { return captureRemaining_; }
+
+		// oldest first
+		const std::deque<FrameRecord>& getHistory() const { return history_; }
+		const std::vector<std::string>& getThreadNames() const { return threadNames_; }
+		Summary summarize() const;
+
+		double toMilliseconds(uint64_t ticks) const { return static_cast<double>(ticks) * nanosecondsPerTick_ * 1e-6; }
+
+	private:
+		Profiler::Cursor cursor_{};
+		std::vector<Profiler::Frame> newFrames_;
+		std::vector<FrameZone> pending_; // zones of frames that haven't been closed yet
+		std::deque<FrameRecord> history_;
+		std::vector<std::string> threadNames_;
+		double nanosecondsPerTick_ = 1.0;
+
+		bool paused_ = false;
+		bool skipBacklog_ = false;
+		uint32_t captureRemaining_ = 0;
+	};
+}
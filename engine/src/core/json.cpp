@@ -0,0 +1,281 @@
+#include "../pch.h"
+#include "json.h"
+
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+
+namespace bve
+{
+	// recursive descent over the text, nesting is limited so a hostile file can't overflow the stack
+	class JsonParser
+	{
+	public:
+		static constexpr uint32_t MAX_DEPTH = 256;
+
+		explicit JsonParser(std::string_view text) : text_{text} {}
+
+		JsonValue parseDocument()
+		{
+			JsonValue value = parseValue(0);
+			skipWhitespace();
+			if (position_ != text_.size()) {
+				fail("trailing characters");
+			}
+			return value;
+		}
+
+	private:
+		[[noreturn]] void fail(const char* reason) const
+		{
+			throw std::runtime_error("invalid json at offset " + std::to_string(position_) + ": " + reason);
+		}
+
+		void skipWhitespace()
+		{
+			while (position_ < text_.size() && (text_[position_] == ' ' || text_[position_] == '\t' || text_[position_] == '\n' || text_[position_] == '\r')) {
+				position_++;
+			}
+		}
+
+		char peek()
+		{
+			skipWhitespace();
+			if (position_ == text_.size()) {
+				fail("unexpected end");
+			}
+			return text_[position_];
+		}
+
+		void expect(char c)
+		{
+			if (peek() != c) {
+				fail("unexpected character");
+			}
+			position_++;
+		}
+
+		bool consumeLiteral(std::string_view literal)
+		{
+			if (text_.substr(position_, literal.size()) != literal) {
+				return false;
+			}
+			position_ += literal.size();
+			return true;
+		}
+
+		JsonValue parseValue(uint32_t depth)
+		{
+			if (depth > MAX_DEPTH) {
+				fail("nested too deeply");
+			}
+
+			JsonValue value{};
+			const char c = peek();
+			if (c == '{') {
+				value.type_ = JsonValue::Type::OBJECT;
+				position_++;
+				if (peek() == '}') {
+					position_++;
+					return value;
+				}
+				do {
+					if (peek() != '"') {
+						fail("expected a member name");
+					}
+					value.keys_.push_back(parseString());
+					expect(':');
+					value.elements_.push_back(parseValue(depth + 1));
+				} while (consumeSeparator('}'));
+			} else if (c == '[') {
+				value.type_ = JsonValue::Type::ARRAY;
+				position_++;
+				if (peek() == ']') {
+					position_++;
+					return value;
+				}
+				do {
+					value.elements_.push_back(parseValue(depth + 1));
+				} while (consumeSeparator(']'));
+			} else if (c == '"') {
+				value.type_ = JsonValue::Type::STRING;
+				value.string_ = parseString();
+			} else if (consumeLiteral("true")) {
+				value.type_ = JsonValue::Type::BOOLEAN;
+				value.boolean_ = true;
+			} else if (consumeLiteral("false")) {
+				value.type_ = JsonValue::Type::BOOLEAN;
+			} else if (consumeLiteral("null")) {
+				value.type_ = JsonValue::Type::NUL;
+			} else {
+				value.type_ = JsonValue::Type::NUMBER;
+				value.number_ = parseNumber();
+			}
+			return value;
+		}
+
+		// true after a comma, false after the closing bracket
+		bool consumeSeparator(char close)
+		{
+			const char c = peek();
+			position_++;
+			if (c == ',') {
+				return true;
+			}
+			if (c != close) {
+				fail("expected a comma or closing bracket");
+			}
+			return false;
+		}
+
+		double parseNumber()
+		{
+			// from_chars also takes forms json doesn't allow, such as inf or a leading plus, so the start is checked
+			const char first = text_[position_];
+			if (first != '-' && (first < '0' || first > '9')) {
+				fail("unexpected character");
+			}
+			double number = 0.0;
+			const auto [end, error] = std::from_chars(text_.data() + position_, text_.data() + text_.size(), number);
+			if (error != std::errc{}) {
+				fail("invalid number");
+			}
+			position_ = static_cast<size_t>(end - text_.data());
+			return number;
+		}
+
+		uint32_t parseHex4()
+		{
+			if (text_.size() - position_ < 4) {
+				fail("truncated escape");
+			}
+			uint32_t value = 0;
+			const auto [end, error] = std::from_chars(text_.data() + position_, text_.data() + position_ + 4, value, 16);
+			if (error != std::errc{} || end != text_.data() + position_ + 4) {
+				fail("invalid escape");
+			}
+			position_ += 4;
+			return value;
+		}
+
+		static void appendUtf8(std::string& out, uint32_t codepoint)
+		{
+			if (codepoint < 0x80) {
+				out += static_cast<char>(codepoint);
+			} else if (codepoint < 0x800) {
+				out += static_cast<char>(0xc0 | codepoint >> 6);
+				out += static_cast<char>(0x80 | (codepoint & 0x3f));
+			} else if (codepoint < 0x10000) {
+				out += static_cast<char>(0xe0 | codepoint >> 12);
+				out += static_cast<char>(0x80 | (codepoint >> 6 & 0x3f));
+				out += static_cast<char>(0x80 | (codepoint & 0x3f));
+			} else {
+				out += static_cast<char>(0xf0 | codepoint >> 18);
+				out += static_cast<char>(0x80 | (codepoint >> 12 & 0x3f));
+				out += static_cast<char>(0x80 | (codepoint >> 6 & 0x3f));
+				out += static_cast<char>(0x80 | (codepoint & 0x3f));
+			}
+		}
+
+		std::string parseString()
+		{
+			position_++;
+			std::string out;
+			while (true) {
+				if (position_ == text_.size()) {
+					fail("unterminated string");
+				}
+				const char c = text_[position_++];
+				if (c == '"') {
+					return out;
+				}
+				if (static_cast<unsigned char>(c) < 0x20) {
+					fail("control character in string");
+				}
+				if (c != '\\') {
+					out += c;
+					continue;
+				}
+
+				if (position_ == text_.size()) {
+					fail("unterminated string");
+				}
+				switch (text_[position_++]) {
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u': {
+					uint32_t codepoint = parseHex4();
+					// characters outside the basic plane are escaped as a surrogate pair
+					if (codepoint >= 0xd800 && codepoint < 0xdc00 && consumeLiteral("\\u")) {
+						const uint32_t low = parseHex4();
+						if (low < 0xdc00 || low >= 0xe000) {
+							fail("invalid surrogate pair");
+						}
+						codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+					}
+					appendUtf8(out, codepoint);
+					break;
+				}
+				default:
+					fail("invalid escape");
+				}
+			}
+		}
+
+		std::string_view text_;
+		size_t position_ = 0;
+	};
+
+	JsonValue JsonValue::parse(std::string_view text)
+	{
+		return JsonParser{text}.parseDocument();
+	}
+
+	bool JsonValue::asBool() const
+	{
+		if (type_ != Type::BOOLEAN) {
+			throw std::runtime_error("json value is not a boolean");
+		}
+		return boolean_;
+	}
+
+	double JsonValue::asNumber() const
+	{
+		if (type_ != Type::NUMBER) {
+			throw std::runtime_error("json value is not a number");
+		}
+		return number_;
+	}
+
+	const std::string& JsonValue::asString() const
+	{
+		if (type_ != Type::STRING) {
+			throw std::runtime_error("json value is not a string");
+		}
+		return string_;
+	}
+
+	const std::vector<JsonValue>& JsonValue::asArray() const
+	{
+		if (type_ != Type::ARRAY) {
+			throw std::runtime_error("json value is not an array");
+		}
+		return elements_;
+	}
+
+	const JsonValue* JsonValue::find(std::string_view key) const
+	{
+		for (size_t i = 0; i < keys_.size(); i++) {
+			if (keys_[i] == key) {
+				return &elements_[i];
+			}
+		}
+		return nullptr;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bve
+{
+	// A parsed JSON document, enough to read asset formats such as glTF. Numbers are doubles and objects keep their
+	// members in file order, so lookups are linear, which suits the small objects these formats are made of.
+	class JsonValue
+	{
+	public:
+		enum class Type
+		{
+			NUL,
+			BOOLEAN,
+			NUMBER,
+			STRING,
+			ARRAY,
+			OBJECT,
+		};
+
+		// throws with the offset of the first error
+		static JsonValue parse(std::string_view text);
+
+		Type getType() const { return type_; }
+		bool isObject() const { return type_ == Type::OBJECT; }
+		bool isArray() const { return type_ == Type::ARRAY; }
+
+		// each throws if the value has another type
+		bool asBool() const;
+		double asNumber() const;
+		const std::string& asString() const;
+		const std::vector<JsonValue>& asArray() const;
+
+		// null if this isn't an object or has no member named key
+		const JsonValue* find(std::string_view key) const;
+		const std::vector<std::string>& getKeys() const { return keys_; }
+
+	private:
+		friend class JsonParser;
+
+		Type type_ = Type::NUL;
+		bool boolean_ = false;
+		double number_ = 0.0;
+		std::string string_;
+		std::vector<JsonValue> elements_; // array elements or object member values
+		std::vector<std::string> keys_; // object member names, parallel to elements_
+	};
+}
@@ -0,0 +1,111 @@
+#include "../pch.h"
+#include "mapped_file.h"
+
+#ifdef _WIN32
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#include <stdexcept>
+
+namespace bve
+{
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::string& path)
+	{
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("failed to open " + path);
+		}
+
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(file, &fileSize)) {
+			CloseHandle(file);
+			throw std::runtime_error("failed to get the size of " + path);
+		}
+		size_ = static_cast<size_t>(fileSize.QuadPart);
+
+		if (size_ > 0) {
+			// the view keeps the file mapped after both handles are closed
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+			if (mapping) {
+				CloseHandle(mapping);
+			}
+			if (!view) {
+				CloseHandle(file);
+				throw std::runtime_error("failed to map " + path);
+			}
+			data_ = static_cast<const std::byte*>(view);
+		}
+		CloseHandle(file);
+		open_ = true;
+	}
+
+	void MappedFile::close()
+	{
+		if (data_) {
+			UnmapViewOfFile(data_);
+		}
+	}
+#else
+	MappedFile::MappedFile(const std::string& path)
+	{
+		const int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			throw std::runtime_error("failed to open " + path);
+		}
+
+		struct stat status{};
+		if (fstat(file, &status) != 0) {
+			::close(file);
+			throw std::runtime_error("failed to get the size of " + path);
+		}
+		size_ = static_cast<size_t>(status.st_size);
+
+		// mmap rejects empty ranges
+		if (size_ > 0) {
+			void* view = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+			if (view == MAP_FAILED) {
+				::close(file);
+				throw std::runtime_error("failed to map " + path);
+			}
+			data_ = static_cast<const std::byte*>(view);
+		}
+		::close(file);
+		open_ = true;
+	}
+
+	void MappedFile::close()
+	{
+		if (data_) {
+			munmap(const_cast<std::byte*>(data_), size_);
+		}
+	}
+#endif
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+		: data_{std::exchange(other.data_, nullptr)}, size_{std::exchange(other.size_, 0)}, open_{std::exchange(other.open_, false)}
+	{
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other) {
+			close();
+			data_ = std::exchange(other.data_, nullptr);
+			size_ = std::exchange(other.size_, 0);
+			open_ = std::exchange(other.open_, false);
+		}
+		return *this;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace bve
+{
+	// read only view of a whole file mapped into memory, pages are loaded by the os as they are touched
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		// throws if the file can't be opened or mapped
+		explicit MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		bool isOpen() const { return open_; }
+		size_t size() const { return size_; }
+		const std::byte* data() const { return data_; }
+		std::span<const std::byte> bytes() const { return {data_, size_}; }
+
+	private:
+		void close();
+
+		const std::byte* data_ = nullptr;
+		size_t size_ = 0;
+		bool open_ = false; // empty files are open but have no mapping
+	};
+}
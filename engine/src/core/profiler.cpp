@@ -0,0 +1,186 @@
+#include "../pch.h"
+#include "profiler.h"
+
+#include "../log.h"
+
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+
+namespace bve
+{
+	namespace
+	{
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<std::unique_ptr<Profiler::ThreadBuffer>> buffers;
+
+			// ticks are converted by comparing the elapsed ticks and nanoseconds since the registry was made
+			uint64_t originTicks = Profiler::ticks();
+			uint64_t originNanoseconds = Profiler::now();
+
+			// written by the main thread only, but read under the lock by collect
+			std::array<Profiler::Frame, Profiler::FRAME_RING_SIZE> frames{};
+			uint64_t frameHead = 0;
+			uint64_t frameStart = originTicks;
+			std::array<std::atomic<uint64_t>, Profiler::COUNTER_COUNT> counters{};
+		};
+
+		// leaked so threads still running during static destruction can keep recording
+		Registry& registry()
+		{
+			static Registry* instance = new Registry{};
+			return *instance;
+		}
+
+		void writeJsonString(std::ostream& out, const std::string& value)
+		{
+			out << '"';
+			for (char c : value) {
+				if (c == '"' || c == '\\') {
+					out << '\\';
+				}
+				out << c;
+			}
+			out << '"';
+		}
+	}
+
+	Profiler::ThreadBuffer& Profiler::threadBuffer()
+	{
+		thread_local ThreadBuffer* buffer = [] {
+			Registry& reg = registry();
+			std::lock_guard lock{reg.mutex};
+			reg.buffers.push_back(std::make_unique<ThreadBuffer>(static_cast<uint32_t>(reg.buffers.size())));
+			return reg.buffers.back().get();
+		}();
+		return *buffer;
+	}
+
+	void Profiler::setThreadName(const std::string& name)
+	{
+		ThreadBuffer& buffer = threadBuffer();
+		std::lock_guard lock{registry().mutex};
+		buffer.name = name;
+	}
+
+	void Profiler::count(Counter counter, uint64_t value)
+	{
+		registry().counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+	}
+
+	void Profiler::markFrame()
+	{
+		Registry& reg = registry();
+		const uint64_t end = ticks();
+
+		Frame frame{};
+		frame.start = reg.frameStart;
+		frame.end = end;
+		for (size_t i = 0; i < COUNTER_COUNT; i++) {
+			frame.counters[i] = reg.counters[i].exchange(0, std::memory_order_relaxed);
+		}
+
+		std::lock_guard lock{reg.mutex};
+		frame.number = reg.frameHead;
+		reg.frames[reg.frameHead % FRAME_RING_SIZE] = frame;
+		reg.frameHead++;
+		reg.frameStart = end;
+	}
+
+	std::vector<Profiler::ThreadZones> Profiler::collect()
+	{
+		Cursor cursor{};
+		std::vector<Frame> frames;
+		return collect(cursor, frames);
+	}
+
+	std::vector<Profiler::ThreadZones> Profiler::collect(Cursor& cursor, std::vector<Frame>& frames)
+	{
+		Registry& reg = registry();
+		std::lock_guard lock{reg.mutex};
+
+		frames.clear();
+		const uint64_t firstFrame = std::max(cursor.frameHead, reg.frameHead > FRAME_RING_SIZE ? reg.frameHead - FRAME_RING_SIZE : 0);
+		for (uint64_t i = firstFrame; i < reg.frameHead; i++) {
+			frames.push_back(reg.frames[i % FRAME_RING_SIZE]);
+		}
+		cursor.frameHead = reg.frameHead;
+
+		cursor.threadHeads.resize(reg.buffers.size(), 0);
+		std::vector<ThreadZones> result;
+		result.reserve(reg.buffers.size());
+		for (const auto& buffer : reg.buffers) {
+			ThreadZones& thread = result.emplace_back();
+			thread.threadIndex = buffer->threadIndex;
+			thread.threadName = buffer->name.empty() ? "thread " + std::to_string(buffer->threadIndex) : buffer->name;
+
+			uint64_t& threadHead = cursor.threadHeads[buffer->threadIndex];
+			const uint64_t head = buffer->head_.load(std::memory_order_acquire);
+			const uint64_t first = std::max(threadHead, head > RING_SIZE ? head - RING_SIZE : 0);
+			thread.zones.reserve(head - first);
+			for (uint64_t i = first; i < head; i++) {
+				thread.zones.push_back(buffer->zones_[i % RING_SIZE]);
+			}
+			threadHead = head;
+
+			// the owner kept writing while we copied, the slots it reached since may hold newer zones
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint64_t newHead = buffer->head_.load(std::memory_order_relaxed);
+			const uint64_t overwritten = newHead > RING_SIZE ? newHead - RING_SIZE : 0;
+			if (overwritten > first) {
+				thread.zones.erase(thread.zones.begin(), thread.zones.begin() + static_cast<ptrdiff_t>(std::min(overwritten, head) - first));
+			}
+		}
+		return result;
+	}
+
+	double Profiler::nanosecondsPerTick()
+	{
+		const Registry& reg = registry();
+		const uint64_t elapsedTicks = ticks() - reg.originTicks;
+		const uint64_t elapsedNanoseconds = now() - reg.originNanoseconds;
+		return elapsedTicks > 0 ? static_cast<double>(elapsedNanoseconds) / static_cast<double>(elapsedTicks) : 1.0;
+	}
+
+	void Profiler::writeChromeTrace(const std::string& path)
+	{
+		const std::vector<ThreadZones> threads = collect();
+		const double microsecondsPerTick = nanosecondsPerTick() * 1e-3;
+
+		uint64_t origin = UINT64_MAX;
+		size_t zoneCount = 0;
+		for (const auto& thread : threads) {
+			for (const Zone& zone : thread.zones) {
+				origin = std::min(origin, zone.start);
+			}
+			zoneCount += thread.zones.size();
+		}
+
+		std::ofstream file{path};
+		if (!file) {
+			throw std::runtime_error("failed to open trace file: " + path);
+		}
+
+		// complete events carry their own duration, so the viewer nests them without matching begin and end pairs
+		file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+		bool first = true;
+		for (const auto& thread : threads) {
+			file << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << thread.threadIndex << ",\"args\":{\"name\":";
+			writeJsonString(file, thread.threadName);
+			file << "}}";
+			first = false;
+
+			for (const Zone& zone : thread.zones) {
+				file << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.threadIndex << ",\"name\":";
+				writeJsonString(file, zone.name);
+				file << ",\"ts\":" << static_cast<double>(zone.start - origin) * microsecondsPerTick << ",\"dur\":" << static_cast<double>(zone.end - zone.start) * microsecondsPerTick << '}';
+			}
+		}
+		file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+		LOG_INFO("wrote {} profiling zones from {} threads to {}", zoneCount, threads.size(), path);
+	}
+}
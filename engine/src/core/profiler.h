@@ -0,0 +1,177 @@
+#pragma once
+
+#include "../defines.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace bve
+{
+	// Scoped cpu zones recorded into per thread ring buffers. A thread only ever appends to its own ring and
+	// publishes each zone with a release store, so recording never locks. Readers copy a ring and drop whatever
+	// the owning thread may have overwritten while they were copying. Zones are stored when they end, every ring
+	// holds the last RING_SIZE finished zones of its thread. Zones are timed in ticks of the cpu's timestamp counter
+	// where there is one, it is read about twice as fast as the steady clock. The main thread marks frame boundaries,
+	// which also close the frame's counters.
+	class IG_API Profiler
+	{
+	public:
+		static constexpr uint32_t RING_SIZE = 1 << 14;
+		static constexpr uint32_t FRAME_RING_SIZE = 1024;
+
+		enum class Counter
+		{
+			DRAW_CALLS,
+			TRIANGLES,
+			CULLED_OBJECTS,
+			UPLOAD_BYTES,
+			COUNT,
+		};
+		static constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::COUNT);
+
+		struct Zone
+		{
+			const char* name; // must outlive the profiler, in practice a string literal
+			uint64_t start; // ticks
+			uint64_t end;
+			uint32_t depth; // zones still open on the same thread when this one started
+		};
+
+		struct ThreadZones
+		{
+			uint32_t threadIndex;
+			std::string threadName;
+			std::vector<Zone> zones; // ordered by end time
+		};
+
+		struct Frame
+		{
+			uint64_t number;
+			uint64_t start; // ticks
+			uint64_t end;
+			std::array<uint64_t, COUNTER_COUNT> counters;
+		};
+
+		// how far a reader has collected, so repeated collects only copy what was recorded since
+		struct Cursor
+		{
+			std::vector<uint64_t> threadHeads;
+			uint64_t frameHead = 0;
+		};
+
+		class ThreadBuffer
+		{
+		public:
+			ThreadBuffer(uint32_t index) : threadIndex{index} {}
+
+			void push(const Zone& zone)
+			{
+				const uint64_t head = head_.load(std::memory_order_relaxed);
+				zones_[head % RING_SIZE] = zone;
+				head_.store(head + 1, std::memory_order_release);
+			}
+
+			uint32_t depth = 0;
+			const uint32_t threadIndex;
+			std::string name{}; // guarded by the profiler's registry lock
+
+		private:
+			friend class Profiler;
+
+			std::unique_ptr<Zone[]> zones_{new Zone[RING_SIZE]};
+			std::atomic<uint64_t> head_{0};
+		};
+
+		class ScopedZone
+		{
+		public:
+			explicit ScopedZone(const char* name) : buffer_{threadBuffer()}, name_{name}, depth_{buffer_.depth++}, start_{ticks()} {}
+
+			~ScopedZone()
+			{
+				buffer_.push({name_, start_, ticks(), depth_});
+				buffer_.depth--;
+			}
+
+			ScopedZone(const ScopedZone&) = delete;
+			ScopedZone& operator=(const ScopedZone&) = delete;
+			ScopedZone(const ScopedZone&&) = delete;
+			ScopedZone& operator=(const ScopedZone&&) = delete;
+
+		private:
+			ThreadBuffer& buffer_;
+			const char* name_;
+			uint32_t depth_;
+			uint64_t start_;
+		};
+
+		static uint64_t now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		static uint64_t ticks()
+		{
+#if defined(_M_X64) || defined(__x86_64__)
+			return __rdtsc();
+#else
+			return now();
+#endif
+		}
+
+		// the calling thread's ring, registered on first use and kept after the thread exits
+		static ThreadBuffer& threadBuffer();
+		static void setThreadName(const std::string& name);
+
+		// adds to a counter of the current frame, from any thread
+		static void count(Counter counter, uint64_t value);
+
+		// closes the current frame and starts the next, only call from the main thread
+		static void markFrame();
+
+		// copies every thread's recorded zones
+		static std::vector<ThreadZones> collect();
+
+		// copies the zones and closed frames recorded since cursor, or everything still recorded for a new cursor
+		static std::vector<ThreadZones> collect(Cursor& cursor, std::vector<Frame>& frames);
+
+		// measured against the steady clock since the first zone was recorded
+		static double nanosecondsPerTick();
+
+		// Chrome trace event json, opens in chrome://tracing and ui.perfetto.dev
+		static void writeChromeTrace(const std::string& path);
+	};
+}
+
+#ifdef IG_PROFILE
+#define IG_PROFILE_CONCAT_INNER(a, b) a##b
+#define IG_PROFILE_CONCAT(a, b) IG_PROFILE_CONCAT_INNER(a, b)
+#ifdef _MSC_VER
+#define IG_PROFILE_FUNCTION_NAME __FUNCTION__
+#else
+#define IG_PROFILE_FUNCTION_NAME __PRETTY_FUNCTION__
+#endif
+
+#define IG_PROFILE_SCOPE(name) ::bve::Profiler::ScopedZone IG_PROFILE_CONCAT(profileZone_, __LINE__){name}
+#define IG_PROFILE_FUNCTION() IG_PROFILE_SCOPE(IG_PROFILE_FUNCTION_NAME)
+#define IG_PROFILE_THREAD(name) ::bve::Profiler::setThreadName(name)
+#define IG_PROFILE_FRAME() ::bve::Profiler::markFrame()
+#define IG_PROFILE_COUNT(counter, value) ::bve::Profiler::count(::bve::Profiler::Counter::counter, value)
+#else
+#define IG_PROFILE_SCOPE(name)
+#define IG_PROFILE_FUNCTION()
+#define IG_PROFILE_THREAD(name)
+#define IG_PROFILE_FRAME()
+#define IG_PROFILE_COUNT(counter, value)
+#endif
@@ -0,0 +1,129 @@
+#include "../pch.h"
+#include "thread_pool.h"
+#include "profiler.h"
+
+#include <exception>
+
+namespace bve
+{
+	ThreadPool::ThreadPool(uint32_t threadCount)
+	{
+		workers_.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++) {
+			workers_.emplace_back([this, i]() {
+				IG_PROFILE_THREAD("worker " + std::to_string(i));
+				workerLoop();
+			});
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock{mutex_};
+			stopping_ = true;
+		}
+		condition_.notify_all();
+
+		for (auto& worker : workers_) {
+			worker.join();
+		}
+	}
+
+	ThreadPool& ThreadPool::instance()
+	{
+		static ThreadPool instance;
+		return instance;
+	}
+
+	uint32_t ThreadPool::defaultThreadCount()
+	{
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	void ThreadPool::workerLoop()
+	{
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock lock{mutex_};
+				condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+
+				if (stopping_ && tasks_.empty()) {
+					return;
+				}
+
+				task = std::move(tasks_.front());
+				tasks_.pop_front();
+			}
+
+			task();
+		}
+	}
+
+	bool ThreadPool::runPendingTask()
+	{
+		std::function<void()> task;
+		{
+			std::lock_guard lock{mutex_};
+			if (tasks_.empty()) {
+				return false;
+			}
+
+			task = std::move(tasks_.front());
+			tasks_.pop_front();
+		}
+
+		task();
+		return true;
+	}
+
+	void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& body, uint32_t minBatchSize)
+	{
+		if (count == 0) {
+			return;
+		}
+
+		minBatchSize = std::max(minBatchSize, 1u);
+		const uint32_t maxChunks = (count + minBatchSize - 1) / minBatchSize;
+		const uint32_t chunkCount = std::min(getThreadCount() + 1, maxChunks);
+
+		if (chunkCount <= 1) {
+			body(0, count);
+			return;
+		}
+
+		const uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+		std::vector<std::future<void>> pending;
+		pending.reserve(chunkCount - 1);
+		for (uint32_t begin = chunkSize; begin < count; begin += chunkSize) {
+			const uint32_t end = std::min(begin + chunkSize, count);
+			pending.push_back(submit([&body, begin, end]() { body(begin, end); }));
+		}
+
+		// every range must finish before unwinding since the tasks reference body
+		std::exception_ptr error;
+		try {
+			body(0, std::min(chunkSize, count));
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		for (auto& future : pending) {
+			wait(future);
+			try {
+				future.get();
+			} catch (...) {
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace bve
+{
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(uint32_t threadCount = defaultThreadCount());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool(const ThreadPool&&) = delete;
+		ThreadPool& operator=(const ThreadPool&&) = delete;
+
+		// shared engine-wide pool, sized to leave one core for the main thread
+		static ThreadPool& instance();
+		static uint32_t defaultThreadCount();
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(workers_.size()); }
+
+		template <typename F>
+		auto submit(F&& task) -> std::future<std::invoke_result_t<F>>;
+
+		// splits [0, count) into at most getThreadCount() + 1 contiguous ranges and runs body(begin, end)
+		// on each, using the calling thread for one of them. Blocks until every range has finished.
+		void parallelFor(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& body, uint32_t minBatchSize = 1);
+
+		// blocks until the future is ready, running queued tasks on the calling thread in the meantime
+		// so that waiting from inside a worker cannot deadlock the pool
+		template <typename T>
+		void wait(std::future<T>& future);
+
+	private:
+		void workerLoop();
+		bool runPendingTask();
+
+		std::vector<std::thread> workers_;
+		std::deque<std::function<void()>> tasks_;
+		std::mutex mutex_;
+		std::condition_variable condition_;
+		bool stopping_ = false;
+	};
+
+	template <typename F>
+	auto ThreadPool::submit(F&& task) -> std::future<std::invoke_result_t<F>>
+	{
+		using Result = std::invoke_result_t<F>;
+
+		// std::function requires a copyable callable, packaged_task is move only
+		auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+		std::future<Result> future = packaged->get_future();
+
+		if (workers_.empty()) {
+			(*packaged)();
+			return future;
+		}
+
+		{
+			std::lock_guard lock{mutex_};
+			tasks_.emplace_back([packaged]() { (*packaged)(); });
+		}
+		condition_.notify_one();
+
+		return future;
+	}
+
+	template <typename T>
+	void ThreadPool::wait(std::future<T>& future)
+	{
+		while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			if (!runPendingTask()) {
+				future.wait();
+			}
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#include "pch.h"
+#include "culling.h"
+
+#include <cmath>
+
+namespace bve
+{
+	Frustum Frustum::fromMatrix(const glm::mat4& matrix)
+	{
+		auto row = [&](int i) { return glm::vec4{matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]}; };
+
+		// Gribb and Hartmann, depth is clipped to 0 <= z <= w rather than -w <= z <= w
+		Frustum frustum{};
+		frustum.planes[0] = row(3) + row(0);
+		frustum.planes[1] = row(3) - row(0);
+		frustum.planes[2] = row(3) + row(1);
+		frustum.planes[3] = row(3) - row(1);
+		frustum.planes[4] = row(2);
+		frustum.planes[5] = row(3) - row(2);
+
+		for (glm::vec4& plane : frustum.planes) {
+			plane /= glm::length(glm::vec3{plane});
+		}
+		return frustum;
+	}
+
+	bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const
+	{
+		for (const glm::vec4& plane : planes) {
+			if (glm::dot(glm::vec3{plane}, center) + plane.w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	namespace
+	{
+		// true when every triangle of the meshlet faces away from the camera
+		bool isBackfacing(const mesh_optimizer::Meshlet& meshlet, const MeshletCullView& view)
+		{
+			if (meshlet.coneCutoff >= 1.f) {
+				return false;
+			}
+
+			// the direction to every point of the bounding sphere must be within 90 degrees minus the cone angle of the axis
+			if (view.perspective) {
+				const glm::vec3 toCenter = meshlet.center - view.cameraPosition;
+				return glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+			}
+			return glm::dot(view.viewDirection, meshlet.coneAxis) >= meshlet.coneCutoff;
+		}
+	}
+
+	uint32_t cullMeshlets(std::span<const mesh_optimizer::Meshlet> meshlets, const MeshletCullView& view, std::vector<IndexRange>& ranges)
+	{
+		uint32_t kept = 0;
+		for (const mesh_optimizer::Meshlet& meshlet : meshlets) {
+			if (view.coneCulling && isBackfacing(meshlet, view)) {
+				continue;
+			}
+
+			const glm::vec3 center{view.modelMatrix * glm::vec4{meshlet.center, 1.f}};
+			if (!view.frustum.intersectsSphere(center, meshlet.radius * view.maxScale)) {
+				continue;
+			}
+
+			kept++;
+			if (!ranges.empty() && ranges.back().firstIndex + ranges.back().indexCount == meshlet.firstIndex) {
+				ranges.back().indexCount += meshlet.indexCount;
+			} else {
+				ranges.push_back(IndexRange{meshlet.firstIndex, meshlet.indexCount});
+			}
+		}
+		return kept;
+	}
+}
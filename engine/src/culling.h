@@ -0,0 +1,49 @@
+#pragma once
+
+#include "mesh_optimizer.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <span>
+#include <vector>
+
+namespace bve
+{
+	// planes point inwards, a point is inside when dot(plane.xyz, p) + plane.w >= 0 for all six
+	struct Frustum
+	{
+		std::array<glm::vec4, 6> planes;
+
+		// planes of a projection * view matrix with a zero to one depth range, in the space the matrix maps from
+		static Frustum fromMatrix(const glm::mat4& matrix);
+
+		bool intersectsSphere(const glm::vec3& center, float radius) const;
+	};
+
+	struct IndexRange
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	// Where the camera is for one model, in its model space so meshlet cones can be tested untransformed.
+	// Which side of a plane a point lies on survives any affine transform, so this stays exact with
+	// non uniform scale. Orthographic views have no position, only a direction.
+	struct MeshletCullView
+	{
+		Frustum frustum; // world space
+		glm::mat4 modelMatrix;
+		float maxScale;
+		glm::vec3 cameraPosition; // model space
+		glm::vec3 viewDirection; // model space, only used when not perspective
+		bool perspective;
+		bool coneCulling; // only valid when the pipeline culls back faces
+	};
+
+	// appends the index ranges of meshlets that survive frustum and back face cone culling, neighbouring
+	// ranges are merged so a fully visible mesh costs one draw. returns the number of meshlets kept
+	uint32_t cullMeshlets(std::span<const mesh_optimizer::Meshlet> meshlets, const MeshletCullView& view, std::vector<IndexRange>& ranges);
+}
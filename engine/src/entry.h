@@ -11,6 +11,10 @@ int main(int argc, char** argv)
 	bve::Log::init();
 
 	auto app = bve::createApplication();
-	app->run();
+	if (const auto headlessOptions = bve::Application::parseHeadlessOptions(argc, argv)) {
+		app->runHeadless(*headlessOptions);
+	} else {
+		app->run();
+	}
 	delete app;
 }
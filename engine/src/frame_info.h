@@ -1,17 +1,25 @@
 #pragma once
 
 #include "entity_manager.h"
+#include "occlusion_buffer.h"
+#include "vulkan_frame_allocator.h"
+#include "vulkan_parallel_recorder.h"
 
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
 #include <vulkan/vulkan.h>
 
+#include <array>
+
 namespace bve
 {
-#define MAX_LIGHTS 10
+#define MAX_LIGHTS 16384
 
 	struct PointLight
 	{
-		glm::vec4 position{};
-		glm::vec4 color{};
+		glm::vec4 position{}; // w is the influence radius used for clustering and the attenuation window
+		glm::vec4 color{}; // w is intensity
 	};
 
 	struct GlobalUbo
@@ -20,16 +28,31 @@ namespace bve
 		glm::mat4 view{1.f};
 		glm::mat4 inverseView{1.f};
 		glm::vec4 ambientLightColor{1.f, 1.f, 1.f, .02f};
-		PointLight pointLights[MAX_LIGHTS];
+		glm::vec4 viewport{}; // width, height, 1 / width, 1 / height
+		glm::uvec4 clusterCount{}; // x, y and z dimensions of the light cluster grid
+		glm::vec4 clusterDepth{}; // depth slice = log(viewZ) * x + y
 		int numLights;
 	};
 
+	// the global set is made of dynamic buffers only, offsets are given in binding order
+	constexpr uint32_t GLOBAL_UBO_BINDING = 0;
+	constexpr uint32_t GLOBAL_LIGHTS_BINDING = 1;
+	constexpr uint32_t GLOBAL_CLUSTERS_BINDING = 2;
+	constexpr uint32_t GLOBAL_LIGHT_INDICES_BINDING = 3;
+	constexpr uint32_t GLOBAL_LIGHT_BILLBOARDS_BINDING = 4;
+	constexpr uint32_t GLOBAL_BINDING_COUNT = 5;
+
 	struct FrameInfo
 	{
 		int frameIndex;
 		float frameTime;
 		VkCommandBuffer commandBuffer;
+		VkExtent2D extent;
 		Entity camera;
 		VkDescriptorSet globalDescriptorSet;
+		std::array<uint32_t, GLOBAL_BINDING_COUNT> globalDynamicOffsets;
+		VulkanFrameAllocator& frameAllocator;
+		VulkanParallelRecorder& recorder; // records into commandBuffer's current render pass
+		const OcclusionBuffer& occlusionBuffer; // already rasterized for this frame's camera
 	};
-}
+}
\ No newline at end of file
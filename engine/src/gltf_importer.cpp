@@ -0,0 +1,665 @@
+#include "pch.h"
+#include "gltf_importer.h"
+#include "asset_manager.h"
+#include "bve_utils.h"
+#include "components/components.h"
+#include "core/profiler.h"
+#include "core/thread_pool.h"
+#include "log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BVE_GLTF_SSE2
+#endif
+
+namespace bve::gltf
+{
+	namespace
+	{
+		constexpr uint32_t GLB_MAGIC = 0x46546c67; // "glTF"
+		constexpr uint32_t GLB_VERSION = 2;
+		constexpr uint32_t CHUNK_JSON = 0x4e4f534a;
+		constexpr uint32_t CHUNK_BIN = 0x004e4942;
+
+		constexpr uint32_t BYTE = 5120;
+		constexpr uint32_t UNSIGNED_BYTE = 5121;
+		constexpr uint32_t SHORT = 5122;
+		constexpr uint32_t UNSIGNED_SHORT = 5123;
+		constexpr uint32_t UNSIGNED_INT = 5125;
+		constexpr uint32_t FLOAT = 5126;
+
+		constexpr uint32_t MODE_TRIANGLES = 4;
+
+		// documents kept by Document::open, a scene's meshes are usually loaded close together
+		constexpr size_t DOCUMENT_CACHE_SIZE = 4;
+		constexpr uint32_t ELEMENTS_PER_BATCH = 4096;
+
+		struct GlbHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t length;
+		};
+
+		struct ChunkHeader
+		{
+			uint32_t length;
+			uint32_t type;
+		};
+
+		uint32_t getComponentSize(uint32_t componentType)
+		{
+			switch (componentType) {
+			case BYTE:
+			case UNSIGNED_BYTE:
+				return 1;
+			case SHORT:
+			case UNSIGNED_SHORT:
+				return 2;
+			case UNSIGNED_INT:
+			case FLOAT:
+				return 4;
+			default:
+				throw std::runtime_error("unsupported accessor component type " + std::to_string(componentType));
+			}
+		}
+
+		uint32_t getComponentCount(const std::string& type)
+		{
+			if (type == "SCALAR") {
+				return 1;
+			}
+			if (type == "VEC2") {
+				return 2;
+			}
+			if (type == "VEC3") {
+				return 3;
+			}
+			if (type == "VEC4") {
+				return 4;
+			}
+			throw std::runtime_error("unsupported accessor type " + type);
+		}
+
+		const JsonValue& getMember(const JsonValue& object, const char* key)
+		{
+			const JsonValue* member = object.find(key);
+			if (!member) {
+				throw std::runtime_error(std::string{"missing "} + key);
+			}
+			return *member;
+		}
+
+		uint32_t toIndex(const JsonValue& value)
+		{
+			const double number = value.asNumber();
+			if (!(number >= 0.0 && number <= std::numeric_limits<uint32_t>::max()) || std::floor(number) != number) {
+				throw std::runtime_error("invalid index " + std::to_string(number));
+			}
+			return static_cast<uint32_t>(number);
+		}
+
+		uint32_t getIndex(const JsonValue& object, const char* key, uint32_t fallback)
+		{
+			const JsonValue* member = object.find(key);
+			return member ? toIndex(*member) : fallback;
+		}
+
+		template <size_t N>
+		void readFloats(const JsonValue& object, const char* key, float* out)
+		{
+			const JsonValue* member = object.find(key);
+			if (!member) {
+				return;
+			}
+			const std::vector<JsonValue>& values = member->asArray();
+			if (values.size() != N) {
+				throw std::runtime_error(std::string{"wrong number of values for "} + key);
+			}
+			for (size_t i = 0; i < N; i++) {
+				out[i] = static_cast<float>(values[i].asNumber());
+			}
+		}
+
+		// widens up to four components to floats, normalized integers are mapped to [0, 1] or [-1, 1] as glTF defines
+		template <typename T>
+		void convertComponents(const std::byte* source, uint32_t count, bool normalized, float* out)
+		{
+			T values[4]{};
+			std::memcpy(values, source, count * sizeof(T));
+			if constexpr (std::is_same_v<T, float>) {
+				std::memcpy(out, values, count * sizeof(float));
+			} else {
+				const float scale = normalized ? 1.f / static_cast<float>(std::numeric_limits<T>::max()) : 1.f;
+#ifdef BVE_GLTF_SSE2
+				if constexpr (std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t>) {
+					// all four lanes are widened and scaled at once, the common layout of quantized colors and uvs
+					__m128i widened;
+					if constexpr (std::is_same_v<T, uint8_t>) {
+						int packed;
+						std::memcpy(&packed, values, sizeof(packed));
+						widened = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), _mm_setzero_si128());
+					} else {
+						widened = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(values));
+					}
+					widened = _mm_unpacklo_epi16(widened, _mm_setzero_si128());
+					float converted[4];
+					_mm_storeu_ps(converted, _mm_mul_ps(_mm_cvtepi32_ps(widened), _mm_set1_ps(scale)));
+					std::memcpy(out, converted, count * sizeof(float));
+					return;
+				}
+#endif
+				for (uint32_t i = 0; i < count; i++) {
+					out[i] = static_cast<float>(values[i]) * scale;
+					if constexpr (std::is_signed_v<T>) {
+						// the most negative value would fall just below -1
+						out[i] = std::max(out[i], -1.f);
+					}
+				}
+			}
+		}
+
+		// calls write(element, floats) for every element of the accessor, in parallel for large ones
+		template <typename T, typename Write>
+		void forEachElementAs(const std::byte* data, uint32_t count, uint32_t stride, uint32_t components, bool normalized, const Write& write)
+		{
+			ThreadPool::instance().parallelFor(count, [&](uint32_t begin, uint32_t end) {
+				float values[4];
+				for (uint32_t i = begin; i < end; i++) {
+					convertComponents<T>(data + static_cast<size_t>(i) * stride, components, normalized, values);
+					write(i, values);
+				}
+			}, ELEMENTS_PER_BATCH);
+		}
+
+		// the component type is dispatched once per accessor, so the loop for each type is compiled on its own
+		template <typename Write>
+		void forEachElement(const std::byte* data, uint32_t count, uint32_t stride, uint32_t componentType, uint32_t components, bool normalized, const Write& write)
+		{
+			switch (componentType) {
+			case BYTE: forEachElementAs<int8_t>(data, count, stride, components, normalized, write); break;
+			case UNSIGNED_BYTE: forEachElementAs<uint8_t>(data, count, stride, components, normalized, write); break;
+			case SHORT: forEachElementAs<int16_t>(data, count, stride, components, normalized, write); break;
+			case UNSIGNED_SHORT: forEachElementAs<uint16_t>(data, count, stride, components, normalized, write); break;
+			case UNSIGNED_INT: forEachElementAs<uint32_t>(data, count, stride, components, normalized, write); break;
+			default: forEachElementAs<float>(data, count, stride, components, normalized, write); break;
+			}
+		}
+
+		// false if any index is past the primitive's vertices
+		template <typename T, typename Accessor>
+		bool readIndices(const Accessor& indices, uint32_t base, uint32_t vertexCount, uint32_t* out)
+		{
+			std::atomic<bool> inRange = true;
+			ThreadPool::instance().parallelFor(indices.count, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++) {
+					T index;
+					std::memcpy(&index, indices.data + static_cast<size_t>(i) * indices.stride, sizeof(index));
+					if (index >= vertexCount) {
+						inRange = false;
+					}
+					out[i] = base + static_cast<uint32_t>(index);
+				}
+			}, ELEMENTS_PER_BATCH);
+			return inRange;
+		}
+
+		// glTF is y up with assets facing +z and the engine is y down. Half a turn around x takes one to the other
+		// without mirroring, so windings and tangent handedness carry over unchanged
+		glm::vec3 toEngineAxes(const glm::vec3& v)
+		{
+			return {v.x, -v.y, -v.z};
+		}
+
+		// the same half turn applied to a node's rotation, q' = Rx * q * Rx^-1
+		glm::quat toEngineAxes(const glm::quat& q)
+		{
+			return {q.w, q.x, -q.y, -q.z};
+		}
+
+		// the angles TransformComponent composes as Ry * Rx * Rz back out of a rotation
+		glm::vec3 toTransformRotation(const glm::quat& rotation)
+		{
+			const glm::mat3 m = glm::mat3_cast(glm::normalize(rotation));
+			const float x = std::asin(std::clamp(-m[2][1], -1.f, 1.f));
+			// looking straight up or down leaves y and z turning about the same axis, all of it is put in y
+			if (std::abs(m[2][1]) > 0.9999f) {
+				return {x, std::atan2(-m[0][2], m[0][0]), 0.f};
+			}
+			return {x, std::atan2(m[2][0], m[2][2]), std::atan2(m[0][1], m[1][1])};
+		}
+
+		// translation, rotation and scale of a node matrix, assuming it has no shear
+		void decompose(const glm::mat4& matrix, Node& node)
+		{
+			node.translation = glm::vec3{matrix[3]};
+			glm::mat3 rotation{matrix};
+			node.scale = {glm::length(rotation[0]), glm::length(rotation[1]), glm::length(rotation[2])};
+			if (glm::determinant(rotation) < 0.f) {
+				node.scale.x = -node.scale.x;
+			}
+			for (int i = 0; i < 3; i++) {
+				if (node.scale[i] != 0.f) {
+					rotation[i] /= node.scale[i];
+				}
+			}
+			node.rotation = glm::quat_cast(rotation);
+		}
+	}
+
+	Document::Document(const std::string& path) : path_{path}, file_{path}
+	{
+		IG_PROFILE_FUNCTION();
+		const std::span<const std::byte> bytes = file_.bytes();
+		GlbHeader header{};
+		if (bytes.size() < sizeof(header)) {
+			throw std::runtime_error(path + " is not a glb file");
+		}
+		std::memcpy(&header, bytes.data(), sizeof(header));
+		if (header.magic != GLB_MAGIC) {
+			throw std::runtime_error(path + " is not a glb file, only binary glTF is supported");
+		}
+		if (header.version != GLB_VERSION || header.length > bytes.size()) {
+			throw std::runtime_error(path + " has an unsupported version or is truncated");
+		}
+
+		// the json chunk comes first, the binary chunk is optional and any chunks after it are ignored
+		std::span<const std::byte> json;
+		size_t offset = sizeof(header);
+		for (uint32_t chunk = 0; offset + sizeof(ChunkHeader) <= header.length && chunk < 2; chunk++) {
+			ChunkHeader chunkHeader{};
+			std::memcpy(&chunkHeader, bytes.data() + offset, sizeof(chunkHeader));
+			offset += sizeof(chunkHeader);
+			if (chunkHeader.length > header.length - offset) {
+				throw std::runtime_error(path + " has a truncated chunk");
+			}
+			const std::span<const std::byte> data = bytes.subspan(offset, chunkHeader.length);
+			if (chunk == 0 && chunkHeader.type == CHUNK_JSON) {
+				json = data;
+			} else if (chunk == 1 && chunkHeader.type == CHUNK_BIN) {
+				binary_ = data;
+			}
+			offset += (chunkHeader.length + 3) & ~3u;
+		}
+		if (json.empty()) {
+			throw std::runtime_error(path + " has no json chunk");
+		}
+
+		try {
+			json_ = JsonValue::parse({reinterpret_cast<const char*>(json.data()), json.size()});
+			const std::string& version = getMember(getMember(json_, "asset"), "version").asString();
+			if (!version.starts_with("2.")) {
+				throw std::runtime_error("unsupported glTF version " + version);
+			}
+			if (const JsonValue* required = json_.find("extensionsRequired")) {
+				for (const JsonValue& extension : required->asArray()) {
+					throw std::runtime_error("unsupported required extension " + extension.asString());
+				}
+			}
+			loadNodes();
+		} catch (const std::exception& e) {
+			throw std::runtime_error(path + ": " + e.what());
+		}
+	}
+
+	std::shared_ptr<const Document> Document::open(const std::string& path)
+	{
+		struct CachedDocument
+		{
+			std::string path;
+			std::filesystem::file_time_type writeTime;
+			std::shared_ptr<const Document> document;
+		};
+		static std::mutex mutex;
+		static std::vector<CachedDocument> cache;
+
+		// an edited file is parsed again rather than read through a stale mapping
+		const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(path);
+		{
+			std::lock_guard lock{mutex};
+			const auto cached = std::ranges::find_if(cache, [&](const CachedDocument& entry) {
+				return entry.path == path && entry.writeTime == writeTime;
+			});
+			if (cached != cache.end()) {
+				std::shared_ptr<const Document> document = cached->document;
+				std::rotate(cached, cached + 1, cache.end());
+				return document;
+			}
+		}
+
+		// parsed outside the lock, two threads opening the same file at once only costs a second parse
+		auto document = std::make_shared<const Document>(path);
+		std::lock_guard lock{mutex};
+		std::erase_if(cache, [&path](const CachedDocument& entry) { return entry.path == path; });
+		if (cache.size() == DOCUMENT_CACHE_SIZE) {
+			cache.erase(cache.begin());
+		}
+		cache.push_back({path, writeTime, document});
+		return document;
+	}
+
+	uint32_t Document::getMeshCount() const
+	{
+		const JsonValue* meshes = json_.find("meshes");
+		return meshes ? static_cast<uint32_t>(meshes->asArray().size()) : 0;
+	}
+
+	const JsonValue& Document::getElement(const char* array, uint32_t index) const
+	{
+		const JsonValue* elements = json_.find(array);
+		if (!elements || index >= elements->asArray().size()) {
+			throw std::runtime_error(path_ + ": " + array + " " + std::to_string(index) + " doesn't exist");
+		}
+		return elements->asArray()[index];
+	}
+
+	Document::Accessor Document::getAccessor(uint32_t index) const
+	{
+		const JsonValue& accessor = getElement("accessors", index);
+		if (accessor.find("sparse")) {
+			throw std::runtime_error(path_ + ": sparse accessors are not supported");
+		}
+		if (!accessor.find("bufferView")) {
+			throw std::runtime_error(path_ + ": accessors without a buffer view are not supported");
+		}
+
+		const JsonValue& view = getElement("bufferViews", toIndex(getMember(accessor, "bufferView")));
+		const JsonValue& buffer = getElement("buffers", toIndex(getMember(view, "buffer")));
+		if (buffer.find("uri")) {
+			throw std::runtime_error(path_ + ": only the glb binary chunk can be read, external and embedded buffers are not supported");
+		}
+
+		Accessor result{};
+		result.componentType = toIndex(getMember(accessor, "componentType"));
+		result.componentCount = getComponentCount(getMember(accessor, "type").asString());
+		result.count = toIndex(getMember(accessor, "count"));
+		const JsonValue* normalized = accessor.find("normalized");
+		result.normalized = normalized && normalized->asBool();
+
+		const uint64_t elementSize = static_cast<uint64_t>(getComponentSize(result.componentType)) * result.componentCount;
+		result.stride = getIndex(view, "byteStride", static_cast<uint32_t>(elementSize));
+		if (result.stride < elementSize) {
+			throw std::runtime_error(path_ + ": buffer view stride is smaller than its elements");
+		}
+
+		// everything read through the accessor has to be inside the view, and the view inside the binary chunk
+		const uint64_t viewOffset = getIndex(view, "byteOffset", 0);
+		const uint64_t viewLength = toIndex(getMember(view, "byteLength"));
+		const uint64_t accessorOffset = getIndex(accessor, "byteOffset", 0);
+		const uint64_t accessorEnd = result.count == 0 ? accessorOffset : accessorOffset + static_cast<uint64_t>(result.stride) * (result.count - 1) + elementSize;
+		if (viewOffset + viewLength > binary_.size() || accessorEnd > viewLength) {
+			throw std::runtime_error(path_ + ": accessor " + std::to_string(index) + " is out of bounds");
+		}
+		result.data = binary_.data() + viewOffset + accessorOffset;
+		return result;
+	}
+
+	void Document::loadMesh(uint32_t mesh, BveModel::Builder& builder) const
+	{
+		IG_PROFILE_FUNCTION();
+		const JsonValue& primitives = getMember(getElement("meshes", mesh), "primitives");
+		bool warnedMode = false;
+		for (const JsonValue& primitive : primitives.asArray()) {
+			if (getIndex(primitive, "mode", MODE_TRIANGLES) != MODE_TRIANGLES) {
+				if (!warnedMode) {
+					LOG_WARN("{} mesh {} has primitives that aren't triangle lists, they are skipped", path_, mesh);
+					warnedMode = true;
+				}
+				continue;
+			}
+
+			const JsonValue& attributes = getMember(primitive, "attributes");
+			const Accessor positions = getAccessor(toIndex(getMember(attributes, "POSITION")));
+			if (positions.componentCount != 3) {
+				throw std::runtime_error(path_ + ": positions must have three components");
+			}
+
+			const auto base = static_cast<uint32_t>(builder.vertices.size());
+			const uint32_t vertexCount = positions.count;
+			// vertices without colors are white, like obj vertices without them
+			builder.vertices.resize(base + vertexCount, BveModel::Vertex{{}, glm::vec3{1.f}, {}, {}});
+			BveModel::Vertex* const vertices = builder.vertices.data() + base;
+
+			forEachElement(positions.data, vertexCount, positions.stride, positions.componentType, 3, positions.normalized, [vertices](uint32_t i, const float* v) {
+				vertices[i].position = toEngineAxes({v[0], v[1], v[2]});
+			});
+
+			// optional attributes have to cover every vertex to be used
+			auto findAttribute = [&](const char* name, uint32_t minComponents, uint32_t maxComponents) -> std::optional<Accessor> {
+				const JsonValue* index = attributes.find(name);
+				if (!index) {
+					return std::nullopt;
+				}
+				const Accessor accessor = getAccessor(toIndex(*index));
+				if (accessor.count != vertexCount || accessor.componentCount < minComponents || accessor.componentCount > maxComponents) {
+					throw std::runtime_error(path_ + ": attribute " + name + " doesn't match the positions");
+				}
+				return accessor;
+			};
+
+			if (const std::optional<Accessor> normals = findAttribute("NORMAL", 3, 3)) {
+				forEachElement(normals->data, vertexCount, normals->stride, normals->componentType, 3, normals->normalized, [vertices](uint32_t i, const float* v) {
+					vertices[i].normal = toEngineAxes({v[0], v[1], v[2]});
+				});
+			}
+			if (const std::optional<Accessor> tangents = findAttribute("TANGENT", 4, 4)) {
+				forEachElement(tangents->data, vertexCount, tangents->stride, tangents->componentType, 4, tangents->normalized, [vertices](uint32_t i, const float* v) {
+					vertices[i].tangent = {toEngineAxes({v[0], v[1], v[2]}), v[3] < 0.f ? -1.f : 1.f};
+				});
+			}
+			if (const std::optional<Accessor> uvs = findAttribute("TEXCOORD_0", 2, 2)) {
+				forEachElement(uvs->data, vertexCount, uvs->stride, uvs->componentType, 2, uvs->normalized, [vertices](uint32_t i, const float* v) {
+					vertices[i].uv = {v[0], v[1]};
+				});
+			}
+			if (const std::optional<Accessor> colors = findAttribute("COLOR_0", 3, 4)) {
+				// alpha is read along with the rest but has nowhere to go
+				forEachElement(colors->data, vertexCount, colors->stride, colors->componentType, colors->componentCount, colors->normalized, [vertices](uint32_t i, const float* v) {
+					vertices[i].color = {v[0], v[1], v[2]};
+				});
+			}
+
+			const size_t firstIndex = builder.indices.size();
+			if (const JsonValue* indicesIndex = primitive.find("indices")) {
+				const Accessor indices = getAccessor(toIndex(*indicesIndex));
+				if (indices.componentCount != 1 || indices.normalized
+					|| (indices.componentType != UNSIGNED_BYTE && indices.componentType != UNSIGNED_SHORT && indices.componentType != UNSIGNED_INT)) {
+					throw std::runtime_error(path_ + ": indices must be unsigned integer scalars");
+				}
+				builder.indices.resize(firstIndex + indices.count);
+				uint32_t* const out = builder.indices.data() + firstIndex;
+				const bool inRange = indices.componentType == UNSIGNED_BYTE ? readIndices<uint8_t>(indices, base, vertexCount, out)
+					: indices.componentType == UNSIGNED_SHORT ? readIndices<uint16_t>(indices, base, vertexCount, out)
+					: readIndices<uint32_t>(indices, base, vertexCount, out);
+				if (!inRange) {
+					throw std::runtime_error(path_ + ": index out of range");
+				}
+			} else {
+				builder.indices.resize(firstIndex + vertexCount);
+				for (uint32_t i = 0; i < vertexCount; i++) {
+					builder.indices[firstIndex + i] = base + i;
+				}
+			}
+			if ((builder.indices.size() - firstIndex) % 3 != 0) {
+				throw std::runtime_error(path_ + ": triangle list with an index count that isn't a multiple of three");
+			}
+		}
+
+		if (builder.indices.empty()) {
+			throw std::runtime_error(path_ + " mesh " + std::to_string(mesh) + " has no triangles");
+		}
+	}
+
+	uint64_t Document::hashMesh(uint32_t mesh) const
+	{
+		IG_PROFILE_FUNCTION();
+		// the description of every accessor read is hashed along with its bytes, the bytes alone don't say how they are read
+		uint64_t hash = 0;
+		auto hashAccessor = [this, &hash](const JsonValue* index) {
+			if (!index) {
+				hash = hashBytes(&hash, sizeof(hash), hash);
+				return;
+			}
+			const Accessor accessor = getAccessor(toIndex(*index));
+			const uint32_t description[] = {accessor.count, accessor.stride, accessor.componentType, accessor.componentCount, accessor.normalized};
+			hash = hashBytes(description, sizeof(description), hash);
+			if (accessor.count > 0) {
+				const size_t size = static_cast<size_t>(accessor.stride) * (accessor.count - 1) + getComponentSize(accessor.componentType) * accessor.componentCount;
+				hash = hashBytes(accessor.data, size, hash);
+			}
+		};
+
+		for (const JsonValue& primitive : getMember(getElement("meshes", mesh), "primitives").asArray()) {
+			const uint32_t mode = getIndex(primitive, "mode", MODE_TRIANGLES);
+			hash = hashBytes(&mode, sizeof(mode), hash);
+			const JsonValue& attributes = getMember(primitive, "attributes");
+			for (const char* attribute : {"POSITION", "NORMAL", "TANGENT", "TEXCOORD_0", "COLOR_0"}) {
+				hashAccessor(attributes.find(attribute));
+			}
+			hashAccessor(primitive.find("indices"));
+		}
+		return hash;
+	}
+
+	void Document::loadNodes()
+	{
+		const JsonValue* nodes = json_.find("nodes");
+		if (!nodes) {
+			return;
+		}
+		const std::vector<JsonValue>& elements = nodes->asArray();
+
+		// the default scene lists its roots, without scenes every node that isn't a child is one
+		std::vector<uint32_t> roots;
+		if (const JsonValue* scenes = json_.find("scenes"); scenes && !scenes->asArray().empty()) {
+			const JsonValue& scene = getElement("scenes", getIndex(json_, "scene", 0));
+			if (const JsonValue* sceneNodes = scene.find("nodes")) {
+				for (const JsonValue& root : sceneNodes->asArray()) {
+					roots.push_back(toIndex(root));
+				}
+			}
+		} else {
+			std::vector<bool> isChild(elements.size());
+			for (const JsonValue& node : elements) {
+				if (const JsonValue* children = node.find("children")) {
+					for (const JsonValue& child : children->asArray()) {
+						const uint32_t index = toIndex(child);
+						if (index < isChild.size()) {
+							isChild[index] = true;
+						}
+					}
+				}
+			}
+			for (uint32_t i = 0; i < elements.size(); i++) {
+				if (!isChild[i]) {
+					roots.push_back(i);
+				}
+			}
+		}
+
+		// depth first, so every node is added after its parent. Nodes reached twice would make the hierarchy a graph
+		std::vector<bool> visited(elements.size());
+		std::vector<std::pair<uint32_t, int32_t>> stack;
+		for (auto root = roots.rbegin(); root != roots.rend(); ++root) {
+			stack.emplace_back(*root, -1);
+		}
+		while (!stack.empty()) {
+			const auto [index, parent] = stack.back();
+			stack.pop_back();
+			if (index >= elements.size() || visited[index]) {
+				throw std::runtime_error("node " + std::to_string(index) + " doesn't exist or has more than one parent");
+			}
+			visited[index] = true;
+
+			const JsonValue& element = elements[index];
+			Node& node = nodes_.emplace_back();
+			node.parent = parent;
+			if (const JsonValue* name = element.find("name")) {
+				node.name = name->asString();
+			}
+			if (const JsonValue* mesh = element.find("mesh")) {
+				node.mesh = static_cast<int32_t>(toIndex(*mesh));
+				if (static_cast<uint32_t>(node.mesh) >= getMeshCount()) {
+					throw std::runtime_error("node " + std::to_string(index) + " refers to a missing mesh");
+				}
+			}
+
+			if (element.find("matrix")) {
+				glm::mat4 matrix{1.f};
+				readFloats<16>(element, "matrix", &matrix[0][0]);
+				decompose(matrix, node);
+			} else {
+				readFloats<3>(element, "translation", &node.translation.x);
+				float rotation[4] = {0.f, 0.f, 0.f, 1.f};
+				readFloats<4>(element, "rotation", rotation);
+				node.rotation = glm::quat{rotation[3], rotation[0], rotation[1], rotation[2]};
+				readFloats<3>(element, "scale", &node.scale.x);
+			}
+			// scales are along the node's own axes, which the half turn maps onto themselves
+			node.translation = toEngineAxes(node.translation);
+			node.rotation = toEngineAxes(node.rotation);
+
+			if (const JsonValue* children = element.find("children")) {
+				const std::vector<JsonValue>& childIndices = children->asArray();
+				const auto nodeIndex = static_cast<int32_t>(nodes_.size() - 1);
+				for (auto child = childIndices.rbegin(); child != childIndices.rend(); ++child) {
+					stack.emplace_back(toIndex(*child), nodeIndex);
+				}
+			}
+		}
+	}
+
+	std::string getMeshPath(const std::string& filepath, uint32_t mesh)
+	{
+		return filepath + "#" + std::to_string(mesh);
+	}
+
+	uint32_t parseMeshIndex(std::string_view fragment)
+	{
+		if (fragment.empty()) {
+			return 0;
+		}
+		uint32_t mesh = 0;
+		const auto [end, error] = std::from_chars(fragment.data(), fragment.data() + fragment.size(), mesh);
+		if (error != std::errc{} || end != fragment.data() + fragment.size()) {
+			throw std::runtime_error("invalid mesh index " + std::string{fragment});
+		}
+		return mesh;
+	}
+
+	std::vector<Entity> loadScene(EntityManager& entityManager, AssetManager& assetManager, const std::string& filepath, BveModel::VertexFormat vertexFormat)
+	{
+		IG_PROFILE_FUNCTION();
+		const std::shared_ptr<const Document> document = Document::open(filepath);
+		const std::string stem = std::filesystem::path{filepath}.stem().string();
+
+		std::vector<Entity> entities;
+		entities.reserve(document->getNodes().size());
+		for (const Node& node : document->getNodes()) {
+			const Entity entity = entityManager.createEntity(node.name.empty() ? stem + " node " + std::to_string(entities.size()) : node.name);
+			entityManager.addComponent<TransformComponent>(entity, TransformComponent{node.translation, node.scale, toTransformRotation(node.rotation)});
+			if (node.parent >= 0) {
+				entityManager.addComponent<ParentComponent>(entity, ParentComponent{entities[node.parent]});
+			}
+			if (node.mesh >= 0) {
+				const MeshHandle mesh = assetManager.loadMesh(getMeshPath(filepath, static_cast<uint32_t>(node.mesh)), vertexFormat);
+				entityManager.addComponent<RenderComponent>(entity, RenderComponent{mesh, glm::vec3{}});
+			}
+			entities.push_back(entity);
+		}
+
+		LOG_INFO("loaded {} nodes from {}", entities.size(), filepath);
+		return entities;
+	}
+}
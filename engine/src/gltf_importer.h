@@ -0,0 +1,102 @@
+#pragma once
+
+#include "bve_model.h"
+#include "entity_manager.h"
+#include "core/json.h"
+#include "core/mapped_file.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bve
+{
+	class AssetManager;
+
+	// Binary glTF 2.0 (.glb) import. The file is mapped and every accessor is converted straight out of the binary
+	// chunk into builder vertices, without copying buffers first. A mesh is loaded like any other model through a
+	// path naming it within the file, see getMeshPath, and the node hierarchy becomes entities with loadScene.
+	// Meshes and node transforms are turned from glTF's y up axes into the engine's y down ones as they are read.
+	// Only triangles stored in the file's own binary chunk are read: external and embedded buffers, sparse
+	// accessors and required extensions such as mesh compression are rejected.
+	namespace gltf
+	{
+		struct Node
+		{
+			std::string name;
+			int32_t parent = -1; // index into getNodes, after which this node comes
+			int32_t mesh = -1;
+			glm::vec3 translation{0.f};
+			glm::quat rotation{1.f, 0.f, 0.f, 0.f};
+			glm::vec3 scale{1.f};
+		};
+
+		class Document
+		{
+		public:
+			// throws if the file can't be read or isn't a glb this importer supports
+			explicit Document(const std::string& path);
+
+			Document(const Document&) = delete;
+			Document& operator=(const Document&) = delete;
+			Document(const Document&&) = delete;
+			Document& operator=(const Document&&) = delete;
+
+			// shares the document with other loads of the same unchanged file. Every mesh of a scene is imported
+			// separately, so the last few documents are kept instead of parsing the json again for each of them
+			static std::shared_ptr<const Document> open(const std::string& path);
+
+			uint32_t getMeshCount() const;
+			// the default scene, parents come before their children
+			const std::vector<Node>& getNodes() const { return nodes_; }
+
+			// appends every triangle primitive of the mesh to the builder's vertices and indices
+			void loadMesh(uint32_t mesh, BveModel::Builder& builder) const;
+			// hash of the mesh's primitives and the data they read, the same mesh hashes the same in any file
+			uint64_t hashMesh(uint32_t mesh) const;
+
+		private:
+			// the elements of an accessor in the mapped file, stride apart
+			struct Accessor
+			{
+				const std::byte* data;
+				uint32_t count;
+				uint32_t stride;
+				uint32_t componentType;
+				uint32_t componentCount;
+				bool normalized;
+			};
+
+			const JsonValue& getElement(const char* array, uint32_t index) const;
+			Accessor getAccessor(uint32_t index) const;
+			void loadNodes();
+
+			std::string path_;
+			MappedFile file_;
+			JsonValue json_;
+			std::span<const std::byte> binary_;
+			std::vector<Node> nodes_;
+		};
+
+		// "scene.glb#2" is the third mesh of scene.glb, a glb path without a mesh is its first
+		std::string getMeshPath(const std::string& filepath, uint32_t mesh);
+		// the mesh a fragment of such a path names, throws if it isn't an index
+		uint32_t parseMeshIndex(std::string_view fragment);
+
+		// an entity for every node of the default scene with its local TransformComponent, a ParentComponent unless it
+		// is a root and a RenderComponent loading its mesh through assetManager. Returns the entities in node order
+		std::vector<Entity> loadScene(
+			EntityManager& entityManager,
+			AssetManager& assetManager,
+			const std::string& filepath,
+			BveModel::VertexFormat vertexFormat = BveModel::VertexFormat::PACKED);
+	}
+}
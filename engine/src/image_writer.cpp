@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "image_writer.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace bve
+{
+	namespace
+	{
+		uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+		{
+			static const std::array<uint32_t, 256> table = [] {
+				std::array<uint32_t, 256> entries{};
+				for (uint32_t i = 0; i < 256; i++) {
+					uint32_t c = i;
+					for (int k = 0; k < 8; k++) {
+						c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					}
+					entries[i] = c;
+				}
+				return entries;
+			}();
+
+			crc = ~crc;
+			for (size_t i = 0; i < size; i++) {
+				crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+			}
+			return ~crc;
+		}
+
+		void appendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+		{
+			out.push_back(static_cast<uint8_t>(value >> 24));
+			out.push_back(static_cast<uint8_t>(value >> 16));
+			out.push_back(static_cast<uint8_t>(value >> 8));
+			out.push_back(static_cast<uint8_t>(value));
+		}
+
+		void appendChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+		{
+			appendBigEndian(out, static_cast<uint32_t>(data.size()));
+			const size_t typeOffset = out.size();
+			out.insert(out.end(), type, type + 4);
+			out.insert(out.end(), data.begin(), data.end());
+			appendBigEndian(out, crc32(&out[typeOffset], out.size() - typeOffset));
+		}
+	}
+
+	void writePng(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba)
+	{
+		assert(rgba.size() == static_cast<size_t>(width) * height * 4 && "Pixel data does not match the image size");
+
+		// every row starts with filter type 0, then the image goes into stored deflate blocks. Golden images
+		// are compared by pixel, so compression isn't worth a dependency
+		const size_t rowSize = static_cast<size_t>(width) * 4;
+		std::vector<uint8_t> raw;
+		raw.reserve((rowSize + 1) * height);
+		for (uint32_t y = 0; y < height; y++) {
+			raw.push_back(0);
+			raw.insert(raw.end(), rgba.begin() + y * rowSize, rgba.begin() + (y + 1) * rowSize);
+		}
+
+		std::vector<uint8_t> zlib{0x78, 0x01};
+		constexpr size_t MAX_STORED_BLOCK = 65535;
+		for (size_t offset = 0; offset < raw.size() || offset == 0; offset += MAX_STORED_BLOCK) {
+			const size_t blockSize = std::min(MAX_STORED_BLOCK, raw.size() - offset);
+			zlib.push_back(offset + blockSize >= raw.size() ? 1 : 0);
+			zlib.push_back(static_cast<uint8_t>(blockSize));
+			zlib.push_back(static_cast<uint8_t>(blockSize >> 8));
+			zlib.push_back(static_cast<uint8_t>(~blockSize));
+			zlib.push_back(static_cast<uint8_t>(~blockSize >> 8));
+			zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+			if (raw.empty()) {
+				break;
+			}
+		}
+
+		uint32_t adlerA = 1;
+		uint32_t adlerB = 0;
+		for (uint8_t byte : raw) {
+			adlerA = (adlerA + byte) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+		appendBigEndian(zlib, (adlerB << 16) | adlerA);
+
+		std::vector<uint8_t> header;
+		appendBigEndian(header, width);
+		appendBigEndian(header, height);
+		header.insert(header.end(), {8, 6, 0, 0, 0}); // 8 bits per channel, rgba, deflate, no filter, no interlace
+
+		std::vector<uint8_t> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+		appendChunk(png, "IHDR", header);
+		appendChunk(png, "IDAT", zlib);
+		appendChunk(png, "IEND", {});
+
+		std::ofstream file{path, std::ios::binary};
+		if (!file) {
+			throw std::runtime_error("failed to open image file: " + path);
+		}
+		file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+		if (!file) {
+			throw std::runtime_error("failed to write image file: " + path);
+		}
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bve
+{
+	// writes rgba8 pixels, rows top to bottom, as an uncompressed png. Throws if the file can't be written
+	void writePng(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba);
+}
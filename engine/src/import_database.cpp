@@ -0,0 +1,400 @@
+#include "pch.h"
+#include "import_database.h"
+#include "bve_utils.h"
+#include "obj_parser.h"
+#include "core/mapped_file.h"
+#include "core/profiler.h"
+#include "core/thread_pool.h"
+#include "log.h"
+
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <type_traits>
+
+namespace bve
+{
+	namespace
+	{
+		constexpr uint32_t MAGIC = 0x42444749; // "IGDB"
+
+		// little endian, the records follow as cache path, key, cache stamp and dependencies, strings prefixed by
+		// their length
+		struct FileHeader
+		{
+			uint32_t magic;
+			uint32_t formatVersion;
+			uint32_t recordCount;
+			uint32_t reserved;
+		};
+
+		static_assert(std::is_trivially_copyable_v<FileHeader> && sizeof(FileHeader) == 16);
+
+		std::string normalizePath(const std::string& path)
+		{
+			return std::filesystem::path{path}.lexically_normal().generic_string();
+		}
+
+		class RecordWriter
+		{
+		public:
+			template <typename T>
+			void write(const T& value)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				const auto* bytes = reinterpret_cast<const std::byte*>(&value);
+				data_.insert(data_.end(), bytes, bytes + sizeof(T));
+			}
+
+			void writeString(const std::string& value)
+			{
+				write(static_cast<uint32_t>(value.size()));
+				const auto* bytes = reinterpret_cast<const std::byte*>(value.data());
+				data_.insert(data_.end(), bytes, bytes + value.size());
+			}
+
+			void writeStamp(const ImportDatabase::FileStamp& stamp)
+			{
+				write(static_cast<uint32_t>(stamp.exists));
+				write(stamp.size);
+				write(stamp.writeTime);
+			}
+
+			const std::vector<std::byte>& getData() const { return data_; }
+
+		private:
+			std::vector<std::byte> data_;
+		};
+
+		// every read is checked against the end of the file, a damaged database throws rather than reading past it
+		class RecordReader
+		{
+		public:
+			explicit RecordReader(std::span<const std::byte> data) : data_{data} {}
+
+			template <typename T>
+			T read()
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				T value;
+				std::memcpy(&value, take(sizeof(T)), sizeof(T));
+				return value;
+			}
+
+			std::string readString()
+			{
+				const auto size = read<uint32_t>();
+				const auto* bytes = reinterpret_cast<const char*>(take(size));
+				return {bytes, size};
+			}
+
+			ImportDatabase::FileStamp readStamp()
+			{
+				ImportDatabase::FileStamp stamp{};
+				stamp.exists = read<uint32_t>() != 0;
+				stamp.size = read<uint64_t>();
+				stamp.writeTime = read<int64_t>();
+				return stamp;
+			}
+
+			bool atEnd() const { return position_ == data_.size(); }
+
+		private:
+			const std::byte* take(size_t size)
+			{
+				if (size > data_.size() - position_) {
+					throw std::runtime_error("truncated");
+				}
+				const std::byte* bytes = data_.data() + position_;
+				position_ += size;
+				return bytes;
+			}
+
+			std::span<const std::byte> data_;
+			size_t position_ = 0;
+		};
+	}
+
+	ImportDatabase::ImportDatabase(const std::string& path) : path_{path}
+	{
+		load();
+	}
+
+	ImportDatabase::FileStamp ImportDatabase::getStamp(const std::string& path)
+	{
+		std::error_code error;
+		if (!std::filesystem::is_regular_file(path, error)) {
+			return {};
+		}
+		const uint64_t size = std::filesystem::file_size(path, error);
+		if (error) {
+			return {};
+		}
+		const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(path, error);
+		if (error) {
+			return {};
+		}
+		return {true, size, static_cast<int64_t>(writeTime.time_since_epoch().count())};
+	}
+
+	void ImportDatabase::load()
+	{
+		IG_PROFILE_FUNCTION();
+		std::error_code error;
+		if (!std::filesystem::exists(path_, error)) {
+			return;
+		}
+
+		try {
+			const MappedFile file{path_};
+			RecordReader reader{file.bytes()};
+			const auto header = reader.read<FileHeader>();
+			if (header.magic != MAGIC) {
+				throw std::runtime_error("not an import database");
+			}
+			// written by another version, everything is checked again and the file rewritten
+			if (header.formatVersion != FORMAT_VERSION) {
+				modified_ = true;
+				return;
+			}
+
+			for (uint32_t i = 0; i < header.recordCount; i++) {
+				std::string cachePath = reader.readString();
+				Record record{};
+				record.key.sourceHash = reader.read<uint64_t>();
+				record.key.importerVersion = reader.read<uint32_t>();
+				record.key.options = reader.read<uint32_t>();
+				record.cacheStamp = reader.readStamp();
+				const auto dependencyCount = reader.read<uint32_t>();
+				for (uint32_t j = 0; j < dependencyCount; j++) {
+					Dependency& dependency = record.dependencies.emplace_back();
+					dependency.path = reader.readString();
+					dependency.stamp = reader.readStamp();
+					dependency.hash = reader.read<uint64_t>();
+				}
+				records_.insert_or_assign(std::move(cachePath), std::move(record));
+			}
+			if (!reader.atEnd()) {
+				throw std::runtime_error("trailing data");
+			}
+		} catch (const std::exception& e) {
+			LOG_WARN("ignoring malformed import database {}: {}", path_, e.what());
+			records_.clear();
+			modified_ = true;
+		}
+	}
+
+	bool ImportDatabase::save()
+	{
+		IG_PROFILE_FUNCTION();
+		std::lock_guard lock{mutex_};
+		if (!modified_) {
+			return true;
+		}
+
+		RecordWriter writer{};
+		writer.write(FileHeader{MAGIC, FORMAT_VERSION, static_cast<uint32_t>(records_.size()), 0});
+		for (const auto& [cachePath, record] : records_) {
+			writer.writeString(cachePath);
+			writer.write(record.key.sourceHash);
+			writer.write(record.key.importerVersion);
+			writer.write(record.key.options);
+			writer.writeStamp(record.cacheStamp);
+			writer.write(static_cast<uint32_t>(record.dependencies.size()));
+			for (const Dependency& dependency : record.dependencies) {
+				writer.writeString(dependency.path);
+				writer.writeStamp(dependency.stamp);
+				writer.write(dependency.hash);
+			}
+		}
+
+		const std::vector<std::byte>& data = writer.getData();
+		const std::string temporaryPath = path_ + ".tmp";
+		{
+			std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+			file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+			if (!file) {
+				LOG_WARN("failed to write import database {}", temporaryPath);
+				file.close();
+				std::error_code error;
+				std::filesystem::remove(temporaryPath, error);
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, path_, error);
+		if (error) {
+			LOG_WARN("failed to replace import database {}: {}", path_, error.message());
+			std::filesystem::remove(temporaryPath, error);
+			return false;
+		}
+		modified_ = false;
+		return true;
+	}
+
+	std::optional<uint64_t> ImportDatabase::findSourceHash(const std::string& sourcePath, const BveModel::Builder& builder)
+	{
+		IG_PROFILE_FUNCTION();
+		const std::string cachePath = mesh_cache::getCachePath(normalizePath(sourcePath), builder.vertexFormat);
+		Record record{};
+		{
+			std::lock_guard lock{mutex_};
+			const auto found = records_.find(cachePath);
+			if (found == records_.end()) {
+				return std::nullopt;
+			}
+			record = found->second;
+		}
+
+		// the files are checked without holding the lock, they may need hashing
+		const mesh_cache::Key key = mesh_cache::makeKey(record.key.sourceHash, builder);
+		if (key.importerVersion != record.key.importerVersion || key.options != record.key.options || getStamp(cachePath) != record.cacheStamp) {
+			return std::nullopt;
+		}
+
+		bool restamped = false;
+		for (Dependency& dependency : record.dependencies) {
+			const FileStamp stamp = getStamp(std::string{splitAssetPath(dependency.path).first});
+			if (stamp == dependency.stamp) {
+				continue;
+			}
+			if (!stamp.exists || !dependency.stamp.exists) {
+				return std::nullopt;
+			}
+			// touched but maybe not edited, as after a checkout, so the contents decide
+			try {
+				if (mesh_cache::hashSource(dependency.path) != dependency.hash) {
+					return std::nullopt;
+				}
+			} catch (const std::exception&) {
+				return std::nullopt;
+			}
+			dependency.stamp = stamp;
+			restamped = true;
+		}
+
+		// the new stamps save hashing the files again next time
+		if (restamped) {
+			std::lock_guard lock{mutex_};
+			const auto found = records_.find(cachePath);
+			if (found != records_.end() && found->second.cacheStamp == record.cacheStamp) {
+				found->second = std::move(record);
+				modified_ = true;
+			}
+		}
+		return key.sourceHash;
+	}
+
+	bool ImportDatabase::isRecorded(const std::string& cachePath)
+	{
+		std::lock_guard lock{mutex_};
+		return records_.contains(normalizePath(cachePath));
+	}
+
+	std::vector<ImportDatabase::Dependency> ImportDatabase::findDependencies(const std::string& sourcePath) const
+	{
+		IG_PROFILE_FUNCTION();
+		const std::string normalized = normalizePath(sourcePath);
+		const std::string file{splitAssetPath(normalized).first};
+
+		std::vector<Dependency> dependencies;
+		dependencies.push_back({normalized, getStamp(file)});
+		if (!dependencies.front().stamp.exists) {
+			throw std::runtime_error(file + " doesn't exist");
+		}
+
+		// materials aren't imported yet, but an OBJ is reimported with them so caches never lag behind its library
+		if (std::filesystem::path{file}.extension() == ".obj") {
+			const MappedFile source{file};
+			const std::filesystem::path directory = std::filesystem::path{file}.parent_path();
+			for (const std::string& library : obj_parser::findMaterialLibraries({reinterpret_cast<const char*>(source.data()), source.size()})) {
+				Dependency& dependency = dependencies.emplace_back();
+				dependency.path = (directory / library).lexically_normal().generic_string();
+				dependency.stamp = getStamp(dependency.path);
+			}
+		}
+
+		// a missing library is recorded too, creating it makes the source stale
+		for (size_t i = 1; i < dependencies.size(); i++) {
+			if (dependencies[i].stamp.exists) {
+				dependencies[i].hash = mesh_cache::hashSource(dependencies[i].path);
+			}
+		}
+		return dependencies;
+	}
+
+	void ImportDatabase::record(const std::string& sourcePath, BveModel::VertexFormat vertexFormat, const mesh_cache::Key& key, std::vector<Dependency> dependencies)
+	{
+		assert(!dependencies.empty() && "Dependencies have to start with the source");
+		const std::string cachePath = mesh_cache::getCachePath(normalizePath(sourcePath), vertexFormat);
+		// a cache that failed to write is imported again next time
+		const FileStamp cacheStamp = getStamp(cachePath);
+		if (!cacheStamp.exists) {
+			return;
+		}
+
+		dependencies.front().hash = key.sourceHash;
+		std::lock_guard lock{mutex_};
+		records_.insert_or_assign(cachePath, Record{key, cacheStamp, std::move(dependencies)});
+		modified_ = true;
+	}
+
+	ImportDatabase::ImportSummary ImportDatabase::importStale(std::span<const std::string> sourcePaths, std::span<const BveModel::VertexFormat> vertexFormats)
+	{
+		IG_PROFILE_FUNCTION();
+		std::atomic<uint32_t> imported = 0;
+		std::atomic<uint32_t> current = 0;
+		std::atomic<uint32_t> failed = 0;
+
+		auto importSource = [&](const std::string& sourcePath, BveModel::VertexFormat vertexFormat) {
+			try {
+				BveModel::Builder builder{};
+				builder.vertexFormat = vertexFormat;
+				if (findSourceHash(sourcePath, builder)) {
+					current++;
+					return;
+				}
+
+				std::vector<Dependency> dependencies = findDependencies(sourcePath);
+				const mesh_cache::Key key = mesh_cache::makeKey(sourcePath, builder);
+				const std::string cachePath = mesh_cache::getCachePath(sourcePath, vertexFormat);
+				// a cache from before the database only needs recording if it is current, but one with a stale record
+				// is imported again even if its key matches, since the key doesn't cover the other dependencies
+				if (!isRecorded(cachePath) && mesh_cache::read(cachePath, key)) {
+					current++;
+				} else {
+					builder.loadModel(sourcePath);
+					if (!mesh_cache::write(cachePath, key, builder.pack().data)) {
+						failed++;
+						return;
+					}
+					imported++;
+				}
+				record(sourcePath, vertexFormat, key, std::move(dependencies));
+			} catch (const std::exception& e) {
+				LOG_ERROR("failed to import {}: {}", sourcePath, e.what());
+				failed++;
+			}
+		};
+
+		// one task per cache, each import spreads its own parsing across the pool as well
+		ThreadPool& pool = ThreadPool::instance();
+		std::vector<std::future<void>> imports;
+		imports.reserve(sourcePaths.size() * vertexFormats.size());
+		for (const std::string& sourcePath : sourcePaths) {
+			for (const BveModel::VertexFormat vertexFormat : vertexFormats) {
+				imports.push_back(pool.submit([&importSource, &sourcePath, vertexFormat]() { importSource(sourcePath, vertexFormat); }));
+			}
+		}
+		for (std::future<void>& import : imports) {
+			pool.wait(import);
+		}
+
+		return {imported, current, failed};
+	}
+}
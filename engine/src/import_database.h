@@ -0,0 +1,93 @@
+#pragma once
+
+#include "bve_model.h"
+#include "mesh_cache.h"
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bve
+{
+	// Remembers what every mesh cache was imported from, so finding out whether it is still current takes a stat of
+	// each file involved rather than reading them. A record holds the cache's key and the size, write time and hash of
+	// the source and of every file it depends on, such as the material libraries an OBJ names. A file whose stamp
+	// changed is hashed again, and only a different hash makes the cache stale, so touching a file costs a hash and
+	// not an import. The database is a single file written through a temporary like the caches themselves.
+	class ImportDatabase
+	{
+	public:
+		static constexpr uint32_t FORMAT_VERSION = 1;
+
+		struct FileStamp
+		{
+			bool exists = false;
+			uint64_t size = 0;
+			int64_t writeTime = 0;
+
+			bool operator==(const FileStamp&) const = default;
+		};
+
+		// path is an asset path, for a glb mesh hash covers just that mesh like mesh_cache::hashSource
+		struct Dependency
+		{
+			std::string path;
+			FileStamp stamp;
+			uint64_t hash = 0;
+		};
+
+		struct ImportSummary
+		{
+			uint32_t imported = 0;
+			uint32_t current = 0;
+			uint32_t failed = 0;
+		};
+
+		// starts empty if the file doesn't exist yet, a file that can't be read is logged and replaced on save
+		explicit ImportDatabase(const std::string& path);
+
+		ImportDatabase(const ImportDatabase&) = delete;
+		ImportDatabase& operator=(const ImportDatabase&) = delete;
+		ImportDatabase(const ImportDatabase&&) = delete;
+		ImportDatabase& operator=(const ImportDatabase&&) = delete;
+
+		static FileStamp getStamp(const std::string& path);
+
+		// the source hash of the cache the builder's settings would import sourcePath to, if the cache and everything
+		// it was imported from are unchanged. Empty if it has to be imported
+		std::optional<uint64_t> findSourceHash(const std::string& sourcePath, const BveModel::Builder& builder);
+
+		// the source of sourcePath first and then the files it depends on, stamped before they are read so an edit
+		// while importing leaves the record stale. Hashes all but the source, whose hash comes with the key
+		std::vector<Dependency> findDependencies(const std::string& sourcePath) const;
+		// remembers the cache just written for sourcePath, dependencies as found before importing it
+		void record(const std::string& sourcePath, BveModel::VertexFormat vertexFormat, const mesh_cache::Key& key, std::vector<Dependency> dependencies);
+
+		// imports every source whose caches are missing or stale in parallel, writing the caches next to the sources
+		ImportSummary importStale(std::span<const std::string> sourcePaths, std::span<const BveModel::VertexFormat> vertexFormats);
+
+		// writes the database if anything was recorded since it was read. False and logged if it can't be written
+		bool save();
+		const std::string& getPath() const { return path_; }
+
+	private:
+		struct Record
+		{
+			mesh_cache::Key key;
+			FileStamp cacheStamp;
+			std::vector<Dependency> dependencies;
+		};
+
+		void load();
+		bool isRecorded(const std::string& cachePath);
+
+		std::string path_;
+		std::mutex mutex_;
+		std::unordered_map<std::string, Record> records_; // by cache path
+		bool modified_ = false;
+	};
+}
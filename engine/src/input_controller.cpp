@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "input_controller.h"
 #include "components/components.h"
+#include "core/profiler.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -15,6 +16,7 @@ namespace bve
 
 	void InputController::update(GLFWwindow* window)
 	{
+		IG_PROFILE_FUNCTION();
 		for (auto&& [entity, _] : entityManager_.view<SelectedTag>()) {
 			if (!entityManager_.hasComponent<TransformComponent>(entity)) {
 				continue;
@@ -1,24 +1,62 @@
 #include "master_renderer.h"
 
 #include "components/components.h"
+#include "core/profiler.h"
+#include "core/thread_pool.h"
+#include "log.h"
 
 namespace bve
 {
-	MasterRenderer::MasterRenderer(BveWindow& window, BveDevice& device, EntityManager& entityManager) :
+	MasterRenderer::MasterRenderer(BveWindow& window, BveDevice& device, EntityManager& entityManager, const AssetManager& assetManager) :
 		device_(device),
 		renderer_(window, device),
 		entityManager_(entityManager),
-		gui_(window, device, renderer_.getSwapChainRenderPass(), renderer_.getImageCount(), entityManager)
+		assetManager_(assetManager),
+		lightClusterSystem_(entityManager),
+		occlusionCullingSystem_(entityManager, assetManager),
+		gui_(std::make_unique<BveImgui>(window, device, renderer_.getSwapChainRenderPass(), renderer_.getImageCount(), entityManager)),
+		frameAllocator_(device, BveSwapChain::MAX_FRAMES_IN_FLIGHT),
+		recorder_(device, BveSwapChain::MAX_FRAMES_IN_FLIGHT, ThreadPool::instance().getThreadCount() + 1),
+		gpuProfiler_(device, BveSwapChain::MAX_FRAMES_IN_FLIGHT, recorder_.getWorkerCount() * 2),
+		renderGraph_(device, BveSwapChain::MAX_FRAMES_IN_FLIGHT),
+		swapChainGeneration_(renderer_.getSwapChainGeneration())
 	{
-		initGlobalDescriptorSets();
-		renderSystem_ = std::make_unique<RenderSystem>(device, renderer_.getSwapChainRenderPass(), entityManager, globalSetLayout_->getDescriptorSetLayout());
-		pointLightRenderSystem_ = std::make_unique<PointLightRenderSystem>(device, renderer_.getSwapChainRenderPass(), entityManager, globalSetLayout_->getDescriptorSetLayout());
+		createSystems();
+	}
+
+	MasterRenderer::MasterRenderer(BveDevice& device, VkExtent2D extent, EntityManager& entityManager, const AssetManager& assetManager) :
+		device_(device),
+		renderer_(device, extent),
+		entityManager_(entityManager),
+		assetManager_(assetManager),
+		lightClusterSystem_(entityManager),
+		occlusionCullingSystem_(entityManager, assetManager),
+		frameAllocator_(device, BveSwapChain::MAX_FRAMES_IN_FLIGHT),
+		recorder_(device, BveSwapChain::MAX_FRAMES_IN_FLIGHT, ThreadPool::instance().getThreadCount() + 1),
+		gpuProfiler_(device, BveSwapChain::MAX_FRAMES_IN_FLIGHT, recorder_.getWorkerCount() * 2),
+		renderGraph_(device, BveSwapChain::MAX_FRAMES_IN_FLIGHT),
+		swapChainGeneration_(renderer_.getSwapChainGeneration())
+	{
+		createSystems();
 	}
 
 	MasterRenderer::~MasterRenderer() = default;
 
+	void MasterRenderer::createSystems()
+	{
+		initGlobalDescriptorSets();
+		recorder_.setProfiler(&gpuProfiler_);
+
+		// systems only register their pipelines here, they are all created together by build()
+		BvePipelineBuilder pipelineBuilder{device_};
+		renderSystem_ = std::make_unique<RenderSystem>(device_, pipelineBuilder, renderer_.getSwapChainRenderPass(), entityManager_, assetManager_, globalSetLayout_->getDescriptorSetLayout());
+		pointLightRenderSystem_ = std::make_unique<PointLightRenderSystem>(device_, pipelineBuilder, renderer_.getSwapChainRenderPass(), globalSetLayout_->getDescriptorSetLayout());
+		pipelineBuilder.build();
+	}
+
 	bool MasterRenderer::renderFrame(float dt)
 	{
+		IG_PROFILE_FUNCTION();
 		const VkCommandBuffer commandBuffer = renderer_.beginFrame();
 		if (!commandBuffer) {
 			return false;
@@ -28,26 +66,96 @@ namespace bve
 		const Entity camera = entityManager_.getOnlyEntity<ActiveCameraTag>().value();
 		auto&& cameraComponent = entityManager_.getComponent<CameraComponent>(camera);
 		const int frameIndex = renderer_.getFrameIndex();
-		FrameInfo frameInfo{frameIndex, dt, commandBuffer, camera, globalDescriptorSets_[frameIndex]};
+
+		// beginFrame has waited on this frame's fence, so the gpu is done with its previous allocations
+		frameAllocator_.beginFrame(frameIndex);
+		recorder_.beginFrame(frameIndex);
+		renderGraph_.beginFrame(frameIndex);
+		gpuProfiler_.beginFrame(frameIndex, commandBuffer);
+
+		// the device was idle when the swap chain was recreated, so framebuffers of its old views can go
+		if (swapChainGeneration_ != renderer_.getSwapChainGeneration()) {
+			renderGraph_.releaseFramebuffers();
+			swapChainGeneration_ = renderer_.getSwapChainGeneration();
+		}
 
 		GlobalUbo ubo{};
 		ubo.projection = cameraComponent.projectionMatrix;
 		ubo.view = cameraComponent.viewMatrix;
 		ubo.inverseView = cameraComponent.inverseViewMatrix;
-		pointLightRenderSystem_->update(ubo);
-		globalUbos_[frameInfo.frameIndex]->writeToBuffer(&ubo);
-		globalUbos_[frameInfo.frameIndex]->flush();
+
+		const VkExtent2D extent = renderer_.getSwapChainExtent();
+		const float width = static_cast<float>(extent.width);
+		const float height = static_cast<float>(extent.height);
+		ubo.viewport = glm::vec4{width, height, 1.f / width, 1.f / height};
+
+		const auto lightAllocations = lightClusterSystem_.update(cameraComponent, frameAllocator_, ubo);
+		const auto uboAllocation = frameAllocator_.allocate(ubo);
+
+		std::array<uint32_t, GLOBAL_BINDING_COUNT> globalDynamicOffsets{};
+		globalDynamicOffsets[GLOBAL_UBO_BINDING] = uboAllocation.dynamicOffset();
+		globalDynamicOffsets[GLOBAL_LIGHTS_BINDING] = lightAllocations.lightsOffset;
+		globalDynamicOffsets[GLOBAL_CLUSTERS_BINDING] = lightAllocations.clustersOffset;
+		globalDynamicOffsets[GLOBAL_LIGHT_INDICES_BINDING] = lightAllocations.lightIndicesOffset;
+		globalDynamicOffsets[GLOBAL_LIGHT_BILLBOARDS_BINDING] = lightAllocations.lightBillboardsOffset;
+
+		// occluders are rasterized before any draws are recorded, the render system tests against them while recording
+		occlusionCullingSystem_.update(cameraComponent, extent);
+
+		FrameInfo frameInfo{frameIndex, dt, commandBuffer, extent, camera, globalDescriptorSets_[frameIndex], globalDynamicOffsets, frameAllocator_, recorder_, occlusionCullingSystem_.getOcclusionBuffer()};
 
 		// render
-		gui_.newFrame();
-		renderer_.beginSwapChainRenderPass(commandBuffer);
+		if (gui_) {
+			IG_PROFILE_SCOPE("imgui");
+			gui_->newFrame();
+			gui_->run();
+			gui_->drawGpuProfiler(gpuProfiler_);
+			gui_->drawFrameProfiler();
+		}
+
+		const RenderGraph::ImageHandle backbuffer = renderGraph_.importImage(
+			"backbuffer",
+			renderer_.getCurrentImage(),
+			renderer_.getCurrentImageView(),
+			renderer_.getSwapChainImageFormat(),
+			extent,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			renderer_.getFinalImageLayout());
+
+		renderGraph_.addPass("forward", [&](RenderGraph::PassBuilder& builder) {
+			const RenderGraph::ImageHandle depth = builder.createImage("depth", renderer_.getSwapChainDepthFormat(), extent);
+			builder.writeColor(backbuffer, VkClearColorValue{{0.01f, 0.01f, 0.01f, 1.0f}});
+			builder.writeDepth(depth, VkClearDepthStencilValue{1.0f, 0});
+		}, [this, &frameInfo](RenderGraph::PassContext& context) {
+			context.recorder.beginScope("RenderSystem");
+			renderSystem_->render(frameInfo);
+			context.recorder.endScope();
 
-		renderSystem_->render(frameInfo);
-		pointLightRenderSystem_->render(frameInfo);
-		gui_.run();
-		gui_.render(commandBuffer);
+			context.recorder.beginScope("PointLightRenderSystem");
+			pointLightRenderSystem_->render(frameInfo, lightClusterSystem_.getStats().lightCount);
+			context.recorder.endScope();
+
+			if (gui_) {
+				context.recorder.beginScope("ImGui");
+				context.recorder.record(1, [this](VkCommandBuffer guiCommandBuffer, uint32_t, uint32_t) {
+					gui_->render(guiCommandBuffer);
+				});
+				context.recorder.endScope();
+			}
+		});
+
+		{
+			IG_PROFILE_SCOPE("render graph");
+			renderGraph_.compile();
+			renderGraph_.execute(commandBuffer, recorder_);
+		}
+		gpuProfiler_.endFrame(commandBuffer);
+
+		if (!renderGraphLogged_) {
+			LOG_TRACE("{}", renderGraph_.dump());
+			renderGraphLogged_ = true;
+		}
 
-		renderer_.endSwapChainRenderPass(commandBuffer);
 		renderer_.endFrame();
 
 		return true;
@@ -55,32 +163,34 @@ namespace bve
 
 	void MasterRenderer::initGlobalDescriptorSets()
 	{
-		globalUbos_ = std::vector<std::unique_ptr<VulkanBuffer>>(BveSwapChain::MAX_FRAMES_IN_FLIGHT);
-		for (auto& uboBuffer : globalUbos_) {
-			uboBuffer = std::make_unique<VulkanBuffer>(
-				device_,
-				sizeof(GlobalUbo),
-				1,
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				device_.properties.limits.minUniformBufferOffsetAlignment);
-			uboBuffer->map();
-		}
-
 		globalPool_ = VulkanDescriptorPool::Builder(device_)
 		              .setMaxSets(BveSwapChain::MAX_FRAMES_IN_FLIGHT)
-		              .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, BveSwapChain::MAX_FRAMES_IN_FLIGHT)
+		              .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, BveSwapChain::MAX_FRAMES_IN_FLIGHT)
+		              .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 4 * BveSwapChain::MAX_FRAMES_IN_FLIGHT)
 		              .build();
 
 		globalSetLayout_ = VulkanDescriptorSetLayout::Builder(device_)
-		                   .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+		                   .addBinding(GLOBAL_UBO_BINDING, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
+		                   .addBinding(GLOBAL_LIGHTS_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
+		                   .addBinding(GLOBAL_CLUSTERS_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
+		                   .addBinding(GLOBAL_LIGHT_INDICES_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
+		                   .addBinding(GLOBAL_LIGHT_BILLBOARDS_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
 		                   .build();
 
+		// the sets only ever point at the start of each frame's arena, the data is located with dynamic offsets
 		globalDescriptorSets_ = std::vector<VkDescriptorSet>(BveSwapChain::MAX_FRAMES_IN_FLIGHT);
 		for (int i = 0; i < globalDescriptorSets_.size(); i++) {
-			auto bufferInfo = globalUbos_[i]->descriptorInfo();
+			auto uboInfo = frameAllocator_.descriptorInfo(i, sizeof(GlobalUbo));
+			auto lightsInfo = frameAllocator_.descriptorInfo(i, LightClusterSystem::LIGHTS_RANGE);
+			auto clustersInfo = frameAllocator_.descriptorInfo(i, LightClusterSystem::CLUSTERS_RANGE);
+			auto lightIndicesInfo = frameAllocator_.descriptorInfo(i, LightClusterSystem::LIGHT_INDICES_RANGE);
+			auto lightBillboardsInfo = frameAllocator_.descriptorInfo(i, LightClusterSystem::LIGHT_BILLBOARDS_RANGE);
 			VulkanDescriptorWriter(*globalSetLayout_, *globalPool_)
-				.writeBuffer(0, &bufferInfo)
+				.writeBuffer(GLOBAL_UBO_BINDING, &uboInfo)
+				.writeBuffer(GLOBAL_LIGHTS_BINDING, &lightsInfo)
+				.writeBuffer(GLOBAL_CLUSTERS_BINDING, &clustersInfo)
+				.writeBuffer(GLOBAL_LIGHT_INDICES_BINDING, &lightIndicesInfo)
+				.writeBuffer(GLOBAL_LIGHT_BILLBOARDS_BINDING, &lightBillboardsInfo)
 				.build(globalDescriptorSets_[i]);
 		}
 	}
@@ -1,9 +1,16 @@
 #pragma once
 
 #include "vulkan_renderer.h"
+#include "asset_manager.h"
 #include "systems/render_system.h"
 #include "systems/point_light_render_system.h"
+#include "systems/light_cluster_system.h"
+#include "systems/occlusion_culling_system.h"
 #include "bve_imgui.h"
+#include "vulkan_frame_allocator.h"
+#include "vulkan_parallel_recorder.h"
+#include "vulkan_gpu_profiler.h"
+#include "render_graph.h"
 
 #include <vector>
 #include <memory>
@@ -13,7 +20,9 @@ namespace bve
 	class MasterRenderer
 	{
 	public:
-		MasterRenderer(BveWindow& window, BveDevice& device, EntityManager& entityManager);
+		MasterRenderer(BveWindow& window, BveDevice& device, EntityManager& entityManager, const AssetManager& assetManager);
+		// headless, renders offscreen at a fixed extent and without the gui
+		MasterRenderer(BveDevice& device, VkExtent2D extent, EntityManager& entityManager, const AssetManager& assetManager);
 		~MasterRenderer();
 
 		MasterRenderer(const MasterRenderer&) = delete;
@@ -25,18 +34,37 @@ namespace bve
 
 		bool renderFrame(float dt);
 
+		// headless only, the next rendered frame is read back into getCapturedPixels()
+		void requestCapture() { renderer_.requestCapture(); }
+		const std::vector<uint8_t>& getCapturedPixels() const { return renderer_.getCapturedPixels(); }
+		VkExtent2D getExtent() const { return renderer_.getSwapChainExtent(); }
+
+		VulkanGpuProfiler& getGpuProfiler() { return gpuProfiler_; }
+
+		// the graph compiled for the last rendered frame
+		std::string dumpRenderGraph() const { return renderGraph_.dump(); }
+
 	private:
+		void createSystems();
 		void initGlobalDescriptorSets(); // Prepare global states like descriptor sets
 		void cleanupGlobalState(); // Cleanup or update states post-rendering
 
 		BveDevice& device_;
 		VulkanRenderer renderer_;
 		EntityManager& entityManager_;
+		const AssetManager& assetManager_;
 		std::unique_ptr<RenderSystem> renderSystem_;
 		std::unique_ptr<PointLightRenderSystem> pointLightRenderSystem_;
-		BveImgui gui_;
+		LightClusterSystem lightClusterSystem_;
+		OcclusionCullingSystem occlusionCullingSystem_;
+		std::unique_ptr<BveImgui> gui_; // null when headless
 
-		std::vector<std::unique_ptr<VulkanBuffer>> globalUbos_;
+		VulkanFrameAllocator frameAllocator_;
+		VulkanParallelRecorder recorder_;
+		VulkanGpuProfiler gpuProfiler_;
+		RenderGraph renderGraph_;
+		uint32_t swapChainGeneration_;
+		bool renderGraphLogged_ = false;
 		std::unique_ptr<VulkanDescriptorPool> globalPool_;
 		std::vector<VkDescriptorSet> globalDescriptorSets_;
 		std::unique_ptr<VulkanDescriptorSetLayout> globalSetLayout_;
@@ -0,0 +1,494 @@
+#include "pch.h"
+#include "mesh_attributes.h"
+#include "mesh_optimizer.h"
+#include "core/profiler.h"
+#include "core/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BVE_MESH_ATTRIBUTES_SSE2
+#endif
+
+namespace bve::mesh_attributes
+{
+	namespace
+	{
+		constexpr uint32_t ELEMENTS_PER_BATCH = 4096;
+		// twice the uv area below which a face's gradients are too unreliable to orient a tangent
+		constexpr float MIN_UV_AREA = 1e-12f;
+		// accumulated tangents shorter than this after removing the normal part fall back to buildBasis
+		constexpr float MIN_TANGENT_LENGTH = 1e-12f;
+
+		// Abramowitz, Stegun 4.4.45, within 7e-5 radians, which is plenty for weights. Both paths use it so they agree
+		float approximateAcos(float x)
+		{
+			x = std::clamp(x, -1.f, 1.f);
+			const float a = std::abs(x);
+			const float r = std::sqrt(1.f - a) * (1.5707288f + a * (-0.2121144f + a * (0.0742610f + a * -0.0187293f)));
+			return x < 0.f ? std::numbers::pi_v<float> - r : r;
+		}
+
+		// the angle between two edges leaving a corner, 0 if either has no length
+		float cornerAngle(const glm::vec3& a, const glm::vec3& b)
+		{
+			const float lengths = std::sqrt(glm::dot(a, a) * glm::dot(b, b));
+			return lengths > 0.f ? approximateAcos(glm::dot(a, b) / lengths) : 0.f;
+		}
+
+		// per triangle results of a face pass, scattered to the vertices afterwards
+		struct FaceStreams
+		{
+			Streams direction; // face normal, or uv gradient for tangents
+			Streams bitangent; // only for tangents
+			std::vector<float> weights[3]; // of each corner
+
+			explicit FaceStreams(size_t triangleCount, bool withBitangent)
+			{
+				for (std::vector<float>* stream : {&direction.x, &direction.y, &direction.z}) {
+					stream->resize(triangleCount);
+				}
+				if (withBitangent) {
+					for (std::vector<float>* stream : {&bitangent.x, &bitangent.y, &bitangent.z}) {
+						stream->resize(triangleCount);
+					}
+				}
+				for (std::vector<float>& stream : weights) {
+					stream.resize(triangleCount);
+				}
+			}
+		};
+
+		void computeFaceNormal(const Streams& positions, const uint32_t* triangle, NormalWeighting weighting, FaceStreams& faces, uint32_t t)
+		{
+			const glm::vec3 a = positions.get(triangle[0]);
+			const glm::vec3 b = positions.get(triangle[1]);
+			const glm::vec3 c = positions.get(triangle[2]);
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			glm::vec3 weights{1.f};
+			if (weighting == NormalWeighting::ANGLE) {
+				const float length = glm::length(normal);
+				normal = length > 0.f ? normal / length : glm::vec3{0.f};
+				weights = {cornerAngle(b - a, c - a), cornerAngle(c - b, a - b), cornerAngle(a - c, b - c)};
+			}
+			faces.direction.x[t] = normal.x;
+			faces.direction.y[t] = normal.y;
+			faces.direction.z[t] = normal.z;
+			for (int i = 0; i < 3; i++) {
+				faces.weights[i][t] = weights[i];
+			}
+		}
+
+		// the uv gradients along the face as MikkTSpace orients them, normalized and flipped with the uv winding
+		void computeFaceTangent(const Streams& positions, const Streams& uvs, const uint32_t* triangle, FaceStreams& faces, uint32_t t)
+		{
+			const glm::vec3 p0 = positions.get(triangle[0]);
+			const glm::vec3 e1 = positions.get(triangle[1]) - p0;
+			const glm::vec3 e2 = positions.get(triangle[2]) - p0;
+			const glm::vec2 uv0{uvs.x[triangle[0]], uvs.y[triangle[0]]};
+			const glm::vec2 d1 = glm::vec2{uvs.x[triangle[1]], uvs.y[triangle[1]]} - uv0;
+			const glm::vec2 d2 = glm::vec2{uvs.x[triangle[2]], uvs.y[triangle[2]]} - uv0;
+
+			const float area = d1.x * d2.y - d1.y * d2.x;
+			glm::vec3 tangent = e1 * d2.y - e2 * d1.y;
+			glm::vec3 bitangent = e2 * d1.x - e1 * d2.x;
+			const float tangentLength = glm::length(tangent);
+			const float bitangentLength = glm::length(bitangent);
+			const bool usable = std::abs(area) > MIN_UV_AREA && tangentLength > 0.f && bitangentLength > 0.f;
+			const float orientation = area < 0.f ? -1.f : 1.f;
+			tangent = usable ? tangent * (orientation / tangentLength) : glm::vec3{0.f};
+			bitangent = usable ? bitangent * (orientation / bitangentLength) : glm::vec3{0.f};
+
+			faces.direction.x[t] = tangent.x;
+			faces.direction.y[t] = tangent.y;
+			faces.direction.z[t] = tangent.z;
+			faces.bitangent.x[t] = bitangent.x;
+			faces.bitangent.y[t] = bitangent.y;
+			faces.bitangent.z[t] = bitangent.z;
+			const glm::vec3 p1 = p0 + e1;
+			const glm::vec3 p2 = p0 + e2;
+			faces.weights[0][t] = usable ? cornerAngle(e1, e2) : 0.f;
+			faces.weights[1][t] = usable ? cornerAngle(p2 - p1, p0 - p1) : 0.f;
+			faces.weights[2][t] = usable ? cornerAngle(p0 - p2, p1 - p2) : 0.f;
+		}
+
+#ifdef BVE_MESH_ATTRIBUTES_SSE2
+		struct Vec4x3
+		{
+			__m128 x;
+			__m128 y;
+			__m128 z;
+		};
+
+		Vec4x3 operator-(const Vec4x3& a, const Vec4x3& b)
+		{
+			return {_mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z)};
+		}
+
+		Vec4x3 scale(const Vec4x3& a, __m128 s)
+		{
+			return {_mm_mul_ps(a.x, s), _mm_mul_ps(a.y, s), _mm_mul_ps(a.z, s)};
+		}
+
+		__m128 dot(const Vec4x3& a, const Vec4x3& b)
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+		}
+
+		Vec4x3 cross(const Vec4x3& a, const Vec4x3& b)
+		{
+			return {
+				_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+				_mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+				_mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x)),
+			};
+		}
+
+		__m128 select(__m128 mask, __m128 a, __m128 b)
+		{
+			return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+		}
+
+		__m128 approximateAcos4(__m128 x)
+		{
+			x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.f)), _mm_set1_ps(1.f));
+			const __m128 a = _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+			__m128 polynomial = _mm_add_ps(_mm_set1_ps(0.0742610f), _mm_mul_ps(a, _mm_set1_ps(-0.0187293f)));
+			polynomial = _mm_add_ps(_mm_set1_ps(-0.2121144f), _mm_mul_ps(a, polynomial));
+			polynomial = _mm_add_ps(_mm_set1_ps(1.5707288f), _mm_mul_ps(a, polynomial));
+			const __m128 r = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.f), a)), polynomial);
+			return select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(std::numbers::pi_v<float>), r), r);
+		}
+
+		__m128 cornerAngle4(const Vec4x3& a, const Vec4x3& b)
+		{
+			const __m128 lengths = _mm_sqrt_ps(_mm_mul_ps(dot(a, a), dot(b, b)));
+			const __m128 valid = _mm_cmpgt_ps(lengths, _mm_setzero_ps());
+			return _mm_and_ps(valid, approximateAcos4(_mm_div_ps(dot(a, b), lengths)));
+		}
+
+		// one corner of four consecutive triangles
+		Vec4x3 gatherCorner(const Streams& streams, const uint32_t* triangles, uint32_t corner)
+		{
+			const uint32_t i0 = triangles[corner];
+			const uint32_t i1 = triangles[3 + corner];
+			const uint32_t i2 = triangles[6 + corner];
+			const uint32_t i3 = triangles[9 + corner];
+			const __m128 z = streams.z.empty() ? _mm_setzero_ps() : _mm_setr_ps(streams.z[i0], streams.z[i1], streams.z[i2], streams.z[i3]);
+			return {
+				_mm_setr_ps(streams.x[i0], streams.x[i1], streams.x[i2], streams.x[i3]),
+				_mm_setr_ps(streams.y[i0], streams.y[i1], streams.y[i2], streams.y[i3]),
+				z,
+			};
+		}
+
+		void store(Streams& streams, uint32_t first, const Vec4x3& value)
+		{
+			_mm_storeu_ps(streams.x.data() + first, value.x);
+			_mm_storeu_ps(streams.y.data() + first, value.y);
+			_mm_storeu_ps(streams.z.data() + first, value.z);
+		}
+
+		Vec4x3 load(const Streams& streams, uint32_t first)
+		{
+			return {_mm_loadu_ps(streams.x.data() + first), _mm_loadu_ps(streams.y.data() + first), _mm_loadu_ps(streams.z.data() + first)};
+		}
+
+		void computeFaceNormals4(const Streams& positions, const uint32_t* triangles, NormalWeighting weighting, FaceStreams& faces, uint32_t t)
+		{
+			const Vec4x3 a = gatherCorner(positions, triangles, 0);
+			const Vec4x3 b = gatherCorner(positions, triangles, 1);
+			const Vec4x3 c = gatherCorner(positions, triangles, 2);
+			Vec4x3 normal = cross(b - a, c - a);
+			__m128 weights[3] = {_mm_set1_ps(1.f), _mm_set1_ps(1.f), _mm_set1_ps(1.f)};
+			if (weighting == NormalWeighting::ANGLE) {
+				const __m128 length = _mm_sqrt_ps(dot(normal, normal));
+				const __m128 valid = _mm_cmpgt_ps(length, _mm_setzero_ps());
+				normal = scale(normal, _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.f), length)));
+				weights[0] = cornerAngle4(b - a, c - a);
+				weights[1] = cornerAngle4(c - b, a - b);
+				weights[2] = cornerAngle4(a - c, b - c);
+			}
+			store(faces.direction, t, normal);
+			for (int i = 0; i < 3; i++) {
+				_mm_storeu_ps(faces.weights[i].data() + t, weights[i]);
+			}
+		}
+
+		void computeFaceTangents4(const Streams& positions, const Streams& uvs, const uint32_t* triangles, FaceStreams& faces, uint32_t t)
+		{
+			const Vec4x3 p0 = gatherCorner(positions, triangles, 0);
+			const Vec4x3 p1 = gatherCorner(positions, triangles, 1);
+			const Vec4x3 p2 = gatherCorner(positions, triangles, 2);
+			const Vec4x3 uv0 = gatherCorner(uvs, triangles, 0);
+			const Vec4x3 d1 = gatherCorner(uvs, triangles, 1) - uv0;
+			const Vec4x3 d2 = gatherCorner(uvs, triangles, 2) - uv0;
+			const Vec4x3 e1 = p1 - p0;
+			const Vec4x3 e2 = p2 - p0;
+
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 area = _mm_sub_ps(_mm_mul_ps(d1.x, d2.y), _mm_mul_ps(d1.y, d2.x));
+			const Vec4x3 tangent = scale(e1, d2.y) - scale(e2, d1.y);
+			const Vec4x3 bitangent = scale(e2, d1.x) - scale(e1, d2.x);
+			const __m128 tangentLength = _mm_sqrt_ps(dot(tangent, tangent));
+			const __m128 bitangentLength = _mm_sqrt_ps(dot(bitangent, bitangent));
+			const __m128 usable = _mm_and_ps(
+				_mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), area), _mm_set1_ps(MIN_UV_AREA)),
+				_mm_and_ps(_mm_cmpgt_ps(tangentLength, zero), _mm_cmpgt_ps(bitangentLength, zero)));
+			const __m128 orientation = select(_mm_cmplt_ps(area, zero), _mm_set1_ps(-1.f), _mm_set1_ps(1.f));
+
+			store(faces.direction, t, scale(tangent, _mm_and_ps(usable, _mm_div_ps(orientation, tangentLength))));
+			store(faces.bitangent, t, scale(bitangent, _mm_and_ps(usable, _mm_div_ps(orientation, bitangentLength))));
+			_mm_storeu_ps(faces.weights[0].data() + t, _mm_and_ps(usable, cornerAngle4(e1, e2)));
+			_mm_storeu_ps(faces.weights[1].data() + t, _mm_and_ps(usable, cornerAngle4(p2 - p1, p0 - p1)));
+			_mm_storeu_ps(faces.weights[2].data() + t, _mm_and_ps(usable, cornerAngle4(p0 - p2, p1 - p2)));
+		}
+#endif
+
+		// unit length in place, zero vectors stay zero
+		void normalizeStreams(Streams& streams, uint32_t begin, uint32_t end)
+		{
+			uint32_t i = begin;
+#ifdef BVE_MESH_ATTRIBUTES_SSE2
+			for (; i + 4 <= end; i += 4) {
+				const Vec4x3 value = load(streams, i);
+				const __m128 length = _mm_sqrt_ps(dot(value, value));
+				const __m128 valid = _mm_cmpgt_ps(length, _mm_setzero_ps());
+				store(streams, i, scale(value, _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.f), length))));
+			}
+#endif
+			for (; i < end; i++) {
+				const glm::vec3 value = streams.get(i);
+				const float length = glm::length(value);
+				const glm::vec3 normalized = length > 0.f ? value / length : glm::vec3{0.f};
+				streams.x[i] = normalized.x;
+				streams.y[i] = normalized.y;
+				streams.z[i] = normalized.z;
+			}
+		}
+
+		Streams makeStreams(size_t count)
+		{
+			Streams streams{};
+			streams.x.resize(count);
+			streams.y.resize(count);
+			streams.z.resize(count);
+			return streams;
+		}
+	}
+
+	Streams generateNormals(const Streams& positions, std::span<const uint32_t> indices, NormalWeighting weighting)
+	{
+		IG_PROFILE_FUNCTION();
+		const auto vertexCount = static_cast<uint32_t>(positions.size());
+		const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+		FaceStreams faces{triangleCount, false};
+		ThreadPool::instance().parallelFor(triangleCount, [&](uint32_t begin, uint32_t end) {
+			uint32_t t = begin;
+#ifdef BVE_MESH_ATTRIBUTES_SSE2
+			for (; t + 4 <= end; t += 4) {
+				computeFaceNormals4(positions, indices.data() + 3 * t, weighting, faces, t);
+			}
+#endif
+			for (; t < end; t++) {
+				computeFaceNormal(positions, indices.data() + 3 * t, weighting, faces, t);
+			}
+		}, ELEMENTS_PER_BATCH);
+
+		// vertices are grouped by position, then every face adds to the groups of its corners
+		std::vector<float> interleaved(static_cast<size_t>(vertexCount) * 3);
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			interleaved[3 * i + 0] = positions.x[i];
+			interleaved[3 * i + 1] = positions.y[i];
+			interleaved[3 * i + 2] = positions.z[i];
+		}
+		std::vector<uint32_t> unique;
+		std::vector<uint32_t> groups;
+		mesh_optimizer::weldVertices(interleaved, 3, unique, groups);
+
+		Streams sums = makeStreams(unique.size());
+		for (uint32_t t = 0; t < triangleCount; t++) {
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				const uint32_t group = groups[indices[3 * t + corner]];
+				const float weight = faces.weights[corner][t];
+				sums.x[group] += faces.direction.x[t] * weight;
+				sums.y[group] += faces.direction.y[t] * weight;
+				sums.z[group] += faces.direction.z[t] * weight;
+			}
+		}
+		ThreadPool::instance().parallelFor(static_cast<uint32_t>(sums.size()), [&sums](uint32_t begin, uint32_t end) {
+			normalizeStreams(sums, begin, end);
+		}, ELEMENTS_PER_BATCH);
+
+		Streams normals = makeStreams(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			normals.x[i] = sums.x[groups[i]];
+			normals.y[i] = sums.y[groups[i]];
+			normals.z[i] = sums.z[groups[i]];
+		}
+		return normals;
+	}
+
+	std::vector<glm::vec4> generateTangents(const Streams& positions, const Streams& normals, const Streams& uvs, std::span<const uint32_t> indices)
+	{
+		IG_PROFILE_FUNCTION();
+		const auto vertexCount = static_cast<uint32_t>(positions.size());
+		const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+		FaceStreams faces{triangleCount, true};
+		ThreadPool::instance().parallelFor(triangleCount, [&](uint32_t begin, uint32_t end) {
+			uint32_t t = begin;
+#ifdef BVE_MESH_ATTRIBUTES_SSE2
+			for (; t + 4 <= end; t += 4) {
+				computeFaceTangents4(positions, uvs, indices.data() + 3 * t, faces, t);
+			}
+#endif
+			for (; t < end; t++) {
+				computeFaceTangent(positions, uvs, indices.data() + 3 * t, faces, t);
+			}
+		}, ELEMENTS_PER_BATCH);
+
+		// each corner's tangent is made orthogonal to its vertex normal before summing, as MikkTSpace does
+		Streams tangentSums = makeStreams(vertexCount);
+		Streams bitangentSums = makeStreams(vertexCount);
+		for (uint32_t t = 0; t < triangleCount; t++) {
+			const glm::vec3 tangent = faces.direction.get(t);
+			const glm::vec3 bitangent = faces.bitangent.get(t);
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				const float weight = faces.weights[corner][t];
+				if (weight == 0.f) {
+					continue;
+				}
+				const uint32_t vertex = indices[3 * t + corner];
+				const glm::vec3 normal = normals.get(vertex);
+				const glm::vec3 projected = tangent - normal * glm::dot(normal, tangent);
+				const float length = glm::length(projected);
+				if (length > 0.f) {
+					const glm::vec3 weighted = projected * (weight / length);
+					tangentSums.x[vertex] += weighted.x;
+					tangentSums.y[vertex] += weighted.y;
+					tangentSums.z[vertex] += weighted.z;
+				}
+				bitangentSums.x[vertex] += bitangent.x * weight;
+				bitangentSums.y[vertex] += bitangent.y * weight;
+				bitangentSums.z[vertex] += bitangent.z * weight;
+			}
+		}
+
+		std::vector<glm::vec4> tangents(vertexCount);
+		ThreadPool::instance().parallelFor(vertexCount, [&](uint32_t begin, uint32_t end) {
+			uint32_t i = begin;
+#ifdef BVE_MESH_ATTRIBUTES_SSE2
+			for (; i + 4 <= end; i += 4) {
+				const Vec4x3 normal = load(normals, i);
+				const Vec4x3 sum = load(tangentSums, i);
+				const Vec4x3 tangent = sum - scale(normal, dot(normal, sum));
+				const __m128 length = _mm_sqrt_ps(dot(tangent, tangent));
+				// a lane without a usable tangent is left for the scalar loop below
+				if (_mm_movemask_ps(_mm_cmpgt_ps(length, _mm_set1_ps(MIN_TANGENT_LENGTH))) != 0xf) {
+					break;
+				}
+				const Vec4x3 unit = scale(tangent, _mm_div_ps(_mm_set1_ps(1.f), length));
+				const __m128 handedness = dot(cross(normal, unit), load(bitangentSums, i));
+				const __m128 w = select(_mm_cmplt_ps(handedness, _mm_setzero_ps()), _mm_set1_ps(-1.f), _mm_set1_ps(1.f));
+
+				alignas(16) float x[4], y[4], z[4], ws[4];
+				_mm_store_ps(x, unit.x);
+				_mm_store_ps(y, unit.y);
+				_mm_store_ps(z, unit.z);
+				_mm_store_ps(ws, w);
+				for (uint32_t lane = 0; lane < 4; lane++) {
+					tangents[i + lane] = {x[lane], y[lane], z[lane], ws[lane]};
+				}
+			}
+#endif
+			for (; i < end; i++) {
+				const glm::vec3 normal = normals.get(i);
+				const glm::vec3 sum = tangentSums.get(i);
+				glm::vec3 tangent = sum - normal * glm::dot(normal, sum);
+				const float length = glm::length(tangent);
+				if (length > MIN_TANGENT_LENGTH) {
+					tangent /= length;
+					tangents[i] = {tangent, glm::dot(glm::cross(normal, tangent), bitangentSums.get(i)) < 0.f ? -1.f : 1.f};
+				} else {
+					glm::vec3 bitangent;
+					buildBasis(normal, tangent, bitangent);
+					tangents[i] = {tangent, 1.f};
+				}
+			}
+		}, ELEMENTS_PER_BATCH);
+		return tangents;
+	}
+
+	Bounds computeBounds(const Streams& positions)
+	{
+		IG_PROFILE_FUNCTION();
+		Bounds bounds{};
+		const auto count = static_cast<uint32_t>(positions.size());
+		if (count == 0) {
+			return bounds;
+		}
+
+		bounds.min = positions.get(0);
+		bounds.max = bounds.min;
+		uint32_t i = 0;
+#ifdef BVE_MESH_ATTRIBUTES_SSE2
+		if (count >= 4) {
+			Vec4x3 low = load(positions, 0);
+			Vec4x3 high = low;
+			for (i = 4; i + 4 <= count; i += 4) {
+				const Vec4x3 value = load(positions, i);
+				low = {_mm_min_ps(low.x, value.x), _mm_min_ps(low.y, value.y), _mm_min_ps(low.z, value.z)};
+				high = {_mm_max_ps(high.x, value.x), _mm_max_ps(high.y, value.y), _mm_max_ps(high.z, value.z)};
+			}
+			alignas(16) float lanes[6][4];
+			const __m128 all[6] = {low.x, low.y, low.z, high.x, high.y, high.z};
+			for (int j = 0; j < 6; j++) {
+				_mm_store_ps(lanes[j], all[j]);
+			}
+			for (int lane = 0; lane < 4; lane++) {
+				bounds.min = glm::min(bounds.min, glm::vec3{lanes[0][lane], lanes[1][lane], lanes[2][lane]});
+				bounds.max = glm::max(bounds.max, glm::vec3{lanes[3][lane], lanes[4][lane], lanes[5][lane]});
+			}
+		}
+#endif
+		for (; i < count; i++) {
+			bounds.min = glm::min(bounds.min, positions.get(i));
+			bounds.max = glm::max(bounds.max, positions.get(i));
+		}
+
+		bounds.center = (bounds.min + bounds.max) * 0.5f;
+		float radiusSquared = 0.f;
+		i = 0;
+#ifdef BVE_MESH_ATTRIBUTES_SSE2
+		const Vec4x3 center{_mm_set1_ps(bounds.center.x), _mm_set1_ps(bounds.center.y), _mm_set1_ps(bounds.center.z)};
+		__m128 farthest = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4) {
+			const Vec4x3 offset = load(positions, i) - center;
+			farthest = _mm_max_ps(farthest, dot(offset, offset));
+		}
+		alignas(16) float lanes[4];
+		_mm_store_ps(lanes, farthest);
+		radiusSquared = std::max({lanes[0], lanes[1], lanes[2], lanes[3]});
+#endif
+		for (; i < count; i++) {
+			const glm::vec3 offset = positions.get(i) - bounds.center;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+		bounds.radius = std::sqrt(radiusSquared);
+		return bounds;
+	}
+
+	void buildBasis(const glm::vec3& normal, glm::vec3& tangent, glm::vec3& bitangent)
+	{
+		const float sign = normal.z >= 0.f ? 1.f : -1.f;
+		const float a = -1.f / (sign + normal.z);
+		const float b = normal.x * normal.y * a;
+		tangent = {1.f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x};
+		bitangent = {b, sign + normal.y * normal.y * a, -normal.y};
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace bve
+{
+	// Vertex attributes derived from the geometry at import: normals for meshes that come without them, tangents for
+	// normal mapping and bounds. The kernels work on one array per component, four vertices or triangles at a time
+	// with SSE2 where it is available, and spread large meshes over the thread pool.
+	namespace mesh_attributes
+	{
+		// structure of arrays, z stays empty for two component attributes such as uvs
+		struct Streams
+		{
+			std::vector<float> x;
+			std::vector<float> y;
+			std::vector<float> z;
+
+			size_t size() const { return x.size(); }
+			glm::vec3 get(size_t i) const { return {x[i], y[i], z.empty() ? 0.f : z[i]}; }
+		};
+
+		enum class NormalWeighting
+		{
+			AREA, // faces count in proportion to their area, the classic smooth normal
+			ANGLE, // faces count by their corner's angle at the vertex, so splitting a face doesn't change the result (Thürmer, Wüthrich 1998)
+		};
+
+		struct Bounds
+		{
+			glm::vec3 min{0.f};
+			glm::vec3 max{0.f};
+			glm::vec3 center{0.f}; // of the sphere
+			float radius = 0.f;
+		};
+
+		// smooth normals. Vertices at the same position share one, so seams in the uvs or colors don't show in the
+		// shading. A vertex only used by degenerate faces gets a zero normal
+		Streams generateNormals(const Streams& positions, std::span<const uint32_t> indices, NormalWeighting weighting);
+
+		// tangent frames built like MikkTSpace: the uv gradients of each face are made orthogonal to the vertex normal
+		// and summed weighted by the corner angle, w is the handedness of the bitangent. Unlike MikkTSpace, vertices
+		// aren't split where the handedness flips, so mirrored uvs need their own vertices at the seam, as importers
+		// usually produce anyway. Vertices without usable uvs get the tangent of buildBasis
+		std::vector<glm::vec4> generateTangents(const Streams& positions, const Streams& normals, const Streams& uvs, std::span<const uint32_t> indices);
+
+		// the box around the positions and a sphere around its center through the farthest one
+		Bounds computeBounds(const Streams& positions);
+
+		// an orthonormal basis around a unit normal without branching on its direction (Duff et al. 2017), shared with
+		// simple_shader.vert which decodes packed tangents as an angle against it
+		void buildBasis(const glm::vec3& normal, glm::vec3& tangent, glm::vec3& bitangent);
+	}
+}
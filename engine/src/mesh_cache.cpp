@@ -0,0 +1,405 @@
+#include "pch.h"
+#include "mesh_cache.h"
+#include "bve_utils.h"
+#include "gltf_importer.h"
+#include "core/async_file_reader.h"
+#include "core/profiler.h"
+#include "log.h"
+
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+namespace bve::mesh_cache
+{
+	namespace
+	{
+		constexpr uint32_t MAGIC = 0x48534d42; // "BMSH"
+		constexpr uint32_t FLAG_DOUBLE_SIDED = 1 << 0;
+
+		// little endian, the blobs follow at the offsets in the order listed
+		struct FileHeader
+		{
+			uint32_t magic;
+			uint32_t formatVersion;
+			uint64_t sourceHash;
+			uint32_t importerVersion;
+			uint32_t options;
+			uint32_t vertexFormat;
+			uint32_t vertexCount;
+			uint32_t vertexStride;
+			uint32_t indexCount;
+			uint32_t indexSize;
+			uint32_t lodCount;
+			uint32_t meshletCount;
+			uint32_t flags;
+			uint64_t vertexOffset;
+			uint64_t indexOffset;
+			uint64_t lodOffset;
+			uint64_t meshletOffset;
+			uint64_t fileSize;
+			uint64_t fullBytes;
+			glm::mat4 positionTransform;
+			glm::vec3 boundingCenter;
+			float boundingRadius;
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+		};
+
+		static_assert(std::is_trivially_copyable_v<FileHeader> && sizeof(FileHeader) == 208);
+		// stored as is, changing any of these changes the format and needs a new FORMAT_VERSION
+		static_assert(sizeof(BveModel::Lod) == 12 && sizeof(mesh_optimizer::Meshlet) == 44);
+		static_assert(sizeof(BveModel::Vertex) == 60 && sizeof(BveModel::PackedVertex) == 20);
+
+		uint64_t alignOffset(uint64_t offset)
+		{
+			return (offset + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+		}
+
+		uint32_t getVertexStride(BveModel::VertexFormat format)
+		{
+			return format == BveModel::VertexFormat::PACKED ? sizeof(BveModel::PackedVertex) : sizeof(BveModel::Vertex);
+		}
+
+		// checks everything BveModel relies on, so a damaged file is rejected rather than read out of bounds
+		bool validate(const FileHeader& header, uint64_t fileSize)
+		{
+			auto blobFits = [fileSize](uint64_t offset, uint64_t size) {
+				return offset % BLOB_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+			};
+
+			const auto format = static_cast<BveModel::VertexFormat>(header.vertexFormat);
+			if (header.fileSize != fileSize
+				|| (format != BveModel::VertexFormat::FULL && format != BveModel::VertexFormat::PACKED)
+				|| header.vertexStride != getVertexStride(format)
+				|| header.vertexCount < 3
+				|| (header.indexSize != sizeof(uint16_t) && header.indexSize != sizeof(uint32_t))
+				|| header.lodCount == 0) {
+				return false;
+			}
+
+			return blobFits(header.vertexOffset, static_cast<uint64_t>(header.vertexCount) * header.vertexStride)
+				&& blobFits(header.indexOffset, static_cast<uint64_t>(header.indexCount) * header.indexSize)
+				&& blobFits(header.lodOffset, static_cast<uint64_t>(header.lodCount) * sizeof(BveModel::Lod))
+				&& blobFits(header.meshletOffset, static_cast<uint64_t>(header.meshletCount) * sizeof(mesh_optimizer::Meshlet));
+		}
+
+		bool rangeFits(uint32_t first, uint32_t count, uint32_t total)
+		{
+			return first <= total && count <= total - first;
+		}
+
+		// an older format or a different source is expected after edits and upgrades, it is silently rebuilt
+		bool matchesKey(const FileHeader& header, const Key& key, bool compareSource)
+		{
+			return header.magic == MAGIC && header.formatVersion == FORMAT_VERSION && (!compareSource || header.sourceHash == key.sourceHash)
+				&& header.importerVersion == key.importerVersion && header.options == key.options;
+		}
+
+		// everything but the blobs
+		BveModel::MeshData describe(const FileHeader& header)
+		{
+			BveModel::MeshData mesh{};
+			mesh.vertexFormat = static_cast<BveModel::VertexFormat>(header.vertexFormat);
+			mesh.vertexCount = header.vertexCount;
+			mesh.vertexStride = header.vertexStride;
+			mesh.indexCount = header.indexCount;
+			mesh.indexSize = header.indexSize;
+			mesh.positionTransform = header.positionTransform;
+			mesh.boundingCenter = header.boundingCenter;
+			mesh.boundingRadius = header.boundingRadius;
+			mesh.boundsMin = header.boundsMin;
+			mesh.boundsMax = header.boundsMax;
+			mesh.fullBytes = header.fullBytes;
+			mesh.doubleSided = (header.flags & FLAG_DOUBLE_SIDED) != 0;
+			return mesh;
+		}
+
+		template <typename Index>
+		bool indicesFit(std::span<const std::byte> indices, uint32_t vertexCount)
+		{
+			for (size_t offset = 0; offset < indices.size(); offset += sizeof(Index)) {
+				Index index;
+				std::memcpy(&index, indices.data() + offset, sizeof(Index));
+				if (index >= vertexCount) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// the level of detail and meshlet ranges and every index, which validate can't check without the blobs. An
+		// index past the vertices would have the gpu and the occluder rasterizer read past the vertex buffer
+		bool rangesFit(const BveModel::MeshData& mesh)
+		{
+			const bool indicesValid = mesh.indexSize == sizeof(uint16_t)
+				? indicesFit<uint16_t>(mesh.indices, mesh.vertexCount)
+				: indicesFit<uint32_t>(mesh.indices, mesh.vertexCount);
+			if (!indicesValid) {
+				return false;
+			}
+
+			for (const BveModel::Lod& lod : mesh.lods) {
+				if (!rangeFits(lod.firstIndex, lod.indexCount, mesh.indexCount)) {
+					return false;
+				}
+			}
+			for (const mesh_optimizer::Meshlet& meshlet : mesh.meshlets) {
+				if (!rangeFits(meshlet.firstIndex, meshlet.indexCount, mesh.indexCount)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// the blobs of a streamed cache, kept alive by the read until the model owns the staging buffers
+		struct StreamedMesh
+		{
+			BveModel::MeshData data;
+			BveModel::StagingBuffers staging;
+			std::vector<BveModel::Lod> lods;
+			std::vector<mesh_optimizer::Meshlet> meshlets;
+		};
+	}
+
+	uint64_t hashSource(const std::string& sourcePath)
+	{
+		IG_PROFILE_FUNCTION();
+		// each mesh of a glb is hashed on its own, so editing one mesh of a scene only reimports that mesh
+		const auto [file, fragment] = splitAssetPath(sourcePath);
+		if (std::filesystem::path{file}.extension() == ".glb") {
+			return gltf::Document::open(std::string{file})->hashMesh(gltf::parseMeshIndex(fragment));
+		}
+
+		const MappedFile source{sourcePath};
+		return hashBytes(source.data(), source.size());
+	}
+
+	Key makeKey(uint64_t sourceHash, const BveModel::Builder& builder)
+	{
+		Key key{};
+		key.sourceHash = sourceHash;
+		key.importerVersion = BveModel::IMPORTER_VERSION;
+		key.options = static_cast<uint32_t>(builder.vertexFormat)
+			| static_cast<uint32_t>(builder.optimizeMesh) << 8
+			| static_cast<uint32_t>(builder.generateMeshlets) << 9
+			| static_cast<uint32_t>(builder.generateLods) << 10
+			| static_cast<uint32_t>(builder.generateNormals) << 11
+			| static_cast<uint32_t>(builder.normalWeighting) << 12
+			| static_cast<uint32_t>(builder.generateTangents) << 13
+			| static_cast<uint32_t>(builder.doubleSided) << 14;
+		return key;
+	}
+
+	Key makeKey(const std::string& sourcePath, const BveModel::Builder& builder)
+	{
+		return makeKey(hashSource(sourcePath), builder);
+	}
+
+	std::string getCachePath(const std::string& sourcePath, BveModel::VertexFormat vertexFormat)
+	{
+		return sourcePath + (vertexFormat == BveModel::VertexFormat::PACKED ? ".packed" : ".full") + ".bmesh";
+	}
+
+	std::optional<CachedMesh> read(const std::string& path, const Key& key)
+	{
+		IG_PROFILE_FUNCTION();
+		std::error_code error;
+		if (!std::filesystem::exists(path, error)) {
+			return std::nullopt;
+		}
+
+		CachedMesh cached{};
+		try {
+			cached.file = MappedFile{path};
+		} catch (const std::exception& e) {
+			LOG_WARN("failed to read mesh cache: {}", e.what());
+			return std::nullopt;
+		}
+
+		std::optional<BveModel::MeshData> mesh = parse(cached.file.bytes(), key, true, path);
+		if (!mesh) {
+			return std::nullopt;
+		}
+		cached.data = *mesh;
+		return cached;
+	}
+
+	std::optional<BveModel::MeshData> parse(std::span<const std::byte> image, const Key& key, bool compareSource, const std::string& name)
+	{
+		assert(reinterpret_cast<uintptr_t>(image.data()) % alignof(mesh_optimizer::Meshlet) == 0 && "Mesh cache image is misaligned");
+		const std::byte* bytes = image.data();
+		FileHeader header{};
+		if (image.size() < sizeof(header)) {
+			LOG_WARN("ignoring truncated mesh cache {}", name);
+			return std::nullopt;
+		}
+		std::memcpy(&header, bytes, sizeof(header));
+
+		if (!matchesKey(header, key, compareSource)) {
+			return std::nullopt;
+		}
+		if (!validate(header, image.size())) {
+			LOG_WARN("ignoring malformed mesh cache {}", name);
+			return std::nullopt;
+		}
+
+		BveModel::MeshData mesh = describe(header);
+		mesh.vertices = {bytes + header.vertexOffset, static_cast<size_t>(header.vertexCount) * header.vertexStride};
+		mesh.indices = {bytes + header.indexOffset, static_cast<size_t>(header.indexCount) * header.indexSize};
+		mesh.lods = {reinterpret_cast<const BveModel::Lod*>(bytes + header.lodOffset), header.lodCount};
+		mesh.meshlets = {reinterpret_cast<const mesh_optimizer::Meshlet*>(bytes + header.meshletOffset), header.meshletCount};
+		if (!rangesFit(mesh)) {
+			LOG_WARN("ignoring malformed mesh cache {}", name);
+			return std::nullopt;
+		}
+		return mesh;
+	}
+
+	std::optional<std::future<void>> stream(BveDevice& device, const std::string& path, const Key& key, bool keepOccluderGeometry, StreamCallback onComplete)
+	{
+		IG_PROFILE_FUNCTION();
+		std::error_code error;
+		const uint64_t fileSize = std::filesystem::file_size(path, error);
+		if (error) {
+			return std::nullopt;
+		}
+		if (fileSize < sizeof(FileHeader)) {
+			LOG_WARN("ignoring truncated mesh cache {}", path);
+			return std::nullopt;
+		}
+
+		FileHeader header{};
+		try {
+			AsyncFileReader::instance().read(path, {AsyncFileReader::Range{0, std::as_writable_bytes(std::span{&header, 1})}}).get();
+		} catch (const std::exception& e) {
+			LOG_WARN("failed to read mesh cache: {}", e.what());
+			return std::nullopt;
+		}
+		if (!matchesKey(header, key, true)) {
+			return std::nullopt;
+		}
+		if (!validate(header, fileSize)) {
+			LOG_WARN("ignoring malformed mesh cache {}", path);
+			return std::nullopt;
+		}
+
+		auto streamed = std::make_shared<StreamedMesh>();
+		BveModel::MeshData& mesh = streamed->data;
+		mesh = describe(header);
+		streamed->staging = BveModel::createStagingBuffers(device, mesh);
+		streamed->lods.resize(header.lodCount);
+		streamed->meshlets.resize(header.meshletCount);
+
+		const std::span<std::byte> vertices{static_cast<std::byte*>(streamed->staging.vertices->getMappedMemory()), static_cast<size_t>(mesh.vertexCount) * mesh.vertexStride};
+		const std::span<std::byte> indices = streamed->staging.indices
+			? std::span{static_cast<std::byte*>(streamed->staging.indices->getMappedMemory()), static_cast<size_t>(mesh.indexCount) * mesh.indexSize}
+			: std::span<std::byte>{};
+		mesh.vertices = vertices;
+		mesh.indices = indices;
+		mesh.lods = streamed->lods;
+		mesh.meshlets = streamed->meshlets;
+
+		std::vector<AsyncFileReader::Range> ranges{
+			{header.vertexOffset, vertices},
+			{header.indexOffset, indices},
+			{header.lodOffset, std::as_writable_bytes(std::span{streamed->lods})},
+			{header.meshletOffset, std::as_writable_bytes(std::span{streamed->meshlets})},
+		};
+		return AsyncFileReader::instance().read(path, std::move(ranges), [&device, path, keepOccluderGeometry, streamed, onComplete](std::exception_ptr error) {
+			std::unique_ptr<BveModel> model;
+			std::vector<BufferUpload> uploads;
+			if (!error) {
+				try {
+					if (!rangesFit(streamed->data)) {
+						throw std::runtime_error("malformed mesh cache " + path);
+					}
+					model = std::make_unique<BveModel>(device, streamed->data, std::move(streamed->staging), keepOccluderGeometry, uploads);
+				} catch (...) {
+					error = std::current_exception();
+					uploads.clear();
+				}
+			}
+			onComplete(std::move(model), std::move(uploads), error);
+		});
+	}
+
+	std::vector<std::byte> serialize(const Key& key, const BveModel::MeshData& mesh)
+	{
+		FileHeader header{};
+		header.magic = MAGIC;
+		header.formatVersion = FORMAT_VERSION;
+		header.sourceHash = key.sourceHash;
+		header.importerVersion = key.importerVersion;
+		header.options = key.options;
+		header.vertexFormat = static_cast<uint32_t>(mesh.vertexFormat);
+		header.vertexCount = mesh.vertexCount;
+		header.vertexStride = mesh.vertexStride;
+		header.indexCount = mesh.indexCount;
+		header.indexSize = mesh.indexSize;
+		header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+		header.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+		header.fullBytes = mesh.fullBytes;
+		header.flags = mesh.doubleSided ? FLAG_DOUBLE_SIDED : 0;
+		header.positionTransform = mesh.positionTransform;
+		header.boundingCenter = mesh.boundingCenter;
+		header.boundingRadius = mesh.boundingRadius;
+		header.boundsMin = mesh.boundsMin;
+		header.boundsMax = mesh.boundsMax;
+
+		const std::span<const std::byte> blobs[] = {
+			mesh.vertices,
+			mesh.indices,
+			std::as_bytes(mesh.lods),
+			std::as_bytes(mesh.meshlets),
+		};
+		uint64_t* offsets[] = {&header.vertexOffset, &header.indexOffset, &header.lodOffset, &header.meshletOffset};
+
+		uint64_t offset = sizeof(header);
+		for (size_t i = 0; i < std::size(blobs); i++) {
+			offset = alignOffset(offset);
+			*offsets[i] = offset;
+			offset += blobs[i].size();
+		}
+		header.fileSize = offset;
+
+		// padding between blobs is left zeroed
+		std::vector<std::byte> image(offset);
+		std::memcpy(image.data(), &header, sizeof(header));
+		for (size_t i = 0; i < std::size(blobs); i++) {
+			if (!blobs[i].empty()) {
+				std::memcpy(image.data() + *offsets[i], blobs[i].data(), blobs[i].size());
+			}
+		}
+		return image;
+	}
+
+	bool write(const std::string& path, const Key& key, const BveModel::MeshData& mesh)
+	{
+		IG_PROFILE_FUNCTION();
+		const std::vector<std::byte> image = serialize(key, mesh);
+
+		const std::string temporaryPath = path + ".tmp";
+		{
+			std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+			file.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+
+			if (!file) {
+				LOG_WARN("failed to write mesh cache {}", temporaryPath);
+				file.close();
+				std::error_code error;
+				std::filesystem::remove(temporaryPath, error);
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, path, error);
+		if (error) {
+			LOG_WARN("failed to replace mesh cache {}: {}", path, error.message());
+			std::filesystem::remove(temporaryPath, error);
+			return false;
+		}
+		return true;
+	}
+}
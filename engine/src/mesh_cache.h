@@ -0,0 +1,68 @@
+#pragma once
+
+#include "bve_model.h"
+#include "core/mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace bve
+{
+	// Binary copies of imported meshes, written next to the source on first import so later runs map the file and
+	// copy its blobs into staging buffers without parsing. A cache is only used if it was built from the same source
+	// bytes by the same importer version and builder options, anything else is reimported and overwritten.
+	namespace mesh_cache
+	{
+		constexpr uint32_t FORMAT_VERSION = 3;
+		// blobs start on this boundary so they can be read in place and copied to the gpu without realigning
+		constexpr uint64_t BLOB_ALIGNMENT = 64;
+
+		struct Key
+		{
+			uint64_t sourceHash;
+			uint32_t importerVersion;
+			uint32_t options; // builder settings that change its output
+		};
+
+		// hashes the contents of the source, or of the one mesh a glb path names. Throws if it can't be read
+		uint64_t hashSource(const std::string& sourcePath);
+		Key makeKey(uint64_t sourceHash, const BveModel::Builder& builder);
+		Key makeKey(const std::string& sourcePath, const BveModel::Builder& builder);
+		std::string getCachePath(const std::string& sourcePath, BveModel::VertexFormat vertexFormat);
+
+		// data points into file, which stays mapped for as long as this is alive
+		struct CachedMesh
+		{
+			MappedFile file;
+			BveModel::MeshData data;
+		};
+
+		// empty if there is no cache for key or the file is malformed
+		std::optional<CachedMesh> read(const std::string& path, const Key& key);
+
+		// model is null and error set if the blobs couldn't be read or turned out malformed
+		using StreamCallback = std::function<void(std::unique_ptr<BveModel> model, std::vector<BufferUpload> uploads, std::exception_ptr error)>;
+		// like read, but the blobs go through the AsyncFileReader straight into staging buffers instead of being mapped
+		// and copied. Only the header is read before returning, empty if there is no cache for key or it is malformed.
+		// Otherwise onComplete gets the model and its uploads on the thread pool, and the future is ready once it
+		// has returned
+		std::optional<std::future<void>> stream(BveDevice& device, const std::string& path, const Key& key, bool keepOccluderGeometry, StreamCallback onComplete);
+		// writes through a temporary file so a crash never leaves a partial cache, failures are logged and only
+		// cost a reimport next time
+		bool write(const std::string& path, const Key& key, const BveModel::MeshData& mesh);
+
+		// the file contents write produces, for storing caches somewhere else such as an AssetArchive
+		std::vector<std::byte> serialize(const Key& key, const BveModel::MeshData& mesh);
+		// views a cache already in memory, which has to be aligned like an allocation and outlive the result. Empty if it
+		// doesn't match key or is malformed, with name used in warnings. The source hash is only compared if
+		// compareSource is set, a packed cache may be read without its source
+		std::optional<BveModel::MeshData> parse(std::span<const std::byte> image, const Key& key, bool compareSource, const std::string& name);
+	}
+}
@@ -0,0 +1,1055 @@
+#include "pch.h"
+#include "mesh_optimizer.h"
+#include "bve_utils.h"
+#include "core/profiler.h"
+#include "core/thread_pool.h"
+
+#include <bit>
+#include <cmath>
+#include <numeric>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace bve::mesh_optimizer
+{
+	namespace
+	{
+		// fifo cache simulated with timestamps, a vertex is cached while fewer than cacheSize others were added since
+		struct VertexCache
+		{
+			VertexCache(uint32_t vertexCount, uint32_t cacheSize) : timestamps(vertexCount, 0), cacheSize{cacheSize}, time{cacheSize + 1} {}
+
+			uint32_t addTriangle(const uint32_t* triangle)
+			{
+				uint32_t misses = 0;
+				for (uint32_t i = 0; i < 3; i++) {
+					const uint32_t vertex = triangle[i];
+					if (time - timestamps[vertex] > cacheSize) {
+						timestamps[vertex] = time++;
+						misses++;
+					}
+				}
+				return misses;
+			}
+
+			void flush() { time += cacheSize + 1; }
+
+			std::vector<uint32_t> timestamps;
+			uint32_t cacheSize;
+			uint32_t time;
+		};
+
+		// triangles touching each vertex, in compressed rows
+		struct Adjacency
+		{
+			Adjacency(const std::vector<uint32_t>& indices, uint32_t vertexCount) : offsets(vertexCount + 1, 0), triangles(indices.size())
+			{
+				for (uint32_t index : indices) {
+					offsets[index + 1]++;
+				}
+				for (uint32_t i = 0; i < vertexCount; i++) {
+					offsets[i + 1] += offsets[i];
+				}
+
+				std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+				for (size_t i = 0; i < indices.size(); i++) {
+					triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+				}
+			}
+
+			std::vector<uint32_t> offsets;
+			std::vector<uint32_t> triangles;
+		};
+
+		// sum of squared distances to a set of planes, p^T A p + 2 b.p + c
+		struct Quadric
+		{
+			double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+			double b0 = 0, b1 = 0, b2 = 0;
+			double c = 0;
+
+			static Quadric fromPlane(const glm::dvec3& n, double d)
+			{
+				return Quadric{n.x * n.x, n.x * n.y, n.x * n.z, n.y * n.y, n.y * n.z, n.z * n.z, n.x * d, n.y * d, n.z * d, d * d};
+			}
+
+			Quadric& operator+=(const Quadric& o)
+			{
+				a00 += o.a00; a01 += o.a01; a02 += o.a02; a11 += o.a11; a12 += o.a12; a22 += o.a22;
+				b0 += o.b0; b1 += o.b1; b2 += o.b2;
+				c += o.c;
+				return *this;
+			}
+
+			double evaluate(const glm::dvec3& p) const
+			{
+				const double x = p.x, y = p.y, z = p.z;
+				const double result = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + a11 * y * y + 2 * a12 * y * z + a22 * z * z
+					+ 2 * (b0 * x + b1 * y + b2 * z) + c;
+				return std::max(result, 0.0);
+			}
+		};
+
+		// -0 and 0 compare equal as floats, so they have to hash the same
+		uint32_t canonicalBits(float value)
+		{
+			const uint32_t bits = std::bit_cast<uint32_t>(value);
+			return bits == 0x80000000u ? 0u : bits;
+		}
+
+		struct PositionKey
+		{
+			glm::vec3 position;
+
+			bool operator==(const PositionKey& other) const { return position == other.position; }
+		};
+
+		struct PositionKeyHash
+		{
+			size_t operator()(const PositionKey& key) const
+			{
+				const uint32_t bits[3] = {canonicalBits(key.position.x), canonicalBits(key.position.y), canonicalBits(key.position.z)};
+				return hashBytes(bits, sizeof(bits));
+			}
+		};
+
+		// folds the 128-bit product, the mixing step of wyhash
+		uint64_t multiplyFold(uint64_t a, uint64_t b)
+		{
+#ifdef _MSC_VER
+			uint64_t high;
+			const uint64_t low = _umul128(a, b, &high);
+			return low ^ high;
+#else
+			const __uint128_t product = static_cast<__uint128_t>(a) * b;
+			return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#endif
+		}
+
+		// reads the floats as bits two at a time. Canonicalizing on the fly is about twice as fast as copying
+		// canonical bits out for hashBytes
+		uint64_t hashCorner(const float* corner, uint32_t floatsPerVertex)
+		{
+			constexpr uint64_t multiplier = 0x9e3779b97f4a7c15ull;
+			uint64_t hash = 0x243f6a8885a308d3ull ^ floatsPerVertex;
+			uint32_t i = 0;
+			for (; i + 1 < floatsPerVertex; i += 2) {
+				const uint64_t pair = canonicalBits(corner[i]) | static_cast<uint64_t>(canonicalBits(corner[i + 1])) << 32;
+				hash = multiplyFold(hash ^ pair, multiplier);
+			}
+			if (i < floatsPerVertex) {
+				hash = multiplyFold(hash ^ canonicalBits(corner[i]), multiplier);
+			}
+			return multiplyFold(hash, 0xc2b2ae3d27d4eb4full);
+		}
+
+		bool equalCorners(const float* a, const float* b, uint32_t floatsPerVertex)
+		{
+			for (uint32_t i = 0; i < floatsPerVertex; i++) {
+				if (canonicalBits(a[i]) != canonicalBits(b[i])) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		struct HashedCorner
+		{
+			uint64_t hash;
+			uint32_t corner;
+
+			bool operator<(const HashedCorner& other) const { return hash != other.hash ? hash < other.hash : corner < other.corner; }
+		};
+
+		// splits [0, count) into one range per thread and runs body(range, begin, end) on each
+		template <typename F>
+		void forEachRange(uint32_t count, uint32_t rangeCount, F&& body)
+		{
+			ThreadPool::instance().parallelFor(rangeCount, [&](uint32_t first, uint32_t last) {
+				for (uint32_t range = first; range < last; range++) {
+					const auto begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * range / rangeCount);
+					const auto end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (range + 1) / rangeCount);
+					body(range, begin, end);
+				}
+			});
+		}
+
+		// sorts ranges on their own, then merges neighbours pairwise until one is left
+		void parallelSort(std::vector<HashedCorner>& keys, uint32_t rangeCount)
+		{
+			const auto count = static_cast<uint32_t>(keys.size());
+			std::vector<uint32_t> bounds(rangeCount + 1);
+			for (uint32_t range = 0; range <= rangeCount; range++) {
+				bounds[range] = static_cast<uint32_t>(static_cast<uint64_t>(count) * range / rangeCount);
+			}
+
+			forEachRange(count, rangeCount, [&keys](uint32_t, uint32_t begin, uint32_t end) {
+				std::sort(keys.begin() + begin, keys.begin() + end);
+			});
+
+			std::vector<HashedCorner> merged(keys.size());
+			for (uint32_t width = 1; width < rangeCount; width *= 2) {
+				const uint32_t pairCount = (rangeCount + 2 * width - 1) / (2 * width);
+				ThreadPool::instance().parallelFor(pairCount, [&](uint32_t firstPair, uint32_t lastPair) {
+					for (uint32_t pair = firstPair; pair < lastPair; pair++) {
+						const uint32_t begin = bounds[pair * 2 * width];
+						const uint32_t middle = bounds[std::min(pair * 2 * width + width, rangeCount)];
+						const uint32_t end = bounds[std::min(pair * 2 * width + 2 * width, rangeCount)];
+						std::merge(keys.begin() + begin, keys.begin() + middle, keys.begin() + middle, keys.begin() + end, merged.begin() + begin);
+					}
+				});
+				keys.swap(merged);
+			}
+		}
+	}
+
+	VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+
+		VertexCacheStats stats{};
+		if (indices.empty()) {
+			return stats;
+		}
+
+		VertexCache cache{vertexCount, cacheSize};
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			stats.vertexTransforms += cache.addTriangle(&indices[i]);
+		}
+
+		// only vertices that are actually referenced count towards the ideal of one transform each
+		std::vector<bool> used(vertexCount, false);
+		uint32_t usedCount = 0;
+		for (uint32_t index : indices) {
+			usedCount += used[index] ? 0 : 1;
+			used[index] = true;
+		}
+
+		stats.acmr = static_cast<float>(stats.vertexTransforms) / static_cast<float>(indices.size() / 3);
+		stats.atvr = static_cast<float>(stats.vertexTransforms) / static_cast<float>(usedCount);
+		return stats;
+	}
+
+	void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		if (triangleCount == 0) {
+			return;
+		}
+
+		const Adjacency adjacency{indices, vertexCount};
+
+		std::vector<uint32_t> liveTriangles(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			liveTriangles[i] = adjacency.offsets[i + 1] - adjacency.offsets[i];
+		}
+
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnds;
+		std::vector<uint32_t> candidates;
+		deadEnds.reserve(indices.size());
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+
+		uint32_t time = cacheSize + 1;
+		uint32_t cursor = 0;
+		int64_t fanning = 0;
+
+		// the most recently touched vertex with live triangles, otherwise the next one in input order
+		auto skipDeadEnd = [&]() -> int64_t {
+			while (!deadEnds.empty()) {
+				const uint32_t vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[vertex] > 0) {
+					return vertex;
+				}
+			}
+			while (cursor < vertexCount) {
+				if (liveTriangles[cursor] > 0) {
+					return cursor;
+				}
+				cursor++;
+			}
+			return -1;
+		};
+
+		while (fanning >= 0) {
+			candidates.clear();
+
+			const uint32_t vertex = static_cast<uint32_t>(fanning);
+			for (uint32_t a = adjacency.offsets[vertex]; a < adjacency.offsets[vertex + 1]; a++) {
+				const uint32_t triangle = adjacency.triangles[a];
+				if (emitted[triangle]) {
+					continue;
+				}
+
+				for (uint32_t corner = 0; corner < 3; corner++) {
+					const uint32_t v = indices[triangle * 3 + corner];
+					result.push_back(v);
+					deadEnds.push_back(v);
+					candidates.push_back(v);
+					liveTriangles[v]--;
+					if (time - cacheTime[v] > cacheSize) {
+						cacheTime[v] = time++;
+					}
+				}
+				emitted[triangle] = true;
+			}
+
+			// prefer the candidate that entered the cache earliest but will still be cached after its remaining
+			// triangles are emitted, each of which can push up to two new vertices
+			int64_t next = -1;
+			int64_t bestPriority = -1;
+			for (uint32_t candidate : candidates) {
+				if (liveTriangles[candidate] == 0) {
+					continue;
+				}
+
+				int64_t priority = 0;
+				if (time - cacheTime[candidate] + 2 * liveTriangles[candidate] <= cacheSize) {
+					priority = time - cacheTime[candidate];
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					next = candidate;
+				}
+			}
+
+			fanning = next >= 0 ? next : skipDeadEnd();
+		}
+
+		assert(result.size() == indices.size() && "Vertex cache optimization lost triangles");
+		indices = std::move(result);
+	}
+
+	void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, uint32_t cacheSize, float threshold)
+	{
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+		if (triangleCount == 0) {
+			return;
+		}
+
+		// a triangle missing all three vertices starts somewhere new, those are hard cluster boundaries
+		VertexCache cache{vertexCount, cacheSize};
+		std::vector<uint32_t> hardBoundaries;
+		for (uint32_t i = 0; i < triangleCount; i++) {
+			if (cache.addTriangle(&indices[i * 3]) == 3 || i == 0) {
+				hardBoundaries.push_back(i);
+			}
+		}
+		hardBoundaries.push_back(triangleCount);
+
+		// within a hard cluster, start a new one as soon as the running miss ratio has come down to the cluster's
+		// own, since reordering at that point only costs a cache flush
+		std::vector<uint32_t> clusters;
+		for (size_t c = 0; c + 1 < hardBoundaries.size(); c++) {
+			const uint32_t start = hardBoundaries[c];
+			const uint32_t end = hardBoundaries[c + 1];
+
+			cache.flush();
+			uint32_t clusterMisses = 0;
+			for (uint32_t i = start; i < end; i++) {
+				clusterMisses += cache.addTriangle(&indices[i * 3]);
+			}
+			const float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+			clusters.push_back(start);
+			cache.flush();
+			uint32_t runningMisses = 0;
+			uint32_t runningTriangles = 0;
+			for (uint32_t i = start; i < end; i++) {
+				runningMisses += cache.addTriangle(&indices[i * 3]);
+				runningTriangles++;
+				if (static_cast<float>(runningMisses) / static_cast<float>(runningTriangles) <= clusterThreshold && i + 1 < end) {
+					clusters.push_back(i + 1);
+					cache.flush();
+					runningMisses = 0;
+					runningTriangles = 0;
+				}
+			}
+		}
+		const uint32_t clusterCount = static_cast<uint32_t>(clusters.size());
+		clusters.push_back(triangleCount);
+
+		glm::vec3 meshCentroid{0.f};
+		for (const glm::vec3& position : positions) {
+			meshCentroid += position;
+		}
+		meshCentroid /= static_cast<float>(std::max(vertexCount, 1u));
+
+		// clusters whose surface faces away from the centre are most likely in front of the rest of the mesh
+		std::vector<float> sortKeys(clusterCount);
+		for (uint32_t c = 0; c < clusterCount; c++) {
+			glm::vec3 centroid{0.f};
+			glm::vec3 normal{0.f};
+			float area = 0.f;
+
+			for (uint32_t i = clusters[c]; i < clusters[c + 1]; i++) {
+				const glm::vec3& p0 = positions[indices[i * 3 + 0]];
+				const glm::vec3& p1 = positions[indices[i * 3 + 1]];
+				const glm::vec3& p2 = positions[indices[i * 3 + 2]];
+
+				const glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);
+				const float triangleArea = glm::length(areaNormal);
+				centroid += (p0 + p1 + p2) * (triangleArea / 3.f);
+				normal += areaNormal;
+				area += triangleArea;
+			}
+
+			centroid = area > 0.f ? centroid / area : positions[indices[clusters[c] * 3]];
+			const float normalLength = glm::length(normal);
+			normal = normalLength > 0.f ? normal / normalLength : glm::vec3{0.f};
+
+			sortKeys[c] = glm::dot(centroid - meshCentroid, normal);
+		}
+
+		std::vector<uint32_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return sortKeys[a] > sortKeys[b];
+		});
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+		for (uint32_t c : order) {
+			result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+		}
+		indices = std::move(result);
+	}
+
+	std::vector<uint32_t> simplify(
+		const std::vector<uint32_t>& indices,
+		const std::vector<glm::vec3>& positions,
+		const std::vector<glm::vec3>& normals,
+		uint32_t targetIndexCount,
+		float targetError,
+		float& error)
+	{
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+		assert(positions.size() == normals.size() && "Every vertex needs a position and a normal");
+
+		error = 0.f;
+		const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+
+		// vertices split by normals or uvs share a position, the simplification runs on positions and every vertex
+		// at one is a wedge of it, linked through nextWedge
+		std::vector<uint32_t> canonical(vertexCount);
+		std::vector<uint32_t> nextWedge(vertexCount, UINT32_MAX);
+		{
+			std::unordered_map<PositionKey, uint32_t, PositionKeyHash> firstAtPosition;
+			firstAtPosition.reserve(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				auto [it, inserted] = firstAtPosition.try_emplace(PositionKey{positions[v]}, v);
+				canonical[v] = it->second;
+				if (!inserted) {
+					nextWedge[v] = nextWedge[it->second];
+					nextWedge[it->second] = v;
+				}
+			}
+		}
+
+		struct Triangle
+		{
+			uint32_t corners[3]; // vertices, for the output
+			uint32_t positions[3]; // canonical vertices
+		};
+
+		std::vector<Triangle> triangles;
+		triangles.reserve(indices.size() / 3);
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			Triangle triangle{{indices[i], indices[i + 1], indices[i + 2]}, {canonical[indices[i]], canonical[indices[i + 1]], canonical[indices[i + 2]]}};
+			const uint32_t* p = triangle.positions;
+			if (p[0] != p[1] && p[1] != p[2] && p[0] != p[2]) {
+				triangles.push_back(triangle);
+			}
+		}
+
+		// open borders have no plane constraining them from one side and would shrink, so their vertices stay
+		std::vector<bool> locked(vertexCount, false);
+		{
+			std::unordered_map<uint64_t, uint32_t> edgeCounts;
+			edgeCounts.reserve(triangles.size() * 3);
+			for (const Triangle& triangle : triangles) {
+				for (uint32_t e = 0; e < 3; e++) {
+					const uint32_t a = triangle.positions[e];
+					const uint32_t b = triangle.positions[(e + 1) % 3];
+					edgeCounts[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)]++;
+				}
+			}
+			for (const auto& [edge, count] : edgeCounts) {
+				if (count == 1) {
+					locked[edge >> 32] = true;
+					locked[edge & 0xffffffff] = true;
+				}
+			}
+		}
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (const Triangle& triangle : triangles) {
+			const glm::dvec3 p0 = positions[triangle.positions[0]];
+			const glm::dvec3 p1 = positions[triangle.positions[1]];
+			const glm::dvec3 p2 = positions[triangle.positions[2]];
+			const glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const double length = glm::length(normal);
+			if (length == 0.0) {
+				continue;
+			}
+
+			const glm::dvec3 n = normal / length;
+			const Quadric plane = Quadric::fromPlane(n, -glm::dot(n, p0));
+			for (uint32_t corner : triangle.positions) {
+				quadrics[corner] += plane;
+			}
+		}
+
+		struct Collapse
+		{
+			uint32_t from;
+			uint32_t to;
+			double cost;
+		};
+
+		const double maxCost = static_cast<double>(targetError) * targetError;
+		double largestCost = 0.0;
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> collapsedTo(vertexCount, UINT32_MAX);
+		std::vector<bool> touched(vertexCount);
+
+		// each pass collapses the cheapest independent edges, then rebuilds the adjacency
+		while (triangles.size() * 3 > targetIndexCount) {
+			std::vector<uint32_t> offsets(vertexCount + 1, 0);
+			for (const Triangle& triangle : triangles) {
+				for (uint32_t corner : triangle.positions) {
+					offsets[corner + 1]++;
+				}
+			}
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				offsets[v + 1] += offsets[v];
+			}
+			std::vector<uint32_t> adjacent(triangles.size() * 3);
+			{
+				std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+				for (uint32_t t = 0; t < triangles.size(); t++) {
+					for (uint32_t corner : triangles[t].positions) {
+						adjacent[fill[corner]++] = t;
+					}
+				}
+			}
+
+			collapses.clear();
+			for (const Triangle& triangle : triangles) {
+				for (uint32_t e = 0; e < 3; e++) {
+					const uint32_t a = triangle.positions[e];
+					const uint32_t b = triangle.positions[(e + 1) % 3];
+					Quadric combined = quadrics[a];
+					combined += quadrics[b];
+					if (!locked[a]) {
+						collapses.push_back({a, b, combined.evaluate(positions[b])});
+					}
+					if (!locked[b]) {
+						collapses.push_back({b, a, combined.evaluate(positions[a])});
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+			// every collapse removes about two triangles, leave some slack since not all of them go through
+			const size_t wanted = (triangles.size() * 3 - targetIndexCount) / 3;
+			const size_t collapseBudget = std::max<size_t>(wanted / 2, 1);
+			size_t collapseCount = 0;
+			std::fill(touched.begin(), touched.end(), false);
+
+			for (const Collapse& collapse : collapses) {
+				if (collapseCount >= collapseBudget || collapse.cost > maxCost) {
+					break;
+				}
+				if (touched[collapse.from] || touched[collapse.to]) {
+					continue;
+				}
+
+				// moving the vertex must not flip or degenerate any triangle that survives the collapse
+				const glm::vec3 target = positions[collapse.to];
+				bool flips = false;
+				for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1] && !flips; a++) {
+					const Triangle& triangle = triangles[adjacent[a]];
+					const uint32_t* p = triangle.positions;
+					if (p[0] == collapse.to || p[1] == collapse.to || p[2] == collapse.to) {
+						continue;
+					}
+
+					glm::vec3 before[3], after[3];
+					for (uint32_t c = 0; c < 3; c++) {
+						before[c] = positions[p[c]];
+						after[c] = p[c] == collapse.from ? target : before[c];
+					}
+					const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+					const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+					flips = glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter);
+				}
+				if (flips) {
+					continue;
+				}
+
+				collapsedTo[collapse.from] = collapse.to;
+				quadrics[collapse.to] += quadrics[collapse.from];
+				largestCost = std::max(largestCost, collapse.cost);
+				collapseCount++;
+
+				// the triangles around the collapsed vertex changed, so their vertices wait for the next pass
+				for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++) {
+					for (uint32_t corner : triangles[adjacent[a]].positions) {
+						touched[corner] = true;
+					}
+				}
+			}
+
+			if (collapseCount == 0) {
+				break;
+			}
+
+			// corners that moved take the wedge at their new position whose normal is closest to their own
+			size_t kept = 0;
+			for (Triangle& triangle : triangles) {
+				for (uint32_t c = 0; c < 3; c++) {
+					const uint32_t to = collapsedTo[triangle.positions[c]];
+					if (to == UINT32_MAX) {
+						continue;
+					}
+
+					const glm::vec3& normal = normals[triangle.corners[c]];
+					uint32_t best = to;
+					float bestDot = -2.f;
+					for (uint32_t wedge = to; wedge != UINT32_MAX; wedge = nextWedge[wedge]) {
+						const float d = glm::dot(normals[wedge], normal);
+						if (d > bestDot) {
+							bestDot = d;
+							best = wedge;
+						}
+					}
+
+					triangle.positions[c] = to;
+					triangle.corners[c] = best;
+				}
+
+				const uint32_t* p = triangle.positions;
+				if (p[0] != p[1] && p[1] != p[2] && p[0] != p[2]) {
+					triangles[kept++] = triangle;
+				}
+			}
+			triangles.resize(kept);
+
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				collapsedTo[v] = UINT32_MAX;
+			}
+		}
+
+		error = static_cast<float>(std::sqrt(largestCost));
+
+		std::vector<uint32_t> result;
+		result.reserve(triangles.size() * 3);
+		for (const Triangle& triangle : triangles) {
+			result.insert(result.end(), std::begin(triangle.corners), std::end(triangle.corners));
+		}
+		return result;
+	}
+
+	bool hasOpenEdges(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions)
+	{
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+
+		// flat shaded meshes split their vertices along every edge, so edges are matched by position
+		const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+		std::vector<uint32_t> canonical(vertexCount);
+		{
+			std::unordered_map<PositionKey, uint32_t, PositionKeyHash> firstAtPosition;
+			firstAtPosition.reserve(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				canonical[v] = firstAtPosition.try_emplace(PositionKey{positions[v]}, v).first->second;
+			}
+		}
+
+		// each edge as its two positions, lowest first, so both triangles along it produce the same key
+		std::vector<uint64_t> edges;
+		edges.reserve(indices.size());
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				const uint32_t a = canonical[indices[t + corner]];
+				const uint32_t b = canonical[indices[t + (corner + 1) % 3]];
+				if (a != b) {
+					edges.push_back(static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b));
+				}
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		for (size_t i = 0; i < edges.size();) {
+			size_t next = i + 1;
+			while (next < edges.size() && edges[next] == edges[i]) {
+				next++;
+			}
+			if (next - i == 1) {
+				return true;
+			}
+			i = next;
+		}
+		return false;
+	}
+
+	std::vector<Meshlet> buildMeshlets(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, uint32_t maxVertices, uint32_t maxTriangles)
+	{
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+		assert(maxVertices >= 3 && maxTriangles >= 1 && "Meshlets must fit at least one triangle");
+
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+
+		// neighbours are found through shared positions, so flat shaded meshes with split vertices still grow connected meshlets
+		std::vector<uint32_t> canonical(vertexCount);
+		{
+			std::unordered_map<PositionKey, uint32_t, PositionKeyHash> firstAtPosition;
+			firstAtPosition.reserve(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				canonical[v] = firstAtPosition.try_emplace(PositionKey{positions[v]}, v).first->second;
+			}
+		}
+		std::vector<uint32_t> positionIndices(indices.size());
+		for (size_t i = 0; i < indices.size(); i++) {
+			positionIndices[i] = canonical[indices[i]];
+		}
+		const Adjacency adjacency(positionIndices, vertexCount);
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX); // last meshlet each vertex was added to
+		std::vector<uint32_t> positionMeshlet(vertexCount, UINT32_MAX); // same for canonical vertices
+		std::vector<uint32_t> order;
+		order.reserve(triangleCount);
+
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint32_t> meshletPositions;
+		uint32_t seed = 0;
+
+		while (order.size() < triangleCount) {
+			const uint32_t meshletIndex = static_cast<uint32_t>(meshlets.size());
+			const uint32_t firstTriangle = static_cast<uint32_t>(order.size());
+			meshletVertices.clear();
+			meshletPositions.clear();
+			glm::vec3 positionSum{0.f};
+
+			auto newVertexCount = [&](uint32_t triangle) {
+				uint32_t count = 0;
+				for (uint32_t c = 0; c < 3; c++) {
+					count += vertexMeshlet[indices[triangle * 3 + c]] != meshletIndex ? 1 : 0;
+				}
+				return count;
+			};
+
+			auto addTriangle = [&](uint32_t triangle) {
+				emitted[triangle] = true;
+				order.push_back(triangle);
+				for (uint32_t c = 0; c < 3; c++) {
+					const uint32_t vertex = indices[triangle * 3 + c];
+					if (vertexMeshlet[vertex] != meshletIndex) {
+						vertexMeshlet[vertex] = meshletIndex;
+						meshletVertices.push_back(vertex);
+						positionSum += positions[vertex];
+					}
+					if (positionMeshlet[canonical[vertex]] != meshletIndex) {
+						positionMeshlet[canonical[vertex]] = meshletIndex;
+						meshletPositions.push_back(canonical[vertex]);
+					}
+				}
+			};
+
+			// the input is usually cache optimized, so the next unused triangle tends to be close to the last meshlet
+			while (emitted[seed]) {
+				seed++;
+			}
+			addTriangle(seed);
+
+			while (order.size() - firstTriangle < maxTriangles) {
+				const glm::vec3 centroid = positionSum / static_cast<float>(meshletVertices.size());
+				uint32_t best = UINT32_MAX;
+				uint32_t bestNewVertices = 4;
+				float bestDistance = 0.f;
+
+				// candidates share a vertex with the meshlet, ties go to the one closest to its centroid to keep it round
+				for (uint32_t position : meshletPositions) {
+					for (uint32_t i = adjacency.offsets[position]; i < adjacency.offsets[position + 1]; i++) {
+						const uint32_t triangle = adjacency.triangles[i];
+						if (emitted[triangle]) {
+							continue;
+						}
+
+						const uint32_t newVertices = newVertexCount(triangle);
+						if (meshletVertices.size() + newVertices > maxVertices || newVertices > bestNewVertices) {
+							continue;
+						}
+
+						const uint32_t* t = &indices[triangle * 3];
+						const float distance = glm::length((positions[t[0]] + positions[t[1]] + positions[t[2]]) / 3.f - centroid);
+						if (newVertices < bestNewVertices || distance < bestDistance) {
+							best = triangle;
+							bestNewVertices = newVertices;
+							bestDistance = distance;
+						}
+					}
+				}
+
+				if (best == UINT32_MAX) {
+					break;
+				}
+				addTriangle(best);
+			}
+
+			Meshlet meshlet{};
+			meshlet.firstIndex = firstTriangle * 3;
+			meshlet.indexCount = static_cast<uint32_t>(order.size() - firstTriangle) * 3;
+			meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+
+			glm::vec3 boundsMin = positions[meshletVertices[0]];
+			glm::vec3 boundsMax = boundsMin;
+			for (uint32_t vertex : meshletVertices) {
+				boundsMin = glm::min(boundsMin, positions[vertex]);
+				boundsMax = glm::max(boundsMax, positions[vertex]);
+			}
+			meshlet.center = (boundsMin + boundsMax) * 0.5f;
+			meshlet.radius = 0.f;
+			for (uint32_t vertex : meshletVertices) {
+				meshlet.radius = std::max(meshlet.radius, glm::length(positions[vertex] - meshlet.center));
+			}
+
+			// the cone holds every triangle normal, once it is wider than a half sphere some triangle always faces the camera
+			std::vector<glm::vec3> normals;
+			normals.reserve(order.size() - firstTriangle);
+			glm::vec3 normalSum{0.f};
+			for (size_t i = firstTriangle; i < order.size(); i++) {
+				const uint32_t* t = &indices[order[i] * 3];
+				const glm::vec3 normal = glm::cross(positions[t[1]] - positions[t[0]], positions[t[2]] - positions[t[0]]);
+				const float length = glm::length(normal);
+				if (length > 0.f) {
+					normals.push_back(normal / length);
+					normalSum += normals.back();
+				}
+			}
+
+			meshlet.coneAxis = glm::vec3{0.f, 0.f, 1.f};
+			meshlet.coneCutoff = 1.f;
+			const float axisLength = glm::length(normalSum);
+			if (axisLength > 0.f) {
+				meshlet.coneAxis = normalSum / axisLength;
+				float minDot = 1.f;
+				for (const glm::vec3& normal : normals) {
+					minDot = std::min(minDot, glm::dot(meshlet.coneAxis, normal));
+				}
+				if (minDot > 0.f) {
+					meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+				}
+			}
+
+			meshlets.push_back(meshlet);
+		}
+
+		std::vector<uint32_t> reordered(indices.size());
+		for (uint32_t i = 0; i < triangleCount; i++) {
+			std::copy_n(&indices[order[i] * 3], 3, &reordered[i * 3]);
+		}
+		indices = std::move(reordered);
+
+		return meshlets;
+	}
+
+	void optimizeMeshletVertexCache(std::vector<uint32_t>& indices, std::span<const Meshlet> meshlets, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		// each meshlet is optimized on its own vertices, numbered in order of first use, so the pass only costs
+		// what the meshlet touches
+		std::vector<uint32_t> localIndex(vertexCount, UINT32_MAX);
+		std::vector<uint32_t> globalIndex;
+		std::vector<uint32_t> local;
+		for (const Meshlet& meshlet : meshlets) {
+			assert(meshlet.firstIndex + meshlet.indexCount <= indices.size() && "Meshlet is outside the index buffer");
+			const auto range = std::span{indices}.subspan(meshlet.firstIndex, meshlet.indexCount);
+
+			globalIndex.clear();
+			local.resize(range.size());
+			for (size_t i = 0; i < range.size(); i++) {
+				if (localIndex[range[i]] == UINT32_MAX) {
+					localIndex[range[i]] = static_cast<uint32_t>(globalIndex.size());
+					globalIndex.push_back(range[i]);
+				}
+				local[i] = localIndex[range[i]];
+			}
+
+			optimizeVertexCache(local, static_cast<uint32_t>(globalIndex.size()), cacheSize);
+			for (size_t i = 0; i < range.size(); i++) {
+				range[i] = globalIndex[local[i]];
+			}
+			for (uint32_t vertex : globalIndex) {
+				localIndex[vertex] = UINT32_MAX;
+			}
+		}
+	}
+
+	uint32_t optimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& remap)
+	{
+		remap.assign(vertexCount, UINT32_MAX);
+
+		uint32_t nextVertex = 0;
+		for (uint32_t& index : indices) {
+			if (remap[index] == UINT32_MAX) {
+				remap[index] = nextVertex++;
+			}
+			index = remap[index];
+		}
+
+		return nextVertex;
+	}
+
+	void weldVertices(std::span<const float> corners, uint32_t floatsPerVertex, std::vector<uint32_t>& unique, std::vector<uint32_t>& indices)
+	{
+		IG_PROFILE_FUNCTION();
+		assert(floatsPerVertex > 0 && "Vertices need at least one float");
+		const auto cornerCount = static_cast<uint32_t>(corners.size() / floatsPerVertex);
+		unique.clear();
+		indices.resize(cornerCount);
+
+		// linear probing over a power of two table at most half full, grown as vertices are added. Slots keep 32 bits
+		// of the hash next to the vertex so most mismatches are rejected without touching the corners
+		struct Slot
+		{
+			uint32_t hash;
+			uint32_t vertex; // UINT32_MAX if empty
+		};
+		constexpr Slot empty{0, UINT32_MAX};
+		std::vector<Slot> table(std::bit_ceil(std::max(cornerCount / 4, 64u)), empty);
+		size_t mask = table.size() - 1;
+		unique.reserve(cornerCount / 4);
+
+		for (uint32_t corner = 0; corner < cornerCount; corner++) {
+			const float* values = &corners[static_cast<size_t>(corner) * floatsPerVertex];
+			const uint64_t fullHash = hashCorner(values, floatsPerVertex);
+			const auto hash = static_cast<uint32_t>(fullHash ^ (fullHash >> 32));
+
+			size_t slot = hash & mask;
+			while (table[slot].vertex != UINT32_MAX) {
+				const Slot& entry = table[slot];
+				if (entry.hash == hash && equalCorners(&corners[static_cast<size_t>(unique[entry.vertex]) * floatsPerVertex], values, floatsPerVertex)) {
+					break;
+				}
+				slot = (slot + 1) & mask;
+			}
+
+			if (table[slot].vertex != UINT32_MAX) {
+				indices[corner] = table[slot].vertex;
+				continue;
+			}
+
+			table[slot] = Slot{hash, static_cast<uint32_t>(unique.size())};
+			indices[corner] = table[slot].vertex;
+			unique.push_back(corner);
+
+			if (unique.size() * 2 > table.size()) {
+				std::vector<Slot> grown(table.size() * 2, empty);
+				mask = grown.size() - 1;
+				for (const Slot& entry : table) {
+					if (entry.vertex != UINT32_MAX) {
+						size_t target = entry.hash & mask;
+						while (grown[target].vertex != UINT32_MAX) {
+							target = (target + 1) & mask;
+						}
+						grown[target] = entry;
+					}
+				}
+				table = std::move(grown);
+			}
+		}
+	}
+
+	void weldVerticesSorted(std::span<const float> corners, uint32_t floatsPerVertex, std::vector<uint32_t>& unique, std::vector<uint32_t>& indices)
+	{
+		IG_PROFILE_FUNCTION();
+		assert(floatsPerVertex > 0 && "Vertices need at least one float");
+		const auto cornerCount = static_cast<uint32_t>(corners.size() / floatsPerVertex);
+		const uint32_t rangeCount = std::min(ThreadPool::instance().getThreadCount() + 1, std::max(cornerCount, 1u));
+		auto cornerData = [&](uint32_t corner) { return &corners[static_cast<size_t>(corner) * floatsPerVertex]; };
+
+		std::vector<HashedCorner> keys(cornerCount);
+		forEachRange(cornerCount, rangeCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+			for (uint32_t corner = begin; corner < end; corner++) {
+				keys[corner] = HashedCorner{hashCorner(cornerData(corner), floatsPerVertex), corner};
+			}
+		});
+		parallelSort(keys, rangeCount);
+
+		// equal corners end up next to each other, ordered by index, so the first of each is where the vertex is
+		// first used. A range owns the runs of equal hashes that start in it
+		std::vector<uint32_t> first(cornerCount);
+		forEachRange(cornerCount, rangeCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+			while (begin > 0 && begin < end && keys[begin].hash == keys[begin - 1].hash) {
+				begin++;
+			}
+
+			for (uint32_t runBegin = begin; runBegin < end;) {
+				uint32_t runEnd = runBegin + 1;
+				while (runEnd < cornerCount && keys[runEnd].hash == keys[runBegin].hash) {
+					runEnd++;
+				}
+
+				// different corners with the same hash are rare, compare each against the earlier ones of the run
+				for (uint32_t i = runBegin; i < runEnd; i++) {
+					const uint32_t corner = keys[i].corner;
+					first[corner] = corner;
+					for (uint32_t j = runBegin; j < i; j++) {
+						const uint32_t other = keys[j].corner;
+						if (first[other] == other && equalCorners(cornerData(other), cornerData(corner), floatsPerVertex)) {
+							first[corner] = other;
+							break;
+						}
+					}
+				}
+				runBegin = runEnd;
+			}
+		});
+
+		// vertices are numbered in order of first use, a prefix sum over the ranges gives each its first number
+		std::vector<uint32_t> rangeVertices(rangeCount + 1, 0);
+		forEachRange(cornerCount, rangeCount, [&](uint32_t range, uint32_t begin, uint32_t end) {
+			uint32_t count = 0;
+			for (uint32_t corner = begin; corner < end; corner++) {
+				count += first[corner] == corner;
+			}
+			rangeVertices[range + 1] = count;
+		});
+		std::partial_sum(rangeVertices.begin(), rangeVertices.end(), rangeVertices.begin());
+
+		unique.resize(rangeVertices[rangeCount]);
+		indices.resize(cornerCount);
+		forEachRange(cornerCount, rangeCount, [&](uint32_t range, uint32_t begin, uint32_t end) {
+			uint32_t vertex = rangeVertices[range];
+			for (uint32_t corner = begin; corner < end; corner++) {
+				if (first[corner] == corner) {
+					indices[corner] = vertex;
+					unique[vertex++] = corner;
+				}
+			}
+		});
+
+		// a later corner's first occurrence may be numbered by another range, so this waits for all of them
+		forEachRange(cornerCount, rangeCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+			for (uint32_t corner = begin; corner < end; corner++) {
+				if (first[corner] != corner) {
+					indices[corner] = indices[first[corner]];
+				}
+			}
+		});
+	}
+}
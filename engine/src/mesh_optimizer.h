@@ -0,0 +1,124 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace bve
+{
+	// Reorders indexed triangle lists for the gpu. Run in this order: vertex cache first, then overdraw
+	// (which moves whole clusters of the cache friendly order around) and vertex fetch last, since it
+	// renumbers the vertices to match the final triangle order.
+	namespace mesh_optimizer
+	{
+		// fifo size used by the vertex cache simulation, roughly the post transform cache of older hardware
+		constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+		// clusters are split wherever the running miss ratio is this close to the cluster's own
+		constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+		struct VertexCacheStats
+		{
+			uint32_t vertexTransforms = 0;
+			float acmr = 0.f; // average cache miss ratio, transforms per triangle. 0.5 is ideal, 3 is the worst
+			float atvr = 0.f; // average transform to vertex ratio. 1 is ideal
+		};
+
+		// simulates a fifo cache of cacheSize vertices over the index order
+		VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+		// Tipsify (Sander, Nehab, Barczak 2007), fans around a vertex while its neighbours are likely still cached
+		void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+		// splits a cache optimized order into clusters where doing so barely hurts the cache, then sorts them so
+		// triangles facing away from the mesh centre come first and occlude the ones behind them
+		void optimizeOverdraw(
+			std::vector<uint32_t>& indices,
+			const std::vector<glm::vec3>& positions,
+			uint32_t cacheSize = VERTEX_CACHE_SIZE,
+			float threshold = OVERDRAW_THRESHOLD);
+
+		// Quadric error metric simplification (Garland, Heckbert 1997) by half edge collapses, so the result indexes
+		// the same vertices as the input and every level of detail can share one vertex buffer. Vertices sharing a
+		// position are simplified as one, triangle corners moved to another position take the vertex there with
+		// the closest normal. Open borders are kept. Stops at targetIndexCount or once a collapse would exceed
+		// targetError, in position units. error receives the largest error of the collapses made.
+		std::vector<uint32_t> simplify(
+			const std::vector<uint32_t>& indices,
+			const std::vector<glm::vec3>& positions,
+			const std::vector<glm::vec3>& normals,
+			uint32_t targetIndexCount,
+			float targetError,
+			float& error);
+
+		// true if some edge belongs to a single triangle, with vertices at the same position counted as one. A mesh
+		// with such a border isn't closed, so its back faces can be seen
+		bool hasOpenEdges(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions);
+
+		// meshlet limits, chosen to fit the 64 vertex and 124 triangle sweet spot of mesh shading hardware
+		constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+		constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+		// a run of the index buffer small enough to be culled on its own, bounds are in position units
+		struct Meshlet
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			uint32_t vertexCount;
+			glm::vec3 center;
+			float radius;
+			glm::vec3 coneAxis; // average facing of the triangles
+			float coneCutoff; // sine of the angle between coneAxis and the furthest triangle normal, 1 if it can't be culled
+		};
+
+		// groups triangles into meshlets, growing each one by the neighbour that adds the fewest new vertices,
+		// and reorders indices so every meshlet is one contiguous range
+		std::vector<Meshlet> buildMeshlets(
+			std::vector<uint32_t>& indices,
+			const std::vector<glm::vec3>& positions,
+			uint32_t maxVertices = MESHLET_MAX_VERTICES,
+			uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+		// runs the vertex cache pass inside every meshlet's range, which buildMeshlets leaves in the order it grew
+		// the meshlet in. Triangles stay in their meshlet, so the meshlet bounds still hold
+		void optimizeMeshletVertexCache(
+			std::vector<uint32_t>& indices,
+			std::span<const Meshlet> meshlets,
+			uint32_t vertexCount,
+			uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+		// below this many corners or threads the hash map beats sorting, which only wins once it runs in parallel
+		constexpr uint32_t PARALLEL_WELD_MIN_CORNERS = 1 << 17;
+		constexpr uint32_t PARALLEL_WELD_MIN_THREADS = 4;
+
+		// Merges identical vertices, comparing them float by float with -0 equal to 0. Every corner is
+		// floatsPerVertex floats. unique receives the first corner of each vertex in order of first use and indices
+		// the vertex of each corner, the same as inserting corners into a map one by one. Uses an open addressing
+		// table of 64-bit hashes, one lookup per corner.
+		void weldVertices(std::span<const float> corners, uint32_t floatsPerVertex, std::vector<uint32_t>& unique, std::vector<uint32_t>& indices);
+
+		// the same result by hashing and sorting the corners on the thread pool, then numbering runs of equal ones
+		void weldVerticesSorted(std::span<const float> corners, uint32_t floatsPerVertex, std::vector<uint32_t>& unique, std::vector<uint32_t>& indices);
+
+		// renumbers vertices in order of first use and rewrites indices to match, vertices that are never
+		// referenced are dropped. remap[old] = new, or UINT32_MAX for dropped vertices
+		uint32_t optimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& remap);
+
+		// moves vertices into the order produced by optimizeVertexFetch
+		template <typename T>
+		std::vector<T> remapVertices(const std::vector<T>& vertices, const std::vector<uint32_t>& remap, uint32_t newVertexCount)
+		{
+			std::vector<T> result(newVertexCount);
+			for (size_t i = 0; i < vertices.size(); i++) {
+				if (remap[i] != UINT32_MAX) {
+					result[remap[i]] = vertices[i];
+				}
+			}
+			return result;
+		}
+	}
+}
@@ -0,0 +1,582 @@
+#include "pch.h"
+#include "obj_parser.h"
+
+#include "core/mapped_file.h"
+#include "core/profiler.h"
+#include "core/thread_pool.h"
+
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <span>
+#include <stdexcept>
+
+namespace bve::obj_parser
+{
+	namespace
+	{
+		struct Chunk
+		{
+			std::string_view text;
+			std::vector<float> positions;
+			std::vector<float> colors;
+			std::vector<float> normals;
+			std::vector<float> texcoords;
+			std::vector<Index> corners; // of every face, in order
+			std::vector<uint32_t> faceSizes;
+			// corner * 3 + member of corners whose relative index was resolved against this chunk's counts only
+			std::vector<uint32_t> relativeIndices;
+			std::vector<Index> triangles;
+
+			uint32_t lineCount = 0;
+			uint32_t errorLine = 0; // within the chunk, 0 if there was no error
+			const char* error = nullptr;
+
+			// counts of all earlier chunks, in elements
+			size_t positionBase = 0;
+			size_t normalBase = 0;
+			size_t texcoordBase = 0;
+			size_t triangleBase = 0;
+		};
+
+		bool isSpace(char c)
+		{
+			return c == ' ' || c == '\t';
+		}
+
+		bool isDigit(char c)
+		{
+			return static_cast<unsigned char>(c - '0') < 10;
+		}
+
+		const char* skipSpaces(const char* p, const char* end)
+		{
+			while (p < end && isSpace(*p)) {
+				p++;
+			}
+			return p;
+		}
+
+		const char* skipToken(const char* p, const char* end)
+		{
+			while (p < end && !isSpace(*p)) {
+				p++;
+			}
+			return p;
+		}
+
+		const char* skipIndex(const char* p, const char* end)
+		{
+			while (p < end && !isSpace(*p) && *p != '/') {
+				p++;
+			}
+			return p;
+		}
+
+		// accepts tinyobj's grammar: a sign, digits with an optional fraction and an optional exponent. Goes through
+		// double like tinyobj does, so the rounding to float matches
+		bool parseFloat(const char* begin, const char* end, float& value)
+		{
+			if (begin < end && *begin == '+') {
+				begin++; // from_chars rejects a leading plus
+				if (begin < end && *begin == '-') {
+					return false;
+				}
+			}
+
+			const char* digits = begin < end && *begin == '-' ? begin + 1 : begin;
+			if (digits >= end || !(isDigit(*digits) || *digits == '.')) {
+				return false;
+			}
+
+			double result;
+			if (std::from_chars(begin, end, result).ec != std::errc{}) {
+				return false;
+			}
+			value = static_cast<float>(result);
+			return true;
+		}
+
+		// parses the next whitespace separated token, the cursor moves past it even if it isn't a number
+		bool tryParseNextFloat(const char*& p, const char* end, float& value)
+		{
+			p = skipSpaces(p, end);
+			const char* tokenEnd = skipToken(p, end);
+			const bool parsed = parseFloat(p, tokenEnd, value);
+			p = tokenEnd;
+			return parsed;
+		}
+
+		float parseNextFloat(const char*& p, const char* end, float defaultValue)
+		{
+			float value = defaultValue;
+			tryParseNextFloat(p, end, value);
+			return value;
+		}
+
+		// atoi, 0 without digits. Leaves p after the digits
+		int32_t parseInt(const char*& p, const char* end)
+		{
+			p = skipSpaces(p, end);
+			bool negative = false;
+			if (p < end && (*p == '+' || *p == '-')) {
+				negative = *p == '-';
+				p++;
+			}
+
+			int64_t value = 0;
+			for (; p < end && isDigit(*p); p++) {
+				if (value <= std::numeric_limits<int32_t>::max()) {
+					value = value * 10 + (*p - '0');
+				}
+			}
+			value = std::min<int64_t>(value, std::numeric_limits<int32_t>::max());
+			return static_cast<int32_t>(negative ? -value : value);
+		}
+
+		// indices are one based, negative ones count back from the last element defined so far and 0 is only
+		// allowed for normals and texcoords, where it means none
+		bool parseIndex(const char*& p, const char* end, int32_t count, bool allowZero, Chunk& chunk, uint32_t slot, int32_t& index)
+		{
+			const int32_t value = parseInt(p, end);
+			p = skipIndex(p, end);
+
+			if (value > 0) {
+				index = value - 1;
+				return true;
+			}
+			if (value == 0) {
+				index = -1;
+				return allowZero;
+			}
+			index = count + value;
+			chunk.relativeIndices.push_back(slot);
+			return true;
+		}
+
+		bool parseFace(const char* p, const char* end, Chunk& chunk)
+		{
+			const auto positionCount = static_cast<int32_t>(chunk.positions.size() / 3);
+			const auto normalCount = static_cast<int32_t>(chunk.normals.size() / 3);
+			const auto texcoordCount = static_cast<int32_t>(chunk.texcoords.size() / 2);
+
+			uint32_t size = 0;
+			p = skipSpaces(p, end);
+			while (p < end) {
+				Index corner{-1, -1, -1};
+				const auto slot = static_cast<uint32_t>(chunk.corners.size() * 3);
+
+				// i, i/j, i//k or i/j/k
+				if (!parseIndex(p, end, positionCount, false, chunk, slot, corner.position)) {
+					return false;
+				}
+				if (p < end && *p == '/') {
+					p++;
+					if (p < end && *p == '/') {
+						p++;
+						if (!parseIndex(p, end, normalCount, true, chunk, slot + 1, corner.normal)) {
+							return false;
+						}
+					} else {
+						if (!parseIndex(p, end, texcoordCount, true, chunk, slot + 2, corner.texcoord)) {
+							return false;
+						}
+						if (p < end && *p == '/') {
+							p++;
+							if (!parseIndex(p, end, normalCount, true, chunk, slot + 1, corner.normal)) {
+								return false;
+							}
+						}
+					}
+				}
+
+				chunk.corners.push_back(corner);
+				size++;
+				p = skipSpaces(p, end);
+			}
+
+			chunk.faceSizes.push_back(size);
+			return true;
+		}
+
+		void parseChunk(Chunk& chunk)
+		{
+			IG_PROFILE_SCOPE("parse obj chunk");
+			const char* p = chunk.text.data();
+			const char* const chunkEnd = p + chunk.text.size();
+
+			while (p < chunkEnd) {
+				// lines end at \n, \r\n or a lone \r
+				const auto* newline = static_cast<const char*>(std::memchr(p, '\n', chunkEnd - p));
+				const char* lineEnd = newline ? newline : chunkEnd;
+				if (const auto* carriageReturn = static_cast<const char*>(std::memchr(p, '\r', lineEnd - p))) {
+					lineEnd = carriageReturn;
+				}
+				const char* next = lineEnd + 1;
+				if (lineEnd < chunkEnd && *lineEnd == '\r' && next < chunkEnd && *next == '\n') {
+					next++;
+				}
+				chunk.lineCount++;
+
+				const char* token = skipSpaces(p, lineEnd);
+				p = next;
+				const size_t length = lineEnd - token;
+				if (length < 2 || token[0] == '#') {
+					continue;
+				}
+
+				if (token[0] == 'v' && isSpace(token[1])) {
+					token += 2;
+					float x = parseNextFloat(token, lineEnd, 0.f);
+					float y = parseNextFloat(token, lineEnd, 0.f);
+					float z = parseNextFloat(token, lineEnd, 0.f);
+					chunk.positions.insert(chunk.positions.end(), {x, y, z});
+
+					// vertex colors only count if all three are there, a w component alone leaves the vertex white
+					float r, g, b;
+					if (!(tryParseNextFloat(token, lineEnd, r) && tryParseNextFloat(token, lineEnd, g) && tryParseNextFloat(token, lineEnd, b))) {
+						r = g = b = 1.f;
+					}
+					chunk.colors.insert(chunk.colors.end(), {r, g, b});
+				} else if (token[0] == 'v' && token[1] == 'n' && length > 2 && isSpace(token[2])) {
+					token += 3;
+					float x = parseNextFloat(token, lineEnd, 0.f);
+					float y = parseNextFloat(token, lineEnd, 0.f);
+					float z = parseNextFloat(token, lineEnd, 0.f);
+					chunk.normals.insert(chunk.normals.end(), {x, y, z});
+				} else if (token[0] == 'v' && token[1] == 't' && length > 2 && isSpace(token[2])) {
+					token += 3;
+					float u = parseNextFloat(token, lineEnd, 0.f);
+					float v = parseNextFloat(token, lineEnd, 0.f);
+					chunk.texcoords.insert(chunk.texcoords.end(), {u, v});
+				} else if (token[0] == 'f' && isSpace(token[1])) {
+					if (!parseFace(token + 2, lineEnd, chunk)) {
+						chunk.error = "a zero position index or a relative index before the first element";
+						chunk.errorLine = chunk.lineCount;
+						return;
+					}
+				}
+			}
+		}
+
+		// indices out of bounds fail validation, relative indices are completed with the counts of earlier chunks
+		bool resolveIndices(Chunk& chunk, const Mesh& mesh)
+		{
+			for (uint32_t slot : chunk.relativeIndices) {
+				Index& corner = chunk.corners[slot / 3];
+				int32_t& index = slot % 3 == 0 ? corner.position : slot % 3 == 1 ? corner.normal : corner.texcoord;
+				const size_t base = slot % 3 == 0 ? chunk.positionBase : slot % 3 == 1 ? chunk.normalBase : chunk.texcoordBase;
+				index += static_cast<int32_t>(base);
+				if (index < 0) {
+					return false;
+				}
+			}
+
+			const auto positionCount = static_cast<int32_t>(mesh.positions.size() / 3);
+			const auto normalCount = static_cast<int32_t>(mesh.normals.size() / 3);
+			const auto texcoordCount = static_cast<int32_t>(mesh.texcoords.size() / 2);
+			for (const Index& corner : chunk.corners) {
+				if (corner.position < 0 || corner.position >= positionCount
+					|| corner.normal < -1 || corner.normal >= normalCount
+					|| corner.texcoord < -1 || corner.texcoord >= texcoordCount) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// pnpoly by W. Randolph Franklin, as used by tinyobj
+		bool isInsideTriangle(const float* x, const float* y, float testX, float testY)
+		{
+			bool inside = false;
+			for (int i = 0, j = 2; i < 3; j = i++) {
+				if (((y[i] > testY) != (y[j] > testY)) && (testX < (x[j] - x[i]) * (testY - y[i]) / (y[j] - y[i]) + x[i])) {
+					inside = !inside;
+				}
+			}
+			return inside;
+		}
+
+		// tinyobj's ear clipping, step for step so its output is reproduced exactly
+		void clipEars(std::span<const Index> face, const std::vector<float>& positions, std::vector<Index>& triangles)
+		{
+			const size_t count = face.size();
+			auto position = [&positions](const Index& corner, size_t axis) { return positions[static_cast<size_t>(corner.position) * 3 + axis]; };
+
+			// project onto the two axes most parallel to the first corner that isn't degenerate
+			size_t axes[2] = {1, 2};
+			for (size_t k = 0; k < count; k++) {
+				const Index& a = face[k];
+				const Index& b = face[(k + 1) % count];
+				const Index& c = face[(k + 2) % count];
+				const float e0x = position(b, 0) - position(a, 0);
+				const float e0y = position(b, 1) - position(a, 1);
+				const float e0z = position(b, 2) - position(a, 2);
+				const float e1x = position(c, 0) - position(b, 0);
+				const float e1y = position(c, 1) - position(b, 1);
+				const float e1z = position(c, 2) - position(b, 2);
+				const float cx = std::fabs(e0y * e1z - e0z * e1y);
+				const float cy = std::fabs(e0z * e1x - e0x * e1z);
+				const float cz = std::fabs(e0x * e1y - e0y * e1x);
+				const float epsilon = std::numeric_limits<float>::epsilon();
+				if (cx > epsilon || cy > epsilon || cz > epsilon) {
+					if (!(cx > cy && cx > cz)) {
+						axes[0] = 0;
+						if (cz > cx && cz > cy) {
+							axes[1] = 1;
+						}
+					}
+					break;
+				}
+			}
+
+			std::vector<Index> remaining(face.begin(), face.end());
+			size_t guess = 0;
+			size_t remainingIterations = count;
+			size_t previousRemaining = remaining.size();
+			Index corners[3];
+			float x[3];
+			float y[3];
+
+			while (remaining.size() > 3 && remainingIterations > 0) {
+				const size_t size = remaining.size();
+				if (guess >= size) {
+					guess -= size;
+				}
+
+				if (previousRemaining != size) {
+					previousRemaining = size;
+					remainingIterations = size;
+				} else {
+					remainingIterations--;
+				}
+
+				for (size_t k = 0; k < 3; k++) {
+					corners[k] = remaining[(guess + k) % size];
+					x[k] = position(corners[k], axes[0]);
+					y[k] = position(corners[k], axes[1]);
+				}
+
+				const float e0x = x[1] - x[0];
+				const float e0y = y[1] - y[0];
+				const float e1x = x[2] - x[1];
+				const float e1y = y[2] - y[1];
+				const float cross = e0x * e1y - e0y * e1x;
+				const float area = (x[0] * y[1] - y[0] * x[1]) * 0.5f;
+				if (cross * area < 0.f) {
+					guess++;
+					continue;
+				}
+
+				bool overlap = false;
+				for (size_t other = 3; other < size; other++) {
+					const Index& corner = remaining[(guess + other) % size];
+					if (isInsideTriangle(x, y, position(corner, axes[0]), position(corner, axes[1]))) {
+						overlap = true;
+						break;
+					}
+				}
+				if (overlap) {
+					guess++;
+					continue;
+				}
+
+				triangles.insert(triangles.end(), std::begin(corners), std::end(corners));
+				remaining.erase(remaining.begin() + static_cast<ptrdiff_t>((guess + 1) % size));
+			}
+
+			if (remaining.size() == 3) {
+				triangles.insert(triangles.end(), remaining.begin(), remaining.end());
+			}
+		}
+
+		void triangulate(std::span<const Index> face, const std::vector<float>& positions, std::vector<Index>& triangles)
+		{
+			// faces with fewer than three corners are dropped, like tinyobj does
+			if (face.size() < 3) {
+				return;
+			}
+
+			if (face.size() == 3) {
+				triangles.insert(triangles.end(), face.begin(), face.end());
+				return;
+			}
+
+			if (face.size() == 4) {
+				// split along the shorter diagonal
+				auto squaredDistance = [&positions](const Index& a, const Index& b) {
+					const float* pa = &positions[static_cast<size_t>(a.position) * 3];
+					const float* pb = &positions[static_cast<size_t>(b.position) * 3];
+					const float dx = pb[0] - pa[0];
+					const float dy = pb[1] - pa[1];
+					const float dz = pb[2] - pa[2];
+					return dx * dx + dy * dy + dz * dz;
+				};
+
+				if (squaredDistance(face[0], face[2]) < squaredDistance(face[1], face[3])) {
+					triangles.insert(triangles.end(), {face[0], face[1], face[2], face[0], face[2], face[3]});
+				} else {
+					triangles.insert(triangles.end(), {face[0], face[1], face[3], face[1], face[2], face[3]});
+				}
+				return;
+			}
+
+			clipEars(face, positions, triangles);
+		}
+
+		std::vector<Chunk> splitChunks(std::string_view text)
+		{
+			const size_t chunkCount = std::max<size_t>(text.size() / CHUNK_SIZE, 1);
+			std::vector<Chunk> chunks;
+			chunks.reserve(chunkCount);
+
+			size_t begin = 0;
+			for (size_t i = 1; i <= chunkCount && begin < text.size(); i++) {
+				size_t end = text.size();
+				if (i < chunkCount) {
+					const size_t target = std::max(begin, text.size() / chunkCount * i);
+					const size_t newline = text.find('\n', target);
+					end = newline == std::string_view::npos ? text.size() : newline + 1;
+				}
+
+				chunks.emplace_back().text = text.substr(begin, end - begin);
+				begin = end;
+			}
+			return chunks;
+		}
+	}
+
+	Mesh load(const std::string& path)
+	{
+		IG_PROFILE_FUNCTION();
+		const MappedFile file{path};
+		try {
+			return parse({reinterpret_cast<const char*>(file.data()), file.size()});
+		} catch (const std::runtime_error& e) {
+			throw std::runtime_error(path + ": " + e.what());
+		}
+	}
+
+	Mesh parse(std::string_view text)
+	{
+		IG_PROFILE_FUNCTION();
+		ThreadPool& pool = ThreadPool::instance();
+		std::vector<Chunk> chunks = splitChunks(text);
+		const auto chunkCount = static_cast<uint32_t>(chunks.size());
+		if (chunks.empty()) {
+			return {};
+		}
+
+		pool.parallelFor(chunkCount, [&chunks](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				parseChunk(chunks[i]);
+			}
+		});
+
+		Mesh mesh{};
+		size_t positionCount = 0;
+		size_t normalCount = 0;
+		size_t texcoordCount = 0;
+		uint32_t lineBase = 0;
+		for (Chunk& chunk : chunks) {
+			if (chunk.error) {
+				throw std::runtime_error("line " + std::to_string(lineBase + chunk.errorLine) + ": " + chunk.error);
+			}
+			lineBase += chunk.lineCount;
+
+			chunk.positionBase = positionCount;
+			chunk.normalBase = normalCount;
+			chunk.texcoordBase = texcoordCount;
+			positionCount += chunk.positions.size() / 3;
+			normalCount += chunk.normals.size() / 3;
+			texcoordCount += chunk.texcoords.size() / 2;
+		}
+		if (positionCount > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+			throw std::runtime_error("too many vertices");
+		}
+
+		mesh.positions.resize(positionCount * 3);
+		mesh.colors.resize(positionCount * 3);
+		mesh.normals.resize(normalCount * 3);
+		mesh.texcoords.resize(texcoordCount * 2);
+
+		pool.parallelFor(chunkCount, [&chunks, &mesh](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				const Chunk& chunk = chunks[i];
+				std::ranges::copy(chunk.positions, mesh.positions.begin() + chunk.positionBase * 3);
+				std::ranges::copy(chunk.colors, mesh.colors.begin() + chunk.positionBase * 3);
+				std::ranges::copy(chunk.normals, mesh.normals.begin() + chunk.normalBase * 3);
+				std::ranges::copy(chunk.texcoords, mesh.texcoords.begin() + chunk.texcoordBase * 2);
+			}
+		});
+
+		// triangulation needs every position, so it waits for the merge
+		std::vector<uint8_t> valid(chunkCount);
+		pool.parallelFor(chunkCount, [&chunks, &mesh, &valid](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				Chunk& chunk = chunks[i];
+				valid[i] = resolveIndices(chunk, mesh);
+				if (!valid[i]) {
+					continue;
+				}
+
+				chunk.triangles.reserve(chunk.corners.size());
+				size_t first = 0;
+				for (uint32_t size : chunk.faceSizes) {
+					triangulate(std::span{chunk.corners}.subspan(first, size), mesh.positions, chunk.triangles);
+					first += size;
+				}
+			}
+		});
+
+		size_t triangleCornerCount = 0;
+		for (uint32_t i = 0; i < chunkCount; i++) {
+			if (!valid[i]) {
+				throw std::runtime_error("face index out of bounds or before the first element");
+			}
+			chunks[i].triangleBase = triangleCornerCount;
+			triangleCornerCount += chunks[i].triangles.size();
+		}
+
+		mesh.indices.resize(triangleCornerCount);
+		pool.parallelFor(chunkCount, [&chunks, &mesh](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				std::ranges::copy(chunks[i].triangles, mesh.indices.begin() + chunks[i].triangleBase);
+			}
+		});
+
+		return mesh;
+	}
+
+	std::vector<std::string> findMaterialLibraries(std::string_view text)
+	{
+		IG_PROFILE_FUNCTION();
+		std::vector<std::string> libraries;
+		const char* p = text.data();
+		const char* const end = p + text.size();
+		while (p < end) {
+			const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+			lineEnd = lineEnd ? lineEnd : end;
+
+			p = skipSpaces(p, lineEnd);
+			const char* const keyword = p;
+			p = skipToken(p, lineEnd);
+			if (std::string_view{keyword, static_cast<size_t>(p - keyword)} == "mtllib") {
+				// one line may name several libraries
+				while ((p = skipSpaces(p, lineEnd)) < lineEnd) {
+					const char* const name = p;
+					p = skipToken(p, lineEnd);
+					const char* nameEnd = p;
+					while (nameEnd > name && nameEnd[-1] == '\r') {
+						nameEnd--;
+					}
+					if (nameEnd > name) {
+						libraries.emplace_back(name, nameEnd);
+					}
+				}
+			}
+			p = lineEnd + 1;
+		}
+		return libraries;
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bve
+{
+	// Reads the geometry of Wavefront OBJ files. The text is split into line aligned chunks parsed on the thread pool,
+	// then the chunks are merged and their polygons triangulated. The result matches tinyobj::LoadObj with
+	// triangulation on: the same attribute arrays and the same triangles in the same order. Materials, groups,
+	// smoothing groups, lines and points are skipped.
+	namespace obj_parser
+	{
+		// chunks are at least this large so small files don't pay for the thread pool
+		constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+		// a corner of a triangle, -1 where the face has no normal or texcoord
+		struct Index
+		{
+			int32_t position;
+			int32_t normal;
+			int32_t texcoord;
+		};
+
+		struct Mesh
+		{
+			std::vector<float> positions; // xyz
+			std::vector<float> colors; // rgb for every position, white unless the file has vertex colors
+			std::vector<float> normals; // xyz
+			std::vector<float> texcoords; // uv
+			std::vector<Index> indices; // three per triangle
+		};
+
+		// maps the file and parses it, throws std::runtime_error if it can't be read or a face is malformed
+		Mesh load(const std::string& path);
+		Mesh parse(std::string_view text);
+
+		// the material libraries the text names with mtllib, as written in the file
+		std::vector<std::string> findMaterialLibraries(std::string_view text);
+	}
+}
@@ -0,0 +1,438 @@
+#include "pch.h"
+#include "occlusion_buffer.h"
+
+#include "core/thread_pool.h"
+
+#include <cmath>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BVE_OCCLUSION_SSE2
+#endif
+
+namespace bve
+{
+	namespace
+	{
+		// vertices closer to the camera plane than this are not projected, their triangles are skipped
+		constexpr float MIN_W = 1e-5f;
+
+		constexpr uint32_t TRIANGLES_PER_BATCH = 256;
+		constexpr uint32_t VERTICES_PER_BATCH = 1024;
+
+		constexpr uint32_t NO_NEIGHBOUR = std::numeric_limits<uint32_t>::max();
+
+		// for each edge the far vertex of the triangle sharing it, NO_NEIGHBOUR if the edge is open or shared by more
+		// than two. Vertices are matched by position since the importers split them along uv and normal seams
+		void findNeighbours(std::span<const glm::vec3> positions, std::span<const uint32_t> indices, std::span<glm::uvec3> neighbours)
+		{
+			std::vector<uint32_t> order(positions.size());
+			std::iota(order.begin(), order.end(), 0u);
+			std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+				const glm::vec3& pa = positions[a];
+				const glm::vec3& pb = positions[b];
+				return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+			});
+			std::vector<uint32_t> welded(positions.size());
+			for (size_t i = 0; i < order.size(); i++) {
+				welded[order[i]] = i > 0 && positions[order[i]] == positions[order[i - 1]] ? welded[order[i - 1]] : order[i];
+			}
+
+			// one entry per corner, keyed by the welded edge opposite it
+			std::vector<std::pair<uint64_t, uint32_t>> edges;
+			edges.reserve(indices.size());
+			for (uint32_t corner = 0; corner < indices.size(); corner++) {
+				const uint32_t first = corner - corner % 3;
+				const uint32_t from = welded[indices[first + (corner + 1) % 3]];
+				const uint32_t to = welded[indices[first + (corner + 2) % 3]];
+				if (from != to) {
+					edges.emplace_back(static_cast<uint64_t>(std::min(from, to)) << 32 | std::max(from, to), corner);
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+
+			std::fill(neighbours.begin(), neighbours.end(), glm::uvec3{NO_NEIGHBOUR});
+			for (size_t begin = 0, end = 0; begin < edges.size(); begin = end) {
+				while (end < edges.size() && edges[end].first == edges[begin].first) {
+					end++;
+				}
+				if (end - begin == 2) {
+					const uint32_t a = edges[begin].second;
+					const uint32_t b = edges[begin + 1].second;
+					neighbours[a / 3][a % 3] = indices[b];
+					neighbours[b / 3][b % 3] = indices[a];
+				}
+			}
+		}
+
+		// the edge through p and q, positive on the side of inside and lowered so it only passes whole pixels
+		glm::vec3 wholePixelEdge(const glm::vec3& p, const glm::vec3& q, const glm::vec3& inside)
+		{
+			float edgeX = -(q.y - p.y);
+			float edgeY = q.x - p.x;
+			float edgeConstant = -(edgeX * p.x + edgeY * p.y);
+			if (edgeX * inside.x + edgeY * inside.y + edgeConstant < 0.f) {
+				edgeX = -edgeX;
+				edgeY = -edgeY;
+				edgeConstant = -edgeConstant;
+			}
+			return {edgeX, edgeY, edgeConstant + 0.5f * (edgeX + edgeY) - 0.5f * (std::abs(edgeX) + std::abs(edgeY))};
+		}
+
+		// the farthest depth over the pixel, so the stored depth never claims the occluder is closer than it is
+		glm::vec3 farthestDepthPlane(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float area)
+		{
+			const float dx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+			const float dy = ((v1.x - v0.x) * (v2.z - v0.z) - (v2.x - v0.x) * (v1.z - v0.z)) / area;
+			const float constant = v0.z - dx * v0.x - dy * v0.y;
+			return {dx, dy, constant + 0.5f * (dx + dy) + 0.5f * (std::abs(dx) + std::abs(dy))};
+		}
+	}
+
+	void OcclusionBuffer::beginFrame(const glm::mat4& viewProjection, uint32_t width, uint32_t height)
+	{
+		// bins are whole tiles and every row of a bin is a multiple of four pixels, so simd groups never straddle bins
+		const uint32_t binWidth = TILE_SIZE * BIN_COLUMNS;
+		const uint32_t binHeight = TILE_SIZE * BIN_ROWS;
+		width_ = std::max((width + binWidth - 1) / binWidth, 1u) * binWidth;
+		height_ = std::max((height + binHeight - 1) / binHeight, 1u) * binHeight;
+		tileColumns_ = width_ / TILE_SIZE;
+		viewProjection_ = viewProjection;
+
+		depth_.assign(static_cast<size_t>(width_) * height_, 1.f);
+		tileMaxDepth_.assign(static_cast<size_t>(tileColumns_) * (height_ / TILE_SIZE), 1.f);
+		occluders_.clear();
+		stats_ = {};
+	}
+
+	void OcclusionBuffer::addOccluder(std::span<const glm::vec3> positions, std::span<const uint32_t> indices, const glm::mat4& modelMatrix)
+	{
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+		occluders_.push_back(Occluder{positions, indices, viewProjection_ * modelMatrix});
+	}
+
+	void OcclusionBuffer::rasterize()
+	{
+		std::vector<uint32_t> vertexOffsets(occluders_.size() + 1, 0);
+		std::vector<uint32_t> triangleOffsets(occluders_.size() + 1, 0);
+		for (size_t i = 0; i < occluders_.size(); i++) {
+			vertexOffsets[i + 1] = vertexOffsets[i] + static_cast<uint32_t>(occluders_[i].positions.size());
+			triangleOffsets[i + 1] = triangleOffsets[i] + static_cast<uint32_t>(occluders_[i].indices.size() / 3);
+		}
+		const uint32_t vertexCount = vertexOffsets.back();
+		const uint32_t triangleCount = triangleOffsets.back();
+		stats_.occluderTriangles = triangleCount;
+
+		auto findOccluder = [](const std::vector<uint32_t>& offsets, uint32_t item) {
+			return static_cast<size_t>(std::upper_bound(offsets.begin(), offsets.end(), item) - offsets.begin()) - 1;
+		};
+
+		std::vector<glm::vec4> clipPositions(vertexCount);
+		ThreadPool::instance().parallelFor(vertexCount, [&](uint32_t begin, uint32_t end) {
+			size_t occluder = findOccluder(vertexOffsets, begin);
+			for (uint32_t v = begin; v < end; v++) {
+				while (v >= vertexOffsets[occluder + 1]) {
+					occluder++;
+				}
+				const Occluder& o = occluders_[occluder];
+				clipPositions[v] = o.modelViewProjection * glm::vec4{o.positions[v - vertexOffsets[occluder]], 1.f};
+			}
+		}, VERTICES_PER_BATCH);
+
+		std::vector<glm::uvec3> neighbours(triangleCount);
+		ThreadPool::instance().parallelFor(static_cast<uint32_t>(occluders_.size()), [&](uint32_t begin, uint32_t end) {
+			for (uint32_t o = begin; o < end; o++) {
+				const std::span<glm::uvec3> occluderNeighbours{neighbours.data() + triangleOffsets[o], triangleOffsets[o + 1] - triangleOffsets[o]};
+				findNeighbours(occluders_[o].positions, occluders_[o].indices, occluderNeighbours);
+			}
+		}, 1);
+
+		triangles_.resize(triangleCount);
+		triangleValid_.assign(triangleCount, 0);
+		ThreadPool::instance().parallelFor(triangleCount, [&](uint32_t begin, uint32_t end) {
+			size_t occluder = findOccluder(triangleOffsets, begin);
+			for (uint32_t t = begin; t < end; t++) {
+				while (t >= triangleOffsets[occluder + 1]) {
+					occluder++;
+				}
+				const uint32_t* corners = &occluders_[occluder].indices[(t - triangleOffsets[occluder]) * 3];
+				const glm::vec4* clip = &clipPositions[vertexOffsets[occluder]];
+				std::array<const glm::vec4*, 3> across{};
+				for (int i = 0; i < 3; i++) {
+					across[i] = neighbours[t][i] == NO_NEIGHBOUR ? nullptr : &clip[neighbours[t][i]];
+				}
+				triangleValid_[t] = setupTriangle(clip[corners[0]], clip[corners[1]], clip[corners[2]], across, triangles_[t]) ? 1 : 0;
+			}
+		}, TRIANGLES_PER_BATCH);
+
+		// binning is a cheap serial pass, each bin is then rasterized by one thread and owns its pixels
+		const int32_t binWidth = static_cast<int32_t>(width_ / BIN_COLUMNS);
+		const int32_t binHeight = static_cast<int32_t>(height_ / BIN_ROWS);
+		binTriangles_.resize(BIN_COLUMNS * BIN_ROWS);
+		for (auto& bin : binTriangles_) {
+			bin.clear();
+		}
+		for (uint32_t t = 0; t < triangleCount; t++) {
+			if (!triangleValid_[t]) {
+				continue;
+			}
+			stats_.rasterizedTriangles++;
+
+			const Triangle& triangle = triangles_[t];
+			for (int32_t row = triangle.minY / binHeight; row <= triangle.maxY / binHeight; row++) {
+				for (int32_t column = triangle.minX / binWidth; column <= triangle.maxX / binWidth; column++) {
+					binTriangles_[row * BIN_COLUMNS + column].push_back(t);
+				}
+			}
+		}
+
+		ThreadPool::instance().parallelFor(BIN_COLUMNS * BIN_ROWS, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t bin = begin; bin < end; bin++) {
+				rasterizeBin(bin);
+			}
+		});
+	}
+
+	bool OcclusionBuffer::setupTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, std::array<const glm::vec4*, 3> across, Triangle& triangle) const
+	{
+		// triangles crossing the camera plane would need clipping, skipping them only costs some culling
+		if (a.w < MIN_W || b.w < MIN_W || c.w < MIN_W) {
+			return false;
+		}
+
+		const float width = static_cast<float>(width_);
+		const float height = static_cast<float>(height_);
+		auto toScreen = [&](const glm::vec4& clip) {
+			return glm::vec3{(clip.x / clip.w * 0.5f + 0.5f) * width, (clip.y / clip.w * 0.5f + 0.5f) * height, clip.z / clip.w};
+		};
+		std::array<glm::vec3, 3> v{toScreen(a), toScreen(b), toScreen(c)};
+
+		// occluders are double sided, wind every triangle the same way
+		float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+		if (area < 0.f) {
+			std::swap(v[1], v[2]);
+			std::swap(across[1], across[2]);
+			area = -area;
+		}
+		if (area < 1e-6f) {
+			return false;
+		}
+
+		// pixels whose centre can be inside
+		triangle.minX = std::max(static_cast<int32_t>(std::ceil(std::min({v[0].x, v[1].x, v[2].x}) - 0.5f)), 0);
+		triangle.minY = std::max(static_cast<int32_t>(std::ceil(std::min({v[0].y, v[1].y, v[2].y}) - 0.5f)), 0);
+		triangle.maxX = std::min(static_cast<int32_t>(std::floor(std::max({v[0].x, v[1].x, v[2].x}) - 0.5f)), static_cast<int32_t>(width_) - 1);
+		triangle.maxY = std::min(static_cast<int32_t>(std::floor(std::max({v[0].y, v[1].y, v[2].y}) - 0.5f)), static_cast<int32_t>(height_) - 1);
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+			return false;
+		}
+
+		triangle.sharedEdges = 0;
+		for (int i = 0; i < 3; i++) {
+			const glm::vec3& from = v[(i + 1) % 3];
+			const glm::vec3& to = v[(i + 2) % 3];
+			const float edgeX = -(to.y - from.y);
+			const float edgeY = to.x - from.x;
+			const float edgeConstant = -(edgeX * from.x + edgeY * from.y);
+			triangle.edgeX[i] = edgeX;
+			triangle.edgeY[i] = edgeY;
+			triangle.edgeSpan[i] = 0.5f * (std::abs(edgeX) + std::abs(edgeY));
+			triangle.edgeConstant[i] = edgeConstant + 0.5f * (edgeX + edgeY);
+
+			// sampling at the pixel centre is enough along an edge when the triangle on the other side covers the
+			// rest of the pixel. A neighbour folded onto the same side in screen space, like one behind a
+			// silhouette, covers nothing past the edge
+			bool shared = false;
+			if (across[i] != nullptr && across[i]->w >= MIN_W) {
+				const glm::vec3 far = toScreen(*across[i]);
+				const float farArea = (to.x - from.x) * (far.y - from.y) - (to.y - from.y) * (far.x - from.x);
+				if (edgeX * far.x + edgeY * far.y + edgeConstant < 0.f && std::abs(farArea) >= 1e-6f) {
+					triangle.neighbourEdges[i * 2] = wholePixelEdge(to, far, from);
+					triangle.neighbourEdges[i * 2 + 1] = wholePixelEdge(far, from, to);
+					triangle.neighbourDepthPlanes[i] = farthestDepthPlane(from, to, far, farArea);
+					shared = true;
+				}
+			}
+			if (shared) {
+				triangle.sharedEdges |= 1u << i;
+			} else {
+				triangle.edgeConstant[i] -= triangle.edgeSpan[i];
+			}
+		}
+
+		triangle.depthPlane = farthestDepthPlane(v[0], v[1], v[2], area);
+		return true;
+	}
+
+	void OcclusionBuffer::rasterizeBin(uint32_t bin)
+	{
+		const int32_t binWidth = static_cast<int32_t>(width_ / BIN_COLUMNS);
+		const int32_t binHeight = static_cast<int32_t>(height_ / BIN_ROWS);
+		const int32_t binMinX = static_cast<int32_t>(bin % BIN_COLUMNS) * binWidth;
+		const int32_t binMinY = static_cast<int32_t>(bin / BIN_COLUMNS) * binHeight;
+		const int32_t binMaxX = binMinX + binWidth - 1;
+		const int32_t binMaxY = binMinY + binHeight - 1;
+
+		for (uint32_t t : binTriangles_[bin]) {
+			const Triangle& triangle = triangles_[t];
+			rasterizeTriangle(
+				triangle,
+				std::max(triangle.minX, binMinX),
+				std::max(triangle.minY, binMinY),
+				std::min(triangle.maxX, binMaxX),
+				std::min(triangle.maxY, binMaxY));
+		}
+
+		for (int32_t tileY = binMinY; tileY < binMaxY; tileY += TILE_SIZE) {
+			for (int32_t tileX = binMinX; tileX < binMaxX; tileX += TILE_SIZE) {
+				float maxDepth = 0.f;
+				for (int32_t y = tileY; y < tileY + static_cast<int32_t>(TILE_SIZE); y++) {
+					const float* row = &depth_[static_cast<size_t>(y) * width_ + tileX];
+					maxDepth = std::max(maxDepth, *std::max_element(row, row + TILE_SIZE));
+				}
+				tileMaxDepth_[(tileY / TILE_SIZE) * tileColumns_ + tileX / TILE_SIZE] = maxDepth;
+			}
+		}
+	}
+
+	void OcclusionBuffer::rasterizeTriangle(const Triangle& triangle, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY)
+	{
+		// rows start on a multiple of four, pixels of the group left of minX fail the edge tests on their own
+		const int32_t startX = minX & ~3;
+
+		// a pixel that is sampled inside but reaches across a shared edge also has to be inside the neighbour there,
+		// and takes the farther of the two depths
+#ifdef BVE_OCCLUSION_SSE2
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 laneOffsets = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+		const __m128 edgeX0 = _mm_set1_ps(triangle.edgeX[0]);
+		const __m128 edgeX1 = _mm_set1_ps(triangle.edgeX[1]);
+		const __m128 edgeX2 = _mm_set1_ps(triangle.edgeX[2]);
+		const __m128 depthX = _mm_set1_ps(triangle.depthPlane.x);
+
+		for (int32_t y = minY; y <= maxY; y++) {
+			const float fy = static_cast<float>(y);
+			const __m128 rowEdge0 = _mm_set1_ps(triangle.edgeY[0] * fy + triangle.edgeConstant[0]);
+			const __m128 rowEdge1 = _mm_set1_ps(triangle.edgeY[1] * fy + triangle.edgeConstant[1]);
+			const __m128 rowEdge2 = _mm_set1_ps(triangle.edgeY[2] * fy + triangle.edgeConstant[2]);
+			const __m128 rowDepth = _mm_set1_ps(triangle.depthPlane.y * fy + triangle.depthPlane.z);
+			float* row = &depth_[static_cast<size_t>(y) * width_];
+
+			for (int32_t x = startX; x <= maxX; x += 4) {
+				const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+				const __m128 edges[3] = {
+					_mm_add_ps(_mm_mul_ps(edgeX0, px), rowEdge0),
+					_mm_add_ps(_mm_mul_ps(edgeX1, px), rowEdge1),
+					_mm_add_ps(_mm_mul_ps(edgeX2, px), rowEdge2)};
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edges[0], zero), _mm_cmpge_ps(edges[1], zero)), _mm_cmpge_ps(edges[2], zero));
+				if (_mm_movemask_ps(inside) == 0) {
+					continue;
+				}
+
+				__m128 depth = _mm_add_ps(_mm_mul_ps(depthX, px), rowDepth);
+				for (int i = 0; i < 3; i++) {
+					if (!(triangle.sharedEdges & (1u << i))) {
+						continue;
+					}
+					const __m128 straddles = _mm_cmplt_ps(edges[i], _mm_set1_ps(triangle.edgeSpan[i]));
+					const glm::vec3& first = triangle.neighbourEdges[i * 2];
+					const glm::vec3& second = triangle.neighbourEdges[i * 2 + 1];
+					const glm::vec3& plane = triangle.neighbourDepthPlanes[i];
+					const __m128 firstEdge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(first.x), px), _mm_set1_ps(first.y * fy + first.z));
+					const __m128 secondEdge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(second.x), px), _mm_set1_ps(second.y * fy + second.z));
+					const __m128 neighbourInside = _mm_and_ps(_mm_cmpge_ps(firstEdge, zero), _mm_cmpge_ps(secondEdge, zero));
+					inside = _mm_andnot_ps(_mm_andnot_ps(neighbourInside, straddles), inside);
+
+					const __m128 neighbourDepth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), px), _mm_set1_ps(plane.y * fy + plane.z));
+					depth = _mm_or_ps(_mm_and_ps(straddles, _mm_max_ps(depth, neighbourDepth)), _mm_andnot_ps(straddles, depth));
+				}
+
+				const __m128 previous = _mm_loadu_ps(row + x);
+				const __m128 nearest = _mm_min_ps(previous, depth);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+			}
+		}
+#else
+		for (int32_t y = minY; y <= maxY; y++) {
+			const float fy = static_cast<float>(y);
+			float* row = &depth_[static_cast<size_t>(y) * width_];
+
+			for (int32_t x = startX; x <= maxX; x++) {
+				const float fx = static_cast<float>(x);
+				const glm::vec3 edges = triangle.edgeX * fx + triangle.edgeY * fy + triangle.edgeConstant;
+				if (edges.x < 0.f || edges.y < 0.f || edges.z < 0.f) {
+					continue;
+				}
+
+				float depth = triangle.depthPlane.x * fx + triangle.depthPlane.y * fy + triangle.depthPlane.z;
+				bool inside = true;
+				for (int i = 0; i < 3 && inside; i++) {
+					if (!(triangle.sharedEdges & (1u << i)) || edges[i] >= triangle.edgeSpan[i]) {
+						continue;
+					}
+					const glm::vec3& first = triangle.neighbourEdges[i * 2];
+					const glm::vec3& second = triangle.neighbourEdges[i * 2 + 1];
+					const glm::vec3& plane = triangle.neighbourDepthPlanes[i];
+					inside = first.x * fx + first.y * fy + first.z >= 0.f && second.x * fx + second.y * fy + second.z >= 0.f;
+					depth = std::max(depth, plane.x * fx + plane.y * fy + plane.z);
+				}
+				if (inside) {
+					row[x] = std::min(row[x], depth);
+				}
+			}
+		}
+#endif
+	}
+
+	bool OcclusionBuffer::isVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+	{
+		glm::vec2 screenMin{std::numeric_limits<float>::max()};
+		glm::vec2 screenMax{std::numeric_limits<float>::lowest()};
+		float minDepth = std::numeric_limits<float>::max();
+
+		// the projected box is within the projection of its corners, and depth grows with view distance
+		for (uint32_t i = 0; i < 8; i++) {
+			const glm::vec3 corner{i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y, i & 4 ? boundsMax.z : boundsMin.z};
+			const glm::vec4 clip = viewProjection_ * glm::vec4{corner, 1.f};
+			if (clip.w < MIN_W) {
+				return true;
+			}
+
+			const glm::vec2 screen{(clip.x / clip.w * 0.5f + 0.5f) * static_cast<float>(width_), (clip.y / clip.w * 0.5f + 0.5f) * static_cast<float>(height_)};
+			screenMin = glm::min(screenMin, screen);
+			screenMax = glm::max(screenMax, screen);
+			minDepth = std::min(minDepth, clip.z / clip.w);
+		}
+
+		// every pixel the box touches, occluders only cover pixels they cover entirely
+		const int32_t minX = std::max(static_cast<int32_t>(std::floor(screenMin.x)), 0);
+		const int32_t minY = std::max(static_cast<int32_t>(std::floor(screenMin.y)), 0);
+		const int32_t maxX = std::min(static_cast<int32_t>(std::floor(screenMax.x)), static_cast<int32_t>(width_) - 1);
+		const int32_t maxY = std::min(static_cast<int32_t>(std::floor(screenMax.y)), static_cast<int32_t>(height_) - 1);
+		if (minX > maxX || minY > maxY) {
+			return true; // off screen, that is for frustum culling to decide
+		}
+
+		for (int32_t tileY = minY / static_cast<int32_t>(TILE_SIZE); tileY <= maxY / static_cast<int32_t>(TILE_SIZE); tileY++) {
+			for (int32_t tileX = minX / static_cast<int32_t>(TILE_SIZE); tileX <= maxX / static_cast<int32_t>(TILE_SIZE); tileX++) {
+				if (tileMaxDepth_[tileY * tileColumns_ + tileX] < minDepth) {
+					continue;
+				}
+
+				const int32_t x0 = std::max(tileX * static_cast<int32_t>(TILE_SIZE), minX);
+				const int32_t y0 = std::max(tileY * static_cast<int32_t>(TILE_SIZE), minY);
+				const int32_t x1 = std::min((tileX + 1) * static_cast<int32_t>(TILE_SIZE) - 1, maxX);
+				const int32_t y1 = std::min((tileY + 1) * static_cast<int32_t>(TILE_SIZE) - 1, maxY);
+				for (int32_t y = y0; y <= y1; y++) {
+					for (int32_t x = x0; x <= x1; x++) {
+						if (depth_[static_cast<size_t>(y) * width_ + x] >= minDepth) {
+							return true;
+						}
+					}
+				}
+			}
+		}
+		return false;
+	}
+}
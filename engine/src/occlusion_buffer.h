@@ -0,0 +1,101 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace bve
+{
+	// Low resolution depth buffer rasterized on the cpu from a few large occluders, used to skip draws that are
+	// hidden behind them. The screen is split into bins rasterized in parallel, each made of tiles that keep
+	// their farthest depth so most tests finish without touching pixels. A pixel only takes an occluder's depth
+	// if the occluder covers all of it: open edges must clear the whole pixel, and a pixel sampled on one side of
+	// an edge shared with another triangle must have the rest of it inside that neighbour. Occluder depth is the
+	// farthest over the pixel and occludees are tested outwards, so even a gap thinner than a pixel between two
+	// occluders stays open and an object is only reported hidden if it really is.
+	class OcclusionBuffer
+	{
+	public:
+		static constexpr uint32_t TILE_SIZE = 8;
+		static constexpr uint32_t BIN_COLUMNS = 4;
+		static constexpr uint32_t BIN_ROWS = 4;
+		static constexpr uint32_t DEFAULT_WIDTH = 256;
+
+		struct Stats
+		{
+			uint32_t occluderTriangles;
+			uint32_t rasterizedTriangles; // in front of the near plane and facing a pixel
+		};
+
+		OcclusionBuffer() = default;
+
+		OcclusionBuffer(const OcclusionBuffer&) = delete;
+		OcclusionBuffer& operator=(const OcclusionBuffer&) = delete;
+		OcclusionBuffer(const OcclusionBuffer&&) = delete;
+		OcclusionBuffer& operator=(const OcclusionBuffer&&) = delete;
+
+		// clears the buffer, the size is rounded up to whole bins. viewProjection maps world space to clip space
+		void beginFrame(const glm::mat4& viewProjection, uint32_t width, uint32_t height);
+
+		// the geometry has to outlive rasterize()
+		void addOccluder(std::span<const glm::vec3> positions, std::span<const uint32_t> indices, const glm::mat4& modelMatrix);
+
+		// sets up and rasterizes every occluder added this frame on the thread pool
+		void rasterize();
+
+		// false if the world space box is entirely behind rasterized occluders. Thread safe after rasterize()
+		bool isVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+		uint32_t getWidth() const { return width_; }
+		uint32_t getHeight() const { return height_; }
+		const std::vector<float>& getDepth() const { return depth_; }
+		const Stats& getStats() const { return stats_; }
+
+	private:
+		struct Occluder
+		{
+			std::span<const glm::vec3> positions;
+			std::span<const uint32_t> indices;
+			glm::mat4 modelViewProjection;
+		};
+
+		// edge functions and depth planes in pixel units, already offset to pixel centres. Edge i is opposite vertex i
+		struct Triangle
+		{
+			glm::vec3 edgeX;
+			glm::vec3 edgeY;
+			glm::vec3 edgeConstant; // open edges are lowered by their span so the whole pixel has to be inside
+			glm::vec3 edgeSpan; // how much each edge function drops from the pixel centre to the farthest corner
+			glm::vec3 depthPlane; // depth = x * dx + y * dy + c, already the farthest depth over the pixel
+			// across each shared edge, the neighbour's two other edges lowered like open ones and its depth plane
+			std::array<glm::vec3, 6> neighbourEdges; // x, y and constant of edge 2i and 2i + 1
+			std::array<glm::vec3, 3> neighbourDepthPlanes;
+			uint32_t sharedEdges; // bit i for edge i
+			int32_t minX, minY, maxX, maxY; // inclusive pixel bounds
+		};
+
+		// across holds the clip position of the far vertex of the triangle on the other side of each edge, or null
+		bool setupTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, std::array<const glm::vec4*, 3> across, Triangle& triangle) const;
+		void rasterizeBin(uint32_t bin);
+		void rasterizeTriangle(const Triangle& triangle, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY);
+
+		uint32_t width_ = 0;
+		uint32_t height_ = 0;
+		uint32_t tileColumns_ = 0;
+		glm::mat4 viewProjection_{1.f};
+
+		std::vector<float> depth_; // nearest occluder depth per pixel, 1 where there is none
+		std::vector<float> tileMaxDepth_;
+
+		std::vector<Occluder> occluders_;
+		std::vector<Triangle> triangles_;
+		std::vector<uint8_t> triangleValid_;
+		std::vector<std::vector<uint32_t>> binTriangles_;
+		Stats stats_{};
+	};
+}
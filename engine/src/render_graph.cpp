@@ -0,0 +1,927 @@
+#include "pch.h"
+#include "render_graph.h"
+
+#include "bve_utils.h"
+
+#include <iomanip>
+#include <numeric>
+#include <stdexcept>
+
+namespace bve
+{
+	namespace
+	{
+		// how an image was last used while walking the live passes in submission order
+		struct ImageState
+		{
+			bool touched = false;
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags writeStages = 0;
+			VkAccessFlags writeAccess = 0;
+			VkPipelineStageFlags readStages = 0; // reads since the last write, a later write must wait on them
+			VkPipelineStageFlags visibleStages = 0; // stages that already waited on the last write
+			VkPipelineStageFlags allStages = 0; // every stage that touched it, for the next image aliasing its memory
+			VkAccessFlags allWriteAccess = 0;
+		};
+
+		// compiles a framebuffer can go unused in its frame slot before it is destroyed
+		constexpr uint32_t FRAMEBUFFER_EVICT_AGE = 8;
+
+		const char* layoutName(VkImageLayout layout)
+		{
+			switch (layout) {
+			case VK_IMAGE_LAYOUT_UNDEFINED: return "UNDEFINED";
+			case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: return "COLOR_ATTACHMENT";
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: return "DEPTH_STENCIL_ATTACHMENT";
+			case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return "SHADER_READ_ONLY";
+			case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return "TRANSFER_SRC";
+			case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: return "TRANSFER_DST";
+			case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: return "PRESENT_SRC";
+			case VK_IMAGE_LAYOUT_GENERAL: return "GENERAL";
+			default: return "OTHER";
+			}
+		}
+
+		const char* accessName(RenderGraph::Access access)
+		{
+			switch (access) {
+			case RenderGraph::Access::COLOR_ATTACHMENT: return "color attachment";
+			case RenderGraph::Access::DEPTH_ATTACHMENT: return "depth attachment";
+			case RenderGraph::Access::FRAGMENT_SAMPLED: return "fragment sampled";
+			case RenderGraph::Access::COMPUTE_SAMPLED: return "compute sampled";
+			case RenderGraph::Access::TRANSFER_SOURCE: return "transfer source";
+			case RenderGraph::Access::TRANSFER_DESTINATION: return "transfer destination";
+			}
+			return "unknown";
+		}
+	}
+
+	RenderGraph::ImageHandle RenderGraph::PassBuilder::createImage(const std::string& name, VkFormat format, VkExtent2D extent)
+	{
+		Image image{};
+		image.name = name;
+		image.format = format;
+		image.extent = extent;
+		image.imported = false;
+		return graph_.addImage(std::move(image));
+	}
+
+	void RenderGraph::PassBuilder::writeColor(ImageHandle image, std::optional<VkClearColorValue> clear)
+	{
+		VkClearValue clearValue{};
+		if (clear) {
+			clearValue.color = *clear;
+		}
+		graph_.addUse(passIndex_, ImageUse{image, Access::COLOR_ATTACHMENT, true, clear.has_value(), clearValue});
+	}
+
+	void RenderGraph::PassBuilder::writeDepth(ImageHandle image, std::optional<VkClearDepthStencilValue> clear)
+	{
+		VkClearValue clearValue{};
+		if (clear) {
+			clearValue.depthStencil = *clear;
+		}
+		graph_.addUse(passIndex_, ImageUse{image, Access::DEPTH_ATTACHMENT, true, clear.has_value(), clearValue});
+	}
+
+	void RenderGraph::PassBuilder::read(ImageHandle image, Access access)
+	{
+		assert(!isAttachment(access) && "Attachments are written with writeColor or writeDepth");
+		graph_.addUse(passIndex_, ImageUse{image, access, false, false, VkClearValue{}});
+	}
+
+	void RenderGraph::PassBuilder::write(ImageHandle image, Access access)
+	{
+		assert(!isAttachment(access) && "Attachments are written with writeColor or writeDepth");
+		graph_.addUse(passIndex_, ImageUse{image, access, true, false, VkClearValue{}});
+	}
+
+	void RenderGraph::PassBuilder::setSideEffects()
+	{
+		graph_.passes_[passIndex_].sideEffects = true;
+	}
+
+	RenderGraph::RenderGraph(BveDevice& device, uint32_t frameCount) : bveDevice_{device}
+	{
+		frames_.resize(frameCount);
+	}
+
+	size_t RenderGraph::KeyHash::operator()(const RenderPassKey& key) const
+	{
+		size_t seed = 0;
+		for (const RenderPassKey::Attachment& attachment : key.attachments) {
+			hashCombine(seed, attachment.format, attachment.loadOp, attachment.storeOp, attachment.layout);
+		}
+		return seed;
+	}
+
+	size_t RenderGraph::KeyHash::operator()(const FramebufferKey& key) const
+	{
+		size_t seed = 0;
+		hashCombine(seed, key.renderPass, key.width, key.height);
+		for (VkImageView view : key.views) {
+			hashCombine(seed, view);
+		}
+		return seed;
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		for (auto& frame : frames_) {
+			destroyTransientImages(frame);
+		}
+		for (const auto& [key, renderPass] : renderPasses_) {
+			vkDestroyRenderPass(bveDevice_.device(), renderPass, nullptr);
+		}
+	}
+
+	void RenderGraph::beginFrame(int frameIndex)
+	{
+		assert(frameIndex >= 0 && frameIndex < static_cast<int>(frames_.size()) && "Frame index out of range");
+
+		frameIndex_ = frameIndex;
+		compiled_ = false;
+		passes_.clear();
+		images_.clear();
+		finalBarriers_.clear();
+	}
+
+	RenderGraph::ImageHandle RenderGraph::importImage(
+		const std::string& name,
+		VkImage image,
+		VkImageView view,
+		VkFormat format,
+		VkExtent2D extent,
+		VkImageLayout initialLayout,
+		VkImageLayout finalLayout)
+	{
+		Image imported{};
+		imported.name = name;
+		imported.format = format;
+		imported.extent = extent;
+		imported.imported = true;
+		imported.image = image;
+		imported.view = view;
+		imported.initialLayout = initialLayout;
+		imported.finalLayout = finalLayout;
+		return addImage(std::move(imported));
+	}
+
+	void RenderGraph::addPass(const std::string& name, const SetupFn& setup, ExecuteFn execute)
+	{
+		assert(!compiled_ && "Cannot add passes to a compiled graph");
+
+		passes_.push_back(Pass{name, std::move(execute)});
+		PassBuilder builder{*this, static_cast<uint32_t>(passes_.size() - 1)};
+		setup(builder);
+	}
+
+	RenderGraph::ImageHandle RenderGraph::addImage(Image image)
+	{
+		images_.push_back(std::move(image));
+		return static_cast<ImageHandle>(images_.size() - 1);
+	}
+
+	void RenderGraph::addUse(uint32_t passIndex, ImageUse use)
+	{
+		assert(use.image < images_.size() && "Unknown image handle");
+
+		auto& uses = passes_[passIndex].uses;
+		assert(std::none_of(uses.begin(), uses.end(), [&](const ImageUse& other) { return other.image == use.image; }) &&
+			"A pass can only use an image once");
+		uses.push_back(use);
+	}
+
+	RenderGraph::AccessInfo RenderGraph::getAccessInfo(Access access)
+	{
+		switch (access) {
+		case Access::COLOR_ATTACHMENT:
+			return {
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+		case Access::DEPTH_ATTACHMENT:
+			return {
+				VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+				VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+		case Access::FRAGMENT_SAMPLED:
+			return {
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_IMAGE_USAGE_SAMPLED_BIT};
+		case Access::COMPUTE_SAMPLED:
+			return {
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_IMAGE_USAGE_SAMPLED_BIT};
+		case Access::TRANSFER_SOURCE:
+			return {
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+		case Access::TRANSFER_DESTINATION:
+			return {
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+		}
+
+		throw std::runtime_error("Unknown render graph access");
+	}
+
+	bool RenderGraph::isAttachment(Access access)
+	{
+		return access == Access::COLOR_ATTACHMENT || access == Access::DEPTH_ATTACHMENT;
+	}
+
+	VkImageAspectFlags RenderGraph::getAspectMask(VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+	}
+
+	void RenderGraph::compile()
+	{
+		assert(!compiled_ && "Graph is already compiled");
+
+		cullPasses();
+		computeLifetimes();
+		createTransientImages();
+		computeBarriers();
+		createRenderPasses();
+
+		compiled_ = true;
+	}
+
+	void RenderGraph::cullPasses()
+	{
+		// walk backwards from the imported images and side effects, a pass lives if a later live pass or the
+		// outside world needs something it writes. Clearing writes end the need for earlier contents.
+		std::vector<bool> needed(images_.size(), false);
+		for (size_t i = 0; i < images_.size(); i++) {
+			needed[i] = images_[i].imported;
+		}
+
+		for (auto pass = passes_.rbegin(); pass != passes_.rend(); ++pass) {
+			bool live = pass->sideEffects;
+			for (const auto& use : pass->uses) {
+				live |= use.write && needed[use.image];
+			}
+
+			pass->culled = !live;
+			if (!live) {
+				continue;
+			}
+
+			for (const auto& use : pass->uses) {
+				if (use.write && use.clear) {
+					needed[use.image] = false;
+				}
+			}
+			for (const auto& use : pass->uses) {
+				if (!use.write || !use.clear) {
+					needed[use.image] = true;
+				}
+			}
+		}
+	}
+
+	void RenderGraph::computeLifetimes()
+	{
+		for (uint32_t passIndex = 0; passIndex < passes_.size(); passIndex++) {
+			const Pass& pass = passes_[passIndex];
+			if (pass.culled) {
+				continue;
+			}
+
+			for (const auto& use : pass.uses) {
+				Image& image = images_[use.image];
+				image.usage |= getAccessInfo(use.access).usage;
+				image.firstPass = std::min(image.firstPass, passIndex);
+				image.lastPass = std::max(image.lastPass, passIndex);
+			}
+		}
+	}
+
+	void RenderGraph::createTransientImages()
+	{
+		std::vector<ImageHandle> transients;
+		size_t signature = 0;
+		for (ImageHandle i = 0; i < images_.size(); i++) {
+			const Image& image = images_[i];
+			if (!image.imported && image.firstPass != UINT32_MAX) {
+				transients.push_back(i);
+				hashCombine(signature, image.format, image.extent.width, image.extent.height, image.usage, image.firstPass, image.lastPass);
+			}
+		}
+
+		FrameResources& frame = frames_[frameIndex_];
+		if (frame.signature != signature || frame.images.size() != transients.size()) {
+			// the frame's fence has signaled, so nothing in flight still uses its images
+			destroyTransientImages(frame);
+			frame.signature = signature;
+
+			std::vector<VkMemoryRequirements> requirements(transients.size());
+			for (size_t i = 0; i < transients.size(); i++) {
+				const Image& image = images_[transients[i]];
+
+				VkImageCreateInfo imageInfo{};
+				imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+				imageInfo.imageType = VK_IMAGE_TYPE_2D;
+				imageInfo.extent = {image.extent.width, image.extent.height, 1};
+				imageInfo.mipLevels = 1;
+				imageInfo.arrayLayers = 1;
+				imageInfo.format = image.format;
+				imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				imageInfo.usage = image.usage;
+				imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+				imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+				VkImage vkImage;
+				if (vkCreateImage(bveDevice_.device(), &imageInfo, nullptr, &vkImage) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create render graph image");
+				}
+				frame.images.push_back(vkImage);
+				vkGetImageMemoryRequirements(bveDevice_.device(), vkImage, &requirements[i]);
+			}
+
+			// greedy placement in order of first use: reuse the slot whose previous occupant is already dead
+			// and whose size is closest to what is needed, growing it if nothing is large enough
+			struct Slot
+			{
+				VkDeviceSize size;
+				uint32_t memoryTypeBits;
+				uint32_t lastPass;
+				uint32_t lastImage;
+			};
+			std::vector<Slot> slots;
+			std::vector<size_t> order(transients.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+				return images_[transients[a]].firstPass < images_[transients[b]].firstPass;
+			});
+
+			frame.imageSlots.assign(transients.size(), UINT32_MAX);
+			frame.previousAliases.assign(transients.size(), UINT32_MAX);
+			frame.imageSizes.assign(transients.size(), 0);
+			for (size_t i : order) {
+				const Image& image = images_[transients[i]];
+				const VkMemoryRequirements& requirement = requirements[i];
+
+				uint32_t best = UINT32_MAX;
+				for (uint32_t s = 0; s < slots.size(); s++) {
+					const Slot& slot = slots[s];
+					if (slot.lastPass >= image.firstPass || (slot.memoryTypeBits & requirement.memoryTypeBits) == 0) {
+						continue;
+					}
+
+					if (best == UINT32_MAX) {
+						best = s;
+						continue;
+					}
+
+					// prefer the smallest slot that fits, otherwise the largest one so it grows the least
+					const bool fits = slot.size >= requirement.size;
+					const bool bestFits = slots[best].size >= requirement.size;
+					if ((fits && (!bestFits || slot.size < slots[best].size)) || (!fits && !bestFits && slot.size > slots[best].size)) {
+						best = s;
+					}
+				}
+
+				if (best == UINT32_MAX) {
+					slots.push_back(Slot{0, requirement.memoryTypeBits, 0, UINT32_MAX});
+					best = static_cast<uint32_t>(slots.size() - 1);
+				} else {
+					frame.previousAliases[i] = slots[best].lastImage;
+				}
+
+				Slot& slot = slots[best];
+				slot.size = std::max(slot.size, requirement.size);
+				slot.memoryTypeBits &= requirement.memoryTypeBits;
+				slot.lastPass = image.lastPass;
+				slot.lastImage = static_cast<uint32_t>(i);
+				frame.imageSlots[i] = best;
+				frame.imageSizes[i] = requirement.size;
+			}
+
+			for (const Slot& slot : slots) {
+				VkMemoryAllocateInfo allocInfo{};
+				allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+				allocInfo.allocationSize = slot.size;
+				allocInfo.memoryTypeIndex = bveDevice_.findMemoryType(slot.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+				VkDeviceMemory memory;
+				if (vkAllocateMemory(bveDevice_.device(), &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to allocate render graph memory");
+				}
+				frame.memory.push_back(memory);
+				frame.slotSizes.push_back(slot.size);
+			}
+
+			for (size_t i = 0; i < transients.size(); i++) {
+				const Image& image = images_[transients[i]];
+				vkBindImageMemory(bveDevice_.device(), frame.images[i], frame.memory[frame.imageSlots[i]], 0);
+
+				VkImageViewCreateInfo viewInfo{};
+				viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				viewInfo.image = frame.images[i];
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = image.format;
+				viewInfo.subresourceRange.aspectMask = getAspectMask(image.format);
+				viewInfo.subresourceRange.baseMipLevel = 0;
+				viewInfo.subresourceRange.levelCount = 1;
+				viewInfo.subresourceRange.baseArrayLayer = 0;
+				viewInfo.subresourceRange.layerCount = 1;
+
+				VkImageView view;
+				if (vkCreateImageView(bveDevice_.device(), &viewInfo, nullptr, &view) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create render graph image view");
+				}
+				frame.views.push_back(view);
+			}
+		}
+
+		for (size_t i = 0; i < transients.size(); i++) {
+			Image& image = images_[transients[i]];
+			image.image = frame.images[i];
+			image.view = frame.views[i];
+			image.memorySlot = frame.imageSlots[i];
+			image.size = frame.imageSizes[i];
+			image.previousAlias = frame.previousAliases[i] == UINT32_MAX ? UINT32_MAX : transients[frame.previousAliases[i]];
+		}
+	}
+
+	void RenderGraph::destroyTransientImages(FrameResources& frame)
+	{
+		// framebuffers may reference the views being destroyed
+		for (const auto& [key, cached] : frame.framebuffers) {
+			vkDestroyFramebuffer(bveDevice_.device(), cached.framebuffer, nullptr);
+		}
+		frame.framebuffers.clear();
+
+		for (VkImageView view : frame.views) {
+			vkDestroyImageView(bveDevice_.device(), view, nullptr);
+		}
+		for (VkImage image : frame.images) {
+			vkDestroyImage(bveDevice_.device(), image, nullptr);
+		}
+		for (VkDeviceMemory memory : frame.memory) {
+			vkFreeMemory(bveDevice_.device(), memory, nullptr);
+		}
+
+		frame.views.clear();
+		frame.images.clear();
+		frame.memory.clear();
+		frame.imageSlots.clear();
+		frame.previousAliases.clear();
+		frame.imageSizes.clear();
+		frame.slotSizes.clear();
+		frame.signature = 0;
+	}
+
+	void RenderGraph::computeBarriers()
+	{
+		std::vector<ImageState> states(images_.size());
+
+		auto makeBarrier = [&](ImageHandle handle, VkImageLayout oldLayout, VkAccessFlags srcAccess, const AccessInfo& dst) {
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = dst.access;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = dst.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = images_[handle].image;
+			barrier.subresourceRange.aspectMask = getAspectMask(images_[handle].format);
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
+			return barrier;
+		};
+
+		for (uint32_t passIndex = 0; passIndex < passes_.size(); passIndex++) {
+			Pass& pass = passes_[passIndex];
+			pass.barriers.clear();
+			pass.srcStages = 0;
+			pass.dstStages = 0;
+			if (pass.culled) {
+				continue;
+			}
+
+			for (auto& use : pass.uses) {
+				const Image& image = images_[use.image];
+				const AccessInfo info = getAccessInfo(use.access);
+				ImageState& state = states[use.image];
+
+				VkPipelineStageFlags srcStages = 0;
+				VkAccessFlags srcAccess = 0;
+				VkImageLayout oldLayout = state.layout;
+				bool needsBarrier = false;
+
+				if (!state.touched) {
+					if (image.imported) {
+						// the first access stage also waits on whatever semaphore guards the image, e.g. swap chain acquire
+						oldLayout = image.initialLayout;
+						srcStages = info.stages;
+						needsBarrier = oldLayout != info.layout;
+					} else {
+						// contents are never carried over from another frame or the previous image in this memory
+						oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+						if (image.previousAlias != UINT32_MAX) {
+							srcStages = states[image.previousAlias].allStages;
+							srcAccess = states[image.previousAlias].allWriteAccess;
+						}
+						needsBarrier = true;
+					}
+					use.loadOp = use.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : (image.imported && oldLayout != VK_IMAGE_LAYOUT_UNDEFINED ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+				} else {
+					if (state.layout != info.layout) {
+						// layout transitions are read-modify-write, so they wait on every earlier access
+						srcStages = state.writeStages | state.readStages;
+						srcAccess = state.writeAccess;
+						needsBarrier = true;
+					} else if (use.write) {
+						// write after read only needs an execution dependency, write after write needs the memory one too
+						srcStages = state.readStages != 0 ? state.readStages : state.writeStages;
+						srcAccess = state.readStages != 0 ? 0 : state.writeAccess;
+						needsBarrier = srcStages != 0;
+					} else if ((info.stages & ~state.visibleStages) != 0 && state.writeStages != 0) {
+						srcStages = state.writeStages;
+						srcAccess = state.writeAccess;
+						needsBarrier = true;
+					}
+					use.loadOp = use.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+				}
+
+				// attachment contents only need to be stored if something later, or outside the graph, reads them
+				use.storeOp = image.imported || image.lastPass > passIndex ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+				if (needsBarrier) {
+					pass.barriers.push_back(makeBarrier(use.image, oldLayout, srcAccess, info));
+					pass.srcStages |= srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+					pass.dstStages |= info.stages;
+				}
+
+				state.touched = true;
+				state.layout = info.layout;
+				state.allStages |= info.stages;
+				if (use.write) {
+					state.writeStages = info.stages;
+					state.writeAccess = info.access;
+					state.allWriteAccess |= info.access;
+					state.readStages = 0;
+					state.visibleStages = info.stages;
+				} else {
+					state.readStages |= info.stages;
+					state.visibleStages |= info.stages;
+				}
+			}
+		}
+
+		// hand imported images back in the layout the outside world expects
+		finalSrcStages_ = 0;
+		finalDstStages_ = 0;
+		for (ImageHandle i = 0; i < images_.size(); i++) {
+			const Image& image = images_[i];
+			const ImageState& state = states[i];
+			if (!image.imported || !state.touched || image.finalLayout == state.layout || image.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
+				continue;
+			}
+
+			AccessInfo final{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, image.finalLayout, 0};
+			finalBarriers_.push_back(makeBarrier(i, state.layout, state.writeAccess, final));
+			finalSrcStages_ |= state.writeStages | state.readStages;
+			finalDstStages_ |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		}
+	}
+
+	void RenderGraph::createRenderPasses()
+	{
+		FrameResources& frame = frames_[frameIndex_];
+		frame.compileCount++;
+
+		for (Pass& pass : passes_) {
+			pass.renderPass = VK_NULL_HANDLE;
+			pass.framebuffer = VK_NULL_HANDLE;
+			pass.clearValues.clear();
+			if (pass.culled) {
+				continue;
+			}
+
+			bool hasAttachments = false;
+			for (const auto& use : pass.uses) {
+				if (isAttachment(use.access)) {
+					const Image& image = images_[use.image];
+					assert((!hasAttachments || (image.extent.width == pass.extent.width && image.extent.height == pass.extent.height)) &&
+						"All attachments of a pass must have the same extent");
+					pass.extent = image.extent;
+					hasAttachments = true;
+				}
+			}
+
+			if (!hasAttachments) {
+				continue;
+			}
+
+			pass.renderPass = getRenderPass(pass);
+			pass.framebuffer = getFramebuffer(pass);
+
+			// clear values are indexed by attachment, colors first then depth, matching getRenderPass
+			for (Access kind : {Access::COLOR_ATTACHMENT, Access::DEPTH_ATTACHMENT}) {
+				for (const auto& use : pass.uses) {
+					if (use.access == kind) {
+						pass.clearValues.push_back(use.clearValue);
+					}
+				}
+			}
+		}
+
+		evictFramebuffers(frame);
+	}
+
+	VkRenderPass RenderGraph::getRenderPass(const Pass& pass)
+	{
+		std::vector<VkAttachmentDescription> attachments;
+		std::vector<VkAttachmentReference> colorReferences;
+		std::optional<VkAttachmentReference> depthReference;
+		RenderPassKey key{};
+
+		// colors come first and depth last, which keeps passes compatible with pipelines built for the swap chain pass
+		for (Access kind : {Access::COLOR_ATTACHMENT, Access::DEPTH_ATTACHMENT}) {
+			for (const auto& use : pass.uses) {
+				if (use.access != kind) {
+					continue;
+				}
+
+				const VkImageLayout layout = getAccessInfo(use.access).layout;
+				VkAttachmentDescription attachment{};
+				attachment.format = images_[use.image].format;
+				attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+				attachment.loadOp = use.loadOp;
+				attachment.storeOp = use.storeOp;
+				attachment.stencilLoadOp = use.loadOp;
+				attachment.stencilStoreOp = use.storeOp;
+				// render passes never transition layouts themselves, barriers outside of them do
+				attachment.initialLayout = layout;
+				attachment.finalLayout = layout;
+
+				VkAttachmentReference reference{static_cast<uint32_t>(attachments.size()), layout};
+				if (kind == Access::COLOR_ATTACHMENT) {
+					colorReferences.push_back(reference);
+				} else {
+					assert(!depthReference && "A pass can only have one depth attachment");
+					depthReference = reference;
+				}
+
+				attachments.push_back(attachment);
+				key.attachments.push_back({attachment.format, attachment.loadOp, attachment.storeOp, layout});
+			}
+		}
+
+		auto it = renderPasses_.find(key);
+		if (it != renderPasses_.end()) {
+			return it->second;
+		}
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+		subpass.pColorAttachments = colorReferences.data();
+		subpass.pDepthStencilAttachment = depthReference ? &*depthReference : nullptr;
+
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+
+		VkRenderPass renderPass;
+		if (vkCreateRenderPass(bveDevice_.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create render graph render pass");
+		}
+
+		renderPasses_.emplace(std::move(key), renderPass);
+		return renderPass;
+	}
+
+	VkFramebuffer RenderGraph::getFramebuffer(const Pass& pass)
+	{
+		FramebufferKey key{pass.renderPass, pass.extent.width, pass.extent.height, {}};
+		for (Access kind : {Access::COLOR_ATTACHMENT, Access::DEPTH_ATTACHMENT}) {
+			for (const auto& use : pass.uses) {
+				if (use.access == kind) {
+					key.views.push_back(images_[use.image].view);
+				}
+			}
+		}
+
+		FrameResources& frame = frames_[frameIndex_];
+		auto it = frame.framebuffers.find(key);
+		if (it != frame.framebuffers.end()) {
+			it->second.lastUse = frame.compileCount;
+			return it->second.framebuffer;
+		}
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = pass.renderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(key.views.size());
+		framebufferInfo.pAttachments = key.views.data();
+		framebufferInfo.width = pass.extent.width;
+		framebufferInfo.height = pass.extent.height;
+		framebufferInfo.layers = 1;
+
+		VkFramebuffer framebuffer;
+		if (vkCreateFramebuffer(bveDevice_.device(), &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create render graph framebuffer");
+		}
+
+		frame.framebuffers.emplace(std::move(key), CachedFramebuffer{framebuffer, frame.compileCount});
+		return framebuffer;
+	}
+
+	void RenderGraph::evictFramebuffers(FrameResources& frame)
+	{
+		// a framebuffer this frame slot has not used recently is no longer referenced by anything in flight
+		for (auto it = frame.framebuffers.begin(); it != frame.framebuffers.end();) {
+			if (it->second.lastUse + FRAMEBUFFER_EVICT_AGE < frame.compileCount) {
+				vkDestroyFramebuffer(bveDevice_.device(), it->second.framebuffer, nullptr);
+				it = frame.framebuffers.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	void RenderGraph::releaseFramebuffers()
+	{
+		for (auto& frame : frames_) {
+			for (const auto& [key, cached] : frame.framebuffers) {
+				vkDestroyFramebuffer(bveDevice_.device(), cached.framebuffer, nullptr);
+			}
+			frame.framebuffers.clear();
+		}
+	}
+
+	void RenderGraph::execute(VkCommandBuffer commandBuffer, VulkanParallelRecorder& recorder)
+	{
+		assert(compiled_ && "Cannot execute a graph before compiling it");
+
+		for (Pass& pass : passes_) {
+			if (pass.culled) {
+				continue;
+			}
+
+			// one barrier call per pass covering every image it uses
+			if (!pass.barriers.empty()) {
+				vkCmdPipelineBarrier(
+					commandBuffer,
+					pass.srcStages,
+					pass.dstStages,
+					0,
+					0,
+					nullptr,
+					0,
+					nullptr,
+					static_cast<uint32_t>(pass.barriers.size()),
+					pass.barriers.data());
+			}
+
+			PassContext context{commandBuffer, recorder, pass.renderPass, pass.extent};
+			if (pass.renderPass == VK_NULL_HANDLE) {
+				pass.execute(context);
+				continue;
+			}
+
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = pass.renderPass;
+			renderPassInfo.framebuffer = pass.framebuffer;
+			renderPassInfo.renderArea.offset = {0, 0};
+			renderPassInfo.renderArea.extent = pass.extent;
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+			renderPassInfo.pClearValues = pass.clearValues.data();
+
+			// pass contents are always recorded into secondaries through the recorder
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			recorder.beginRenderPass(commandBuffer, pass.renderPass, pass.framebuffer, pass.extent);
+			pass.execute(context);
+			vkCmdEndRenderPass(commandBuffer);
+		}
+
+		if (!finalBarriers_.empty()) {
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				finalSrcStages_ != 0 ? finalSrcStages_ : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				finalDstStages_,
+				0,
+				0,
+				nullptr,
+				0,
+				nullptr,
+				static_cast<uint32_t>(finalBarriers_.size()),
+				finalBarriers_.data());
+		}
+	}
+
+	VkImageView RenderGraph::getImageView(ImageHandle image) const
+	{
+		assert(compiled_ && "Image views are only known after compile");
+		assert(image < images_.size() && "Unknown image handle");
+		return images_[image].view;
+	}
+
+	std::string RenderGraph::dump() const
+	{
+		std::ostringstream out;
+
+		const FrameResources& frame = frames_[frameIndex_];
+		VkDeviceSize requested = 0;
+		VkDeviceSize allocated = 0;
+		for (const Image& image : images_) {
+			requested += image.size;
+		}
+		for (VkDeviceSize size : frame.slotSizes) {
+			allocated += size;
+		}
+
+		const size_t culledCount = std::count_if(passes_.begin(), passes_.end(), [](const Pass& pass) { return pass.culled; });
+		out << "render graph: " << passes_.size() << " passes (" << culledCount << " culled), " << images_.size() << " images\n";
+		out << std::fixed << std::setprecision(2)
+			<< "transient memory: " << allocated / (1024.0 * 1024.0) << " MiB in " << frame.slotSizes.size()
+			<< " allocations, " << requested / (1024.0 * 1024.0) << " MiB without aliasing\n";
+
+		for (size_t p = 0; p < passes_.size(); p++) {
+			const Pass& pass = passes_[p];
+			out << "pass " << p << " \"" << pass.name << "\"";
+			if (pass.culled) {
+				out << " [culled]\n";
+				continue;
+			}
+			if (pass.renderPass != VK_NULL_HANDLE) {
+				out << " " << pass.extent.width << "x" << pass.extent.height;
+			}
+			out << "\n";
+
+			for (const auto& barrier : pass.barriers) {
+				const auto image = std::find_if(images_.begin(), images_.end(), [&](const Image& i) { return i.image == barrier.image; });
+				out << "    barrier " << (image != images_.end() ? image->name : "?") << ": "
+					<< layoutName(barrier.oldLayout) << " -> " << layoutName(barrier.newLayout) << "\n";
+			}
+
+			for (const auto& use : pass.uses) {
+				out << "    " << (use.write ? "write " : "read ") << images_[use.image].name << " as " << accessName(use.access);
+				if (isAttachment(use.access)) {
+					out << (use.loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR ? ", clear" : use.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? ", load" : ", don't care")
+						<< (use.storeOp == VK_ATTACHMENT_STORE_OP_STORE ? ", store" : ", discard");
+				}
+				out << "\n";
+			}
+		}
+
+		for (const auto& barrier : finalBarriers_) {
+			const auto image = std::find_if(images_.begin(), images_.end(), [&](const Image& i) { return i.image == barrier.image; });
+			out << "final barrier " << (image != images_.end() ? image->name : "?") << ": "
+				<< layoutName(barrier.oldLayout) << " -> " << layoutName(barrier.newLayout) << "\n";
+		}
+
+		for (const Image& image : images_) {
+			out << "image \"" << image.name << "\" " << image.extent.width << "x" << image.extent.height;
+			if (image.imported) {
+				out << " imported\n";
+			} else if (image.firstPass == UINT32_MAX) {
+				out << " unused\n";
+			} else {
+				out << " passes " << image.firstPass << "-" << image.lastPass << ", memory slot " << image.memorySlot
+					<< ", " << image.size / 1024 << " KiB";
+				if (image.previousAlias != UINT32_MAX) {
+					out << ", aliases \"" << images_[image.previousAlias].name << "\"";
+				}
+				out << "\n";
+			}
+		}
+
+		return out.str();
+	}
+}
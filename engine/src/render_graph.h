@@ -0,0 +1,247 @@
+#pragma once
+
+#include "bve_device.h"
+#include "vulkan_parallel_recorder.h"
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bve
+{
+	// Frame graph rebuilt every frame. Passes declare which images they read and write, compile() culls
+	// passes whose output is never used, derives the barriers and layout transitions between passes and
+	// places transient images with non-overlapping lifetimes in the same memory. Vulkan objects are cached
+	// across frames, so an unchanged graph costs no allocations after the first frame.
+	class RenderGraph
+	{
+	public:
+		using ImageHandle = uint32_t;
+
+		enum class Access
+		{
+			COLOR_ATTACHMENT,
+			DEPTH_ATTACHMENT,
+			FRAGMENT_SAMPLED,
+			COMPUTE_SAMPLED,
+			TRANSFER_SOURCE,
+			TRANSFER_DESTINATION,
+		};
+
+		class PassBuilder
+		{
+		public:
+			ImageHandle createImage(const std::string& name, VkFormat format, VkExtent2D extent);
+
+			// attachments are cleared when a clear value is given, otherwise their previous contents are loaded
+			void writeColor(ImageHandle image, std::optional<VkClearColorValue> clear = std::nullopt);
+			void writeDepth(ImageHandle image, std::optional<VkClearDepthStencilValue> clear = std::nullopt);
+
+			void read(ImageHandle image, Access access = Access::FRAGMENT_SAMPLED);
+			void write(ImageHandle image, Access access);
+
+			// the pass is kept even if nothing reads what it writes
+			void setSideEffects();
+
+		private:
+			friend class RenderGraph;
+			PassBuilder(RenderGraph& graph, uint32_t passIndex) : graph_{graph}, passIndex_{passIndex} {}
+
+			RenderGraph& graph_;
+			uint32_t passIndex_;
+		};
+
+		struct PassContext
+		{
+			VkCommandBuffer commandBuffer; // primary, only record into it directly from passes without attachments
+			VulkanParallelRecorder& recorder; // records into the pass's render pass
+			VkRenderPass renderPass;
+			VkExtent2D extent;
+		};
+
+		using SetupFn = std::function<void(PassBuilder& builder)>;
+		using ExecuteFn = std::function<void(PassContext& context)>;
+
+		RenderGraph(BveDevice& device, uint32_t frameCount);
+		~RenderGraph();
+
+		RenderGraph(const RenderGraph&) = delete;
+		RenderGraph& operator=(const RenderGraph&) = delete;
+		RenderGraph(const RenderGraph&&) = delete;
+		RenderGraph& operator=(const RenderGraph&&) = delete;
+
+		// clears the previous frame's passes, only call once the frame's in flight fence has signaled
+		void beginFrame(int frameIndex);
+
+		ImageHandle importImage(
+			const std::string& name,
+			VkImage image,
+			VkImageView view,
+			VkFormat format,
+			VkExtent2D extent,
+			VkImageLayout initialLayout,
+			VkImageLayout finalLayout);
+
+		// setup runs immediately, execute runs from execute() if the pass survives culling
+		void addPass(const std::string& name, const SetupFn& setup, ExecuteFn execute);
+
+		void compile();
+		void execute(VkCommandBuffer commandBuffer, VulkanParallelRecorder& recorder);
+
+		// valid after compile
+		VkImageView getImageView(ImageHandle image) const;
+
+		// human readable description of the compiled graph
+		std::string dump() const;
+
+		// cached framebuffers reference imported views, call with the device idle whenever those are recreated
+		void releaseFramebuffers();
+
+	private:
+		struct ImageUse
+		{
+			ImageHandle image;
+			Access access;
+			bool write;
+			bool clear;
+			VkClearValue clearValue;
+
+			// compiled
+			VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			VkAttachmentStoreOp storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			ExecuteFn execute;
+			std::vector<ImageUse> uses;
+			bool sideEffects = false;
+
+			// compiled
+			bool culled = false;
+			std::vector<VkImageMemoryBarrier> barriers;
+			VkPipelineStageFlags srcStages = 0;
+			VkPipelineStageFlags dstStages = 0;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			VkFramebuffer framebuffer = VK_NULL_HANDLE;
+			VkExtent2D extent{};
+			std::vector<VkClearValue> clearValues;
+		};
+
+		struct Image
+		{
+			std::string name;
+			VkFormat format;
+			VkExtent2D extent;
+			bool imported;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			// compiled
+			VkImageUsageFlags usage = 0;
+			uint32_t firstPass = UINT32_MAX;
+			uint32_t lastPass = 0;
+			uint32_t memorySlot = UINT32_MAX;
+			ImageHandle previousAlias = UINT32_MAX;
+			VkDeviceSize size = 0;
+		};
+
+		struct AccessInfo
+		{
+			VkPipelineStageFlags stages;
+			VkAccessFlags access;
+			VkImageLayout layout;
+			VkImageUsageFlags usage;
+		};
+
+		// everything a render pass is created from, attachments in the order getRenderPass adds them
+		struct RenderPassKey
+		{
+			struct Attachment
+			{
+				VkFormat format;
+				VkAttachmentLoadOp loadOp;
+				VkAttachmentStoreOp storeOp;
+				VkImageLayout layout;
+
+				bool operator==(const Attachment&) const = default;
+			};
+
+			std::vector<Attachment> attachments;
+
+			bool operator==(const RenderPassKey&) const = default;
+		};
+
+		struct FramebufferKey
+		{
+			VkRenderPass renderPass;
+			uint32_t width;
+			uint32_t height;
+			std::vector<VkImageView> views;
+
+			bool operator==(const FramebufferKey&) const = default;
+		};
+
+		struct KeyHash
+		{
+			size_t operator()(const RenderPassKey& key) const;
+			size_t operator()(const FramebufferKey& key) const;
+		};
+
+		struct CachedFramebuffer
+		{
+			VkFramebuffer framebuffer;
+			uint64_t lastUse;
+		};
+
+		// transient images are owned per frame in flight, so a frame never aliases memory the gpu may still be using
+		struct FrameResources
+		{
+			uint64_t signature = 0;
+			std::vector<VkImage> images;
+			std::vector<VkImageView> views;
+			std::vector<VkDeviceMemory> memory;
+			std::vector<uint32_t> imageSlots;
+			std::vector<uint32_t> previousAliases;
+			std::vector<VkDeviceSize> imageSizes;
+			std::vector<VkDeviceSize> slotSizes;
+			std::unordered_map<FramebufferKey, CachedFramebuffer, KeyHash> framebuffers;
+			uint64_t compileCount = 0;
+		};
+
+		static AccessInfo getAccessInfo(Access access);
+		static bool isAttachment(Access access);
+		static VkImageAspectFlags getAspectMask(VkFormat format);
+
+		ImageHandle addImage(Image image);
+		void addUse(uint32_t passIndex, ImageUse use);
+
+		void cullPasses();
+		void computeLifetimes();
+		void createTransientImages();
+		void destroyTransientImages(FrameResources& frame);
+		void computeBarriers();
+		void createRenderPasses();
+		VkRenderPass getRenderPass(const Pass& pass);
+		VkFramebuffer getFramebuffer(const Pass& pass);
+		void evictFramebuffers(FrameResources& frame);
+
+		BveDevice& bveDevice_;
+		std::vector<FrameResources> frames_;
+		int frameIndex_ = 0;
+		bool compiled_ = false;
+
+		std::vector<Pass> passes_;
+		std::vector<Image> images_;
+		std::vector<VkImageMemoryBarrier> finalBarriers_;
+		VkPipelineStageFlags finalSrcStages_ = 0;
+		VkPipelineStageFlags finalDstStages_ = 0;
+
+		std::unordered_map<RenderPassKey, VkRenderPass, KeyHash> renderPasses_;
+	};
+}
@@ -3,6 +3,7 @@
 
 #include "movement_system.h"
 #include "../components/components.h"
+#include "../core/profiler.h"
 #include <glm/gtc/matrix_transform.hpp>
 
 namespace bve
@@ -20,6 +21,7 @@ namespace bve
 
 	void CameraSystem::update(float aspectRatio)
 	{
+		IG_PROFILE_FUNCTION();
 		auto cameras = entityManager_.view<CameraComponent>();
 		for (auto&& [entity, cameraComp] : cameras) {
 			assert(entityManager_.hasComponent<TransformComponent>(entity) && "Camera must have a transform component");
@@ -0,0 +1,371 @@
+#include "../pch.h"
+#include "light_cluster_system.h"
+
+#include "../core/thread_pool.h"
+#include "../core/profiler.h"
+#include "../log.h"
+
+#include <bit>
+#include <cmath>
+#include <numbers>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BVE_LIGHT_CLUSTER_SSE2
+#endif
+
+namespace bve
+{
+	namespace
+	{
+		// a light's slice range is widened by this much so the rounding of approximateLog2 and of the shader's log
+		// can't move a light out of a slice it touches
+		constexpr float SLICE_PADDING = 1e-3f;
+
+		// 2 / ln 2 times the odd terms of the atanh series, log2(m) = 2 atanh(t) / ln 2 with t = (m - 1) / (m + 1)
+		constexpr float LOG2_C1 = 2.f / std::numbers::ln2_v<float>;
+		constexpr float LOG2_C3 = LOG2_C1 / 3.f;
+		constexpr float LOG2_C5 = LOG2_C1 / 5.f;
+		constexpr float LOG2_C7 = LOG2_C1 / 7.f;
+
+		// for positive normal floats. The mantissa is folded into [sqrt(1/2), sqrt(2)) so |t| < 0.172, where the
+		// truncated series is off by less than 1e-8 and float rounding dominates. Both paths use it so they agree
+		float approximateLog2(float x)
+		{
+			const uint32_t bits = std::bit_cast<uint32_t>(x);
+			float exponent = static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+			float mantissa = std::bit_cast<float>((bits & 0x007fffffu) | 0x3f800000u);
+			if (mantissa > std::numbers::sqrt2_v<float>) {
+				mantissa *= 0.5f;
+				exponent += 1.f;
+			}
+			const float t = (mantissa - 1.f) / (mantissa + 1.f);
+			const float t2 = t * t;
+			return exponent + t * (LOG2_C1 + t2 * (LOG2_C3 + t2 * (LOG2_C5 + t2 * LOG2_C7)));
+		}
+
+#ifdef BVE_LIGHT_CLUSTER_SSE2
+		__m128 approximateLog2x4(__m128 x)
+		{
+			const __m128i bits = _mm_castps_si128(x);
+			__m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+			__m128 mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+			const __m128 fold = _mm_cmpgt_ps(mantissa, _mm_set1_ps(std::numbers::sqrt2_v<float>));
+			mantissa = _mm_or_ps(_mm_and_ps(fold, _mm_mul_ps(mantissa, _mm_set1_ps(0.5f))), _mm_andnot_ps(fold, mantissa));
+			exponent = _mm_add_ps(exponent, _mm_and_ps(fold, _mm_set1_ps(1.f)));
+
+			const __m128 one = _mm_set1_ps(1.f);
+			const __m128 t = _mm_div_ps(_mm_sub_ps(mantissa, one), _mm_add_ps(mantissa, one));
+			const __m128 t2 = _mm_mul_ps(t, t);
+			__m128 series = _mm_add_ps(_mm_set1_ps(LOG2_C5), _mm_mul_ps(t2, _mm_set1_ps(LOG2_C7)));
+			series = _mm_add_ps(_mm_set1_ps(LOG2_C3), _mm_mul_ps(t2, series));
+			series = _mm_add_ps(_mm_set1_ps(LOG2_C1), _mm_mul_ps(t2, series));
+			return _mm_add_ps(exponent, _mm_mul_ps(t, series));
+		}
+#endif
+	}
+
+	LightClusterSystem::LightClusterSystem(EntityManager& entityManager) : entityManager_(entityManager)
+	{
+		sliceClusters_.resize(CLUSTER_Z);
+		sliceIndices_.resize(CLUSTER_Z);
+	}
+
+	LightClusterSystem::Allocations LightClusterSystem::update(const CameraComponent& camera, VulkanFrameAllocator& frameAllocator, GlobalUbo& ubo)
+	{
+		IG_PROFILE_FUNCTION();
+		const auto lightsAllocation = frameAllocator.allocate(LIGHTS_RANGE);
+		const auto clustersAllocation = frameAllocator.allocate(CLUSTERS_RANGE);
+		const auto lightIndicesAllocation = frameAllocator.allocate(LIGHT_INDICES_RANGE);
+		const auto lightBillboardsAllocation = frameAllocator.allocate(LIGHT_BILLBOARDS_RANGE);
+
+		gatherLights(static_cast<PointLight*>(lightsAllocation.data), static_cast<float*>(lightBillboardsAllocation.data));
+
+		// exponential slices keep clusters roughly cubic in view space, orthographic cameras may use a zero near plane
+		const float near = std::max(camera.near, 0.001f);
+		const float far = std::max(camera.far, near * 1.001f);
+		const float logDepthRange = std::log(far / near);
+		sliceScale_ = static_cast<float>(CLUSTER_Z) / logDepthRange;
+		sliceBias_ = -static_cast<float>(CLUSTER_Z) * std::log(near) / logDepthRange;
+
+		ThreadPool& threadPool = ThreadPool::instance();
+		threadPool.parallelFor(lightCount_, [&](uint32_t begin, uint32_t end) {
+			computeViewBounds(camera, begin, end);
+		}, 1024);
+
+		// each depth slice is an independent set of clusters, so slices are binned in parallel without sharing any output
+		threadPool.parallelFor(CLUSTER_Z, [&](uint32_t begin, uint32_t end) {
+			binSlices(camera, begin, end);
+		});
+
+		auto* clusters = static_cast<LightCluster*>(clustersAllocation.data);
+		auto* lightIndices = static_cast<uint32_t*>(lightIndicesAllocation.data);
+		uint32_t lightIndexCount = 0;
+		bool overflowed = false;
+
+		for (uint32_t slice = 0; slice < CLUSTER_Z; slice++) {
+			const auto& sliceClusters = sliceClusters_[slice];
+			const auto& sliceIndices = sliceIndices_[slice];
+
+			const uint32_t available = MAX_LIGHT_INDICES - lightIndexCount;
+			const uint32_t copyCount = std::min(static_cast<uint32_t>(sliceIndices.size()), available);
+			overflowed |= copyCount < sliceIndices.size();
+			if (copyCount > 0) {
+				memcpy(lightIndices + lightIndexCount, sliceIndices.data(), copyCount * sizeof(uint32_t));
+			}
+
+			// clusters that did not fit are truncated rather than dropped entirely
+			LightCluster* out = clusters + slice * CLUSTER_X * CLUSTER_Y;
+			for (size_t i = 0; i < sliceClusters.size(); i++) {
+				const LightCluster& cluster = sliceClusters[i];
+				const uint32_t count = cluster.offset < copyCount ? std::min(cluster.count, copyCount - cluster.offset) : 0;
+				out[i] = LightCluster{lightIndexCount + cluster.offset, count};
+			}
+
+			lightIndexCount += copyCount;
+		}
+
+		if (overflowed && !overflowWarned_) {
+			LOG_WARN("light cluster index list is full ({} entries), some lights will be skipped", MAX_LIGHT_INDICES);
+			overflowWarned_ = true;
+		}
+
+		uint32_t visibleLightCount = 0;
+		for (uint32_t i = 0; i < lightCount_; i++) {
+			visibleLightCount += sliceMin_[i] <= sliceMax_[i] ? 1 : 0;
+		}
+		stats_ = Stats{lightCount_, visibleLightCount, lightIndexCount};
+
+		ubo.clusterCount = glm::uvec4{CLUSTER_X, CLUSTER_Y, CLUSTER_Z, 0};
+		ubo.clusterDepth = glm::vec4{sliceScale_, sliceBias_, near, far};
+		ubo.numLights = static_cast<int>(lightCount_);
+
+		return Allocations{
+			lightsAllocation.dynamicOffset(),
+			clustersAllocation.dynamicOffset(),
+			lightIndicesAllocation.dynamicOffset(),
+			lightBillboardsAllocation.dynamicOffset()};
+	}
+
+	void LightClusterSystem::gatherLights(PointLight* lights, float* billboardRadii)
+	{
+		worldX_.clear();
+		worldY_.clear();
+		worldZ_.clear();
+		radius_.clear();
+
+		EntityComponentView<PointLightComponent> view = entityManager_.view<PointLightComponent>();
+		uint32_t index = 0;
+		for (const auto&& [entity, lightComponent] : view) {
+			if (entityManager_.hasComponent<TransformComponent>(entity)) {
+				// the frame allocations hold MAX_LIGHTS, lights past it are left out
+				if (index == MAX_LIGHTS) {
+					if (!lightLimitWarned_) {
+						LOG_WARN("more than {} point lights, the rest will be skipped", MAX_LIGHTS);
+						lightLimitWarned_ = true;
+					}
+					break;
+				}
+
+				// parented lights are placed and sized by their world transform
+				auto& transformComponent = entityManager_.getComponent<TransformComponent>(entity);
+				glm::vec3 position = transformComponent.translation;
+				float billboardRadius = transformComponent.scale.x;
+				if (entityManager_.hasComponent<WorldTransformComponent>(entity)) {
+					const glm::mat4& world = entityManager_.getComponent<WorldTransformComponent>(entity).matrix;
+					position = glm::vec3{world[3]};
+					billboardRadius = glm::length(glm::vec3{world[0]});
+				}
+				const glm::vec4& color = lightComponent.color;
+
+				// attenuation is 1 / d^2, so the brightest channel falls below the cutoff at this distance
+				const float brightest = std::max({color.r, color.g, color.b}) * color.w;
+				const float radius = std::sqrt(std::max(brightest, 0.f) / LIGHT_CUTOFF);
+
+				lights[index] = PointLight{glm::vec4{position, radius}, color};
+				billboardRadii[index] = billboardRadius;
+				worldX_.push_back(position.x);
+				worldY_.push_back(position.y);
+				worldZ_.push_back(position.z);
+				radius_.push_back(radius);
+				index++;
+			}
+		}
+
+		lightCount_ = index;
+		viewX_.resize(lightCount_);
+		viewY_.resize(lightCount_);
+		viewZ_.resize(lightCount_);
+		sliceMin_.resize(lightCount_);
+		sliceMax_.resize(lightCount_);
+	}
+
+	void LightClusterSystem::computeViewBounds(const CameraComponent& camera, uint32_t begin, uint32_t end)
+	{
+		const glm::mat4& view = camera.viewMatrix;
+		const float near = std::max(camera.near, 0.001f);
+		const float far = std::max(camera.far, near * 1.001f);
+		const int32_t lastSlice = static_cast<int32_t>(CLUSTER_Z) - 1;
+		// the slices are spaced by the natural log, the kernels take log2
+		const float sliceScale = sliceScale_ * std::numbers::ln2_v<float>;
+
+		uint32_t i = begin;
+#ifdef BVE_LIGHT_CLUSTER_SSE2
+		const __m128 row[3][4] = {
+			{_mm_set1_ps(view[0][0]), _mm_set1_ps(view[1][0]), _mm_set1_ps(view[2][0]), _mm_set1_ps(view[3][0])},
+			{_mm_set1_ps(view[0][1]), _mm_set1_ps(view[1][1]), _mm_set1_ps(view[2][1]), _mm_set1_ps(view[3][1])},
+			{_mm_set1_ps(view[0][2]), _mm_set1_ps(view[1][2]), _mm_set1_ps(view[2][2]), _mm_set1_ps(view[3][2])},
+		};
+		const __m128 nearPlane = _mm_set1_ps(near);
+		const __m128 farPlane = _mm_set1_ps(far);
+		const __m128 scale = _mm_set1_ps(sliceScale);
+		const __m128 bias = _mm_set1_ps(sliceBias_);
+		const __m128 padding = _mm_set1_ps(SLICE_PADDING);
+		const __m128 firstSliceFloat = _mm_setzero_ps();
+		const __m128 lastSliceFloat = _mm_set1_ps(static_cast<float>(lastSlice));
+		const __m128i hiddenMin = _mm_set1_epi32(lastSlice + 1);
+		const __m128i hiddenMax = _mm_set1_epi32(-1);
+		for (; i + 4 <= end; i += 4) {
+			const __m128 x = _mm_loadu_ps(worldX_.data() + i);
+			const __m128 y = _mm_loadu_ps(worldY_.data() + i);
+			const __m128 z = _mm_loadu_ps(worldZ_.data() + i);
+			const __m128 r = _mm_loadu_ps(radius_.data() + i);
+
+			__m128 transformed[3];
+			for (int axis = 0; axis < 3; axis++) {
+				transformed[axis] = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(row[axis][0], x), _mm_mul_ps(row[axis][1], y)),
+					_mm_add_ps(_mm_mul_ps(row[axis][2], z), row[axis][3]));
+			}
+			_mm_storeu_ps(viewX_.data() + i, transformed[0]);
+			_mm_storeu_ps(viewY_.data() + i, transformed[1]);
+			_mm_storeu_ps(viewZ_.data() + i, transformed[2]);
+
+			const __m128 zMin = _mm_sub_ps(transformed[2], r);
+			const __m128 zMax = _mm_add_ps(transformed[2], r);
+			const __m128i visible = _mm_castps_si128(_mm_and_ps(_mm_cmpgt_ps(zMax, nearPlane), _mm_cmplt_ps(zMin, farPlane)));
+
+			// clamped before truncating, which is what truncating and then clamping gives but needs no integer min / max
+			const __m128 sliceMin = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(approximateLog2x4(_mm_max_ps(zMin, nearPlane)), scale), bias), padding);
+			const __m128 sliceMax = _mm_add_ps(_mm_add_ps(_mm_mul_ps(approximateLog2x4(_mm_min_ps(zMax, farPlane)), scale), bias), padding);
+			const __m128i sliceMinIndex = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(sliceMin, firstSliceFloat), lastSliceFloat));
+			const __m128i sliceMaxIndex = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(sliceMax, firstSliceFloat), lastSliceFloat));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(sliceMin_.data() + i), _mm_or_si128(_mm_and_si128(visible, sliceMinIndex), _mm_andnot_si128(visible, hiddenMin)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(sliceMax_.data() + i), _mm_or_si128(_mm_and_si128(visible, sliceMaxIndex), _mm_andnot_si128(visible, hiddenMax)));
+		}
+#endif
+		for (; i < end; i++) {
+			const float x = worldX_[i];
+			const float y = worldY_[i];
+			const float z = worldZ_[i];
+			const float r = radius_[i];
+
+			const float viewX = view[0][0] * x + view[1][0] * y + view[2][0] * z + view[3][0];
+			const float viewY = view[0][1] * x + view[1][1] * y + view[2][1] * z + view[3][1];
+			const float viewZ = view[0][2] * x + view[1][2] * y + view[2][2] * z + view[3][2];
+			viewX_[i] = viewX;
+			viewY_[i] = viewY;
+			viewZ_[i] = viewZ;
+
+			const float zMin = viewZ - r;
+			const float zMax = viewZ + r;
+			const bool visible = zMax > near && zMin < far;
+
+			const float sliceMin = approximateLog2(std::max(zMin, near)) * sliceScale + sliceBias_ - SLICE_PADDING;
+			const float sliceMax = approximateLog2(std::min(zMax, far)) * sliceScale + sliceBias_ + SLICE_PADDING;
+			sliceMin_[i] = visible ? static_cast<int32_t>(std::clamp(sliceMin, 0.f, static_cast<float>(lastSlice))) : lastSlice + 1;
+			sliceMax_[i] = visible ? static_cast<int32_t>(std::clamp(sliceMax, 0.f, static_cast<float>(lastSlice))) : -1;
+		}
+	}
+
+	template <typename F>
+	void LightClusterSystem::forEachTileRect(const CameraComponent& camera, uint32_t slice, F&& func) const
+	{
+		const glm::mat4& projection = camera.projectionMatrix;
+		const bool perspective = camera.mode == ProjectionMode::PERSPECTIVE;
+		const float sliceNear = std::exp((static_cast<float>(slice) - sliceBias_) / sliceScale_);
+		const float sliceFar = std::exp((static_cast<float>(slice + 1) - sliceBias_) / sliceScale_);
+
+		auto toTile = [](float ndc, uint32_t tiles) {
+			return std::clamp(static_cast<int32_t>((ndc + 1.f) * 0.5f * static_cast<float>(tiles)), 0, static_cast<int32_t>(tiles) - 1);
+		};
+
+		// extent of [lo, hi] over the slab after projection, corners of the box bound x / z since z > 0
+		auto project = [&](float lo, float hi, float scale, float bias, float zNear, float zFar, float& outMin, float& outMax) {
+			if (perspective) {
+				const float a = lo * scale / zNear;
+				const float b = lo * scale / zFar;
+				const float c = hi * scale / zNear;
+				const float d = hi * scale / zFar;
+				outMin = std::min({a, b, c, d});
+				outMax = std::max({a, b, c, d});
+			} else {
+				const float a = lo * scale + bias;
+				const float b = hi * scale + bias;
+				outMin = std::min(a, b);
+				outMax = std::max(a, b);
+			}
+		};
+
+		const int32_t sliceIndex = static_cast<int32_t>(slice);
+		for (uint32_t i = 0; i < lightCount_; i++) {
+			if (sliceIndex < sliceMin_[i] || sliceIndex > sliceMax_[i]) {
+				continue;
+			}
+
+			const float r = radius_[i];
+			const float viewZ = viewZ_[i];
+
+			// the sphere's cross section within the slab is widest at the depth closest to its centre
+			const float dz = std::max({sliceNear - viewZ, viewZ - sliceFar, 0.f});
+			const float halfWidth = std::sqrt(std::max(r * r - dz * dz, 0.f));
+			const float zNear = std::max(viewZ - r, sliceNear);
+			const float zFar = std::min(viewZ + r, sliceFar);
+
+			float minX, maxX, minY, maxY;
+			project(viewX_[i] - halfWidth, viewX_[i] + halfWidth, projection[0][0], projection[3][0], zNear, zFar, minX, maxX);
+			project(viewY_[i] - halfWidth, viewY_[i] + halfWidth, projection[1][1], projection[3][1], zNear, zFar, minY, maxY);
+
+			if (maxX < -1.f || minX > 1.f || maxY < -1.f || minY > 1.f) {
+				continue;
+			}
+
+			func(i, toTile(minX, CLUSTER_X), toTile(maxX, CLUSTER_X), toTile(minY, CLUSTER_Y), toTile(maxY, CLUSTER_Y));
+		}
+	}
+
+	void LightClusterSystem::binSlices(const CameraComponent& camera, uint32_t sliceBegin, uint32_t sliceEnd)
+	{
+		for (uint32_t slice = sliceBegin; slice < sliceEnd; slice++) {
+			auto& clusters = sliceClusters_[slice];
+			auto& indices = sliceIndices_[slice];
+			clusters.assign(CLUSTER_X * CLUSTER_Y, LightCluster{0, 0});
+
+			// count, prefix sum, then fill, so every cluster's indices end up contiguous
+			forEachTileRect(camera, slice, [&](uint32_t, int32_t x0, int32_t x1, int32_t y0, int32_t y1) {
+				for (int32_t y = y0; y <= y1; y++) {
+					for (int32_t x = x0; x <= x1; x++) {
+						clusters[y * CLUSTER_X + x].count++;
+					}
+				}
+			});
+
+			uint32_t offset = 0;
+			for (auto& cluster : clusters) {
+				cluster.offset = offset;
+				offset += cluster.count;
+				cluster.count = 0;
+			}
+			indices.resize(offset);
+
+			forEachTileRect(camera, slice, [&](uint32_t light, int32_t x0, int32_t x1, int32_t y0, int32_t y1) {
+				for (int32_t y = y0; y <= y1; y++) {
+					for (int32_t x = x0; x <= x1; x++) {
+						LightCluster& cluster = clusters[y * CLUSTER_X + x];
+						indices[cluster.offset + cluster.count++] = light;
+					}
+				}
+			});
+		}
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "../frame_info.h"
+#include "../entity_manager.h"
+#include "../vulkan_frame_allocator.h"
+#include "../components/components.h"
+
+#include <vector>
+
+namespace bve
+{
+	struct LightCluster
+	{
+		uint32_t offset; // first entry in the light index list
+		uint32_t count;
+	};
+
+	// Bins point lights into a froxel grid (screen tiles x exponential depth slices) on the cpu so the
+	// fragment shader only loops over the lights touching its cluster.
+	class LightClusterSystem
+	{
+	public:
+		static constexpr uint32_t CLUSTER_X = 16;
+		static constexpr uint32_t CLUSTER_Y = 9;
+		static constexpr uint32_t CLUSTER_Z = 24;
+		static constexpr uint32_t CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+		static constexpr uint32_t MAX_LIGHT_INDICES = 1024 * 1024;
+
+		// light contribution below which it is cut off, this decides each light's influence radius
+		static constexpr float LIGHT_CUTOFF = 0.01f;
+
+		// the dynamic storage bindings always cover these ranges, each frame allocates them in full
+		static constexpr VkDeviceSize LIGHTS_RANGE = MAX_LIGHTS * sizeof(PointLight);
+		static constexpr VkDeviceSize CLUSTERS_RANGE = CLUSTER_COUNT * sizeof(LightCluster);
+		static constexpr VkDeviceSize LIGHT_INDICES_RANGE = MAX_LIGHT_INDICES * sizeof(uint32_t);
+		static constexpr VkDeviceSize LIGHT_BILLBOARDS_RANGE = MAX_LIGHTS * sizeof(float);
+
+		struct Allocations
+		{
+			uint32_t lightsOffset;
+			uint32_t clustersOffset;
+			uint32_t lightIndicesOffset;
+			uint32_t lightBillboardsOffset;
+		};
+
+		struct Stats
+		{
+			uint32_t lightCount;
+			uint32_t visibleLightCount;
+			uint32_t lightIndexCount;
+		};
+
+		LightClusterSystem(EntityManager& entityManager);
+
+		LightClusterSystem(const LightClusterSystem&) = delete;
+		LightClusterSystem& operator=(const LightClusterSystem&) = delete;
+		LightClusterSystem(const LightClusterSystem&&) = delete;
+		LightClusterSystem& operator=(const LightClusterSystem&&) = delete;
+
+		// gathers this frame's lights, writes the light, cluster, index and billboard size lists into the frame
+		// allocator and fills the cluster parameters of the ubo
+		Allocations update(const CameraComponent& camera, VulkanFrameAllocator& frameAllocator, GlobalUbo& ubo);
+
+		const Stats& getStats() const { return stats_; }
+
+	private:
+		void gatherLights(PointLight* lights, float* billboardRadii);
+		void computeViewBounds(const CameraComponent& camera, uint32_t begin, uint32_t end);
+		void binSlices(const CameraComponent& camera, uint32_t sliceBegin, uint32_t sliceEnd);
+
+		template <typename F>
+		void forEachTileRect(const CameraComponent& camera, uint32_t slice, F&& func) const;
+
+		EntityManager& entityManager_;
+		Stats stats_{};
+		bool overflowWarned_ = false;
+		bool lightLimitWarned_ = false;
+
+		float sliceScale_ = 0.f;
+		float sliceBias_ = 0.f;
+		uint32_t lightCount_ = 0;
+
+		// view space bounds in structure of arrays form, computeViewBounds works on four lights at a time with SSE2
+		std::vector<float> worldX_, worldY_, worldZ_, radius_;
+		std::vector<float> viewX_, viewY_, viewZ_;
+		std::vector<int32_t> sliceMin_, sliceMax_;
+
+		// per depth slice results, slices are binned independently and stitched together afterwards
+		std::vector<std::vector<LightCluster>> sliceClusters_;
+		std::vector<std::vector<uint32_t>> sliceIndices_;
+	};
+}
@@ -2,6 +2,7 @@
 #include "movement_system.h"
 
 #include "../components/components.h"
+#include "../core/profiler.h"
 
 namespace bve
 {
@@ -9,6 +10,7 @@ namespace bve
 
 	void MovementSystem::update(float dt)
 	{
+		IG_PROFILE_FUNCTION();
 		auto movers = entityManager_.view<MoveComponent>();
 		for (auto&& [entity, moveComp] : movers) {
 			if (entityManager_.hasComponent<TransformComponent>(entity)) {
@@ -0,0 +1,46 @@
+#include "../pch.h"
+#include "occlusion_culling_system.h"
+
+#include "../core/profiler.h"
+#include "../log.h"
+
+namespace bve
+{
+	OcclusionCullingSystem::OcclusionCullingSystem(EntityManager& entityManager, const AssetManager& assetManager)
+		: entityManager_(entityManager), assetManager_(assetManager) {}
+
+	void OcclusionCullingSystem::update(const CameraComponent& camera, VkExtent2D extent)
+	{
+		IG_PROFILE_FUNCTION();
+		const uint32_t width = OcclusionBuffer::DEFAULT_WIDTH;
+		const uint32_t height = extent.width > 0 ? width * extent.height / extent.width : width;
+		occlusionBuffer_.beginFrame(camera.projectionMatrix * camera.viewMatrix, width, height);
+
+		for (auto&& [entity, _] : entityManager_.view<OccluderTag>()) {
+			if (!entityManager_.hasComponent<RenderComponent>(entity) || !entityManager_.hasComponent<TransformComponent>(entity)) {
+				continue;
+			}
+
+			// occluders that are still loading hide nothing, the placeholder has no occluder geometry
+			const BveModel* model = assetManager_.getMesh(entityManager_.getComponent<RenderComponent>(entity).mesh);
+			if (!model) {
+				continue;
+			}
+
+			if (!model->hasOccluderGeometry()) {
+				if (!missingGeometryWarned_) {
+					LOG_WARN("occluder entity {} has a model loaded without occluder geometry, it is ignored", entity);
+					missingGeometryWarned_ = true;
+				}
+				continue;
+			}
+
+			const glm::mat4 modelMatrix = entityManager_.hasComponent<WorldTransformComponent>(entity)
+				? entityManager_.getComponent<WorldTransformComponent>(entity).matrix
+				: entityManager_.getComponent<TransformComponent>(entity).mat4();
+			occlusionBuffer_.addOccluder(model->getOccluderPositions(), model->getOccluderIndices(), modelMatrix);
+		}
+
+		occlusionBuffer_.rasterize();
+	}
+}
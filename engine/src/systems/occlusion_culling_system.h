@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../asset_manager.h"
+#include "../entity_manager.h"
+#include "../occlusion_buffer.h"
+#include "../components/components.h"
+
+#include <vulkan/vulkan.h>
+
+namespace bve
+{
+	// Rasterizes every entity tagged OccluderTag into the occlusion buffer before draws are recorded, the
+	// render system then skips entities whose bounds are hidden behind them.
+	class OcclusionCullingSystem
+	{
+	public:
+		OcclusionCullingSystem(EntityManager& entityManager, const AssetManager& assetManager);
+
+		OcclusionCullingSystem(const OcclusionCullingSystem&) = delete;
+		OcclusionCullingSystem& operator=(const OcclusionCullingSystem&) = delete;
+		OcclusionCullingSystem(const OcclusionCullingSystem&&) = delete;
+		OcclusionCullingSystem& operator=(const OcclusionCullingSystem&&) = delete;
+
+		// the buffer keeps the aspect ratio of the swap chain at OcclusionBuffer::DEFAULT_WIDTH pixels across
+		void update(const CameraComponent& camera, VkExtent2D extent);
+
+		const OcclusionBuffer& getOcclusionBuffer() const { return occlusionBuffer_; }
+
+	private:
+		EntityManager& entityManager_;
+		const AssetManager& assetManager_;
+		OcclusionBuffer occlusionBuffer_;
+		bool missingGeometryWarned_ = false;
+	};
+}
@@ -1,31 +1,18 @@
 #include "../pch.h"
 #include "point_light_render_system.h"
 #include "../bve_swap_chain.h"
-#include "../entity_manager.h"
-#include "../components/components.h"
-
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#include <glm/glm.hpp>
-#include <glm/gtc/constants.hpp>
+#include "../core/profiler.h"
 
 #include <stdexcept>
 
 
 namespace bve
 {
-	struct PointLightPushConstants
-	{
-		glm::vec4 position{};
-		glm::vec4 color{};
-		float radius;
-	};
-
-	PointLightRenderSystem::PointLightRenderSystem(BveDevice& device, VkRenderPass renderPass, EntityManager& entityManager, VkDescriptorSetLayout globalSetLayout)
-		: bveDevice_(device), entityManager_(entityManager)
+	PointLightRenderSystem::PointLightRenderSystem(BveDevice& device, BvePipelineBuilder& pipelineBuilder, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
+		: bveDevice_(device)
 	{
 		createPipelineLayout(globalSetLayout);
-		createPipeline(renderPass);
+		createPipeline(pipelineBuilder, renderPass);
 	}
 
 	PointLightRenderSystem::~PointLightRenderSystem()
@@ -35,81 +22,54 @@ namespace bve
 
 	void PointLightRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 	{
-		VkPushConstantRange pushConstantRange;
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(PointLightPushConstants);
-
 		const std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
 		if (vkCreatePipelineLayout(bveDevice_.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout_) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create pipeline info");
 		}
 	}
 
-	void PointLightRenderSystem::createPipeline(VkRenderPass renderPass)
+	void PointLightRenderSystem::createPipeline(BvePipelineBuilder& pipelineBuilder, VkRenderPass renderPass)
 	{
 		assert(pipelineLayout_ != nullptr && "Cannot create pipeline before pipeline layout");
 
-		PipelineConfigInfo pipelineConfig{};
-		BvePipeline::defaultPipelineConfigInfo(pipelineConfig);
-		BvePipeline::enableAlphaBlending(pipelineConfig);
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout_;
-		pipelineConfig.attributeDescriptions.clear();
-		pipelineConfig.attributeDescriptions.clear();
-		bvePipeline_ = std::make_unique<BvePipeline>(
-			bveDevice_,
+		auto pipelineConfig = std::make_unique<PipelineConfigInfo>();
+		BvePipeline::defaultPipelineConfigInfo(*pipelineConfig);
+		BvePipeline::enableAlphaBlending(*pipelineConfig);
+		pipelineConfig->renderPass = renderPass;
+		pipelineConfig->pipelineLayout = pipelineLayout_;
+		// billboard corners come from gl_VertexIndex and everything else from the light buffers
+		pipelineConfig->bindingDescriptions.clear();
+		pipelineConfig->attributeDescriptions.clear();
+		pipelineBuilder.addPipeline(
+			bvePipeline_,
 			"shaders/point_light.vert.spv",
 			"shaders/point_light.frag.spv",
-			pipelineConfig);
+			std::move(pipelineConfig));
 	}
 
-	void PointLightRenderSystem::update(GlobalUbo& ubo) const
+	void PointLightRenderSystem::render(FrameInfo& frameInfo, uint32_t lightCount) const
 	{
-		EntityComponentView<PointLightComponent> view = entityManager_.view<PointLightComponent>();
-		int index = 0;
-		for (const auto&& [entity, lightComponent] : view) {
-			if (entityManager_.hasComponent<TransformComponent>(entity)) {
-				assert(index < MAX_LIGHTS && "Exceeded max number of point lights");
-
-				auto& transformComponent = entityManager_.getComponent<TransformComponent>(entity);
-				auto position = glm::vec4(transformComponent.translation, 1);
-
-				ubo.pointLights[index] = PointLight{position, lightComponent.color};
-				index++;
-			}
+		IG_PROFILE_FUNCTION();
+		if (lightCount == 0) {
+			return;
 		}
 
-		ubo.numLights = index;
-	}
+		// instance i reads light i from the buffers the light cluster system filled, so the cpu cost is one draw
+		frameInfo.recorder.record(1, [&](VkCommandBuffer commandBuffer, uint32_t, uint32_t) {
+			bvePipeline_->bind(commandBuffer);
 
-	void PointLightRenderSystem::render(FrameInfo& frameInfo) const
-	{
-		bvePipeline_->bind(frameInfo.commandBuffer);
-
-		vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 0, 1, &frameInfo.globalDescriptorSet, 0, nullptr);
-
-		EntityComponentView<PointLightComponent> view = entityManager_.view<PointLightComponent>();
-		for (const auto&& [entity, lightComponent] : view) {
-			if (entityManager_.hasComponent<TransformComponent>(entity)) {
-				PointLightPushConstants push{};
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 0, 1, &frameInfo.globalDescriptorSet, GLOBAL_BINDING_COUNT, frameInfo.globalDynamicOffsets.data());
 
-				auto& transformComponent = entityManager_.getComponent<TransformComponent>(entity);
-				push.position = glm::vec4(transformComponent.translation, 1);
-				push.radius = transformComponent.scale.x;
-				push.color = lightComponent.color;
-
-				vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout_, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PointLightPushConstants), &push);
-
-				vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
-			}
-		}
+			vkCmdDraw(commandBuffer, 6, lightCount, 0, 0);
+			IG_PROFILE_COUNT(DRAW_CALLS, 1);
+			IG_PROFILE_COUNT(TRIANGLES, 2 * lightCount);
+		});
 	}
 }
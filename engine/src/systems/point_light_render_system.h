@@ -1,9 +1,9 @@
 #pragma once
 
 #include "../bve_pipeline.h"
+#include "../bve_pipeline_builder.h"
 #include "../bve_model.h"
 #include "../frame_info.h"
-#include "../entity_manager.h"
 
 #include <memory>
 
@@ -12,7 +12,7 @@ namespace bve
 	class PointLightRenderSystem
 	{
 	public:
-		PointLightRenderSystem(BveDevice& device, VkRenderPass renderPass, EntityManager& entityManager, VkDescriptorSetLayout globalSetLayout);
+		PointLightRenderSystem(BveDevice& device, BvePipelineBuilder& pipelineBuilder, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
 		~PointLightRenderSystem();
 
 		PointLightRenderSystem(const PointLightRenderSystem&) = delete;
@@ -20,18 +20,16 @@ namespace bve
 		PointLightRenderSystem(const PointLightRenderSystem&&) = delete;
 		PointLightRenderSystem& operator=(const PointLightRenderSystem&&) = delete;
 
-		void update(GlobalUbo& ubo) const;
-		void render(FrameInfo& frameInfo) const;
+		// draws a billboard for each of the first lightCount lights in the frame's light buffer with one instanced draw
+		void render(FrameInfo& frameInfo, uint32_t lightCount) const;
 
 	private:
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipeline(BvePipelineBuilder& pipelineBuilder, VkRenderPass renderPass);
 
 		BveDevice& bveDevice_;
 
 		std::unique_ptr<BvePipeline> bvePipeline_;
 		VkPipelineLayout pipelineLayout_;
-
-		EntityManager& entityManager_;
 	};
 }
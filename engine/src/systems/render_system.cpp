@@ -6,11 +6,14 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <cmath>
 #include <stdexcept>
 
 #include "../bve_swap_chain.h"
+#include "../culling.h"
 #include "../entity_manager.h"
 #include "../components/components.h"
+#include "../core/profiler.h"
 
 namespace bve
 {
@@ -20,11 +23,11 @@ namespace bve
 		glm::mat4 normalMatrix{1.f};
 	};
 
-	RenderSystem::RenderSystem(BveDevice& device, VkRenderPass renderPass, EntityManager& entityManager, VkDescriptorSetLayout globalSetLayout)
-		: bveDevice_(device), entityManager_(entityManager)
+	RenderSystem::RenderSystem(BveDevice& device, BvePipelineBuilder& pipelineBuilder, VkRenderPass renderPass, EntityManager& entityManager, const AssetManager& assetManager, VkDescriptorSetLayout globalSetLayout)
+		: bveDevice_(device), entityManager_(entityManager), assetManager_(assetManager)
 	{
 		createPipelineLayout(globalSetLayout);
-		createPipeline(renderPass);
+		createPipeline(pipelineBuilder, renderPass);
 	}
 
 	RenderSystem::~RenderSystem()
@@ -52,40 +55,176 @@ namespace bve
 		}
 	}
 
-	void RenderSystem::createPipeline(VkRenderPass renderPass)
+	void RenderSystem::createPipeline(BvePipelineBuilder& pipelineBuilder, VkRenderPass renderPass)
 	{
 		assert(pipelineLayout_ != nullptr && "Cannot create pipeline before pipeline layout");
 
-		PipelineConfigInfo pipelineConfig{};
-		BvePipeline::defaultPipelineConfigInfo(pipelineConfig);
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout_;
-		bvePipeline_ = std::make_unique<BvePipeline>(
-			bveDevice_,
-			"shaders/simple_shader.vert.spv",
-			"shaders/simple_shader.frag.spv",
-			pipelineConfig);
+		// the vertex format is a specialization constant, so simple_shader.vert only compiles the decode it needs
+		for (auto format : {BveModel::VertexFormat::FULL, BveModel::VertexFormat::PACKED}) {
+			for (const bool doubleSided : {false, true}) {
+				auto pipelineConfig = std::make_unique<PipelineConfigInfo>();
+				BvePipeline::defaultPipelineConfigInfo(*pipelineConfig);
+				pipelineConfig->bindingDescriptions = BveModel::Vertex::getBindingDescriptions(format);
+				pipelineConfig->attributeDescriptions = BveModel::Vertex::getAttributeDescriptions(format);
+				pipelineConfig->vertexSpecializationConstants = {static_cast<uint32_t>(format)};
+				pipelineConfig->renderPass = renderPass;
+				pipelineConfig->pipelineLayout = pipelineLayout_;
+				// meshes wind front faces counter-clockwise around their normals, and neither the camera nor the
+				// viewport mirror them, so closed meshes lose their back faces. Open ones show them
+				pipelineConfig->rasterizationInfo.cullMode = doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+				pipelineConfig->rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+				pipelineBuilder.addPipeline(
+					bvePipelines_[getPipelineIndex(format, doubleSided)],
+					"shaders/simple_shader.vert.spv",
+					"shaders/simple_shader.frag.spv",
+					std::move(pipelineConfig));
+			}
+		}
 	}
 
-	void RenderSystem::render(FrameInfo& frameInfo) const
+	size_t RenderSystem::getPipelineIndex(BveModel::VertexFormat format, bool doubleSided)
 	{
-		bvePipeline_->bind(frameInfo.commandBuffer);
-
-		vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 0, 1, &frameInfo.globalDescriptorSet, 0, nullptr);
+		return static_cast<size_t>(format) * 2 + (doubleSided ? 1 : 0);
+	}
 
-		EntityComponentView<RenderComponent> view = entityManager_.view<RenderComponent>();
-		for (const auto&& [entity, modelComponent] : view) {
-			SimplePushConstantData push{};
+	uint32_t RenderSystem::selectLod(const BveModel& model, uint32_t currentLod, float pixelsPerUnit)
+	{
+		const uint32_t lodCount = model.getLodCount();
+		currentLod = std::min(currentLod, lodCount - 1);
 
-			if (entityManager_.hasComponent<TransformComponent>(entity)) {
-				auto& transformComponent = entityManager_.getComponent<TransformComponent>(entity);
-				push.modelMatrix = transformComponent.mat4();
-				push.normalMatrix = transformComponent.normalMatrix();
+		auto coarsestWithin = [&](float maxPixels) {
+			uint32_t lod = 0;
+			while (lod + 1 < lodCount && model.getLod(lod + 1).error * pixelsPerUnit <= maxPixels) {
+				lod++;
 			}
+			return lod;
+		};
 
-			vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout_, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
-			modelComponent.model->bind(frameInfo.commandBuffer);
-			modelComponent.model->draw(frameInfo.commandBuffer);
+		// refine as soon as the current level is visibly wrong, but only coarsen once a level fits with margin
+		if (model.getLod(currentLod).error * pixelsPerUnit > LOD_ERROR_PIXELS) {
+			return coarsestWithin(LOD_ERROR_PIXELS);
 		}
+		return std::max(currentLod, coarsestWithin(LOD_ERROR_PIXELS * (1.f - LOD_HYSTERESIS)));
+	}
+
+	void RenderSystem::render(FrameInfo& frameInfo) const
+	{
+		IG_PROFILE_FUNCTION();
+		EntityComponentView<RenderComponent> view = entityManager_.view<RenderComponent>();
+		const std::span<Entity> entities = view.entitySpan_;
+		const std::span<RenderComponent> renderComponents = view.componentSpan_;
+
+		// screen space error of one model unit at unit distance, the orthographic projection has no distance falloff
+		const auto& camera = entityManager_.getComponent<CameraComponent>(frameInfo.camera);
+		const bool perspective = camera.mode == ProjectionMode::PERSPECTIVE;
+		const float projectionScale = std::abs(camera.projectionMatrix[1][1]) * 0.5f * static_cast<float>(frameInfo.extent.height);
+		const glm::vec3 cameraPosition{camera.inverseViewMatrix[3]};
+		const glm::vec3 viewDirection{camera.inverseViewMatrix[2]};
+		const Frustum frustum = Frustum::fromMatrix(camera.projectionMatrix * camera.viewMatrix);
+
+		// each chunk only touches the components in its own range, so ranges of the draw list can be recorded concurrently
+		frameInfo.recorder.record(static_cast<uint32_t>(entities.size()), [&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) {
+			BvePipeline* boundPipeline = nullptr;
+			std::vector<IndexRange> visibleRanges;
+			[[maybe_unused]] uint64_t drawCalls = 0;
+			[[maybe_unused]] uint64_t triangles = 0;
+			[[maybe_unused]] uint64_t culledObjects = 0;
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 0, 1, &frameInfo.globalDescriptorSet, GLOBAL_BINDING_COUNT, frameInfo.globalDynamicOffsets.data());
+
+			for (uint32_t i = begin; i < end; i++) {
+				const Entity entity = entities[i];
+				RenderComponent& modelComponent = renderComponents[i];
+				SimplePushConstantData push{};
+				float maxScale = 1.f;
+
+				if (entityManager_.hasComponent<WorldTransformComponent>(entity)) {
+					const auto& worldComponent = entityManager_.getComponent<WorldTransformComponent>(entity);
+					push.modelMatrix = worldComponent.matrix;
+					push.normalMatrix = worldComponent.normalMatrix;
+					maxScale = worldComponent.maxScale;
+				} else if (entityManager_.hasComponent<TransformComponent>(entity)) {
+					auto& transformComponent = entityManager_.getComponent<TransformComponent>(entity);
+					push.modelMatrix = transformComponent.mat4();
+					push.normalMatrix = transformComponent.normalMatrix();
+					maxScale = std::max({std::abs(transformComponent.scale.x), std::abs(transformComponent.scale.y), std::abs(transformComponent.scale.z)});
+				}
+
+				// meshes still loading are stood in for by the placeholder, failed ones are skipped
+				const BveModel* mesh = assetManager_.getMesh(modelComponent.mesh);
+				if (!mesh) {
+					if (assetManager_.getState(modelComponent.mesh) == AssetState::FAILED) {
+						continue;
+					}
+					mesh = &assetManager_.getPlaceholderMesh();
+				}
+				const BveModel& model = *mesh;
+				const glm::vec3 center{push.modelMatrix * glm::vec4{model.getBoundingCenter(), 1.f}};
+				const float radius = model.getBoundingRadius() * maxScale;
+				if (!frustum.intersectsSphere(center, radius)) {
+					culledObjects++;
+					continue;
+				}
+
+				// occluders would be tested against their own depth
+				if (!entityManager_.hasComponent<OccluderTag>(entity) && !frameInfo.occlusionBuffer.isVisible(center - glm::vec3{radius}, center + glm::vec3{radius})) {
+					culledObjects++;
+					continue;
+				}
+
+				// error is measured at the nearest point of the bounding sphere, so no part of the model exceeds it
+				float pixelsPerUnit = projectionScale * maxScale;
+				if (perspective) {
+					pixelsPerUnit /= std::max(glm::length(center - cameraPosition) - radius, camera.near);
+				}
+				modelComponent.lod = selectLod(model, modelComponent.lod, pixelsPerUnit);
+
+				// only the full level of detail is split into meshlets, coarser levels are small enough to draw whole
+				visibleRanges.clear();
+				if (modelComponent.lod == 0 && !model.getMeshlets().empty()) {
+					const glm::mat4 inverseModel = glm::inverse(push.modelMatrix);
+					MeshletCullView cullView{};
+					cullView.frustum = frustum;
+					cullView.modelMatrix = push.modelMatrix;
+					cullView.maxScale = maxScale;
+					cullView.cameraPosition = glm::vec3{inverseModel * glm::vec4{cameraPosition, 1.f}};
+					cullView.viewDirection = glm::normalize(glm::vec3{inverseModel * glm::vec4{viewDirection, 0.f}});
+					cullView.perspective = perspective;
+					// meshlets facing away are only invisible where the pipeline culls back faces too
+					cullView.coneCulling = !model.isDoubleSided();
+					if (cullMeshlets(model.getMeshlets(), cullView, visibleRanges) == 0) {
+						culledObjects++;
+						continue;
+					}
+				}
+
+				// quantized positions are dequantized by the model matrix, normals are unaffected
+				push.modelMatrix = push.modelMatrix * model.getPositionTransform();
+
+				// the pipelines share a layout, so the descriptor sets stay bound across a switch
+				BvePipeline* pipeline = bvePipelines_[getPipelineIndex(model.getVertexFormat(), model.isDoubleSided())].get();
+				if (boundPipeline != pipeline) {
+					pipeline->bind(commandBuffer);
+					boundPipeline = pipeline;
+				}
+
+				vkCmdPushConstants(commandBuffer, pipelineLayout_, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
+				model.bind(commandBuffer);
+				if (visibleRanges.empty()) {
+					model.draw(commandBuffer, modelComponent.lod);
+					drawCalls++;
+					triangles += model.getTriangleCount(modelComponent.lod);
+				}
+				for (const IndexRange& range : visibleRanges) {
+					model.drawIndices(commandBuffer, range.firstIndex, range.indexCount);
+					drawCalls++;
+					triangles += range.indexCount / 3;
+				}
+			}
+
+			IG_PROFILE_COUNT(DRAW_CALLS, drawCalls);
+			IG_PROFILE_COUNT(TRIANGLES, triangles);
+			IG_PROFILE_COUNT(CULLED_OBJECTS, culledObjects);
+		}, DRAWS_PER_BATCH);
 	}
 }
@@ -1,11 +1,14 @@
 #pragma once
 
 #include "../bve_pipeline.h"
+#include "../bve_pipeline_builder.h"
 #include "../bve_model.h"
+#include "../asset_manager.h"
 #include "../frame_info.h"
 #include "../entity_manager.h"
 #include "../vulkan_descriptors.h"
 
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -14,7 +17,15 @@ namespace bve
 	class RenderSystem
 	{
 	public:
-		RenderSystem(BveDevice& device, VkRenderPass renderPass, EntityManager& entityManager, VkDescriptorSetLayout globalSetLayout);
+		// fewer draws than this are not worth a secondary command buffer of their own
+		static constexpr uint32_t DRAWS_PER_BATCH = 256;
+
+		// a level of detail is drawn while its error projects to no more than this many pixels
+		static constexpr float LOD_ERROR_PIXELS = 1.f;
+		// a coarser level must fit in this fraction less error before switching to it, stops flickering at the boundary
+		static constexpr float LOD_HYSTERESIS = 0.25f;
+
+		RenderSystem(BveDevice& device, BvePipelineBuilder& pipelineBuilder, VkRenderPass renderPass, EntityManager& entityManager, const AssetManager& assetManager, VkDescriptorSetLayout globalSetLayout);
 		~RenderSystem();
 
 		RenderSystem(const RenderSystem&) = delete;
@@ -26,13 +37,20 @@ namespace bve
 
 	private:
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipeline(BvePipelineBuilder& pipelineBuilder, VkRenderPass renderPass);
+
+		// where the pipeline for meshes of a vertex format and sidedness is in bvePipelines_
+		static size_t getPipelineIndex(BveModel::VertexFormat format, bool doubleSided);
+
+		static uint32_t selectLod(const BveModel& model, uint32_t currentLod, float pixelsPerUnit);
 
 		BveDevice& bveDevice_;
 
-		std::unique_ptr<BvePipeline> bvePipeline_;
+		// one pipeline per vertex format, each culling back faces or, for double sided meshes, not
+		std::array<std::unique_ptr<BvePipeline>, 4> bvePipelines_;
 		VkPipelineLayout pipelineLayout_;
 
 		EntityManager& entityManager_;
+		const AssetManager& assetManager_;
 	};
 }
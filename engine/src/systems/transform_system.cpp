@@ -0,0 +1,70 @@
+#include "../pch.h"
+#include "transform_system.h"
+
+#include "../components/components.h"
+#include "../core/profiler.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace bve
+{
+	TransformSystem::TransformSystem(EntityManager& entityManager) : entityManager_(entityManager) { }
+
+	void TransformSystem::update()
+	{
+		IG_PROFILE_FUNCTION();
+		worldMatrices_.clear();
+
+		// a world transform left from before the parent was removed would keep the entity where it last was
+		std::vector<Entity> orphans;
+		for (auto&& [entity, worldComp] : entityManager_.view<WorldTransformComponent>()) {
+			if (!hasParent(entity)) {
+				orphans.push_back(entity);
+			}
+		}
+		for (Entity entity : orphans) {
+			entityManager_.removeComponent<WorldTransformComponent>(entity);
+		}
+
+		for (auto&& [entity, parentComp] : entityManager_.view<ParentComponent>()) {
+			if (!hasParent(entity)) {
+				continue;
+			}
+
+			const glm::mat4& matrix = getWorldMatrix(entity, 0);
+
+			WorldTransformComponent world{};
+			world.matrix = matrix;
+			world.normalMatrix = glm::transpose(glm::inverse(glm::mat3{matrix}));
+			world.maxScale = std::max({glm::length(glm::vec3{matrix[0]}), glm::length(glm::vec3{matrix[1]}), glm::length(glm::vec3{matrix[2]})});
+
+			if (entityManager_.hasComponent<WorldTransformComponent>(entity)) {
+				entityManager_.getComponent<WorldTransformComponent>(entity) = world;
+			} else {
+				entityManager_.addComponent<WorldTransformComponent>(entity, std::move(world));
+			}
+		}
+	}
+
+	const glm::mat4& TransformSystem::getWorldMatrix(Entity entity, uint32_t depth)
+	{
+		assert(depth < MAX_DEPTH && "Entity hierarchy is too deep or has a cycle");
+		if (const auto found = worldMatrices_.find(entity); found != worldMatrices_.end()) {
+			return found->second;
+		}
+
+		glm::mat4 matrix = entityManager_.hasComponent<TransformComponent>(entity) ? entityManager_.getComponent<TransformComponent>(entity).mat4() : glm::mat4{1.f};
+		if (hasParent(entity)) {
+			matrix = getWorldMatrix(entityManager_.getComponent<ParentComponent>(entity).parent, depth + 1) * matrix;
+		}
+		// map nodes don't move when the map grows, so the reference stays valid through the recursion
+		return worldMatrices_.emplace(entity, matrix).first->second;
+	}
+
+	bool TransformSystem::hasParent(Entity entity)
+	{
+		return entityManager_.hasComponent<ParentComponent>(entity)
+			&& entityManager_.hasComponent<TransformComponent>(entityManager_.getComponent<ParentComponent>(entity).parent);
+	}
+}
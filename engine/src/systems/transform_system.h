@@ -0,0 +1,33 @@
+#pragma once
+
+#include "../entity_manager.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+
+namespace bve
+{
+	// composes the transforms of entities with a ParentComponent into their WorldTransformComponent. A parent only
+	// counts while it has a TransformComponent, entities whose parent is gone fall back to their own transform
+	class TransformSystem
+	{
+	public:
+		// deeper hierarchies are taken to be a parent cycle
+		static constexpr uint32_t MAX_DEPTH = 256;
+
+		TransformSystem(EntityManager& entityManager);
+
+		// run after everything that moves entities and before rendering
+		void update();
+
+	private:
+		const glm::mat4& getWorldMatrix(Entity entity, uint32_t depth);
+		bool hasParent(Entity entity);
+
+		EntityManager& entityManager_;
+		std::unordered_map<Entity, glm::mat4> worldMatrices_; // this update's, so shared ancestors are composed once
+	};
+}
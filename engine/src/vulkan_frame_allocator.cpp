@@ -0,0 +1,67 @@
+#include "pch.h"
+#include "vulkan_frame_allocator.h"
+
+#include "core/profiler.h"
+
+#include <stdexcept>
+
+namespace bve
+{
+	VulkanFrameAllocator::VulkanFrameAllocator(BveDevice& device, uint32_t frameCount, VkDeviceSize capacity)
+		: bveDevice_{device}
+	{
+		// every allocation is rounded to an alignment valid for both uniform and storage bindings,
+		// which keeps the bump a single atomic add
+		const VkPhysicalDeviceLimits& limits = device.properties.limits;
+		alignment_ = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+		capacity_ = (capacity + alignment_ - 1) & ~(alignment_ - 1);
+
+		buffers_.resize(frameCount);
+		for (auto& buffer : buffers_) {
+			// coherent memory so allocations never need to be flushed individually
+			buffer = std::make_unique<VulkanBuffer>(
+				device,
+				capacity_,
+				1,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			if (buffer->map() != VK_SUCCESS) {
+				throw std::runtime_error("Failed to map frame allocator buffer");
+			}
+		}
+	}
+
+	VulkanFrameAllocator::~VulkanFrameAllocator() = default;
+
+	void VulkanFrameAllocator::beginFrame(int frameIndex)
+	{
+		assert(frameIndex >= 0 && frameIndex < static_cast<int>(buffers_.size()) && "Frame index out of range");
+
+		frameIndex_ = frameIndex;
+		head_.store(0, std::memory_order_relaxed);
+	}
+
+	VulkanFrameAllocator::Allocation VulkanFrameAllocator::allocate(VkDeviceSize size)
+	{
+		assert(size > 0 && "Cannot make an empty frame allocation");
+
+		const VkDeviceSize alignedSize = (size + alignment_ - 1) & ~(alignment_ - 1);
+		const VkDeviceSize offset = head_.fetch_add(alignedSize, std::memory_order_relaxed);
+		if (offset + alignedSize > capacity_) {
+			throw std::runtime_error("Frame allocator out of memory");
+		}
+
+		IG_PROFILE_COUNT(UPLOAD_BYTES, size);
+
+		Allocation allocation{};
+		allocation.data = static_cast<char*>(buffers_[frameIndex_]->getMappedMemory()) + offset;
+		allocation.offset = offset;
+		allocation.size = size;
+		return allocation;
+	}
+
+	VkDescriptorBufferInfo VulkanFrameAllocator::descriptorInfo(int frameIndex, VkDeviceSize range) const
+	{
+		return buffers_[frameIndex]->descriptorInfo(range, 0);
+	}
+}
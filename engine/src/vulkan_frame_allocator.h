@@ -0,0 +1,68 @@
+#pragma once
+
+#include "bve_device.h"
+#include "vulkan_buffer.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace bve
+{
+	// Linear allocator for data that only lives for one frame. Each frame in flight owns one large,
+	// persistently mapped buffer; allocations bump an offset and are bound with dynamic descriptor
+	// offsets, so systems never need their own buffers or descriptor sets for per-frame data.
+	class VulkanFrameAllocator
+	{
+	public:
+		static constexpr VkDeviceSize DEFAULT_CAPACITY = 16 * 1024 * 1024;
+
+		struct Allocation
+		{
+			void* data = nullptr;
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+
+			uint32_t dynamicOffset() const { return static_cast<uint32_t>(offset); }
+		};
+
+		VulkanFrameAllocator(BveDevice& device, uint32_t frameCount, VkDeviceSize capacity = DEFAULT_CAPACITY);
+		~VulkanFrameAllocator();
+
+		VulkanFrameAllocator(const VulkanFrameAllocator&) = delete;
+		VulkanFrameAllocator& operator=(const VulkanFrameAllocator&) = delete;
+		VulkanFrameAllocator(const VulkanFrameAllocator&&) = delete;
+		VulkanFrameAllocator& operator=(const VulkanFrameAllocator&&) = delete;
+
+		// only call once the frame's in flight fence has signaled, everything previously allocated from it is discarded
+		void beginFrame(int frameIndex);
+
+		// safe to call from any thread while recording the current frame
+		Allocation allocate(VkDeviceSize size);
+
+		template <typename T>
+		Allocation allocate(const T& value)
+		{
+			Allocation allocation = allocate(sizeof(T));
+			memcpy(allocation.data, &value, sizeof(T));
+			return allocation;
+		}
+
+		// descriptor range for a dynamic binding; the offset comes from Allocation::dynamicOffset at bind time
+		VkDescriptorBufferInfo descriptorInfo(int frameIndex, VkDeviceSize range) const;
+
+		VkBuffer getBuffer(int frameIndex) const { return buffers_[frameIndex]->getBuffer(); }
+		VkDeviceSize getCapacity() const { return capacity_; }
+		VkDeviceSize getAlignment() const { return alignment_; }
+		VkDeviceSize getUsedBytes() const { return std::min(head_.load(std::memory_order_relaxed), capacity_); }
+
+	private:
+		BveDevice& bveDevice_;
+		std::vector<std::unique_ptr<VulkanBuffer>> buffers_;
+		VkDeviceSize capacity_;
+		VkDeviceSize alignment_;
+
+		int frameIndex_ = 0;
+		std::atomic<VkDeviceSize> head_ = 0;
+	};
+}
@@ -0,0 +1,284 @@
+#include "pch.h"
+#include "vulkan_gpu_profiler.h"
+
+#include "log.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace bve
+{
+	namespace
+	{
+		// frame begin and end, then a begin and end pair per scope
+		constexpr uint32_t TIMESTAMP_QUERY_COUNT = 2 + 2 * VulkanGpuProfiler::MAX_SCOPES;
+
+		constexpr VkQueryPipelineStatisticFlags STATISTICS_FLAGS =
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+		// results come back in the order of the flag bits, followed by the availability value
+		constexpr uint32_t STATISTICS_COUNT = 5;
+
+		struct TimestampResult
+		{
+			uint64_t value;
+			uint64_t available;
+		};
+
+		struct StatisticsResult
+		{
+			uint64_t values[STATISTICS_COUNT];
+			uint64_t available;
+		};
+	}
+
+	VulkanGpuProfiler::VulkanGpuProfiler(BveDevice& device, uint32_t frameCount, uint32_t statisticsPerScope)
+		: bveDevice_{device}, statisticsPerScope_{std::max(statisticsPerScope, 1u)}, frames_(frameCount)
+	{
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+		const uint32_t validBits = queueFamilies[device.getGraphicsQueueFamily()].timestampValidBits;
+		if (validBits == 0) {
+			LOG_WARN("gpu profiler disabled, the graphics queue doesn't support timestamps");
+			return;
+		}
+		timestampMask_ = validBits >= 64 ? UINT64_MAX : (uint64_t{1} << validBits) - 1;
+		timestampPeriod_ = device.properties.limits.timestampPeriod;
+
+		VkQueryPoolCreateInfo timestampInfo{};
+		timestampInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		timestampInfo.queryCount = TIMESTAMP_QUERY_COUNT;
+
+		timestampPools_.resize(frameCount);
+		for (auto& pool : timestampPools_) {
+			if (vkCreateQueryPool(device.device(), &timestampInfo, nullptr, &pool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create timestamp query pool");
+			}
+		}
+
+		if (!device.enabledFeatures.pipelineStatisticsQuery) {
+			LOG_WARN("gpu profiler won't count primitives or invocations, pipeline statistics queries aren't supported");
+			return;
+		}
+
+		VkQueryPoolCreateInfo statisticsInfo{};
+		statisticsInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		statisticsInfo.queryCount = MAX_SCOPES * statisticsPerScope_;
+		statisticsInfo.pipelineStatistics = STATISTICS_FLAGS;
+
+		statisticsPools_.resize(frameCount);
+		for (auto& pool : statisticsPools_) {
+			if (vkCreateQueryPool(device.device(), &statisticsInfo, nullptr, &pool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create pipeline statistics query pool");
+			}
+		}
+	}
+
+	VulkanGpuProfiler::~VulkanGpuProfiler()
+	{
+		for (VkQueryPool pool : timestampPools_) {
+			vkDestroyQueryPool(bveDevice_.device(), pool, nullptr);
+		}
+		for (VkQueryPool pool : statisticsPools_) {
+			vkDestroyQueryPool(bveDevice_.device(), pool, nullptr);
+		}
+	}
+
+	void VulkanGpuProfiler::beginFrame(int frameIndex, VkCommandBuffer commandBuffer)
+	{
+		assert(frameIndex >= 0 && frameIndex < static_cast<int>(frames_.size()) && "Frame index out of range");
+
+		frameIndex_ = frameIndex;
+		if (!isEnabled()) {
+			return;
+		}
+
+		collectResults(frameIndex);
+
+		FrameQueries& frame = frames_[frameIndex];
+		frame.pending = true;
+		recording_ = true;
+		frame.frameNumber = frameNumber_++;
+		frame.scopeNames.clear();
+		frame.statisticsUsed.clear();
+
+		vkCmdResetQueryPool(commandBuffer, timestampPools_[frameIndex], 0, TIMESTAMP_QUERY_COUNT);
+		if (hasStatistics()) {
+			vkCmdResetQueryPool(commandBuffer, statisticsPools_[frameIndex], 0, MAX_SCOPES * statisticsPerScope_);
+		}
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPools_[frameIndex], 0);
+	}
+
+	void VulkanGpuProfiler::endFrame(VkCommandBuffer commandBuffer)
+	{
+		if (isEnabled()) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPools_[frameIndex_], 1);
+		}
+		recording_ = false;
+	}
+
+	uint32_t VulkanGpuProfiler::addScope(const std::string& name)
+	{
+		FrameQueries& frame = frames_[frameIndex_];
+		if (!isEnabled() || frame.scopeNames.size() == MAX_SCOPES) {
+			return NO_QUERY;
+		}
+
+		frame.scopeNames.push_back(name);
+		frame.statisticsUsed.push_back(0);
+		return static_cast<uint32_t>(frame.scopeNames.size() - 1);
+	}
+
+	void VulkanGpuProfiler::writeTimestamp(VkCommandBuffer commandBuffer, uint32_t scope, bool end)
+	{
+		if (scope == NO_QUERY) {
+			return;
+		}
+
+		const VkPipelineStageFlagBits stage = end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		vkCmdWriteTimestamp(commandBuffer, stage, timestampPools_[frameIndex_], 2 + 2 * scope + (end ? 1 : 0));
+	}
+
+	uint32_t VulkanGpuProfiler::reserveStatistics(uint32_t scope, uint32_t count)
+	{
+		if (scope == NO_QUERY || !hasStatistics()) {
+			return NO_QUERY;
+		}
+
+		uint32_t& used = frames_[frameIndex_].statisticsUsed[scope];
+		if (used + count > statisticsPerScope_) {
+			return NO_QUERY;
+		}
+
+		const uint32_t first = scope * statisticsPerScope_ + used;
+		used += count;
+		return first;
+	}
+
+	void VulkanGpuProfiler::beginStatistics(VkCommandBuffer commandBuffer, uint32_t query)
+	{
+		vkCmdBeginQuery(commandBuffer, statisticsPools_[frameIndex_], query, 0);
+	}
+
+	void VulkanGpuProfiler::endStatistics(VkCommandBuffer commandBuffer, uint32_t query)
+	{
+		vkCmdEndQuery(commandBuffer, statisticsPools_[frameIndex_], query);
+	}
+
+	void VulkanGpuProfiler::collectResults(uint32_t frameIndex, bool wait)
+	{
+		FrameQueries& frame = frames_[frameIndex];
+		if (!frame.pending) {
+			return;
+		}
+		frame.pending = false;
+
+		// without waiting the fence already covers these, and anything that still isn't available was never written.
+		// Every query up to the scope count is recorded, so waiting on them can't block forever once they're submitted
+		const uint32_t scopeCount = static_cast<uint32_t>(frame.scopeNames.size());
+		const VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT | (wait ? VK_QUERY_RESULT_WAIT_BIT : 0);
+		std::array<TimestampResult, TIMESTAMP_QUERY_COUNT> timestamps{};
+		vkGetQueryPoolResults(
+			bveDevice_.device(),
+			timestampPools_[frameIndex],
+			0,
+			2 + 2 * scopeCount,
+			sizeof(timestamps),
+			timestamps.data(),
+			sizeof(TimestampResult),
+			flags);
+
+		const auto elapsed = [&](uint32_t begin) {
+			const TimestampResult& start = timestamps[begin];
+			const TimestampResult& end = timestamps[begin + 1];
+			if (!start.available || !end.available) {
+				return 0.0;
+			}
+			const uint64_t ticks = (end.value - start.value) & timestampMask_;
+			return static_cast<double>(ticks) * timestampPeriod_ * 1e-6;
+		};
+
+		std::vector<StatisticsResult> statistics;
+		if (hasStatistics() && scopeCount > 0) {
+			statistics.resize(scopeCount * statisticsPerScope_);
+			vkGetQueryPoolResults(
+				bveDevice_.device(),
+				statisticsPools_[frameIndex],
+				0,
+				static_cast<uint32_t>(statistics.size()),
+				statistics.size() * sizeof(StatisticsResult),
+				statistics.data(),
+				sizeof(StatisticsResult),
+				flags);
+		}
+
+		FrameResult result{};
+		result.frameNumber = frame.frameNumber;
+		result.milliseconds = elapsed(0);
+		result.scopes.resize(scopeCount);
+		for (uint32_t scope = 0; scope < scopeCount; scope++) {
+			ScopeResult& scopeResult = result.scopes[scope];
+			scopeResult.name = std::move(frame.scopeNames[scope]);
+			scopeResult.milliseconds = elapsed(2 + 2 * scope);
+
+			for (uint32_t i = 0; i < frame.statisticsUsed[scope]; i++) {
+				const StatisticsResult& query = statistics[scope * statisticsPerScope_ + i];
+				if (!query.available) {
+					continue;
+				}
+				scopeResult.inputVertices += query.values[0];
+				scopeResult.inputPrimitives += query.values[1];
+				scopeResult.vertexInvocations += query.values[2];
+				scopeResult.clippingPrimitives += query.values[3];
+				scopeResult.fragmentInvocations += query.values[4];
+			}
+		}
+
+		history_.push_back(std::move(result));
+		if (history_.size() > HISTORY_SIZE) {
+			history_.pop_front();
+		}
+	}
+
+	void VulkanGpuProfiler::exportCsv(const std::string& path)
+	{
+		// frames still in flight are only collected when their slot comes around again, so the last few would be
+		// missing. Collected oldest first to keep the history in order
+		std::vector<uint32_t> inFlight;
+		for (uint32_t i = 0; i < frames_.size(); i++) {
+			if (frames_[i].pending && !(recording_ && i == static_cast<uint32_t>(frameIndex_))) {
+				inFlight.push_back(i);
+			}
+		}
+		std::sort(inFlight.begin(), inFlight.end(), [&](uint32_t a, uint32_t b) { return frames_[a].frameNumber < frames_[b].frameNumber; });
+		for (const uint32_t frameIndex : inFlight) {
+			collectResults(frameIndex, true);
+		}
+
+		std::ofstream file{path};
+		if (!file) {
+			throw std::runtime_error("failed to open gpu timings file: " + path);
+		}
+
+		file << "frame,scope,gpu_ms,input_vertices,input_primitives,vertex_invocations,clipping_primitives,fragment_invocations\n";
+		for (const FrameResult& frame : history_) {
+			file << frame.frameNumber << ",frame," << frame.milliseconds << ",,,,,\n";
+			for (const ScopeResult& scope : frame.scopes) {
+				file << frame.frameNumber << ',' << scope.name << ',' << scope.milliseconds << ','
+					<< scope.inputVertices << ',' << scope.inputPrimitives << ',' << scope.vertexInvocations << ','
+					<< scope.clippingPrimitives << ',' << scope.fragmentInvocations << '\n';
+			}
+		}
+
+		LOG_INFO("exported {} frames of gpu timings to {}", history_.size(), path);
+	}
+}
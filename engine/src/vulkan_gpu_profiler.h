@@ -0,0 +1,100 @@
+#pragma once
+
+#include "bve_device.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace bve
+{
+	// Times named scopes of a frame with timestamp queries and counts their work with pipeline statistics queries.
+	// Every frame in flight owns its query pools and they are only read back once that frame's fence has signaled,
+	// so results arrive a few frames late but reading them never stalls. Only exporting waits for the frames still in
+	// flight. Queries the device can't run are skipped.
+	class VulkanGpuProfiler
+	{
+	public:
+		static constexpr uint32_t MAX_SCOPES = 16;
+		static constexpr uint32_t HISTORY_SIZE = 600;
+		static constexpr uint32_t NO_QUERY = UINT32_MAX;
+
+		struct ScopeResult
+		{
+			std::string name;
+			double milliseconds = 0.0;
+			uint64_t inputVertices = 0;
+			uint64_t inputPrimitives = 0;
+			uint64_t vertexInvocations = 0;
+			uint64_t clippingPrimitives = 0; // primitives that reached the rasterizer
+			uint64_t fragmentInvocations = 0;
+		};
+
+		struct FrameResult
+		{
+			uint64_t frameNumber = 0;
+			double milliseconds = 0.0;
+			std::vector<ScopeResult> scopes;
+		};
+
+		// statisticsPerScope bounds how many command buffers one scope can count statistics over
+		VulkanGpuProfiler(BveDevice& device, uint32_t frameCount, uint32_t statisticsPerScope);
+		~VulkanGpuProfiler();
+
+		VulkanGpuProfiler(const VulkanGpuProfiler&) = delete;
+		VulkanGpuProfiler& operator=(const VulkanGpuProfiler&) = delete;
+		VulkanGpuProfiler(const VulkanGpuProfiler&&) = delete;
+		VulkanGpuProfiler& operator=(const VulkanGpuProfiler&&) = delete;
+
+		// collects what this frame's queries measured the last time around, then resets them and starts timing the
+		// frame. Only call once the frame's fence has signaled, outside of a render pass
+		void beginFrame(int frameIndex, VkCommandBuffer commandBuffer);
+		void endFrame(VkCommandBuffer commandBuffer);
+
+		// NO_QUERY once MAX_SCOPES scopes were added this frame or if timestamps aren't supported
+		uint32_t addScope(const std::string& name);
+		void writeTimestamp(VkCommandBuffer commandBuffer, uint32_t scope, bool end);
+
+		// reserves count statistics queries for scope and returns the first, or NO_QUERY if they don't fit.
+		// begin and end may then be recorded from any thread, each query into a single command buffer
+		uint32_t reserveStatistics(uint32_t scope, uint32_t count);
+		void beginStatistics(VkCommandBuffer commandBuffer, uint32_t query);
+		void endStatistics(VkCommandBuffer commandBuffer, uint32_t query);
+
+		bool isEnabled() const { return timestampPools_.size() > 0; }
+		bool hasStatistics() const { return statisticsPools_.size() > 0; }
+
+		// oldest first, at most HISTORY_SIZE frames
+		const std::deque<FrameResult>& getHistory() const { return history_; }
+
+		// one row per frame and scope, the whole frame is reported as scope "frame". Waits for the submitted frames
+		// that haven't been collected yet so the export ends with the last of them; a frame still being recorded is left out
+		void exportCsv(const std::string& path);
+
+	private:
+		struct FrameQueries
+		{
+			bool pending = false;
+			uint64_t frameNumber = 0;
+			std::vector<std::string> scopeNames;
+			std::vector<uint32_t> statisticsUsed; // per scope
+		};
+
+		// wait blocks until the frame's queries are written, only for frames already submitted
+		void collectResults(uint32_t frameIndex, bool wait = false);
+
+		BveDevice& bveDevice_;
+		uint32_t statisticsPerScope_;
+		uint64_t timestampMask_ = 0;
+		double timestampPeriod_ = 1.0; // nanoseconds per tick
+
+		std::vector<VkQueryPool> timestampPools_;
+		std::vector<VkQueryPool> statisticsPools_;
+		std::vector<FrameQueries> frames_;
+		int frameIndex_ = 0;
+		uint64_t frameNumber_ = 0;
+		bool recording_ = false; // between beginFrame and endFrame, the frame's queries aren't submitted yet
+
+		std::deque<FrameResult> history_;
+	};
+}
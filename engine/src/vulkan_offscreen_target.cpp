@@ -0,0 +1,227 @@
+#include "pch.h"
+#include "vulkan_offscreen_target.h"
+
+#include "core/profiler.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace bve
+{
+	VulkanOffscreenTarget::VulkanOffscreenTarget(BveDevice& device, VkExtent2D extent) : device_{device}, extent_{extent}
+	{
+		assert(extent.width > 0 && extent.height > 0 && "Offscreen target needs a non-zero extent");
+
+		createImages();
+		createRenderPass();
+		createReadbackBuffers();
+		createSyncObjects();
+	}
+
+	VulkanOffscreenTarget::~VulkanOffscreenTarget()
+	{
+		for (size_t i = 0; i < images_.size(); i++) {
+			vkDestroyImageView(device_.device(), imageViews_[i], nullptr);
+			vkDestroyImage(device_.device(), images_[i], nullptr);
+			vkFreeMemory(device_.device(), imageMemory_[i], nullptr);
+			vkDestroyBuffer(device_.device(), readbackBuffers_[i], nullptr);
+			vkFreeMemory(device_.device(), readbackMemory_[i], nullptr);
+			vkDestroyFence(device_.device(), inFlightFences_[i], nullptr);
+		}
+
+		vkDestroyRenderPass(device_.device(), renderPass_, nullptr);
+	}
+
+	uint32_t VulkanOffscreenTarget::acquireNextImage()
+	{
+		IG_PROFILE_SCOPE("wait for frame fence");
+		vkWaitForFences(device_.device(), 1, &inFlightFences_[currentFrame_], VK_TRUE, std::numeric_limits<uint64_t>::max());
+		return static_cast<uint32_t>(currentFrame_);
+	}
+
+	void VulkanOffscreenTarget::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t imageIndex)
+	{
+		assert(imageIndex == static_cast<uint32_t>(currentFrame_) && "Offscreen images are used in frame order");
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = buffers;
+
+		vkResetFences(device_.device(), 1, &inFlightFences_[currentFrame_]);
+		if (vkQueueSubmit(device_.graphicsQueue(), 1, &submitInfo, inFlightFences_[currentFrame_]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit offscreen command buffer!");
+		}
+
+		currentFrame_ = (currentFrame_ + 1) % MAX_FRAMES_IN_FLIGHT;
+	}
+
+	void VulkanOffscreenTarget::recordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+	{
+		// the graph's final transition only waits on bottom of pipe, so make the color writes visible to the copy
+		VkImageMemoryBarrier toTransfer{};
+		toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		toTransfer.oldLayout = FINAL_LAYOUT;
+		toTransfer.newLayout = FINAL_LAYOUT;
+		toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toTransfer.image = images_[imageIndex];
+		toTransfer.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+		VkBufferImageCopy region{};
+		region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+		region.imageExtent = {extent_.width, extent_.height, 1};
+		vkCmdCopyImageToBuffer(commandBuffer, images_[imageIndex], FINAL_LAYOUT, readbackBuffers_[imageIndex], 1, &region);
+
+		VkBufferMemoryBarrier toHost{};
+		toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toHost.buffer = readbackBuffers_[imageIndex];
+		toHost.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 0, nullptr);
+	}
+
+	std::vector<uint8_t> VulkanOffscreenTarget::readPixels(uint32_t imageIndex)
+	{
+		IG_PROFILE_FUNCTION();
+		vkWaitForFences(device_.device(), 1, &inFlightFences_[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+		const size_t size = static_cast<size_t>(extent_.width) * extent_.height * 4;
+		std::vector<uint8_t> pixels(size);
+
+		void* mapped = nullptr;
+		vkMapMemory(device_.device(), readbackMemory_[imageIndex], 0, VK_WHOLE_SIZE, 0, &mapped);
+		std::memcpy(pixels.data(), mapped, size);
+		vkUnmapMemory(device_.device(), readbackMemory_[imageIndex]);
+
+		if (imageFormat_ == VK_FORMAT_B8G8R8A8_SRGB) {
+			for (size_t i = 0; i < size; i += 4) {
+				std::swap(pixels[i], pixels[i + 2]);
+			}
+		}
+		return pixels;
+	}
+
+	void VulkanOffscreenTarget::createImages()
+	{
+		// srgb like the swap chain, so offscreen frames match what is shown on screen
+		imageFormat_ = device_.findSupportedFormat(
+			{VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_B8G8R8A8_SRGB},
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+		depthFormat_ = device_.findSupportedFormat(
+			{VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+		images_.resize(MAX_FRAMES_IN_FLIGHT);
+		imageMemory_.resize(MAX_FRAMES_IN_FLIGHT);
+		imageViews_.resize(MAX_FRAMES_IN_FLIGHT);
+		for (size_t i = 0; i < images_.size(); i++) {
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent = {extent_.width, extent_.height, 1};
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = imageFormat_;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			device_.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, images_[i], imageMemory_[i]);
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = images_[i];
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = imageFormat_;
+			viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+			if (vkCreateImageView(device_.device(), &viewInfo, nullptr, &imageViews_[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create offscreen image view!");
+			}
+		}
+	}
+
+	void VulkanOffscreenTarget::createRenderPass()
+	{
+		// like the swap chain's, this pass only describes the attachment formats pipelines are built against
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format = imageFormat_;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.finalLayout = FINAL_LAYOUT;
+
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format = depthFormat_;
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+		VkAttachmentReference depthAttachmentRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+
+		if (vkCreateRenderPass(device_.device(), &renderPassInfo, nullptr, &renderPass_) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen render pass!");
+		}
+	}
+
+	void VulkanOffscreenTarget::createReadbackBuffers()
+	{
+		const VkDeviceSize size = static_cast<VkDeviceSize>(extent_.width) * extent_.height * 4;
+		readbackBuffers_.resize(MAX_FRAMES_IN_FLIGHT);
+		readbackMemory_.resize(MAX_FRAMES_IN_FLIGHT);
+		for (size_t i = 0; i < readbackBuffers_.size(); i++) {
+			device_.createBuffer(
+				size,
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				readbackBuffers_[i],
+				readbackMemory_[i]);
+		}
+	}
+
+	void VulkanOffscreenTarget::createSyncObjects()
+	{
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		inFlightFences_.resize(MAX_FRAMES_IN_FLIGHT);
+		for (auto& fence : inFlightFences_) {
+			if (vkCreateFence(device_.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create offscreen fence!");
+			}
+		}
+	}
+}
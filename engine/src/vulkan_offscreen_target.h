@@ -0,0 +1,67 @@
+#pragma once
+
+#include "bve_device.h"
+#include "bve_swap_chain.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace bve
+{
+	// Stands in for the swap chain when rendering headless. Each frame in flight renders into its own color
+	// image, which the render graph leaves in TRANSFER_SRC_OPTIMAL so it can be copied back to the host.
+	class VulkanOffscreenTarget
+	{
+	public:
+		static constexpr int MAX_FRAMES_IN_FLIGHT = BveSwapChain::MAX_FRAMES_IN_FLIGHT;
+		static constexpr VkImageLayout FINAL_LAYOUT = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		VulkanOffscreenTarget(BveDevice& device, VkExtent2D extent);
+		~VulkanOffscreenTarget();
+
+		VulkanOffscreenTarget(const VulkanOffscreenTarget&) = delete;
+		VulkanOffscreenTarget& operator=(const VulkanOffscreenTarget&) = delete;
+		VulkanOffscreenTarget(const VulkanOffscreenTarget&&) = delete;
+		VulkanOffscreenTarget& operator=(const VulkanOffscreenTarget&&) = delete;
+
+		VkRenderPass getRenderPass() const { return renderPass_; }
+		VkImage getImage(int index) const { return images_[index]; }
+		VkImageView getImageView(int index) const { return imageViews_[index]; }
+		size_t imageCount() const { return images_.size(); }
+		VkFormat getImageFormat() const { return imageFormat_; }
+		VkFormat getDepthFormat() const { return depthFormat_; }
+		VkExtent2D getExtent() const { return extent_; }
+		float extentAspectRatio() const { return static_cast<float>(extent_.width) / static_cast<float>(extent_.height); }
+
+		// waits until the current frame's image is no longer in use and returns its index
+		uint32_t acquireNextImage();
+		void submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t imageIndex);
+
+		// copies the finished image into host memory, record after the render graph and before the submit
+		void recordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+		// waits for the submitted frame and returns its pixels as tightly packed rgba8
+		std::vector<uint8_t> readPixels(uint32_t imageIndex);
+
+	private:
+		void createImages();
+		void createRenderPass();
+		void createReadbackBuffers();
+		void createSyncObjects();
+
+		BveDevice& device_;
+		VkExtent2D extent_;
+		VkFormat imageFormat_;
+		VkFormat depthFormat_;
+		VkRenderPass renderPass_;
+
+		std::vector<VkImage> images_;
+		std::vector<VkDeviceMemory> imageMemory_;
+		std::vector<VkImageView> imageViews_;
+		std::vector<VkBuffer> readbackBuffers_;
+		std::vector<VkDeviceMemory> readbackMemory_;
+		std::vector<VkFence> inFlightFences_;
+		int currentFrame_ = 0;
+	};
+}
@@ -0,0 +1,184 @@
+#include "pch.h"
+#include "vulkan_parallel_recorder.h"
+
+#include "core/profiler.h"
+#include "core/thread_pool.h"
+
+#include <stdexcept>
+
+namespace bve
+{
+	VulkanParallelRecorder::VulkanParallelRecorder(BveDevice& device, uint32_t frameCount, uint32_t workerCount)
+		: bveDevice_{device}, workerCount_{std::max(workerCount, 1u)}
+	{
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = device.getGraphicsQueueFamily();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		workerPools_.resize(frameCount);
+		for (auto& framePools : workerPools_) {
+			framePools.resize(workerCount_);
+			for (auto& workerPool : framePools) {
+				if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &workerPool.commandPool) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create worker command pool");
+				}
+			}
+		}
+	}
+
+	VulkanParallelRecorder::~VulkanParallelRecorder()
+	{
+		// destroying a pool frees every command buffer allocated from it
+		for (auto& framePools : workerPools_) {
+			for (auto& workerPool : framePools) {
+				vkDestroyCommandPool(bveDevice_.device(), workerPool.commandPool, nullptr);
+			}
+		}
+	}
+
+	void VulkanParallelRecorder::beginFrame(int frameIndex)
+	{
+		assert(frameIndex >= 0 && frameIndex < static_cast<int>(workerPools_.size()) && "Frame index out of range");
+
+		frameIndex_ = frameIndex;
+		for (auto& workerPool : workerPools_[frameIndex_]) {
+			vkResetCommandPool(bveDevice_.device(), workerPool.commandPool, 0);
+			workerPool.usedCount = 0;
+		}
+	}
+
+	void VulkanParallelRecorder::beginRenderPass(VkCommandBuffer primaryCommandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent)
+	{
+		primaryCommandBuffer_ = primaryCommandBuffer;
+		renderPass_ = renderPass;
+		framebuffer_ = framebuffer;
+		extent_ = extent;
+	}
+
+	void VulkanParallelRecorder::record(uint32_t count, const RecordFn& body, uint32_t minBatchSize)
+	{
+		assert(primaryCommandBuffer_ != VK_NULL_HANDLE && "Cannot record before beginRenderPass");
+
+		if (count == 0) {
+			return;
+		}
+
+		// ranges map to worker slots by index rather than by thread, so a pool is never used by two threads at once
+		minBatchSize = std::max(minBatchSize, 1u);
+		const uint32_t maxChunks = (count + minBatchSize - 1) / minBatchSize;
+		const uint32_t chunkSize = (count + std::min(workerCount_, maxChunks) - 1) / std::min(workerCount_, maxChunks);
+		const uint32_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+		// every secondary counts into its own statistics query, the profiler sums them per scope
+		const uint32_t firstQuery = profiler_ ? profiler_->reserveStatistics(scope_, chunkCount) : VulkanGpuProfiler::NO_QUERY;
+
+		std::vector<VkCommandBuffer> secondaries(chunkCount);
+		ThreadPool::instance().parallelFor(chunkCount, [&](uint32_t chunkBegin, uint32_t chunkEnd) {
+			for (uint32_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+				IG_PROFILE_SCOPE("record secondary");
+				VkCommandBuffer commandBuffer = acquireCommandBuffer(workerPools_[frameIndex_][chunk]);
+				beginSecondary(commandBuffer);
+				if (firstQuery != VulkanGpuProfiler::NO_QUERY) {
+					profiler_->beginStatistics(commandBuffer, firstQuery + chunk);
+				}
+
+				const uint32_t begin = chunk * chunkSize;
+				body(commandBuffer, begin, std::min(begin + chunkSize, count));
+
+				if (firstQuery != VulkanGpuProfiler::NO_QUERY) {
+					profiler_->endStatistics(commandBuffer, firstQuery + chunk);
+				}
+
+				if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to record secondary command buffer");
+				}
+				secondaries[chunk] = commandBuffer;
+			}
+		});
+
+		vkCmdExecuteCommands(primaryCommandBuffer_, chunkCount, secondaries.data());
+	}
+
+	void VulkanParallelRecorder::beginScope(const std::string& name)
+	{
+		assert(scope_ == VulkanGpuProfiler::NO_QUERY && "Profiler scopes can't be nested");
+
+		if (profiler_) {
+			scope_ = profiler_->addScope(name);
+			recordTimestamp(false);
+		}
+	}
+
+	void VulkanParallelRecorder::endScope()
+	{
+		recordTimestamp(true);
+		scope_ = VulkanGpuProfiler::NO_QUERY;
+	}
+
+	void VulkanParallelRecorder::recordTimestamp(bool end)
+	{
+		if (scope_ == VulkanGpuProfiler::NO_QUERY) {
+			return;
+		}
+
+		// the primary can only execute secondaries inside the render pass, so the timestamp gets one of its own.
+		// Scopes are opened on the recording thread, so the first worker's pool is free
+		VkCommandBuffer commandBuffer = acquireCommandBuffer(workerPools_[frameIndex_][0]);
+		beginSecondary(commandBuffer);
+		profiler_->writeTimestamp(commandBuffer, scope_, end);
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record timestamp command buffer");
+		}
+		vkCmdExecuteCommands(primaryCommandBuffer_, 1, &commandBuffer);
+	}
+
+	VkCommandBuffer VulkanParallelRecorder::acquireCommandBuffer(WorkerPool& workerPool)
+	{
+		if (workerPool.usedCount == workerPool.commandBuffers.size()) {
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = workerPool.commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(bveDevice_.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate secondary command buffer");
+			}
+			workerPool.commandBuffers.push_back(commandBuffer);
+		}
+
+		return workerPool.commandBuffers[workerPool.usedCount++];
+	}
+
+	void VulkanParallelRecorder::beginSecondary(VkCommandBuffer commandBuffer)
+	{
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPass_;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = framebuffer_;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin recording secondary command buffer");
+		}
+
+		// dynamic state is not inherited from the primary
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(extent_.width);
+		viewport.height = static_cast<float>(extent_.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		VkRect2D scissor{{0, 0}, extent_};
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "bve_device.h"
+#include "vulkan_gpu_profiler.h"
+
+#include <functional>
+#include <vector>
+
+namespace bve
+{
+	// Records the contents of a render pass on the thread pool. Every worker slot owns one command pool
+	// per frame in flight, so secondaries can be recorded without locking and are recycled by resetting
+	// the whole pool once the frame's fence has signaled.
+	class VulkanParallelRecorder
+	{
+	public:
+		using RecordFn = std::function<void(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)>;
+
+		VulkanParallelRecorder(BveDevice& device, uint32_t frameCount, uint32_t workerCount);
+		~VulkanParallelRecorder();
+
+		VulkanParallelRecorder(const VulkanParallelRecorder&) = delete;
+		VulkanParallelRecorder& operator=(const VulkanParallelRecorder&) = delete;
+		VulkanParallelRecorder(const VulkanParallelRecorder&&) = delete;
+		VulkanParallelRecorder& operator=(const VulkanParallelRecorder&&) = delete;
+
+		// only call once the frame's in flight fence has signaled
+		void beginFrame(int frameIndex);
+
+		// the primary must have begun renderPass with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+		void beginRenderPass(VkCommandBuffer primaryCommandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+
+		// splits [0, count) into up to one contiguous range per worker, records each range into its own secondary
+		// with body(commandBuffer, begin, end) and executes them into the primary in range order. Secondaries
+		// start with the viewport and scissor set but nothing else, so body must bind its own pipeline and sets.
+		void record(uint32_t count, const RecordFn& body, uint32_t minBatchSize = 1);
+
+		uint32_t getWorkerCount() const { return workerCount_; }
+
+		// every record() between beginScope and endScope is timed and counted as one scope of the profiler
+		void setProfiler(VulkanGpuProfiler* profiler) { profiler_ = profiler; }
+		void beginScope(const std::string& name);
+		void endScope();
+
+	private:
+		struct WorkerPool
+		{
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint32_t usedCount = 0;
+		};
+
+		VkCommandBuffer acquireCommandBuffer(WorkerPool& workerPool);
+		void beginSecondary(VkCommandBuffer commandBuffer);
+		void recordTimestamp(bool end);
+
+		BveDevice& bveDevice_;
+		uint32_t workerCount_;
+
+		// indexed [frame][worker]
+		std::vector<std::vector<WorkerPool>> workerPools_;
+		int frameIndex_ = 0;
+
+		VkCommandBuffer primaryCommandBuffer_ = VK_NULL_HANDLE;
+		VkRenderPass renderPass_ = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer_ = VK_NULL_HANDLE;
+		VkExtent2D extent_{};
+
+		VulkanGpuProfiler* profiler_ = nullptr;
+		uint32_t scope_ = VulkanGpuProfiler::NO_QUERY;
+	};
+}
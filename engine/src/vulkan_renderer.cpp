@@ -7,22 +7,80 @@
 
 namespace bve
 {
-	VulkanRenderer::VulkanRenderer(BveWindow& window, BveDevice& device) : bveWindow_(window), bveDevice_(device), currentFrameIndex_(0), isFrameStarted_(false)
+	VulkanRenderer::VulkanRenderer(BveWindow& window, BveDevice& device) : bveWindow_(&window), bveDevice_(device), currentFrameIndex_(0), isFrameStarted_(false)
 	{
 		recreateSwapChain();
 		createCommandBuffers();
 	}
 
+	VulkanRenderer::VulkanRenderer(BveDevice& device, VkExtent2D extent) : bveWindow_(nullptr), bveDevice_(device), currentFrameIndex_(0), isFrameStarted_(false)
+	{
+		offscreenTarget_ = std::make_unique<VulkanOffscreenTarget>(device, extent);
+		swapChainGeneration_++;
+		createCommandBuffers();
+	}
+
 	VulkanRenderer::~VulkanRenderer()
 	{
 		freeCommandBuffers();
 	}
 
+	float VulkanRenderer::getAspectRatio() const
+	{
+		return offscreenTarget_ ? offscreenTarget_->extentAspectRatio() : bveSwapChain_->extentAspectRatio();
+	}
+
+	VkRenderPass VulkanRenderer::getSwapChainRenderPass() const
+	{
+		return offscreenTarget_ ? offscreenTarget_->getRenderPass() : bveSwapChain_->getRenderPass();
+	}
+
+	VkExtent2D VulkanRenderer::getSwapChainExtent() const
+	{
+		return offscreenTarget_ ? offscreenTarget_->getExtent() : bveSwapChain_->getSwapChainExtent();
+	}
+
+	VkFormat VulkanRenderer::getSwapChainImageFormat() const
+	{
+		return offscreenTarget_ ? offscreenTarget_->getImageFormat() : bveSwapChain_->getSwapChainImageFormat();
+	}
+
+	VkFormat VulkanRenderer::getSwapChainDepthFormat() const
+	{
+		return offscreenTarget_ ? offscreenTarget_->getDepthFormat() : bveSwapChain_->getSwapChainDepthFormat();
+	}
+
+	VkImage VulkanRenderer::getCurrentImage() const
+	{
+		return offscreenTarget_ ? offscreenTarget_->getImage(currentImageIndex_) : bveSwapChain_->getImage(currentImageIndex_);
+	}
+
+	VkImageView VulkanRenderer::getCurrentImageView() const
+	{
+		return offscreenTarget_ ? offscreenTarget_->getImageView(currentImageIndex_) : bveSwapChain_->getImageView(currentImageIndex_);
+	}
+
+	VkImageLayout VulkanRenderer::getFinalImageLayout() const
+	{
+		return offscreenTarget_ ? VulkanOffscreenTarget::FINAL_LAYOUT : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	}
+
+	uint32_t VulkanRenderer::getImageCount() const
+	{
+		return static_cast<uint32_t>(offscreenTarget_ ? offscreenTarget_->imageCount() : bveSwapChain_->imageCount());
+	}
+
+	void VulkanRenderer::requestCapture()
+	{
+		assert(isHeadless() && "Frames can only be captured when rendering headless");
+		captureRequested_ = true;
+	}
+
 	void VulkanRenderer::recreateSwapChain()
 	{
-		VkExtent2D extent = bveWindow_.getExtent();
+		VkExtent2D extent = bveWindow_->getExtent();
 		while (extent.width == 0 || extent.height == 0) {
-			extent = bveWindow_.getExtent();
+			extent = bveWindow_->getExtent();
 			glfwWaitEvents();
 		}
 
@@ -39,6 +97,8 @@ namespace bve
 				throw std::runtime_error("Swap chain image or depth format has changed!");
 			}
 		}
+
+		swapChainGeneration_++;
 	}
 
 	void VulkanRenderer::createCommandBuffers()
@@ -70,6 +130,19 @@ namespace bve
 	{
 		assert(!isFrameStarted_ && "Cannot call beginFrame while frame already in progress");
 
+		if (offscreenTarget_) {
+			currentImageIndex_ = offscreenTarget_->acquireNextImage();
+			isFrameStarted_ = true;
+
+			VkCommandBuffer commandBuffer = getCurrentCommandBuffer();
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to begin recording command buffer!");
+			}
+			return commandBuffer;
+		}
+
 		VkResult result = bveSwapChain_->acquireNextImage(&currentImageIndex_);
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -100,14 +173,34 @@ namespace bve
 		assert(isFrameStarted_ && "Cannot call endFrame while frame is not in progress");
 
 		VkCommandBuffer commandBuffer = getCurrentCommandBuffer();
+
+		if (offscreenTarget_) {
+			if (captureRequested_) {
+				offscreenTarget_->recordReadback(commandBuffer, currentImageIndex_);
+			}
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to record command buffer");
+			}
+
+			offscreenTarget_->submitCommandBuffers(&commandBuffer, currentImageIndex_);
+			if (captureRequested_) {
+				capturedPixels_ = offscreenTarget_->readPixels(currentImageIndex_);
+				captureRequested_ = false;
+			}
+
+			isFrameStarted_ = false;
+			currentFrameIndex_ = (currentFrameIndex_ + 1) % BveSwapChain::MAX_FRAMES_IN_FLIGHT;
+			return;
+		}
+
 		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to record command buffer");
 		}
 
 		VkResult result = bveSwapChain_->submitCommandBuffers(&commandBuffer, &currentImageIndex_);
 
-		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || bveWindow_.wasWindowResized()) {
-			bveWindow_.resetWindowResizedFlag();
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || bveWindow_->wasWindowResized()) {
+			bveWindow_->resetWindowResizedFlag();
 			recreateSwapChain();
 		} else if (result != VK_SUCCESS) {
 			throw std::runtime_error("failed to present swap chain image!");
@@ -116,45 +209,4 @@ namespace bve
 		isFrameStarted_ = false;
 		currentFrameIndex_ = (currentFrameIndex_ + 1) % BveSwapChain::MAX_FRAMES_IN_FLIGHT;
 	}
-
-	void VulkanRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
-	{
-		assert(isFrameStarted_ && "Cannot call beginSwapChainRenderPass while frame is not in progress");
-		assert(commandBuffer == getCurrentCommandBuffer() && "Cannot begin render pass on another frame's command buffer");
-
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = bveSwapChain_->getRenderPass();
-		renderPassInfo.framebuffer = bveSwapChain_->getFrameBuffer(currentImageIndex_);
-
-		renderPassInfo.renderArea.offset = {0, 0};
-		renderPassInfo.renderArea.extent = bveSwapChain_->getSwapChainExtent();
-
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = {{0.01f, 0.01f, 0.01f, 1.0f}};
-		clearValues[1].depthStencil = {1.0f, 0};
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
-
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = static_cast<float>(bveSwapChain_->getSwapChainExtent().width);
-		viewport.height = static_cast<float>(bveSwapChain_->getSwapChainExtent().height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		VkRect2D scissor{{0, 0}, bveSwapChain_->getSwapChainExtent()};
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-	}
-
-	void VulkanRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer)
-	{
-		assert(isFrameStarted_ && "Cannot call endSwapChainRenderPass while frame is not in progress");
-		assert(commandBuffer == getCurrentCommandBuffer() && "Cannot end render pass on another frame's command buffer");
-
-		vkCmdEndRenderPass(commandBuffer);
-	}
 }
@@ -2,6 +2,7 @@
 
 #include "bve_window.h"
 #include "bve_swap_chain.h"
+#include "vulkan_offscreen_target.h"
 #include "bve_model.h"
 
 #include <memory>
@@ -18,6 +19,8 @@ namespace bve
 		static constexpr int HEIGHT = 1200;
 
 		VulkanRenderer(BveWindow& window, BveDevice& device);
+		// headless, renders into offscreen images of a fixed extent instead of a swap chain
+		VulkanRenderer(BveDevice& device, VkExtent2D extent);
 		~VulkanRenderer();
 
 		VulkanRenderer(const VulkanRenderer&) = delete;
@@ -26,29 +29,46 @@ namespace bve
 		VulkanRenderer& operator=(const VulkanRenderer&&) = delete;
 
 		bool isFrameInProgress() const { return isFrameStarted_; }
-		float getAspectRatio() const { return bveSwapChain_->extentAspectRatio(); }
-		VkRenderPass getSwapChainRenderPass() const { return bveSwapChain_->getRenderPass(); }
+		bool isHeadless() const { return offscreenTarget_ != nullptr; }
+		float getAspectRatio() const;
+		VkRenderPass getSwapChainRenderPass() const;
+		VkExtent2D getSwapChainExtent() const;
+		VkFormat getSwapChainImageFormat() const;
+		VkFormat getSwapChainDepthFormat() const;
+		VkImage getCurrentImage() const;
+		VkImageView getCurrentImageView() const;
+		// layout the frame's image has to be left in, ready to present or to copy back when headless
+		VkImageLayout getFinalImageLayout() const;
+		// incremented whenever the swap chain is recreated and its image views change
+		uint32_t getSwapChainGeneration() const { return swapChainGeneration_; }
 		VkCommandBuffer getCurrentCommandBuffer() const { return commandBuffers_[currentFrameIndex_]; }
 		int getFrameIndex() const { return currentFrameIndex_; }
-		uint32_t getImageCount() const { return bveSwapChain_->imageCount(); }
+		uint32_t getImageCount() const;
 
 		VkCommandBuffer beginFrame();
 		void endFrame();
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
-		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
+
+		// headless only, the frame being recorded is copied back once it finishes
+		void requestCapture();
+		// pixels of the last captured frame as rgba8, rows top to bottom
+		const std::vector<uint8_t>& getCapturedPixels() const { return capturedPixels_; }
 
 	private:
 		void createCommandBuffers();
 		void freeCommandBuffers();
 		void recreateSwapChain();
 
-		BveWindow& bveWindow_;
+		BveWindow* bveWindow_;
 		BveDevice& bveDevice_;
 		std::unique_ptr<BveSwapChain> bveSwapChain_;
+		std::unique_ptr<VulkanOffscreenTarget> offscreenTarget_;
+		bool captureRequested_ = false;
+		std::vector<uint8_t> capturedPixels_;
 		std::vector<VkCommandBuffer> commandBuffers_;
 
 		uint32_t currentImageIndex_;
 		int currentFrameIndex_;
 		bool isFrameStarted_;
+		uint32_t swapChainGeneration_ = 0;
 	};
 }
@@ -0,0 +1,114 @@
+#include "pch.h"
+#include "vulkan_upload_queue.h"
+#include "core/profiler.h"
+
+#include <limits>
+#include <stdexcept>
+
+namespace bve
+{
+	VulkanUploadQueue::VulkanUploadQueue(BveDevice& device) : bveDevice_{device} {}
+
+	VulkanUploadQueue::~VulkanUploadQueue()
+	{
+		// staging buffers can't be freed while the gpu may still be reading them
+		for (Batch& batch : inFlight_) {
+			vkWaitForFences(bveDevice_.device(), 1, &batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+			retire(batch);
+		}
+	}
+
+	uint64_t VulkanUploadQueue::enqueue(std::vector<BufferUpload> uploads)
+	{
+		for (BufferUpload& upload : uploads) {
+			pending_.push_back(std::move(upload));
+		}
+		return nextTicket_;
+	}
+
+	void VulkanUploadQueue::submit()
+	{
+		if (pending_.empty()) {
+			return;
+		}
+
+		IG_PROFILE_FUNCTION();
+		Batch batch{nextTicket_++, VK_NULL_HANDLE, VK_NULL_HANDLE, std::move(pending_)};
+		pending_.clear();
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = bveDevice_.getCommandPool();
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(bveDevice_.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload command buffer");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(bveDevice_.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence");
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+		[[maybe_unused]] VkDeviceSize uploadBytes = 0;
+		for (const BufferUpload& upload : batch.uploads) {
+			VkBufferCopy copyRegion{};
+			copyRegion.size = upload.size;
+			vkCmdCopyBuffer(batch.commandBuffer, upload.staging->getBuffer(), upload.destination, 1, &copyRegion);
+			uploadBytes += upload.size;
+		}
+
+		// draws only start once the fence has signaled, but the copies still have to be made visible to vertex input
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		vkEndCommandBuffer(batch.commandBuffer);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		if (vkQueueSubmit(bveDevice_.graphicsQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload command buffer");
+		}
+
+		IG_PROFILE_COUNT(UPLOAD_BYTES, uploadBytes);
+		inFlight_.push_back(std::move(batch));
+	}
+
+	void VulkanUploadQueue::update()
+	{
+		while (!inFlight_.empty() && vkGetFenceStatus(bveDevice_.device(), inFlight_.front().fence) == VK_SUCCESS) {
+			retire(inFlight_.front());
+			inFlight_.pop_front();
+		}
+	}
+
+	void VulkanUploadQueue::waitIdle()
+	{
+		IG_PROFILE_FUNCTION();
+		submit();
+		while (!inFlight_.empty()) {
+			vkWaitForFences(bveDevice_.device(), 1, &inFlight_.front().fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+			retire(inFlight_.front());
+			inFlight_.pop_front();
+		}
+	}
+
+	void VulkanUploadQueue::retire(Batch& batch)
+	{
+		vkDestroyFence(bveDevice_.device(), batch.fence, nullptr);
+		vkFreeCommandBuffers(bveDevice_.device(), bveDevice_.getCommandPool(), 1, &batch.commandBuffer);
+		batch.uploads.clear();
+		completedTicket_ = batch.ticket;
+	}
+}
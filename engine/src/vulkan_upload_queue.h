@@ -0,0 +1,67 @@
+#pragma once
+
+#include "bve_device.h"
+#include "vulkan_buffer.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace bve
+{
+	// a filled host visible buffer waiting to be copied into a device local one
+	struct BufferUpload
+	{
+		std::unique_ptr<VulkanBuffer> staging;
+		VkBuffer destination = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+	};
+
+	// Batches staging buffer copies into one command buffer per submit instead of waiting for the queue to go
+	// idle after every copy. Each submit gets a fence that is polled once per frame, staging buffers are freed
+	// and tickets reported complete once it has signaled. Only used from the main thread, which owns the queue.
+	class VulkanUploadQueue
+	{
+	public:
+		explicit VulkanUploadQueue(BveDevice& device);
+		~VulkanUploadQueue();
+
+		VulkanUploadQueue(const VulkanUploadQueue&) = delete;
+		VulkanUploadQueue& operator=(const VulkanUploadQueue&) = delete;
+		VulkanUploadQueue(const VulkanUploadQueue&&) = delete;
+		VulkanUploadQueue& operator=(const VulkanUploadQueue&&) = delete;
+
+		// adds the copies to the next submit, the returned ticket is complete once all of them have executed
+		uint64_t enqueue(std::vector<BufferUpload> uploads);
+
+		// records every copy enqueued since the last submit into one command buffer and submits it to the graphics queue
+		void submit();
+
+		// retires the submits the gpu has finished, never blocks
+		void update();
+
+		// submits pending copies and blocks until the gpu has finished all of them
+		void waitIdle();
+
+		bool isComplete(uint64_t ticket) const { return ticket <= completedTicket_; }
+		bool isIdle() const { return pending_.empty() && inFlight_.empty(); }
+
+	private:
+		struct Batch
+		{
+			uint64_t ticket;
+			VkCommandBuffer commandBuffer;
+			VkFence fence;
+			std::vector<BufferUpload> uploads;
+		};
+
+		void retire(Batch& batch);
+
+		BveDevice& bveDevice_;
+		std::vector<BufferUpload> pending_;
+		std::deque<Batch> inFlight_; // in submission order, which is also the order they complete in
+		uint64_t nextTicket_ = 1;
+		uint64_t completedTicket_ = 0;
+	};
+}
@@ -0,0 +1,250 @@
+#include "pch.h"
+#include "test.h"
+#include "asset_archive.h"
+#include "log.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+// Archives read back what was packed into them, and truncated or corrupt archives are refused when mounted or when
+// an entry is read instead of being trusted.
+
+namespace
+{
+	using namespace bve;
+
+	// the file layout from asset_archive.cpp, which keeps it private: a 48 byte header and then the table of contents
+	// on the entry alignment, one 48 byte entry per asset
+	constexpr size_t HEADER_SIZE = 48;
+	constexpr size_t FORMAT_VERSION_OFFSET = 4;
+	constexpr size_t TOC_OFFSET = AssetArchive::ENTRY_ALIGNMENT;
+	constexpr size_t TOC_ENTRY_SIZE = 48;
+	constexpr size_t TOC_ENTRY_OFFSET = 0;
+	constexpr size_t TOC_NAME_LENGTH = 36;
+	constexpr size_t TOC_COMPRESSION = 40;
+	constexpr size_t TOC_BLOCK_COUNT = 44;
+
+	const std::filesystem::path ARCHIVE_PATH = std::filesystem::temp_directory_path() / "asset_archive_tests.igpk";
+	const std::filesystem::path DAMAGED_PATH = std::filesystem::temp_directory_path() / "asset_archive_tests_damaged.igpk";
+
+	// a simple generator so failures reproduce
+	std::vector<std::byte> randomBytes(size_t size, uint32_t seed)
+	{
+		std::vector<std::byte> bytes(size);
+		for (std::byte& byte : bytes) {
+			seed = seed * 1664525u + 1013904223u;
+			byte = static_cast<std::byte>(seed >> 24);
+		}
+		return bytes;
+	}
+
+	// spans several blocks and compresses well
+	std::vector<std::byte> repetitiveBytes(size_t size)
+	{
+		std::vector<std::byte> bytes(size);
+		for (size_t i = 0; i < size; i++) {
+			bytes[i] = static_cast<std::byte>((i / 7) % 13);
+		}
+		return bytes;
+	}
+
+	std::vector<AssetArchive::Source> makeSources()
+	{
+		std::vector<AssetArchive::Source> sources;
+		sources.push_back({"models/large.bvm", repetitiveBytes(AssetArchive::BLOCK_SIZE * 2 + 1000), true});
+		sources.push_back({"models/copy.bvm", repetitiveBytes(AssetArchive::BLOCK_SIZE * 2 + 1000), true});
+		sources.push_back({"models/random.bvm", randomBytes(5000, 1), true});
+		sources.push_back({"models/small.bvm", randomBytes(100, 2), false});
+		sources.push_back({"models/empty.bvm", {}, true});
+		return sources;
+	}
+
+	std::vector<std::byte> readFile(const std::filesystem::path& path)
+	{
+		std::ifstream file{path, std::ios::binary};
+		const std::vector<char> chars{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+		std::vector<std::byte> bytes(chars.size());
+		std::memcpy(bytes.data(), chars.data(), chars.size());
+		return bytes;
+	}
+
+	void writeFile(const std::filesystem::path& path, std::span<const std::byte> bytes)
+	{
+		std::ofstream file{path, std::ios::binary | std::ios::trunc};
+		file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+	}
+
+	bool mounts(std::span<const std::byte> bytes)
+	{
+		writeFile(DAMAGED_PATH, bytes);
+		try {
+			AssetArchive archive{DAMAGED_PATH.string()};
+			return true;
+		} catch (const std::runtime_error&) {
+			return false;
+		}
+	}
+
+	template <typename T>
+	void poke(std::vector<std::byte>& bytes, size_t offset, T value)
+	{
+		std::memcpy(bytes.data() + offset, &value, sizeof(value));
+	}
+
+	size_t getTocEntry(uint32_t index)
+	{
+		return TOC_OFFSET + index * TOC_ENTRY_SIZE;
+	}
+
+	void testRoundTrip()
+	{
+		AssetArchive::write(ARCHIVE_PATH.string(), makeSources());
+		const AssetArchive archive{ARCHIVE_PATH.string()};
+		IG_CHECK(archive.getEntries().size() == 5);
+
+		for (const AssetArchive::Source& source : makeSources()) {
+			const AssetArchive::Entry* entry = archive.find(source.name);
+			IG_CHECK(entry != nullptr);
+			if (!entry) {
+				continue;
+			}
+			IG_CHECK(entry->name == source.name && entry->size == source.data.size());
+			IG_CHECK(entry->offset % AssetArchive::ENTRY_ALIGNMENT == 0);
+			IG_CHECK(archive.read(*entry) == source.data);
+			IG_CHECK(archive.verify(*entry));
+			if (entry->compression == AssetArchive::Compression::NONE) {
+				const std::span<const std::byte> view = archive.view(*entry);
+				IG_CHECK(std::equal(view.begin(), view.end(), source.data.begin(), source.data.end()));
+			}
+		}
+
+		// only data that shrinks is compressed, and the same contents are stored once
+		const AssetArchive::Entry* large = archive.find("models/large.bvm");
+		const AssetArchive::Entry* copy = archive.find("models/copy.bvm");
+		const AssetArchive::Entry* random = archive.find("models/random.bvm");
+		IG_CHECK(large && large->compression == AssetArchive::Compression::LZ4 && large->blockCount == 3);
+		IG_CHECK(large && large->storedSize < large->size / 4);
+		IG_CHECK(large && copy && large->offset == copy->offset && large->contentHash == copy->contentHash);
+		IG_CHECK(random && random->compression == AssetArchive::Compression::NONE);
+
+		IG_CHECK(archive.find("models/missing.bvm") == nullptr);
+		IG_CHECK(archive.find("") == nullptr);
+
+		std::vector<AssetArchive::Source> duplicates = makeSources();
+		duplicates.push_back(duplicates.front());
+		bool threw = false;
+		try {
+			AssetArchive::write(DAMAGED_PATH.string(), std::move(duplicates));
+		} catch (const std::runtime_error&) {
+			threw = true;
+		}
+		IG_CHECK(threw);
+	}
+
+	void testTruncated()
+	{
+		const std::vector<std::byte> bytes = readFile(ARCHIVE_PATH);
+		for (size_t size : {size_t{0}, HEADER_SIZE - 1, HEADER_SIZE, getTocEntry(2) + 10, bytes.size() / 2, bytes.size() - 1}) {
+			IG_CHECK(!mounts(std::span{bytes}.first(size)));
+		}
+		IG_CHECK(mounts(bytes));
+	}
+
+	void testCorruptTableOfContents()
+	{
+		const std::vector<std::byte> original = readFile(ARCHIVE_PATH);
+		// entries are sorted by name: copy, empty, large, random, small
+		const auto corrupt = [&](auto change) {
+			std::vector<std::byte> bytes = original;
+			change(bytes);
+			return !mounts(bytes);
+		};
+
+		IG_CHECK(corrupt([](auto& bytes) { bytes[0] ^= std::byte{1}; }));
+		IG_CHECK(corrupt([](auto& bytes) { poke<uint32_t>(bytes, FORMAT_VERSION_OFFSET, AssetArchive::FORMAT_VERSION + 1); }));
+		// an entry count past the end of the file
+		IG_CHECK(corrupt([](auto& bytes) { poke<uint32_t>(bytes, 8, 1000000); }));
+		// a name running past the names
+		IG_CHECK(corrupt([](auto& bytes) { poke<uint32_t>(bytes, getTocEntry(4) + TOC_NAME_LENGTH, 1000); }));
+		// an entry off its alignment, and one past the end of the file
+		IG_CHECK(corrupt([](auto& bytes) { poke<uint64_t>(bytes, getTocEntry(3) + TOC_ENTRY_OFFSET, AssetArchive::ENTRY_ALIGNMENT + 1); }));
+		IG_CHECK(corrupt([&](auto& bytes) { poke<uint64_t>(bytes, getTocEntry(3) + TOC_ENTRY_OFFSET, original.size() + AssetArchive::ENTRY_ALIGNMENT); }));
+		// an unknown compression, and a compressed entry with the wrong number of blocks
+		IG_CHECK(corrupt([](auto& bytes) { poke<uint32_t>(bytes, getTocEntry(3) + TOC_COMPRESSION, 7); }));
+		IG_CHECK(corrupt([](auto& bytes) { poke<uint32_t>(bytes, getTocEntry(2) + TOC_BLOCK_COUNT, 2); }));
+		// an uncompressed entry claiming blocks
+		IG_CHECK(corrupt([](auto& bytes) { poke<uint32_t>(bytes, getTocEntry(4) + TOC_BLOCK_COUNT, 1); }));
+		// names out of order, which find relies on
+		IG_CHECK(corrupt([](auto& bytes) {
+			std::vector<std::byte> first(TOC_ENTRY_SIZE);
+			std::memcpy(first.data(), bytes.data() + getTocEntry(0), TOC_ENTRY_SIZE);
+			std::memcpy(bytes.data() + getTocEntry(0), bytes.data() + getTocEntry(1), TOC_ENTRY_SIZE);
+			std::memcpy(bytes.data() + getTocEntry(1), first.data(), TOC_ENTRY_SIZE);
+		}));
+	}
+
+	// damage inside an entry passes the mount, reading it throws instead
+	void testCorruptEntries()
+	{
+		const std::vector<std::byte> original = readFile(ARCHIVE_PATH);
+		const auto readsCorrupt = [&](std::string_view name, size_t offset, std::byte flip) {
+			std::vector<std::byte> bytes = original;
+			const AssetArchive::Entry* entry = nullptr;
+			{
+				const AssetArchive archive{ARCHIVE_PATH.string()};
+				entry = archive.find(name);
+				IG_CHECK(entry && offset < entry->storedSize);
+				if (!entry || offset >= entry->storedSize) {
+					return false;
+				}
+				bytes[entry->offset + offset] ^= flip;
+			}
+			writeFile(DAMAGED_PATH, bytes);
+			const AssetArchive damaged{DAMAGED_PATH.string()};
+			const AssetArchive::Entry* damagedEntry = damaged.find(name);
+			bool threw = false;
+			try {
+				damaged.read(*damagedEntry);
+			} catch (const std::runtime_error&) {
+				threw = true;
+			}
+			return threw && !damaged.verify(*damagedEntry);
+		};
+
+		IG_CHECK(readsCorrupt("models/small.bvm", 50, std::byte{0x10}));
+		// the block size table, then the compressed bytes of the first and last block
+		IG_CHECK(readsCorrupt("models/large.bvm", 1, std::byte{0x01}));
+		IG_CHECK(readsCorrupt("models/large.bvm", 3 * sizeof(uint32_t) + 40, std::byte{0xff}));
+
+		const AssetArchive archive{ARCHIVE_PATH.string()};
+		const AssetArchive::Entry* large = archive.find("models/large.bvm");
+		IG_CHECK(readsCorrupt("models/large.bvm", large->storedSize - 3, std::byte{0x80}));
+
+		// damage anywhere in a compressed entry is caught, by its block sizes, its decompression or its hash
+		for (size_t offset = 0; offset < large->storedSize; offset += 37) {
+			std::vector<std::byte> bytes = original;
+			bytes[large->offset + offset] ^= std::byte{0x5a};
+			writeFile(DAMAGED_PATH, bytes);
+			const AssetArchive damaged{DAMAGED_PATH.string()};
+			IG_CHECK(!damaged.verify(*damaged.find("models/large.bvm")));
+		}
+	}
+}
+
+int main()
+{
+	Log::init();
+	testRoundTrip();
+	testTruncated();
+	testCorruptTableOfContents();
+	testCorruptEntries();
+
+	std::error_code error;
+	std::filesystem::remove(ARCHIVE_PATH, error);
+	std::filesystem::remove(DAMAGED_PATH, error);
+	return bve::test::result();
+}
@@ -0,0 +1,154 @@
+#include "pch.h"
+#include "test.h"
+#include "core/async_file_reader.h"
+#include "log.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Reads through io_uring where the kernel allows it and through the fallback threads, with more ranges than the queue
+// holds and with callbacks that read again while the queue is full.
+
+namespace
+{
+	using namespace bve;
+
+	constexpr uint32_t RANGE_SIZE = 4096;
+	constexpr uint32_t RANGE_COUNT = AsyncFileReader::QUEUE_DEPTH * 4;
+	constexpr uint32_t BATCH_COUNT = 8;
+	// a deadlock fails the test instead of hanging ctest
+	constexpr auto TIMEOUT = std::chrono::seconds(60);
+
+	std::byte expectedByte(uint64_t offset)
+	{
+		return static_cast<std::byte>((offset * 31 + offset / 251) & 0xff);
+	}
+
+	std::filesystem::path writeTestFile()
+	{
+		const std::filesystem::path path = std::filesystem::temp_directory_path() / "async_file_reader_tests.bin";
+		std::vector<std::byte> contents(static_cast<size_t>(RANGE_SIZE) * RANGE_COUNT);
+		for (size_t i = 0; i < contents.size(); i++) {
+			contents[i] = expectedByte(i);
+		}
+		std::ofstream file{path, std::ios::binary};
+		file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+		return path;
+	}
+
+	// every range of the file, in reverse so the reads don't just run through it in order
+	struct Destination
+	{
+		std::vector<std::byte> bytes = std::vector<std::byte>(static_cast<size_t>(RANGE_SIZE) * RANGE_COUNT);
+
+		std::vector<AsyncFileReader::Range> ranges()
+		{
+			std::vector<AsyncFileReader::Range> ranges;
+			for (uint32_t i = RANGE_COUNT; i-- > 0;) {
+				const uint64_t offset = static_cast<uint64_t>(i) * RANGE_SIZE;
+				ranges.push_back({offset, std::span{bytes}.subspan(offset, RANGE_SIZE)});
+			}
+			return ranges;
+		}
+
+		bool matches() const
+		{
+			for (size_t i = 0; i < bytes.size(); i++) {
+				if (bytes[i] != expectedByte(i)) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	// a read that never finishes may block the thread that queues it, so the whole test runs against the clock
+	void startWatchdog()
+	{
+		std::thread{[]() {
+			std::this_thread::sleep_for(TIMEOUT);
+			std::fprintf(stderr, "the reads didn't finish within %lld s\n", static_cast<long long>(TIMEOUT.count()));
+			std::_Exit(1);
+		}}.detach();
+	}
+
+	bool succeeds(std::future<void>& future)
+	{
+		try {
+			future.get();
+			return true;
+		} catch (...) {
+			return false;
+		}
+	}
+
+	void testFullQueue(AsyncFileReader& reader, const std::string& path)
+	{
+		// every batch alone has more ranges than the queue holds
+		std::vector<Destination> destinations(BATCH_COUNT);
+		std::vector<std::future<void>> futures;
+		for (Destination& destination : destinations) {
+			futures.push_back(reader.read(path, destination.ranges()));
+		}
+		for (size_t i = 0; i < futures.size(); i++) {
+			IG_CHECK(succeeds(futures[i]));
+			IG_CHECK(destinations[i].matches());
+		}
+
+		// a range past the end fails its batch and leaves the others alone
+		std::vector<std::byte> past(RANGE_SIZE);
+		std::future<void> failing = reader.read(path, {{static_cast<uint64_t>(RANGE_SIZE) * RANGE_COUNT, past}});
+		Destination whole;
+		std::future<void> passing = reader.read(path, whole.ranges());
+		IG_CHECK(!succeeds(failing));
+		IG_CHECK(succeeds(passing));
+		IG_CHECK(whole.matches());
+	}
+
+	void testReadFromCallback(AsyncFileReader& reader, const std::string& path)
+	{
+		// each callback queues another full batch while the others still hold every entry of the queue
+		std::vector<Destination> outer(BATCH_COUNT);
+		std::vector<Destination> inner(BATCH_COUNT);
+		std::vector<std::promise<std::future<void>>> innerFutures(BATCH_COUNT);
+		std::vector<std::future<void>> futures;
+		for (uint32_t i = 0; i < BATCH_COUNT; i++) {
+			futures.push_back(reader.read(path, outer[i].ranges(), [&, i](std::exception_ptr error) {
+				if (!error) {
+					innerFutures[i].set_value(reader.read(path, inner[i].ranges()));
+				}
+			}));
+		}
+		for (uint32_t i = 0; i < BATCH_COUNT; i++) {
+			IG_CHECK(succeeds(futures[i]));
+			IG_CHECK(outer[i].matches());
+			std::future<void> innerFuture = innerFutures[i].get_future().get();
+			IG_CHECK(succeeds(innerFuture));
+			IG_CHECK(inner[i].matches());
+		}
+	}
+}
+
+int main()
+{
+	Log::init();
+	startWatchdog();
+	const std::filesystem::path path = writeTestFile();
+
+	for (const bool allowIoUring : {true, false}) {
+		AsyncFileReader reader{allowIoUring};
+		IG_CHECK(allowIoUring || !reader.usesIoUring());
+		testFullQueue(reader, path.string());
+		testReadFromCallback(reader, path.string());
+	}
+
+	std::filesystem::remove(path);
+	return bve::test::result();
+}
@@ -0,0 +1,146 @@
+#include "pch.h"
+#include "test.h"
+#include "core/compression.h"
+
+#include <cstdint>
+#include <vector>
+
+// Blocks decompress to exactly what was compressed, and truncated or corrupt blocks are rejected without reading or
+// writing outside their buffers.
+
+namespace
+{
+	using namespace bve;
+
+	std::vector<std::byte> compress(std::span<const std::byte> data)
+	{
+		std::vector<std::byte> compressed(compression::getCompressBound(data.size()));
+		compressed.resize(compression::compressBlock(data, compressed));
+		return compressed;
+	}
+
+	// a simple generator so failures reproduce
+	std::vector<std::byte> randomBytes(size_t size, uint32_t seed)
+	{
+		std::vector<std::byte> bytes(size);
+		for (std::byte& byte : bytes) {
+			seed = seed * 1664525u + 1013904223u;
+			byte = static_cast<std::byte>(seed >> 24);
+		}
+		return bytes;
+	}
+
+	std::vector<std::vector<std::byte>> makeInputs()
+	{
+		std::vector<std::vector<std::byte>> inputs;
+		inputs.emplace_back();
+		inputs.push_back(randomBytes(5, 1)); // too short to hold a match
+		inputs.push_back(randomBytes(13, 2));
+		inputs.push_back(randomBytes(70000, 3)); // doesn't compress
+
+		// a run is a match overlapping the bytes it produces
+		inputs.emplace_back(1000, std::byte{0x2a});
+
+		// literal and match lengths past 15 continue in extra bytes
+		std::vector<std::byte> text;
+		for (int i = 0; i < 2000; i++) {
+			const std::vector<std::byte> word = randomBytes(static_cast<size_t>(3 + i % 40), static_cast<uint32_t>(i % 7));
+			text.insert(text.end(), word.begin(), word.end());
+		}
+		inputs.push_back(std::move(text));
+
+		// a repeat further back than a match can reach
+		std::vector<std::byte> distant = randomBytes(70000, 4);
+		const std::vector<std::byte> head(distant.begin(), distant.begin() + 100);
+		distant.insert(distant.end(), head.begin(), head.end());
+		inputs.push_back(std::move(distant));
+		return inputs;
+	}
+
+	void testRoundTrip()
+	{
+		for (const std::vector<std::byte>& input : makeInputs()) {
+			const std::vector<std::byte> compressed = compress(input);
+			IG_CHECK(compressed.size() <= compression::getCompressBound(input.size()));
+
+			std::vector<std::byte> output(input.size());
+			IG_CHECK(compression::decompressBlock(compressed, output));
+			IG_CHECK(output == input);
+
+			// the destination must be exactly the decompressed size
+			std::vector<std::byte> larger(input.size() + 1);
+			IG_CHECK(!compression::decompressBlock(compressed, larger));
+			if (!input.empty()) {
+				std::vector<std::byte> smaller(input.size() - 1);
+				IG_CHECK(!compression::decompressBlock(compressed, smaller));
+			}
+		}
+
+		IG_CHECK(compress(std::vector<std::byte>(4096)).size() < 64);
+	}
+
+	void testTruncated()
+	{
+		for (const std::vector<std::byte>& input : makeInputs()) {
+			const std::vector<std::byte> compressed = compress(input);
+			std::vector<std::byte> output(input.size());
+			const size_t step = std::max<size_t>(compressed.size() / 512, 1);
+			for (size_t size = 0; size < compressed.size(); size += step) {
+				IG_CHECK(!compression::decompressBlock(std::span{compressed}.first(size), output));
+			}
+			IG_CHECK(!compression::decompressBlock(std::span{compressed}.first(compressed.size() - 1), output));
+		}
+	}
+
+	// any answer is fine for a damaged block as long as nothing outside the buffers is touched
+	void testCorrupt()
+	{
+		for (const std::vector<std::byte>& input : makeInputs()) {
+			const std::vector<std::byte> compressed = compress(input);
+			std::vector<std::byte> output(input.size());
+			const size_t step = std::max<size_t>(compressed.size() / 512, 1);
+			for (size_t i = 0; i < compressed.size(); i += step) {
+				for (const std::byte flip : {std::byte{0x01}, std::byte{0x80}, std::byte{0xff}}) {
+					std::vector<std::byte> corrupt = compressed;
+					corrupt[i] ^= flip;
+					compression::decompressBlock(corrupt, output);
+				}
+			}
+		}
+
+		std::vector<std::byte> output(64);
+		const auto decompress = [&](std::initializer_list<uint8_t> bytes) {
+			std::vector<std::byte> block;
+			for (const uint8_t byte : bytes) {
+				block.push_back(static_cast<std::byte>(byte));
+			}
+			return compression::decompressBlock(block, output);
+		};
+
+		// a match before any output, and one reaching further back than what was written
+		IG_CHECK(!decompress({0x00, 0x01, 0x00, 0x00}));
+		IG_CHECK(!decompress({0x10, 0x41, 0x02, 0x00, 0x00}));
+		// a match with no distance
+		IG_CHECK(!decompress({0x10, 0x41, 0x00, 0x00, 0x00}));
+		// a literal length that keeps going to the end of the block
+		IG_CHECK(!decompress({0xf0, 0xff, 0xff, 0xff}));
+		// more literals than the block holds, and more than the destination does
+		IG_CHECK(!decompress({0x50, 0x41, 0x42}));
+		output.resize(2);
+		IG_CHECK(!decompress({0x30, 0x41, 0x42, 0x43}));
+		// a block has to end in literals, even once the destination is full
+		output.resize(9);
+		IG_CHECK(!decompress({0x14, 0x41, 0x01, 0x00}));
+		// a match overlapping its own output repeats it
+		IG_CHECK(decompress({0x11, 0x41, 0x01, 0x00, 0x30, 0x41, 0x41, 0x41}));
+		IG_CHECK(output == std::vector<std::byte>(9, std::byte{0x41}));
+	}
+}
+
+int main()
+{
+	testRoundTrip();
+	testTruncated();
+	testCorrupt();
+	return bve::test::result();
+}
@@ -0,0 +1,172 @@
+#include "pch.h"
+#include "test.h"
+#include "culling.h"
+#include "mesh_optimizer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <vector>
+
+// Frustum planes of the engine's projection and meshlet cone culling against cases with a known answer.
+
+namespace
+{
+	using namespace bve;
+
+	constexpr float NEAR = 0.1f;
+	constexpr float FAR = 100.f;
+	constexpr float EPSILON = 1e-4f;
+
+	// the same matrix CameraSystem::setPerspectiveProjection builds, depth from 0 at near to w at far
+	glm::mat4 perspective(float fovy, float aspect)
+	{
+		const float tanHalfFovy = std::tan(fovy / 2.f);
+		glm::mat4 projection{0.f};
+		projection[0][0] = 1.f / (aspect * tanHalfFovy);
+		projection[1][1] = 1.f / tanHalfFovy;
+		projection[2][2] = FAR / (FAR - NEAR);
+		projection[2][3] = 1.f;
+		projection[3][2] = -(FAR * NEAR) / (FAR - NEAR);
+		return projection;
+	}
+
+	bool nearlyEqual(const glm::vec4& a, const glm::vec4& b)
+	{
+		return glm::all(glm::lessThanEqual(glm::abs(a - b), glm::vec4{EPSILON * FAR}));
+	}
+
+	// every plane at distance one from the origin facing it, so nothing is outside
+	Frustum everything()
+	{
+		Frustum frustum{};
+		frustum.planes.fill(glm::vec4{0.f, 0.f, 0.f, 1.f});
+		return frustum;
+	}
+
+	void testFrustumDepthRange()
+	{
+		const Frustum frustum = Frustum::fromMatrix(perspective(glm::radians(90.f), 1.f));
+
+		// clipping 0 <= z <= w puts the planes at the near and far distances, -w <= z <= w would not
+		IG_CHECK(nearlyEqual(frustum.planes[4], glm::vec4{0.f, 0.f, 1.f, -NEAR}));
+		IG_CHECK(nearlyEqual(frustum.planes[5], glm::vec4{0.f, 0.f, -1.f, FAR}));
+
+		const float radius = 0.01f;
+		IG_CHECK(!frustum.intersectsSphere({0.f, 0.f, NEAR - 2.f * radius}, radius));
+		IG_CHECK(frustum.intersectsSphere({0.f, 0.f, NEAR + 2.f * radius}, radius));
+		IG_CHECK(frustum.intersectsSphere({0.f, 0.f, NEAR - 0.5f * radius}, radius));
+		IG_CHECK(frustum.intersectsSphere({0.f, 0.f, FAR - 2.f * radius}, radius));
+		IG_CHECK(!frustum.intersectsSphere({0.f, 0.f, FAR + 2.f * radius}, radius));
+		IG_CHECK(!frustum.intersectsSphere({0.f, 0.f, -1.f}, 0.5f));
+
+		// with a 90 degree field of view the side planes are the diagonals x = +-z and y = +-z
+		IG_CHECK(frustum.intersectsSphere({9.f, 0.f, 10.f}, 0.5f));
+		IG_CHECK(!frustum.intersectsSphere({11.f, 0.f, 10.f}, 0.5f));
+		IG_CHECK(frustum.intersectsSphere({11.f, 0.f, 10.f}, 1.f));
+		IG_CHECK(!frustum.intersectsSphere({0.f, -11.f, 10.f}, 0.5f));
+		IG_CHECK(frustum.intersectsSphere({0.f, -9.f, 10.f}, 0.5f));
+	}
+
+	void testConeKnownAnswer()
+	{
+		// every triangle faces +z, so the meshlet is back facing from anywhere below z = 9
+		mesh_optimizer::Meshlet meshlet{0, 3, 3, glm::vec3{0.f, 0.f, 10.f}, 1.f, glm::vec3{0.f, 0.f, 1.f}, 0.f};
+
+		MeshletCullView view{};
+		view.frustum = everything();
+		view.modelMatrix = glm::mat4{1.f};
+		view.maxScale = 1.f;
+		view.perspective = true;
+		view.coneCulling = true;
+
+		std::vector<IndexRange> ranges;
+		view.cameraPosition = glm::vec3{0.f};
+		IG_CHECK(cullMeshlets({&meshlet, 1}, view, ranges) == 0);
+		view.cameraPosition = glm::vec3{5.f, 0.f, 0.f};
+		IG_CHECK(cullMeshlets({&meshlet, 1}, view, ranges) == 0);
+		view.cameraPosition = glm::vec3{0.f, 0.f, 20.f};
+		IG_CHECK(cullMeshlets({&meshlet, 1}, view, ranges) == 1);
+		// inside the bounding sphere some triangle may face the camera
+		view.cameraPosition = glm::vec3{0.f, 0.f, 9.5f};
+		IG_CHECK(cullMeshlets({&meshlet, 1}, view, ranges) == 1);
+
+		// culling off keeps it whatever the camera sees
+		view.coneCulling = false;
+		view.cameraPosition = glm::vec3{0.f};
+		IG_CHECK(cullMeshlets({&meshlet, 1}, view, ranges) == 1);
+
+		// an orthographic view only has a direction
+		view.coneCulling = true;
+		view.perspective = false;
+		view.viewDirection = glm::vec3{0.f, 0.f, 1.f};
+		IG_CHECK(cullMeshlets({&meshlet, 1}, view, ranges) == 0);
+		view.viewDirection = glm::normalize(glm::vec3{1.f, 0.f, -0.1f});
+		IG_CHECK(cullMeshlets({&meshlet, 1}, view, ranges) == 1);
+
+		// a cone wider than a half sphere can never be culled
+		meshlet.coneCutoff = 1.f;
+		view.viewDirection = glm::vec3{0.f, 0.f, 1.f};
+		IG_CHECK(cullMeshlets({&meshlet, 1}, view, ranges) == 1);
+	}
+
+	void testGridMeshlets()
+	{
+		// a flat grid in the z = 0 plane wound counter-clockwise around +z, like every front face the importer produces
+		constexpr uint32_t SIZE = 32;
+		std::vector<glm::vec3> positions;
+		for (uint32_t y = 0; y <= SIZE; y++) {
+			for (uint32_t x = 0; x <= SIZE; x++) {
+				positions.emplace_back(static_cast<float>(x), static_cast<float>(y), 0.f);
+			}
+		}
+		std::vector<uint32_t> indices;
+		for (uint32_t y = 0; y < SIZE; y++) {
+			for (uint32_t x = 0; x < SIZE; x++) {
+				const uint32_t corner = y * (SIZE + 1) + x;
+				indices.insert(indices.end(), {corner, corner + 1, corner + SIZE + 2, corner, corner + SIZE + 2, corner + SIZE + 1});
+			}
+		}
+
+		const std::vector<mesh_optimizer::Meshlet> meshlets = mesh_optimizer::buildMeshlets(indices, positions);
+		IG_CHECK(meshlets.size() > 1);
+		for (const mesh_optimizer::Meshlet& meshlet : meshlets) {
+			IG_CHECK(glm::length(meshlet.coneAxis - glm::vec3{0.f, 0.f, 1.f}) < EPSILON);
+			IG_CHECK(meshlet.coneCutoff < EPSILON);
+		}
+
+		MeshletCullView view{};
+		view.frustum = everything();
+		view.modelMatrix = glm::mat4{1.f};
+		view.maxScale = 1.f;
+		view.perspective = true;
+		view.coneCulling = true;
+
+		// seen from the front everything stays and the ranges merge into one draw
+		std::vector<IndexRange> ranges;
+		view.cameraPosition = glm::vec3{16.f, 16.f, 10.f};
+		IG_CHECK(cullMeshlets(meshlets, view, ranges) == meshlets.size());
+		IG_CHECK(ranges.size() == 1 && ranges[0].firstIndex == 0 && ranges[0].indexCount == indices.size());
+
+		ranges.clear();
+		view.cameraPosition = glm::vec3{16.f, 16.f, -10.f};
+		IG_CHECK(cullMeshlets(meshlets, view, ranges) == 0);
+		IG_CHECK(ranges.empty());
+
+		// moved behind a camera looking down +z, the frustum drops the grid whichever way it faces
+		view.coneCulling = false;
+		view.frustum = Frustum::fromMatrix(perspective(glm::radians(90.f), 1.f));
+		view.modelMatrix = glm::translate(glm::mat4{1.f}, glm::vec3{-16.f, -16.f, -20.f});
+		IG_CHECK(cullMeshlets(meshlets, view, ranges) == 0);
+		view.modelMatrix = glm::translate(glm::mat4{1.f}, glm::vec3{-16.f, -16.f, 20.f});
+		IG_CHECK(cullMeshlets(meshlets, view, ranges) == meshlets.size());
+	}
+}
+
+int main()
+{
+	testFrustumDepthRange();
+	testConeKnownAnswer();
+	testGridMeshlets();
+	return bve::test::result();
+}
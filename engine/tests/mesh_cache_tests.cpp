@@ -0,0 +1,107 @@
+#include "pch.h"
+#include "test.h"
+#include "bve_model.h"
+#include "mesh_cache.h"
+#include "log.h"
+
+#include <cstring>
+#include <vector>
+
+// Caches read back as they were written, and damaged ones are rejected instead of handing the renderer indices past
+// its vertices.
+
+namespace
+{
+	using namespace bve;
+
+	constexpr uint64_t SOURCE_HASH = 0x1234;
+
+	struct Image
+	{
+		BveModel::Builder builder{};
+		mesh_cache::Key key{};
+		std::vector<std::byte> bytes;
+
+		explicit Image(BveModel::VertexFormat format)
+		{
+			builder.vertexFormat = format;
+			builder.loadModel("models/cube.obj");
+			key = mesh_cache::makeKey(SOURCE_HASH, builder);
+			bytes = mesh_cache::serialize(key, builder.pack().data);
+		}
+
+		std::optional<BveModel::MeshData> parse() const { return mesh_cache::parse(bytes, key, true, "test"); }
+	};
+
+	// where the indices start in the image, the parsed mesh points into it
+	size_t findIndices(const Image& image, const BveModel::MeshData& mesh)
+	{
+		return static_cast<size_t>(mesh.indices.data() - reinterpret_cast<const std::byte*>(image.bytes.data()));
+	}
+
+	void testRoundTrip(BveModel::VertexFormat format)
+	{
+		const Image image{format};
+		const BveModel::PackedMesh packed = image.builder.pack();
+		const std::optional<BveModel::MeshData> mesh = image.parse();
+		IG_CHECK(mesh.has_value());
+		if (!mesh) {
+			return;
+		}
+		IG_CHECK(mesh->vertexFormat == format);
+		IG_CHECK(mesh->vertexCount == packed.data.vertexCount && mesh->indexCount == packed.data.indexCount);
+		IG_CHECK(std::equal(mesh->vertices.begin(), mesh->vertices.end(), packed.vertices.begin(), packed.vertices.end()));
+		IG_CHECK(std::equal(mesh->indices.begin(), mesh->indices.end(), packed.indices.begin(), packed.indices.end()));
+		IG_CHECK(mesh->lods.size() == packed.lods.size() && mesh->meshlets.size() == image.builder.meshlets.size());
+
+		// another source, importer or set of options is a stale cache
+		mesh_cache::Key other = image.key;
+		other.sourceHash++;
+		IG_CHECK(!mesh_cache::parse(image.bytes, other, true, "test"));
+		IG_CHECK(mesh_cache::parse(image.bytes, other, false, "test").has_value());
+		other = image.key;
+		other.options ^= 1 << 9;
+		IG_CHECK(!mesh_cache::parse(image.bytes, other, true, "test"));
+	}
+
+	void testTruncated()
+	{
+		const Image image{BveModel::VertexFormat::PACKED};
+		for (size_t size : {size_t{0}, size_t{16}, image.bytes.size() / 2, image.bytes.size() - 1}) {
+			const std::vector<std::byte> truncated(image.bytes.begin(), image.bytes.begin() + static_cast<std::ptrdiff_t>(size));
+			IG_CHECK(!mesh_cache::parse(truncated, image.key, true, "test"));
+		}
+	}
+
+	void testIndexPastVertices(BveModel::VertexFormat format)
+	{
+		Image image{format};
+		const std::optional<BveModel::MeshData> mesh = image.parse();
+		IG_CHECK(mesh.has_value());
+		if (!mesh) {
+			return;
+		}
+
+		// the last index of the last level points one past the vertices
+		const size_t offset = findIndices(image, *mesh) + (static_cast<size_t>(mesh->indexCount) - 1) * mesh->indexSize;
+		const uint32_t vertexCount = mesh->vertexCount;
+		if (mesh->indexSize == sizeof(uint16_t)) {
+			const auto index = static_cast<uint16_t>(vertexCount);
+			std::memcpy(image.bytes.data() + offset, &index, sizeof(index));
+		} else {
+			std::memcpy(image.bytes.data() + offset, &vertexCount, sizeof(vertexCount));
+		}
+		IG_CHECK(!image.parse());
+	}
+}
+
+int main()
+{
+	Log::init();
+	for (const auto format : {BveModel::VertexFormat::PACKED, BveModel::VertexFormat::FULL}) {
+		testRoundTrip(format);
+		testIndexPastVertices(format);
+	}
+	testTruncated();
+	return bve::test::result();
+}
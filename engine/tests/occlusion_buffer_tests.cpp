@@ -0,0 +1,138 @@
+#include "pch.h"
+#include "test.h"
+#include "occlusion_buffer.h"
+
+#include <cmath>
+#include <vector>
+
+// Occluders hide what is behind them and nothing else, down to gaps and silhouettes thinner than a pixel.
+
+namespace
+{
+	using namespace bve;
+
+	constexpr float NEAR = 0.1f;
+	constexpr float FAR = 100.f;
+	constexpr uint32_t SIZE = 256;
+
+	// the camera sits at the origin looking down +z, with a 90 degree field of view a pixel column x is at
+	// world x = (2 * x / SIZE - 1) * z
+	glm::mat4 projection()
+	{
+		glm::mat4 projection{0.f};
+		projection[0][0] = 1.f;
+		projection[1][1] = 1.f;
+		projection[2][2] = FAR / (FAR - NEAR);
+		projection[2][3] = 1.f;
+		projection[3][2] = -(FAR * NEAR) / (FAR - NEAR);
+		return projection;
+	}
+
+	float worldAt(float pixel, float z)
+	{
+		return (2.f * pixel / static_cast<float>(SIZE) - 1.f) * z;
+	}
+
+	struct Mesh
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+
+		// a rectangle facing the camera, split along its diagonal
+		void addQuad(float minX, float minY, float maxX, float maxY, float z)
+		{
+			const uint32_t first = static_cast<uint32_t>(positions.size());
+			positions.insert(positions.end(), {{minX, minY, z}, {maxX, minY, z}, {maxX, maxY, z}, {minX, maxY, z}});
+			indices.insert(indices.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+		}
+	};
+
+	// a box whose front covers the pixel columns [minX, maxX] around the middle rows, at the given depth
+	bool isVisible(const OcclusionBuffer& buffer, float minX, float maxX, float z)
+	{
+		const float y = worldAt(SIZE / 2.f, z);
+		return buffer.isVisible({worldAt(minX, z), y - 0.05f, z}, {worldAt(maxX, z), y + 0.05f, z + 0.01f});
+	}
+
+	void rasterize(OcclusionBuffer& buffer, const Mesh& mesh)
+	{
+		buffer.beginFrame(projection(), SIZE, SIZE);
+		buffer.addOccluder(mesh.positions, mesh.indices, glm::mat4{1.f});
+		buffer.rasterize();
+	}
+
+	void testFullScreenQuad()
+	{
+		Mesh mesh;
+		mesh.addQuad(-100.f, -100.f, 100.f, 100.f, 10.f);
+		OcclusionBuffer buffer;
+		rasterize(buffer, mesh);
+
+		IG_CHECK(!isVisible(buffer, 120.f, 136.f, 20.f));
+		// the quad's diagonal runs through the middle, the two halves still cover every pixel along it
+		IG_CHECK(!isVisible(buffer, 10.f, 250.f, 20.f));
+		IG_CHECK(isVisible(buffer, 120.f, 136.f, 5.f));
+		// crossing the occluder
+		IG_CHECK(buffer.isVisible({-1.f, -1.f, 5.f}, {1.f, 1.f, 20.f}));
+	}
+
+	void testQuadBeside()
+	{
+		// covers the left half of the screen
+		Mesh mesh;
+		mesh.addQuad(-100.f, -100.f, 0.f, 100.f, 10.f);
+		OcclusionBuffer buffer;
+		rasterize(buffer, mesh);
+
+		IG_CHECK(!isVisible(buffer, 40.f, 100.f, 20.f));
+		IG_CHECK(isVisible(buffer, 150.f, 200.f, 20.f));
+		IG_CHECK(isVisible(buffer, 100.f, 150.f, 20.f));
+		IG_CHECK(!isVisible(buffer, 100.f, 127.9f, 20.f));
+	}
+
+	void testSubPixelGap()
+	{
+		// the gap between the quads runs from 100.6 to 100.9 across column 100, whose centre is inside the left one
+		constexpr float Z = 10.f;
+		Mesh mesh;
+		mesh.addQuad(-100.f, -100.f, worldAt(100.6f, Z), 100.f, Z);
+		mesh.addQuad(worldAt(100.9f, Z), -100.f, 100.f, 100.f, Z);
+		OcclusionBuffer buffer;
+		rasterize(buffer, mesh);
+
+		IG_CHECK(isVisible(buffer, 100.7f, 100.8f, 20.f));
+		IG_CHECK(!isVisible(buffer, 60.f, 99.9f, 20.f));
+		IG_CHECK(!isVisible(buffer, 101.1f, 200.f, 20.f));
+	}
+
+	void testSilhouette()
+	{
+		// a closed cube whose front face ends at column 142.8, every edge of it is shared with a side face that
+		// folds back behind the silhouette
+		constexpr float FRONT = 9.f;
+		const float halfSize = worldAt(142.8f, FRONT);
+		const float back = FRONT + 2.f * halfSize;
+		Mesh mesh;
+		mesh.positions = {
+			{-halfSize, -halfSize, FRONT}, {halfSize, -halfSize, FRONT}, {halfSize, halfSize, FRONT}, {-halfSize, halfSize, FRONT},
+			{-halfSize, -halfSize, back}, {halfSize, -halfSize, back}, {halfSize, halfSize, back}, {-halfSize, halfSize, back}};
+		mesh.indices = {
+			0, 1, 2, 0, 2, 3, 5, 4, 7, 5, 7, 6,
+			1, 5, 6, 1, 6, 2, 4, 0, 3, 4, 3, 7,
+			3, 2, 6, 3, 6, 7, 4, 5, 1, 4, 1, 0};
+		OcclusionBuffer buffer;
+		rasterize(buffer, mesh);
+
+		IG_CHECK(isVisible(buffer, 142.6f, 142.7f, 30.f));
+		IG_CHECK(!isVisible(buffer, 128.f, 141.9f, 30.f));
+	}
+}
+
+int main()
+{
+	testFullScreenQuad();
+	testQuadBeside();
+	testSubPixelGap();
+	testSilhouette();
+	return bve::test::result();
+}
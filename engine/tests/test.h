@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdio>
+
+// The engine tests are plain executables run by ctest from the engine directory, so the bundled models are found at
+// models/. A failed check is reported and the test carries on, main returns bve::test::result() at the end.
+namespace bve::test
+{
+	inline int failures = 0;
+
+	inline void check(bool passed, const char* expression, const char* file, int line)
+	{
+		if (!passed) {
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+			failures++;
+		}
+	}
+
+	inline int result()
+	{
+		if (failures > 0) {
+			std::fprintf(stderr, "%d checks failed\n", failures);
+			return 1;
+		}
+		return 0;
+	}
+}
+
+#define IG_CHECK(condition) ::bve::test::check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
@@ -0,0 +1,126 @@
+#include "pch.h"
+#include "bve_model.h"
+#include "gltf_importer.h"
+#include "import_database.h"
+#include "log.h"
+
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Imports every OBJ and GLB mesh under the inputs whose caches are missing or stale, in parallel, writing the caches
+// next to the sources as the runtime would. The database remembers what was imported from what, so a run over
+// unchanged sources only stats them. Paths are stored as given, so run it from the directory the application
+// runs from and share the database with it.
+//
+// AssetImporter [--database <file>] [--formats packed,full] <file or directory>...
+
+namespace
+{
+	using namespace bve;
+
+	struct ImporterOptions
+	{
+		std::string databasePath = "models.igdb";
+		std::vector<BveModel::VertexFormat> vertexFormats{BveModel::VertexFormat::PACKED};
+		std::vector<std::filesystem::path> inputs;
+	};
+
+	ImporterOptions parseOptions(int argc, char** argv)
+	{
+		ImporterOptions options{};
+		for (int i = 1; i < argc; i++) {
+			const char* arg = argv[i];
+			if (arg[0] != '-') {
+				options.inputs.emplace_back(arg);
+				continue;
+			}
+
+			const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+			if (!value) {
+				throw std::runtime_error(std::string{"missing value for argument: "} + arg);
+			}
+
+			if (std::strcmp(arg, "--database") == 0) {
+				options.databasePath = value;
+			} else if (std::strcmp(arg, "--formats") == 0) {
+				options.vertexFormats.clear();
+				std::stringstream formats{value};
+				std::string format;
+				while (std::getline(formats, format, ',')) {
+					if (format == "packed") {
+						options.vertexFormats.push_back(BveModel::VertexFormat::PACKED);
+					} else if (format == "full") {
+						options.vertexFormats.push_back(BveModel::VertexFormat::FULL);
+					} else {
+						throw std::runtime_error("unknown vertex format: " + format);
+					}
+				}
+			} else {
+				throw std::runtime_error(std::string{"unknown argument: "} + arg);
+			}
+			i++;
+		}
+
+		if (options.inputs.empty() || options.vertexFormats.empty()) {
+			throw std::runtime_error("usage: AssetImporter [--database <file>] [--formats packed,full] <file or directory>...");
+		}
+		return options;
+	}
+
+	// every mesh of a glb is a source of its own
+	void addSources(const std::filesystem::path& path, std::vector<std::string>& sources)
+	{
+		const std::string extension = path.extension().string();
+		const std::string source = path.lexically_normal().generic_string();
+		if (extension == ".obj") {
+			sources.push_back(source);
+		} else if (extension == ".glb") {
+			const uint32_t meshCount = gltf::Document::open(source)->getMeshCount();
+			for (uint32_t mesh = 0; mesh < meshCount; mesh++) {
+				sources.push_back(gltf::getMeshPath(source, mesh));
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Log::init();
+
+	try {
+		const auto start = std::chrono::steady_clock::now();
+		const ImporterOptions options = parseOptions(argc, argv);
+
+		std::vector<std::string> sources;
+		for (const std::filesystem::path& input : options.inputs) {
+			if (!std::filesystem::is_directory(input)) {
+				addSources(input, sources);
+				continue;
+			}
+			for (const auto& file : std::filesystem::recursive_directory_iterator{input}) {
+				if (file.is_regular_file()) {
+					addSources(file.path(), sources);
+				}
+			}
+		}
+
+		ImportDatabase database{options.databasePath};
+		const ImportDatabase::ImportSummary summary = database.importStale(sources, options.vertexFormats);
+		if (!database.save()) {
+			return 1;
+		}
+
+		LOG_INFO("imported {}, {} already current, {} failed in {:.1f} ms", summary.imported, summary.current, summary.failed,
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		return summary.failed == 0 ? 0 : 1;
+	} catch (const std::exception& e) {
+		LOG_ERROR("asset import failed: {}", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,176 @@
+#include "pch.h"
+#include "asset_archive.h"
+#include "bve_model.h"
+#include "gltf_importer.h"
+#include "mesh_cache.h"
+#include "core/mapped_file.h"
+#include "log.h"
+
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Packs assets into an archive for AssetManager::mountArchive. OBJ files and every mesh of a GLB file are imported
+// once per requested vertex format and stored as mesh caches, named like the cache that would be written next to the source, so the
+// runtime finds them by the path it loads. Other files are stored as they are. Names are relative to --root,
+// which should be the directory the application runs from.
+//
+// AssetPacker -o <archive> [--root <directory>] [--compress] [--formats packed,full] <file or directory>...
+
+namespace
+{
+	using namespace bve;
+
+	struct PackerOptions
+	{
+		std::string outputPath;
+		std::filesystem::path root = std::filesystem::current_path();
+		bool compress = false;
+		std::vector<BveModel::VertexFormat> vertexFormats{BveModel::VertexFormat::PACKED};
+		std::vector<std::filesystem::path> inputs;
+	};
+
+	PackerOptions parseOptions(int argc, char** argv)
+	{
+		PackerOptions options{};
+		for (int i = 1; i < argc; i++) {
+			const char* arg = argv[i];
+			if (std::strcmp(arg, "--compress") == 0) {
+				options.compress = true;
+				continue;
+			}
+			if (arg[0] != '-') {
+				options.inputs.emplace_back(arg);
+				continue;
+			}
+
+			const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+			if (!value) {
+				throw std::runtime_error(std::string{"missing value for argument: "} + arg);
+			}
+
+			if (std::strcmp(arg, "-o") == 0) {
+				options.outputPath = value;
+			} else if (std::strcmp(arg, "--root") == 0) {
+				options.root = value;
+			} else if (std::strcmp(arg, "--formats") == 0) {
+				options.vertexFormats.clear();
+				std::stringstream formats{value};
+				std::string format;
+				while (std::getline(formats, format, ',')) {
+					if (format == "packed") {
+						options.vertexFormats.push_back(BveModel::VertexFormat::PACKED);
+					} else if (format == "full") {
+						options.vertexFormats.push_back(BveModel::VertexFormat::FULL);
+					} else {
+						throw std::runtime_error("unknown vertex format: " + format);
+					}
+				}
+			} else {
+				throw std::runtime_error(std::string{"unknown argument: "} + arg);
+			}
+			i++;
+		}
+
+		if (options.outputPath.empty() || options.inputs.empty() || options.vertexFormats.empty()) {
+			throw std::runtime_error("usage: AssetPacker -o <archive> [--root <directory>] [--compress] [--formats packed,full] <file or directory>...");
+		}
+		return options;
+	}
+
+	std::vector<std::byte> readFile(const std::filesystem::path& path)
+	{
+		const MappedFile file{path.string()};
+		return {file.data(), file.data() + file.size()};
+	}
+
+	// the name the runtime looks the file up by
+	std::string getEntryName(const std::filesystem::path& path, const std::filesystem::path& root)
+	{
+		const std::string name = std::filesystem::relative(path, root).lexically_normal().generic_string();
+		if (name.empty() || name.starts_with("..")) {
+			throw std::runtime_error(path.string() + " is outside of the root " + root.string());
+		}
+		return name;
+	}
+
+	void addFile(const std::filesystem::path& path, const PackerOptions& options, std::vector<AssetArchive::Source>& sources)
+	{
+		const std::string extension = path.extension().string();
+		// caches next to the sources are packed under their source, below
+		if (extension == ".bmesh" || extension == ".tmp") {
+			return;
+		}
+
+		const std::string name = getEntryName(path, options.root);
+		if (extension != ".obj" && extension != ".glb") {
+			sources.push_back({name, readFile(path), options.compress});
+			return;
+		}
+
+		// every mesh of a glb is packed under its own path, the file itself is still read for its nodes
+		std::vector<std::pair<std::string, std::string>> meshes; // source path, entry name
+		if (extension == ".glb") {
+			const uint32_t meshCount = gltf::Document::open(path.string())->getMeshCount();
+			for (uint32_t mesh = 0; mesh < meshCount; mesh++) {
+				meshes.emplace_back(gltf::getMeshPath(path.string(), mesh), gltf::getMeshPath(name, mesh));
+			}
+		} else {
+			meshes.emplace_back(path.string(), name);
+		}
+
+		for (const auto& [meshPath, meshName] : meshes) {
+			const uint64_t sourceHash = mesh_cache::hashSource(meshPath);
+			for (const BveModel::VertexFormat vertexFormat : options.vertexFormats) {
+				BveModel::Builder builder{};
+				builder.vertexFormat = vertexFormat;
+				const mesh_cache::Key key = mesh_cache::makeKey(sourceHash, builder);
+				const std::string entryName = mesh_cache::getCachePath(meshName, vertexFormat);
+
+				// a cache next to the source that is still fresh, like the ones AssetImporter writes, saves importing again
+				if (const std::optional<mesh_cache::CachedMesh> cached = mesh_cache::read(mesh_cache::getCachePath(meshPath, vertexFormat), key)) {
+					sources.push_back({entryName, mesh_cache::serialize(key, cached->data), options.compress});
+					continue;
+				}
+
+				builder.loadModel(meshPath);
+				const BveModel::PackedMesh packed = builder.pack();
+				sources.push_back({entryName, mesh_cache::serialize(key, packed.data), options.compress});
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Log::init();
+
+	try {
+		const PackerOptions options = parseOptions(argc, argv);
+
+		std::vector<AssetArchive::Source> sources;
+		for (const std::filesystem::path& input : options.inputs) {
+			if (!std::filesystem::is_directory(input)) {
+				addFile(input, options, sources);
+				continue;
+			}
+			for (const auto& file : std::filesystem::recursive_directory_iterator{input}) {
+				if (file.is_regular_file()) {
+					addFile(file.path(), options, sources);
+				}
+			}
+		}
+
+		AssetArchive::write(options.outputPath, std::move(sources));
+	} catch (const std::exception& e) {
+		LOG_ERROR("asset packing failed: {}", e.what());
+		return 1;
+	}
+	return 0;
+}